@@ -20,6 +20,7 @@
 
 #include <DemoLib/eng/GameBase.h>
 #include <DemoLib/Viewer.h>
+#include <DemoLib/load/Load.h>
 
 #pragma warning(disable : 4996)
 
@@ -189,6 +190,43 @@ int DemoApp::Run(int argc, char *argv[]) {
             app_params.denoise_after = 1;
         } else if (strcmp(argv[i], "--denoise_after") == 0 && (++i != argc)) {
             app_params.denoise_after = int(strtol(argv[i], nullptr, 10));
+        } else if (strcmp(argv[i], "--calibrate") == 0) {
+            app_params.calibrate_cpu = true;
+        } else if (strcmp(argv[i], "--pixel_order") == 0 && (++i != argc)) {
+            if (strcmp(argv[i], "morton") == 0) {
+                app_params.pixel_order = 1;
+            } else if (strcmp(argv[i], "hilbert") == 0) {
+                app_params.pixel_order = 2;
+            } else {
+                app_params.pixel_order = 0;
+            }
+        } else if (strcmp(argv[i], "--denoise_method") == 0 && (++i != argc)) {
+            app_params.denoise_method = (strcmp(argv[i], "atrous") == 0) ? 1 : 0;
+        } else if (strcmp(argv[i], "--temporal") == 0) {
+            app_params.temporal_accumulation = true;
+        } else if (strcmp(argv[i], "--tex_cache") == 0 && (++i != argc)) {
+            app_params.tex_cache_dir = argv[i];
+        } else if (strcmp(argv[i], "--tex_cache_budget") == 0 && (++i != argc)) {
+            app_params.tex_cache_budget_mb = int(strtol(argv[i], nullptr, 10));
+        } else if (strcmp(argv[i], "--bvh_cache") == 0 && (++i != argc)) {
+            app_params.bvh_cache_dir = argv[i];
+        } else if (strcmp(argv[i], "--snapshot") == 0 && (++i != argc)) {
+            app_params.snapshot_name = argv[i];
+        } else if (strcmp(argv[i], "--stochastic_tex") == 0) {
+            app_params.stochastic_tex_filtering = true;
+        } else if (strcmp(argv[i], "--cpu_tex_compression") == 0) {
+            app_params.cpu_tex_compression = true;
+        } else if (strcmp(argv[i], "--convert_bin") == 0 && (i + 2 < argc)) {
+            const char *in_file_name = argv[++i], *out_file_name = argv[++i];
+            try {
+                if (ConvertBIN(in_file_name, out_file_name)) {
+                    return 0;
+                }
+            } catch (std::exception &e) {
+                fprintf(stderr, "%s\n", e.what());
+            }
+            fprintf(stderr, "Failed to convert %s\n", in_file_name);
+            return -1;
         }
     }
 
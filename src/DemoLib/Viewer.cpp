@@ -63,6 +63,17 @@ Viewer::Viewer(const int w, const int h, const char *local_dir, const AppParams
         Ray::settings_t s;
         s.w = w;
         s.h = h;
+        s.pixel_order = Ray::ePixelOrder(_app_params.pixel_order);
+        s.denoise_method = Ray::eDenoiseMethod(_app_params.denoise_method);
+        s.use_temporal_accumulation = _app_params.temporal_accumulation;
+        s.use_cpu_tex_compression = _app_params.cpu_tex_compression;
+        if (!_app_params.tex_cache_dir.empty()) {
+            s.tex_cache_dir = _app_params.tex_cache_dir.c_str();
+        }
+        s.tex_cache_budget_mb = _app_params.tex_cache_budget_mb;
+        if (!_app_params.bvh_cache_dir.empty()) {
+            s.bvh_cache_dir = _app_params.bvh_cache_dir.c_str();
+        }
 #ifdef ENABLE_GPU_IMPL
         if (!_app_params.device_name.empty()) {
             s.preferred_device = _app_params.device_name.c_str();
@@ -72,7 +83,12 @@ Viewer::Viewer(const int w, const int h, const char *local_dir, const AppParams
         std::shared_ptr<Ray::RendererBase> ray_renderer;
 
         if (gpu_mode == 0) {
-            ray_renderer = std::shared_ptr<Ray::RendererBase>(Ray::CreateRenderer(s, log.get(), Ray::RendererCPU));
+            uint32_t enabled_types = Ray::RendererCPU;
+            if (_app_params.calibrate_cpu) {
+                enabled_types = Ray::CalibrateCPURenderers(log.get(), s, Ray::DefaultCalibratedRenderTypes,
+                                                           "cpu_calibration.txt");
+            }
+            ray_renderer = std::shared_ptr<Ray::RendererBase>(Ray::CreateRenderer(s, log.get(), enabled_types));
         } else {
             s.use_hwrt = (gpu_mode == 2);
             s.use_bindless = !nobindless;
@@ -27,6 +27,16 @@ struct AppParams {
     int denoise_after = -1;
     bool output_exr = false;
     bool output_aux = false;
+    bool calibrate_cpu = false;
+    int pixel_order = 0;    // 0 - scanline, 1 - morton, 2 - hilbert
+    int denoise_method = 0; // 0 - nlm, 1 - a-trous (uses aux buffers)
+    bool temporal_accumulation = false;
+    std::string tex_cache_dir; // directory for out-of-core textures (CPU backends)
+    int tex_cache_budget_mb = 1024;
+    std::string bvh_cache_dir; // directory for prebuilt mesh BVHs (CPU backends)
+    std::string snapshot_name; // whole-scene snapshot, written on first run and restored later (CPU backends)
+    bool stochastic_tex_filtering = false;
+    bool cpu_tex_compression = false;
 };
 
 class Viewer : public GameBase {
@@ -2,17 +2,24 @@
 
 #include <cassert>
 #include <cctype>
+#include <cstring>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <sstream>
 
 #include <Ray/Log.h>
 #include <Ray/RendererBase.h>
 #include <Sys/AssetFile.h>
+#include <Sys/AsyncFileReader.h>
+#include <Sys/MappedFile.h>
 #include <Sys/ThreadPool.h>
 #include <Sys/Time_.h>
 
@@ -32,14 +39,11 @@
 #include <tinyexr/tinyexr.h>
 
 #include "../ren/MMat.h"
-#include "../ren/SmallVector.h"
 #include "../ren/Texture.h"
 #include "../ren/Utils.h"
 
 #include <turbojpeg.h>
 
-#define _abs(x) ((x) > 0.0f ? (x) : -(x))
-
 #define DUMP_BIN_FILES 1
 
 namespace {
@@ -49,166 +53,684 @@ bool ends_with(const std::string &value, const std::string &ending) {
     }
     return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
 }
-} // namespace
 
-std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &js_scene, const int max_tex_res,
-                                          Sys::ThreadPool *threads) {
-    auto new_scene = std::shared_ptr<Ray::SceneBase>(r->CreateScene());
+// Runs func(i) for i in [0, count) on thread pool, calling thread processes items too (so it is safe to wait from
+// pool's own task)
+template <typename F> void ParallelFor(Sys::ThreadPool *threads, const int count, const F &func) {
+    struct state_t {
+        std::atomic_int next = {0}, done = {0};
+        std::mutex mtx;
+        std::condition_variable cnd;
+    };
+    auto state = std::make_shared<state_t>();
+
+    auto process = [state, count, &func]() {
+        for (int i = state->next++; i < count; i = state->next++) {
+            func(i);
+            if (++state->done == count) {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                state->cnd.notify_one();
+            }
+        }
+    };
 
-    std::vector<Ray::CameraHandle> cameras;
-    std::map<std::string, Ray::TextureHandle> textures;
-    std::map<std::string, Ray::MaterialHandle> materials;
-    std::map<std::string, Ray::MeshHandle> meshes;
+    const int helpers_count = threads ? std::min(threads->workers_count(), count - 1) : 0;
+    for (int i = 0; i < helpers_count; ++i) {
+        threads->Enqueue(process);
+    }
+    process();
 
-    // auto jpg_decompressor = std::unique_ptr<void, int (*)(tjhandle)>(tjInitDecompress(), &tjDestroy);
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cnd.wait(lock, [&state, count]() { return state->done == count; });
+}
 
-    thread_local std::unique_ptr<void, int (*)(tjhandle)> jpg_decompressor(nullptr, &tjDestroy);
+bool is_space(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
 
-    auto load_texture = [max_tex_res, &new_scene](const std::string &name, const bool srgb, const bool normalmap,
-                                                  const bool gen_mipmaps) -> Ray::TextureHandle {
+const char *SkipSpaces(const char *p, const char *end) {
+    while (p != end && is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Numbers with up to 7 significant digits are converted with single rounding (result is the same as with strtof),
+// strtof is used for the rest
+const char *ParseFloat(const char *p, const char *end, float &out) {
+    static const float Pow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+    p = SkipSpaces(p, end);
+    const char *beg = p;
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p != end && unsigned(*p - '0') < 10; ++p, ++digits) {
+        mantissa = mantissa * 10 + unsigned(*p - '0');
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && unsigned(*p - '0') < 10; ++p, ++digits) {
+            mantissa = mantissa * 10 + unsigned(*p - '0');
+            --exponent;
+        }
+    }
+    if (digits && p != end && (*p == 'e' || *p == 'E')) {
+        const char *exp_beg = ++p;
+        bool exp_negative = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            exp_negative = (*p == '-');
+            ++p;
+        }
+        int exp_val = 0;
+        for (; p != end && unsigned(*p - '0') < 10 && exp_val < 10000; ++p) {
+            exp_val = exp_val * 10 + (*p - '0');
+        }
+        if (p == exp_beg) {
+            digits = 0; // malformed exponent, leave it to strtof
+        }
+        exponent += exp_negative ? -exp_val : exp_val;
+    }
+
+    const bool terminated = (p == end || is_space(*p) || *p == '\n' || *p == '/');
+    if (digits && digits <= 19 && terminated && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10) {
+        const float val = exponent < 0 ? float(mantissa) / Pow10[-exponent] : float(mantissa) * Pow10[exponent];
+        out = negative ? -val : val;
+        return p;
+    }
+
+    // slow path (many digits, inf, nan etc.)
+    char buf[64];
+    int len = 0;
+    for (p = beg; p != end && !is_space(*p) && *p != '\n' && *p != '/' && len < int(sizeof(buf)) - 1; ++p) {
+        buf[len++] = *p;
+    }
+    buf[len] = '\0';
+    out = strtof(buf, nullptr);
+    return p;
+}
+
+const char *ParseIndex(const char *p, const char *end, long &out) {
+    bool negative = false;
+    if (p != end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    long val = 0;
+    for (; p != end && unsigned(*p - '0') < 10; ++p) {
+        val = val * 10 + (*p - '0');
+    }
+    out = negative ? -val : val;
+    return p;
+}
+
+struct obj_chunk_t {
+    const char *beg, *end;
+    std::vector<float> v, vn, vt;
+    std::vector<uint32_t> corners; // (position, uv, normal) index triplets
+    std::vector<uint32_t> groups;  // group starts (in local corners)
+    bool error = false;
+};
+
+void ParseOBJChunk(obj_chunk_t &chunk) {
+    const char *p = chunk.beg, *end = chunk.end;
+    while (p < end) {
+        const char *line_end = reinterpret_cast<const char *>(memchr(p, '\n', end - p));
+        if (!line_end) {
+            line_end = end;
+        }
+
+        p = SkipSpaces(p, line_end);
+        const ptrdiff_t len = line_end - p;
+
+        if (len > 1 && p[0] == 'v' && is_space(p[1])) {
+            float x, y, z;
+            p = ParseFloat(p + 1, line_end, x);
+            p = ParseFloat(p, line_end, y);
+            ParseFloat(p, line_end, z);
+            chunk.v.insert(chunk.v.end(), {x, y, z});
+        } else if (len > 2 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+            float x, y, z;
+            p = ParseFloat(p + 2, line_end, x);
+            p = ParseFloat(p, line_end, y);
+            ParseFloat(p, line_end, z);
+            chunk.vn.insert(chunk.vn.end(), {x, y, z});
+        } else if (len > 2 && p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+            float u, v;
+            p = ParseFloat(p + 2, line_end, u);
+            ParseFloat(p, line_end, v);
+            chunk.vt.insert(chunk.vt.end(), {u, v});
+        } else if (len > 1 && p[0] == 'f' && is_space(p[1])) {
+            // only triangles with all attributes are expected (rest of vertices is ignored)
+            ++p;
+            for (int j = 0; j < 3; ++j) {
+                long i1, i2, i3;
+                p = ParseIndex(SkipSpaces(p, line_end), line_end, i1);
+                if (p == line_end || *p++ != '/') {
+                    chunk.error = true;
+                    break;
+                }
+                p = ParseIndex(p, line_end, i2);
+                if (p == line_end || *p++ != '/') {
+                    chunk.error = true;
+                    break;
+                }
+                p = ParseIndex(p, line_end, i3);
+                // invalid indices become huge and are caught during validation
+                chunk.corners.insert(chunk.corners.end(), {uint32_t(i1 - 1), uint32_t(i2 - 1), uint32_t(i3 - 1)});
+            }
+        } else if (len > 0 && p[0] == 'g' && (len == 1 || is_space(p[1]))) {
+            chunk.groups.push_back(uint32_t(chunk.corners.size() / 3));
+        }
+
+        p = line_end + 1;
+    }
+}
+
+// Decoded image, pixel data is allocated with STBI_MALLOC
+struct tex_image_t {
+    uint8_t *data = nullptr;
+    int w = 0, h = 0, channels = 0;
+    // resolution of image in file (set if image was decoded with reduced resolution)
+    int src_w = 0, src_h = 0;
+    bool force_no_compression = false;
+
+    tex_image_t() = default;
+    tex_image_t(const tex_image_t &rhs) = delete;
+    tex_image_t &operator=(const tex_image_t &rhs) = delete;
+    ~tex_image_t() { Free(); }
+
+    size_t size() const { return size_t(w) * h * channels; }
+
+    void Free() {
+        if (data) {
+            stbi_image_free(data);
+            data = nullptr;
+        }
+    }
+};
+
+// Texture name can have @red/@green/@blue suffix to use single channel of an image
+std::string ParseTextureName(const std::string &name, int &out_channel) {
+    std::string file_name = name;
+    out_channel = -1;
+    if (ends_with(file_name, "@red")) {
+        out_channel = 0;
+        file_name.resize(file_name.size() - 4);
+    } else if (ends_with(file_name, "@green")) {
+        out_channel = 1;
+        file_name.resize(file_name.size() - 6);
+    } else if (ends_with(file_name, "@blue")) {
+        out_channel = 2;
+        file_name.resize(file_name.size() - 5);
+    }
+    return file_name;
+}
+
+bool IsJPEG(const std::string &file_name) {
+    return ends_with(file_name, ".jpg") || ends_with(file_name, ".jpeg") || ends_with(file_name, ".JPG") ||
+           ends_with(file_name, ".JPEG");
+}
+
+// Resolution of image after it is halved to fit max_tex_res
+void FitTextureRes(const int max_tex_res, int &w, int &h) {
+    while (max_tex_res != -1 && (w > max_tex_res || h > max_tex_res)) {
+        w /= 2;
+        h /= 2;
+    }
+}
+
+// Decodes image from file contents (.hdr files are read by LoadHDR directly), returns false if image is skipped.
+// JPEG images are decoded with the smallest DCT scaling factor that keeps them not smaller than fitted resolution.
+bool DecodeTexture(const std::string &file_name, const uint8_t *file_data, const size_t file_size,
+                   const int max_tex_res, tex_image_t &out_img) {
+    if (ends_with(file_name, ".hdr")) {
+        const std::vector<Ray::color_rgba8_t> temp = LoadHDR(file_name.c_str(), out_img.w, out_img.h);
+
+        out_img.channels = 4;
+        out_img.data = (uint8_t *)STBI_MALLOC(out_img.w * out_img.h * 4);
+        out_img.force_no_compression = true;
+
+        memcpy(out_img.data, &temp[0].v[0], out_img.w * out_img.h * sizeof(Ray::color_rgba8_t));
+    } else if (IsJPEG(file_name)) {
+        thread_local std::unique_ptr<void, int (*)(tjhandle)> jpg_decompressor(nullptr, &tjDestroy);
         if (!jpg_decompressor) {
             jpg_decompressor.reset(tjInitDecompress());
         }
 
-        int w, h, channels;
-        uint8_t *img_data = nullptr;
-        bool force_no_compression = false;
-        if (ends_with(name, ".hdr")) {
-            const std::vector<Ray::color_rgba8_t> temp = LoadHDR(name.c_str(), w, h);
+        auto *jpg_data = const_cast<uint8_t *>(file_data);
+        int w, h;
+        const int res = tjDecompressHeader((tjhandle)jpg_decompressor.get(), jpg_data, file_size, &w, &h);
+        if (res != 0) {
+            fprintf(stderr, "tjDecompressHeader error %i\n", res);
+            return false;
+        }
 
-            channels = 4;
-            img_data = (uint8_t *)STBI_MALLOC(w * h * 4);
-            force_no_compression = true;
+        int scaled_w = w, scaled_h = h;
+        if (max_tex_res != -1) {
+            int target_w = w, target_h = h;
+            FitTextureRes(max_tex_res, target_w, target_h);
 
-            memcpy(img_data, &temp[0].v[0], w * h * sizeof(Ray::color_rgba8_t));
-        } else {
-            int channel_to_extract = -1;
-            std::string _name = name;
-            if (ends_with(_name, "@red")) {
-                channel_to_extract = 0;
-                _name.resize(_name.size() - 4);
-            } else if (ends_with(_name, "@green")) {
-                channel_to_extract = 1;
-                _name.resize(_name.size() - 6);
-            } else if (ends_with(_name, "@blue")) {
-                channel_to_extract = 2;
-                _name.resize(_name.size() - 5);
+            int factors_count = 0;
+            const tjscalingfactor *factors = tjGetScalingFactors(&factors_count);
+            for (int i = 0; i < factors_count; ++i) {
+                const int fw = TJSCALED(w, factors[i]), fh = TJSCALED(h, factors[i]);
+                if (fw >= target_w && fh >= target_h && size_t(fw) * fh < size_t(scaled_w) * scaled_h) {
+                    scaled_w = fw;
+                    scaled_h = fh;
+                }
             }
+        }
 
-            if (ends_with(_name, ".jpg") || ends_with(_name, ".jpeg") || ends_with(_name, ".JPG") ||
-                ends_with(_name, ".JPEG")) {
-                std::ifstream in_file(_name, std::ios::binary | std::ios::ate);
-                const auto in_file_size = (unsigned long)(in_file.tellg());
-                in_file.seekg(0, std::ios::beg);
-
-                std::unique_ptr<uint8_t[]> in_file_buf(new uint8_t[in_file_size]);
-                in_file.read((char *)&in_file_buf[0], in_file_size);
-
-                const int res =
-                    tjDecompressHeader((tjhandle)jpg_decompressor.get(), &in_file_buf[0], in_file_size, &w, &h);
-                if (res == 0) {
-                    img_data = (uint8_t *)STBI_MALLOC(w * h * 3);
-                    const int res2 = tjDecompress((tjhandle)jpg_decompressor.get(), &in_file_buf[0], in_file_size,
-                                                  img_data, w, 0, h, 3, TJXOP_VFLIP);
-                    if (res2 == 0) {
-                        channels = 3;
-                    } else {
-                        stbi_image_free(img_data);
-                        img_data = nullptr;
-                        fprintf(stderr, "tjDecompress error %i\n", res2);
-                        return Ray::InvalidTextureHandle;
-                    }
-                } else {
-                    fprintf(stderr, "tjDecompressHeader error %i\n", res);
-                    return Ray::InvalidTextureHandle;
+        out_img.data = (uint8_t *)STBI_MALLOC(scaled_w * scaled_h * 3);
+        const int res2 = tjDecompress2((tjhandle)jpg_decompressor.get(), jpg_data, file_size, out_img.data, scaled_w,
+                                       0, scaled_h, TJPF_RGB, TJFLAG_BOTTOMUP);
+        if (res2 != 0) {
+            out_img.Free();
+            fprintf(stderr, "tjDecompress2 error %i\n", res2);
+            return false;
+        }
+        out_img.w = scaled_w;
+        out_img.h = scaled_h;
+        out_img.channels = 3;
+        if (scaled_w != w || scaled_h != h) {
+            out_img.src_w = w;
+            out_img.src_h = h;
+        }
+    } else {
+        stbi_set_flip_vertically_on_load(1);
+        out_img.data = stbi_load_from_memory(file_data, int(file_size), &out_img.w, &out_img.h, &out_img.channels, 0);
+    }
+
+    if (!out_img.data) {
+        throw std::runtime_error("Cannot load image!");
+    }
+
+    return true;
+}
+
+// Extracts single channel (detects grey and 1px images if channel is not specified) and downsamples image to
+// fit max_tex_res
+void PreprocessTexture(int channel_to_extract, const int max_tex_res, tex_image_t &img) {
+    uint8_t *img_data = img.data;
+    const int channels = img.channels;
+    int w = img.w, h = img.h;
+
+    if (!img.force_no_compression) {
+        if (channel_to_extract == -1) {
+            // Try to detect single channel texture
+            bool is_grey = true, is_1px_texture = true;
+            for (int i = 0; i < w * h && (is_grey || is_1px_texture); ++i) {
+                for (int j = 1; j < channels; ++j) {
+                    is_grey &= (img_data[i * channels + 0] == img_data[i * channels + j]);
+                }
+                for (int j = 0; j < channels; ++j) {
+                    is_1px_texture &= (img_data[j] == img_data[i * channels + j]);
                 }
-            } else {
-                stbi_set_flip_vertically_on_load(1);
-                img_data = stbi_load(_name.c_str(), &w, &h, &channels, 0);
             }
 
-            if (channel_to_extract == -1) {
-                // Try to detect single channel texture
-                bool is_grey = true, is_1px_texture = true;
-                for (int i = 0; i < w * h && (is_grey || is_1px_texture); ++i) {
-                    for (int j = 1; j < channels; ++j) {
-                        is_grey &= (img_data[i * channels + 0] == img_data[i * channels + j]);
-                    }
-                    for (int j = 0; j < channels; ++j) {
-                        is_1px_texture &= (img_data[j] == img_data[i * channels + j]);
-                    }
-                }
+            if (is_1px_texture) {
+                w = h = 1;
+            }
 
-                if (is_1px_texture) {
-                    w = h = 1;
-                }
+            if (is_grey) {
+                // Use only red channel
+                channel_to_extract = 0;
+            }
+        }
 
-                if (is_grey) {
-                    // Use only red channel
-                    channel_to_extract = 0;
+        if (channel_to_extract != -1) {
+            for (int i = 0; i < w * h; ++i) {
+                for (int j = 0; j < channels; ++j) {
+                    img_data[i + j] = img_data[i * channels + channel_to_extract];
                 }
             }
+            img.channels = 1;
+        }
+    }
 
-            if (channel_to_extract != -1) {
-                for (int i = 0; i < w * h; ++i) {
-                    for (int j = 0; j < channels; ++j) {
-                        img_data[i + j] = img_data[i * channels + channel_to_extract];
-                    }
+    // final resolution is defined by resolution of original image (it could be decoded scaled)
+    int target_w = w, target_h = h;
+    if (img.src_w && w == img.w && h == img.h) {
+        target_w = img.src_w;
+        target_h = img.src_h;
+    }
+    FitTextureRes(max_tex_res, target_w, target_h);
+
+    while (max_tex_res != -1 && (w > max_tex_res || h > max_tex_res) && w / 2 >= target_w && h / 2 >= target_h) {
+        const int new_w = (w / 2), new_h = (h / 2);
+        auto new_img_data = (uint8_t *)STBI_MALLOC(new_w * new_h * img.channels);
+
+        for (int y = 0; y < h - 1; y += 2) {
+            for (int x = 0; x < w - 1; x += 2) {
+                for (int k = 0; k < img.channels; ++k) {
+                    const uint8_t c00 = img_data[img.channels * ((y + 0) * w + (x + 0)) + k];
+                    const uint8_t c01 = img_data[img.channels * ((y + 0) * w + (x + 1)) + k];
+                    const uint8_t c10 = img_data[img.channels * ((y + 1) * w + (x + 0)) + k];
+                    const uint8_t c11 = img_data[img.channels * ((y + 1) * w + (x + 1)) + k];
+
+                    new_img_data[img.channels * ((y / 2) * (w / 2) + (x / 2)) + k] = (c00 + c01 + c10 + c11) / 4;
                 }
-                channels = 1;
             }
         }
-        if (!img_data) {
-            throw std::runtime_error("Cannot load image!");
+
+        stbi_image_free(img_data);
+        img_data = new_img_data;
+        w = new_w;
+        h = new_h;
+    }
+
+    if (w != target_w || h != target_h) {
+        // Scaled image has partial last column/row (if resolution is not divisible by scale), it is dropped the same
+        // way as odd column/row is dropped by halving
+        assert(w - target_w <= 1 && h - target_h <= 1);
+        for (int y = 0; y < target_h; ++y) {
+            memmove(&img_data[y * target_w * img.channels], &img_data[y * w * img.channels], target_w * img.channels);
         }
+        w = target_w;
+        h = target_h;
+    }
 
-        while (max_tex_res != -1 && (w > max_tex_res || h > max_tex_res)) {
-            const int new_w = (w / 2), new_h = (h / 2);
-            auto new_img_data = (uint8_t *)STBI_MALLOC(new_w * new_h * channels);
+    img.data = img_data;
+    img.w = w;
+    img.h = h;
+}
 
-            for (int y = 0; y < h - 1; y += 2) {
-                for (int x = 0; x < w - 1; x += 2) {
-                    for (int k = 0; k < channels; ++k) {
-                        const uint8_t c00 = img_data[channels * ((y + 0) * w + (x + 0)) + k];
-                        const uint8_t c01 = img_data[channels * ((y + 0) * w + (x + 1)) + k];
-                        const uint8_t c10 = img_data[channels * ((y + 1) * w + (x + 0)) + k];
-                        const uint8_t c11 = img_data[channels * ((y + 1) * w + (x + 1)) + k];
+Ray::TextureHandle CommitTexture(Ray::SceneBase *scene, const std::string &name, const tex_image_t &img,
+                                 const bool srgb, const bool normalmap, const bool gen_mipmaps) {
+    Ray::tex_desc_t tex_desc;
+    if (img.channels == 4) {
+        tex_desc.format = Ray::eTextureFormat::RGBA8888;
+    } else if (img.channels == 3) {
+        tex_desc.format = Ray::eTextureFormat::RGB888;
+    } else if (img.channels == 2) {
+        tex_desc.format = Ray::eTextureFormat::RG88;
+    } else if (img.channels == 1) {
+        tex_desc.format = Ray::eTextureFormat::R8;
+    }
+    tex_desc.name = name.c_str();
+    tex_desc.data = &img.data[0];
+    tex_desc.w = img.w;
+    tex_desc.h = img.h;
+    tex_desc.is_srgb = srgb;
+    tex_desc.is_normalmap = normalmap;
+    tex_desc.force_no_compression = img.force_no_compression;
+    tex_desc.generate_mipmaps = gen_mipmaps;
+
+    return scene->AddTexture(tex_desc);
+}
 
-                        new_img_data[channels * ((y / 2) * (w / 2) + (x / 2)) + k] = (c00 + c01 + c10 + c11) / 4;
-                    }
-                }
+// Read buffer with page-sized chunks (default chunk size is too large for small textures)
+class TexFileReadBuf : public Sys::FileReadBufBase {
+  public:
+    TexFileReadBuf() : Sys::FileReadBufBase(4096) {}
+    ~TexFileReadBuf() override { TexFileReadBuf::Free(); }
+
+    uint8_t *Alloc(const size_t new_size) override { return (uint8_t *)::malloc(new_size); }
+    void Free() override {
+        ::free(mem_);
+        mem_ = nullptr;
+        chunk_count_ = 0;
+    }
+
+    size_t capacity() const { return size_t(chunk_size_) * chunk_count_; }
+};
+
+struct tex_request_t {
+    std::string name;
+    bool srgb = false;
+    bool normalmap = false;
+    bool mips = false;
+};
+
+// Loads textures in stages: file contents are read asynchronously on calling thread, then images are decoded,
+// preprocessed and added to scene by tasks on thread pool. Each stage has its own concurrency limit, reading and
+// decoding of new images is postponed while memory held by textures in flight exceeds budget.
+std::vector<Ray::TextureHandle> LoadTextures(Ray::SceneBase *scene, const std::vector<tex_request_t> &requests,
+                                             const int max_tex_res, const tex_load_params_t &params,
+                                             Sys::ThreadPool *threads, size_t &out_peak_memory) {
+    enum eStage { Decode, Preprocess, Commit, StagesCount };
+
+    struct job_t {
+        std::string file_name;
+        int channel = -1;
+        TexFileReadBuf file_buf;
+        tex_image_t img;
+        size_t mem_bytes = 0;
+    };
+
+    const int jobs_count = int(requests.size());
+    std::vector<std::unique_ptr<job_t>> jobs(jobs_count);
+    std::vector<Ray::TextureHandle> handles(jobs_count, Ray::InvalidTextureHandle);
+
+    const int workers_count = std::max(threads->workers_count(), 1);
+    const int max_reads = std::max(params.max_reads, 1);
+    const int max_running[StagesCount] = {params.max_decodes > 0 ? params.max_decodes : workers_count,
+                                          params.max_preprocesses > 0 ? params.max_preprocesses : workers_count,
+                                          std::max(params.max_commits, 1)};
+
+    // shared with pool tasks
+    std::mutex mtx;
+    std::condition_variable cnd;
+    std::deque<int> ready[StagesCount];
+    int running[StagesCount] = {};
+    int done = 0;
+    uint32_t events = 0;
+    size_t mem_in_flight = 0, mem_peak = 0;
+    std::exception_ptr error;
+
+    auto start_task = [&](const int i, const int stage) {
+        ++running[stage];
+        threads->Enqueue([&, i, stage]() {
+            job_t &job = *jobs[i];
+            const tex_request_t &req = requests[i];
+            bool finished = false;
+            std::exception_ptr task_error;
+            try {
+                if (stage == Decode) {
+                    finished = !DecodeTexture(job.file_name, job.file_buf.data(), job.file_buf.data_len(),
+                                              max_tex_res, job.img);
+                    job.file_buf.Free();
+                } else if (stage == Preprocess) {
+                    PreprocessTexture(job.channel, max_tex_res, job.img);
+                } else if (stage == Commit) {
+                    handles[i] = CommitTexture(scene, req.name, job.img, req.srgb, req.normalmap, req.mips);
+                    job.img.Free();
+                    finished = true;
+                }
+            } catch (...) {
+                task_error = std::current_exception();
+                job.file_buf.Free();
+                job.img.Free();
+                finished = true;
+            }
+            const size_t mem_bytes = job.img.data ? job.img.size() : 0;
+
+            std::lock_guard<std::mutex> lock(mtx);
+            --running[stage];
+            mem_in_flight = mem_in_flight - job.mem_bytes + mem_bytes;
+            mem_peak = std::max(mem_peak, mem_in_flight);
+            job.mem_bytes = mem_bytes;
+            if (task_error && !error) {
+                error = task_error;
+            }
+            if (finished) {
+                ++done;
+            } else {
+                ready[stage + 1].push_back(i);
+            }
+            ++events;
+            cnd.notify_one();
+        });
+    };
+
+    Sys::AsyncFileReader reader;
+    std::vector<std::unique_ptr<Sys::FileReadEvent>> read_events(max_reads);
+    std::vector<int> read_slots(max_reads, -1);
+    int reads_in_flight = 0, next_read = 0;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    int reported_done = -1;
+    for (;;) {
+        // any event after this point triggers next iteration (lock is released below)
+        const uint32_t seen_events = events;
+
+        // later stages are started first, they release memory
+        for (int stage = StagesCount - 1; stage >= 0; --stage) {
+            const bool downstream_idle = !running[Preprocess] && !running[Commit] && ready[Preprocess].empty() &&
+                                         ready[Commit].empty();
+            while (running[stage] < max_running[stage] && !ready[stage].empty() &&
+                   (stage != Decode || mem_in_flight < params.memory_budget || downstream_idle)) {
+                start_task(ready[stage].front(), stage);
+                ready[stage].pop_front();
             }
+        }
 
-            stbi_image_free(img_data);
-            img_data = new_img_data;
-            w = new_w;
-            h = new_h;
-        }
-
-        Ray::tex_desc_t tex_desc;
-        if (channels == 4) {
-            tex_desc.format = Ray::eTextureFormat::RGBA8888;
-        } else if (channels == 3) {
-            tex_desc.format = Ray::eTextureFormat::RGB888;
-        } else if (channels == 2) {
-            tex_desc.format = Ray::eTextureFormat::RG88;
-        } else if (channels == 1) {
-            tex_desc.format = Ray::eTextureFormat::R8;
-        }
-        tex_desc.name = name.c_str();
-        tex_desc.data = &img_data[0];
-        tex_desc.w = w;
-        tex_desc.h = h;
-        tex_desc.is_srgb = srgb;
-        tex_desc.is_normalmap = normalmap;
-        tex_desc.force_no_compression = force_no_compression;
-        tex_desc.generate_mipmaps = gen_mipmaps;
-
-        const Ray::TextureHandle tex_handle = new_scene->AddTexture(tex_desc);
+        if (done != reported_done) {
+            reported_done = done;
+            if (params.on_progress) {
+                lock.unlock();
+                params.on_progress(reported_done, jobs_count);
+                lock.lock();
+            }
+        }
+        if (done == jobs_count) {
+            break;
+        }
 
-        stbi_image_free(img_data);
+        const bool can_read = mem_in_flight < params.memory_budget || (done + reads_in_flight) == next_read;
+        lock.unlock();
 
-        return tex_handle;
+        std::vector<std::pair<int, size_t>> completed_reads; // (job, memory)
+        std::vector<int> failed_reads;
+        for (int slot = 0; slot < max_reads; ++slot) {
+            const int i = read_slots[slot];
+            if (i == -1) {
+                continue;
+            }
+            job_t &job = *jobs[i];
+            size_t bytes_read = 0;
+            const Sys::eFileReadResult res = read_events[slot]->GetResult(false /* block */, &bytes_read);
+            if (res == Sys::eFileReadResult::Pending) {
+                continue;
+            }
+            if (res == Sys::eFileReadResult::Successful && bytes_read <= job.file_buf.capacity() &&
+                bytes_read >= job.file_buf.data_off() + job.file_buf.data_len()) {
+                completed_reads.emplace_back(i, job.file_buf.capacity());
+            } else {
+                job.file_buf.Free();
+                failed_reads.push_back(i);
+            }
+            read_slots[slot] = -1;
+            --reads_in_flight;
+        }
+
+        for (int slot = 0; slot < max_reads && next_read < jobs_count && can_read; ++slot) {
+            if (read_slots[slot] != -1) {
+                continue;
+            }
+            const int i = next_read++;
+            jobs[i].reset(new job_t);
+            job_t &job = *jobs[i];
+            job.file_name = ParseTextureName(requests[i].name, job.channel);
+            if (ends_with(job.file_name, ".hdr")) {
+                completed_reads.emplace_back(i, 0);
+                continue;
+            }
+            if (!read_events[slot]) {
+                read_events[slot].reset(new Sys::FileReadEvent);
+            }
+            if (!reader.ReadFileNonBlocking(job.file_name.c_str(), 0, Sys::WholeFile, job.file_buf,
+                                            *read_events[slot])) {
+                // event can be left in unusable state
+                read_events[slot].reset();
+                job.file_buf.Free();
+                failed_reads.push_back(i);
+                continue;
+            }
+            read_slots[slot] = i;
+            ++reads_in_flight;
+        }
+        // new reads are submitted as one batch
+        reader.SubmitRequests();
+
+        lock.lock();
+        for (const std::pair<int, size_t> &r : completed_reads) {
+            jobs[r.first]->mem_bytes = r.second;
+            mem_in_flight += r.second;
+            ready[Decode].push_back(r.first);
+        }
+        mem_peak = std::max(mem_peak, mem_in_flight);
+        for (const int i : failed_reads) {
+            if (!error) {
+                error = std::make_exception_ptr(
+                    std::runtime_error("Cannot read texture file " + jobs[i]->file_name + "!"));
+            }
+            ++done;
+        }
+
+        if (completed_reads.empty() && failed_reads.empty()) {
+            if (reads_in_flight) {
+                cnd.wait_for(lock, std::chrono::milliseconds(1), [&]() { return events != seen_events; });
+            } else if (next_read == jobs_count || !can_read) {
+                cnd.wait(lock, [&]() { return events != seen_events; });
+            }
+        }
+    }
+    lock.unlock();
+
+    out_peak_memory = mem_peak;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return handles;
+}
+} // namespace
+
+bool ReadSceneFile(const char *file_name, JsObject &out_js_scene) {
+    std::ifstream in_file(file_name, std::ios::binary | std::ios::ate);
+    if (!in_file) {
+        return false;
+    }
+    std::vector<char> file_data(size_t(in_file.tellg()));
+    in_file.seekg(0, std::ios::beg);
+    if (!in_file.read(file_data.data(), std::streamsize(file_data.size()))) {
+        return false;
+    }
+    return out_js_scene.Read(file_data.data(), file_data.size());
+}
+
+std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &js_scene, const int max_tex_res,
+                                          Sys::ThreadPool *threads, const tex_load_params_t &tex_params) {
+    auto new_scene = std::shared_ptr<Ray::SceneBase>(r->CreateScene());
+
+    std::vector<Ray::CameraHandle> cameras;
+    std::map<std::string, Ray::TextureHandle> textures;
+    std::map<std::string, Ray::MaterialHandle> materials;
+    std::map<std::string, Ray::MeshHandle> meshes;
+
+    auto load_texture = [max_tex_res, &new_scene](const std::string &name, const bool srgb, const bool normalmap,
+                                                  const bool gen_mipmaps) -> Ray::TextureHandle {
+        int channel;
+        const std::string file_name = ParseTextureName(name, channel);
+
+        std::vector<uint8_t> file_data;
+        if (!ends_with(file_name, ".hdr")) {
+            std::ifstream in_file(file_name, std::ios::binary | std::ios::ate);
+            file_data.resize(size_t(std::max(std::streamoff(in_file.tellg()), std::streamoff(0))));
+            in_file.seekg(0, std::ios::beg);
+            in_file.read((char *)file_data.data(), std::streamsize(file_data.size()));
+        }
+
+        tex_image_t img;
+        if (!DecodeTexture(file_name, file_data.data(), file_data.size(), max_tex_res, img)) {
+            return Ray::InvalidTextureHandle;
+        }
+        PreprocessTexture(channel, max_tex_res, img);
+        return CommitTexture(new_scene.get(), name, img, srgb, normalmap, gen_mipmaps);
     };
 
     auto get_texture = [&](const std::string &name, const bool srgb, const bool normalmap, const bool gen_mipmaps) {
@@ -646,16 +1168,26 @@ std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &
                 }
             }
 
-            std::vector<std::future<Ray::TextureHandle>> tex_load_events;
-
+            std::vector<tex_request_t> tex_requests;
             for (const auto &t : textures_to_load) {
-                tex_load_events.emplace_back(threads->Enqueue(load_texture, std::ref(t.first), t.second.srgb,
-                                                              t.second.normalmap, t.second.mips));
+                tex_request_t req;
+                req.name = t.first;
+                req.srgb = t.second.srgb;
+                req.normalmap = t.second.normalmap;
+                req.mips = t.second.mips;
+                tex_requests.push_back(std::move(req));
             }
 
-            int index = 0;
-            for (const auto &t : textures_to_load) {
-                textures[t.first] = tex_load_events[index++].get();
+            const uint64_t t1 = Sys::GetTimeUs();
+            size_t peak_memory = 0;
+            const std::vector<Ray::TextureHandle> tex_handles =
+                LoadTextures(new_scene.get(), tex_requests, max_tex_res, tex_params, threads, peak_memory);
+            const uint64_t t2 = Sys::GetTimeUs();
+            r->log()->Info("%i textures loaded in %.2fms (peak in-flight memory %.2fMB)", int(tex_requests.size()),
+                           double(t2 - t1) / 1000.0, double(peak_memory) / 1048576.0);
+
+            for (size_t i = 0; i < tex_requests.size(); ++i) {
+                textures[tex_requests[i].name] = tex_handles[i];
             }
         }
 
@@ -887,27 +1419,33 @@ std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &
 
         std::vector<std::future<Ray::MeshHandle>> mesh_load_events;
 
-        auto load_mesh_job = [&global_settings, &materials, &new_scene,
-                              r](const char *mesh_name, const JsObject &js_mesh_obj) -> Ray::MeshHandle {
-            std::vector<float> attrs;
-            std::vector<unsigned> indices, groups;
+        auto load_mesh_job = [&global_settings, &materials, &new_scene, r,
+                              threads](const char *mesh_name, const JsObject &js_mesh_obj) -> Ray::MeshHandle {
+            mesh_data_t mesh;
 
             const JsString &js_vtx_data = js_mesh_obj.at("vertex_data").as_str();
             if (js_vtx_data.val.find(".obj") != std::string::npos) {
                 const uint64_t t1 = Sys::GetTimeUs();
-                std::tie(attrs, indices, groups) = LoadOBJ(js_vtx_data.val.c_str());
+                std::vector<float> attrs;
+                std::vector<unsigned> indices, groups;
+                std::tie(attrs, indices, groups) = LoadOBJ(js_vtx_data.val.c_str(), threads);
+                mesh = mesh_data_t{std::move(attrs), std::move(indices), std::move(groups)};
                 const uint64_t t2 = Sys::GetTimeUs();
 
                 r->log()->Info("OBJ \'%s\' loaded in %.2fms", js_vtx_data.val.c_str(), double(t2 - t1) / 1000.0);
             } else if (js_vtx_data.val.find(".bin") != std::string::npos) {
-                std::tie(attrs, indices, groups) = LoadBIN(js_vtx_data.val.c_str());
+                mesh = LoadBIN(js_vtx_data.val.c_str());
+                if (!mesh.mapped_file) {
+                    r->log()->Warning("Mesh \'%s\' uses legacy format, convert it with --convert_bin for faster loading",
+                                      js_vtx_data.val.c_str());
+                }
             } else {
                 throw std::runtime_error("unknown mesh type");
             }
 
 #if !defined(NDEBUG) && defined(_WIN32)
-            for (int i = 0; i < int(attrs.size()); ++i) {
-                if (attrs[i] > 1.0e+30F) {
+            for (size_t i = 0; i < mesh.attrs_count; ++i) {
+                if (mesh.attrs[i] > 1.0e+30F) {
                     __debugbreak();
                 }
             }
@@ -919,16 +1457,16 @@ std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &
             mesh_desc.name = mesh_name;
             mesh_desc.prim_type = Ray::TriangleList;
             mesh_desc.layout = Ray::PxyzNxyzTuv;
-            mesh_desc.vtx_attrs = &attrs[0];
-            mesh_desc.vtx_attrs_count = attrs.size() / 8;
-            mesh_desc.vtx_indices = &indices[0];
-            mesh_desc.vtx_indices_count = indices.size();
+            mesh_desc.vtx_attrs = mesh.attrs;
+            mesh_desc.vtx_attrs_count = mesh.attrs_count / 8;
+            mesh_desc.vtx_indices = mesh.indices;
+            mesh_desc.vtx_indices_count = mesh.indices_count;
             mesh_desc.use_fast_bvh_build = global_settings.use_fast_bvh_build;
 
-            for (size_t i = 0; i < groups.size(); i += 2) {
+            for (size_t i = 0; i + 1 < mesh.groups_count; i += 2) {
                 const JsString &js_mat_name = js_materials.at(i / 2).as_str();
                 const Ray::MaterialHandle mat_handle = materials.at(js_mat_name.val);
-                mesh_desc.shapes.push_back({mat_handle, mat_handle, groups[i], groups[i + 1]});
+                mesh_desc.shapes.push_back({mat_handle, mat_handle, mesh.groups[i], mesh.groups[i + 1]});
             }
 
             if (js_mesh_obj.Has("allow_spatial_splits")) {
@@ -1250,131 +1788,192 @@ std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &
 
     new_scene->Finalize();
 
+    Ray::tex_stats_t tex_stats;
+    new_scene->GetTextureStats(tex_stats);
+    if (tex_stats.dedup_hits) {
+        r->log()->Info("Textures: %u images for %u textures (%.2fMB), %llu duplicates reused (%.2fMB saved)",
+                       tex_stats.images_count, tex_stats.textures_count, double(tex_stats.images_bytes) / 1048576.0,
+                       tex_stats.dedup_hits, double(tex_stats.dedup_saved_bytes) / 1048576.0);
+    }
+
     return new_scene;
 }
 
-std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> LoadOBJ(const char *file_name) {
-    std::vector<float> attrs;
-    std::vector<unsigned> indices;
-    std::vector<unsigned> groups;
-
-    std::vector<Ren::Vec3f> v;
-    std::vector<float> vn, vt;
-
-    std::ifstream in_file(file_name, std::ios::binary);
+std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> LoadOBJ(const char *file_name,
+                                                                                     Sys::ThreadPool *threads) {
+    Sys::MappedFile in_file(file_name);
     if (!in_file) {
         throw std::runtime_error("File can not be opened!");
     }
 
-    const int SearchGridRes = 32;
-    std::vector<Ren::SmallVector<uint32_t, 16>> search_grid(SearchGridRes * SearchGridRes * SearchGridRes);
-    auto bbox_min = Ren::Vec3f{std::numeric_limits<float>::max()},
-         bbox_max = Ren::Vec3f{std::numeric_limits<float>::lowest()};
+    const auto *file_beg = reinterpret_cast<const char *>(in_file.data());
+    const char *file_end = file_beg + in_file.size();
+
+    //
+    // Parse file in chunks split at line boundaries
+    //
+    const size_t MinChunkSize = 1024 * 1024;
+    const size_t max_chunks_count = threads ? 4 * (threads->workers_count() + 1) : 1;
+    const int chunks_count = int(std::max(std::min(in_file.size() / MinChunkSize, max_chunks_count), size_t(1)));
+
+    std::vector<obj_chunk_t> chunks(chunks_count);
+    for (int i = 0; i < chunks_count; ++i) {
+        const char *beg = (i == 0) ? file_beg : chunks[i - 1].end;
+        const char *end = std::max(file_beg + in_file.size() * (i + 1) / chunks_count, beg);
+        if (i != chunks_count - 1) {
+            const auto *line_end = reinterpret_cast<const char *>(memchr(end, '\n', file_end - end));
+            end = line_end ? line_end + 1 : file_end;
+        }
+        chunks[i].beg = beg;
+        chunks[i].end = end;
+    }
+
+    ParallelFor(threads, chunks_count, [&chunks](const int i) { ParseOBJChunk(chunks[i]); });
 
-    auto grid_index = [&](Ren::Vec3f p) -> int {
-        p = (p - bbox_min) / (bbox_max - bbox_min + Ren::Vec3f{std::numeric_limits<float>::epsilon()});
-        p *= float(SearchGridRes);
+    std::vector<float> v, vn, vt;
+    std::vector<uint32_t> corners, group_starts;
+    for (const obj_chunk_t &chunk : chunks) {
+        if (chunk.error) {
+            throw std::runtime_error("Unsupported face format!");
+        }
+        for (const uint32_t g : chunk.groups) {
+            group_starts.push_back(uint32_t(corners.size() / 3) + g);
+        }
+        v.insert(v.end(), chunk.v.begin(), chunk.v.end());
+        vn.insert(vn.end(), chunk.vn.begin(), chunk.vn.end());
+        vt.insert(vt.end(), chunk.vt.begin(), chunk.vt.end());
+        corners.insert(corners.end(), chunk.corners.begin(), chunk.corners.end());
+    }
+    chunks.clear();
 
-        const int ix = int(p[0]);
-        const int iy = int(p[1]);
-        const int iz = int(p[2]);
+    const uint32_t corners_count = uint32_t(corners.size() / 3);
+    for (uint32_t i = 0; i < corners_count; ++i) {
+        if (corners[3 * i + 0] >= v.size() / 3 || corners[3 * i + 1] >= vt.size() / 2 ||
+            corners[3 * i + 2] >= vn.size() / 3) {
+            throw std::runtime_error("Invalid face index!");
+        }
+    }
 
-        return std::min(std::max(iz * SearchGridRes * SearchGridRes + iy * SearchGridRes + ix, 0),
-                        SearchGridRes * SearchGridRes * SearchGridRes - 1);
+    //
+    // Weld vertices with equal attributes (concurrent open-addressing table keeps the first corner of each vertex,
+    // so resulting order is the same as with sequential processing)
+    //
+    auto corner_attrs = [&](const uint32_t c, float out_attrs[8]) {
+        const uint32_t *corner = &corners[3 * c];
+        // adding zero turns negative zero into positive
+        for (int j = 0; j < 3; ++j) {
+            out_attrs[j] = v[3 * corner[0] + j] + 0.0f;
+            out_attrs[3 + j] = vn[3 * corner[2] + j] + 0.0f;
+        }
+        out_attrs[6] = vt[2 * corner[1] + 0] + 0.0f;
+        out_attrs[7] = vt[2 * corner[1] + 1] + 0.0f;
     };
-
-    auto indices_at = [&](Ren::Vec3f p) -> const Ren::SmallVectorImpl<uint32_t> & {
-        return search_grid[grid_index(p)];
+    auto same_vertex = [&](const uint32_t c, const float c_attrs[8], const uint32_t other) {
+        if (memcmp(&corners[3 * c], &corners[3 * other], 3 * sizeof(uint32_t)) == 0) {
+            return true;
+        }
+        float other_attrs[8];
+        corner_attrs(other, other_attrs);
+        return memcmp(c_attrs, other_attrs, 8 * sizeof(float)) == 0;
+    };
+    auto hash_attrs = [](const float attrs[8]) {
+        uint64_t h = 0;
+        for (int j = 0; j < 8; ++j) {
+            uint32_t bits;
+            memcpy(&bits, &attrs[j], sizeof(uint32_t));
+            h = (h ^ bits) * 0x9e3779b97f4a7c15ull;
+            h ^= (h >> 29);
+        }
+        return uint32_t(h ^ (h >> 32));
     };
 
-    std::string line;
-    while (std::getline(in_file, line)) {
-        const char *delims = " /\r\n";
-        const char *p = line.c_str();
-        const char *q = strpbrk(p + 1, delims);
+    const uint32_t Empty = 0xffffffff;
+    uint32_t table_size = 16;
+    while (table_size < 2 * uint64_t(corners_count)) {
+        table_size *= 2;
+    }
+    const uint32_t table_mask = table_size - 1;
+    std::unique_ptr<std::atomic<uint32_t>[]> table(new std::atomic<uint32_t>[table_size]);
+    for (uint32_t i = 0; i < table_size; ++i) {
+        table[i].store(Empty, std::memory_order_relaxed);
+    }
 
-        if ((q - p) == 1 && p[0] == 'v') {
-            p = q + 1;
-            q = strpbrk(p, delims);
-            const float x = strtof(p, nullptr);
-            p = q + 1;
-            q = strpbrk(p, delims);
-            const float y = strtof(p, nullptr);
-            p = q + 1;
-            q = strpbrk(p, delims);
-            const float z = strtof(p, nullptr);
-            v.emplace_back(x, y, z);
-
-            bbox_min = Min(bbox_min, v.back());
-            bbox_max = Max(bbox_max, v.back());
-        } else if ((q - p) == 2 && p[0] == 'v' && p[1] == 'n') {
-            p = q + 1;
-            q = strpbrk(p, delims);
-            vn.push_back(strtof(p, nullptr));
-            p = q + 1;
-            q = strpbrk(p, delims);
-            vn.push_back(strtof(p, nullptr));
-            p = q + 1;
-            q = strpbrk(p, delims);
-            vn.push_back(strtof(p, nullptr));
-        } else if ((q - p) == 2 && p[0] == 'v' && p[1] == 't') {
-            p = q + 1;
-            q = strpbrk(p, delims);
-            vt.push_back(strtof(p, nullptr));
-            p = q + 1;
-            q = strpbrk(p, delims);
-            vt.push_back(strtof(p, nullptr));
-        } else if ((q - p) == 1 && p[0] == 'f') {
-            for (int j = 0; j < 3; j++) {
-                p = q + 1;
-                q = strpbrk(p, delims);
-                const long i1 = strtol(p, nullptr, 10) - 1;
-                p = q + 1;
-                q = strpbrk(p, delims);
-                const long i2 = strtol(p, nullptr, 10) - 1;
-                p = q + 1;
-                q = strpbrk(p, delims);
-                const long i3 = strtol(p, nullptr, 10) - 1;
-
-                bool found = false;
-                for (const uint32_t i : indices_at(v[i1])) {
-                    if (_abs(attrs[i * 8 + 0] - v[i1][0]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 1] - v[i1][1]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 2] - v[i1][2]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 3] - vn[i3 * 3]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 4] - vn[i3 * 3 + 1]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 5] - vn[i3 * 3 + 2]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 6] - vt[i2 * 2]) < 0.0000001f &&
-                        _abs(attrs[i * 8 + 7] - vt[i2 * 2 + 1]) < 0.0000001f) {
-                        indices.push_back(i);
-                        found = true;
-                        break;
-                    }
-                }
+    const uint32_t RangeSize = 64 * 1024;
+    const int ranges_count = int((corners_count + RangeSize - 1) / RangeSize);
 
-                if (!found) {
-                    const uint32_t index = uint32_t(attrs.size() / 8);
-                    search_grid[grid_index(v[i1])].push_back(index);
+    // corner attributes are immutable, slot value only changes to other corner of the same vertex (relaxed is enough)
+    ParallelFor(threads, ranges_count, [&](const int range) {
+        for (uint32_t c = range * RangeSize; c < std::min((range + 1) * RangeSize, corners_count); ++c) {
+            float attrs[8];
+            corner_attrs(c, attrs);
 
-                    indices.push_back(index);
-                    attrs.push_back(v[i1][0]);
-                    attrs.push_back(v[i1][1]);
-                    attrs.push_back(v[i1][2]);
+            for (uint32_t slot = hash_attrs(attrs) & table_mask;; slot = (slot + 1) & table_mask) {
+                uint32_t cur = table[slot].load(std::memory_order_relaxed);
+                if (cur == Empty && table[slot].compare_exchange_strong(cur, c, std::memory_order_relaxed)) {
+                    break;
+                }
+                if (same_vertex(c, attrs, cur)) {
+                    while (c < cur && !table[slot].compare_exchange_weak(cur, c, std::memory_order_relaxed)) {
+                    }
+                    break;
+                }
+            }
+        }
+    });
+
+    // find first corner of each vertex
+    std::vector<uint32_t> first_corner(corners_count), range_vertices(ranges_count + 1, 0);
+    ParallelFor(threads, ranges_count, [&](const int range) {
+        for (uint32_t c = range * RangeSize; c < std::min((range + 1) * RangeSize, corners_count); ++c) {
+            float attrs[8];
+            corner_attrs(c, attrs);
+
+            uint32_t slot = hash_attrs(attrs) & table_mask;
+            while (!same_vertex(c, attrs, table[slot].load(std::memory_order_relaxed))) {
+                slot = (slot + 1) & table_mask;
+            }
+            first_corner[c] = table[slot].load(std::memory_order_relaxed);
+            range_vertices[range + 1] += (first_corner[c] == c);
+        }
+    });
+    table.reset();
 
-                    attrs.push_back(vn[i3 * 3]);
-                    attrs.push_back(vn[i3 * 3 + 1]);
-                    attrs.push_back(vn[i3 * 3 + 2]);
+    for (int i = 0; i < ranges_count; ++i) {
+        range_vertices[i + 1] += range_vertices[i];
+    }
 
-                    attrs.push_back(vt[i2 * 2]);
-                    attrs.push_back(vt[i2 * 2 + 1]);
-                }
+    std::vector<float> attrs(8 * size_t(range_vertices[ranges_count]));
+    std::vector<unsigned> indices(corners_count);
+
+    // assign vertex indices in order of first occurrence
+    ParallelFor(threads, ranges_count, [&](const int range) {
+        uint32_t next_vertex = range_vertices[range];
+        for (uint32_t c = range * RangeSize; c < std::min((range + 1) * RangeSize, corners_count); ++c) {
+            if (first_corner[c] == c) {
+                float *vtx_attrs = &attrs[8 * size_t(next_vertex)];
+                const uint32_t *corner = &corners[3 * c];
+                memcpy(&vtx_attrs[0], &v[3 * corner[0]], 3 * sizeof(float));
+                memcpy(&vtx_attrs[3], &vn[3 * corner[2]], 3 * sizeof(float));
+                memcpy(&vtx_attrs[6], &vt[2 * corner[1]], 2 * sizeof(float));
+                indices[c] = next_vertex++;
             }
-        } else if ((q - p) == 1 && p[0] == 'g') {
-            if (!groups.empty()) {
-                groups.push_back(uint32_t(indices.size() - groups.back()));
+        }
+    });
+    // first corners are left untouched, they are read by other ranges concurrently
+    ParallelFor(threads, ranges_count, [&](const int range) {
+        for (uint32_t c = range * RangeSize; c < std::min((range + 1) * RangeSize, corners_count); ++c) {
+            if (first_corner[c] != c) {
+                indices[c] = indices[first_corner[c]];
             }
-            groups.push_back(uint32_t(indices.size()));
         }
+    });
+
+    std::vector<unsigned> groups;
+    for (const uint32_t start : group_starts) {
+        if (!groups.empty()) {
+            groups.push_back(start - groups.back());
+        }
+        groups.push_back(start);
     }
 
     if (groups.empty()) {
@@ -1390,22 +1989,15 @@ std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> Loa
         out_file_name[out_file_name.size() - 2] = 'i';
         out_file_name[out_file_name.size() - 1] = 'n';
 
-        std::ofstream out_file(out_file_name, std::ios::binary);
-
-        uint32_t s;
-
-        s = uint32_t(attrs.size());
-        out_file.write((char *)&s, sizeof(s));
-
-        s = uint32_t(indices.size());
-        out_file.write((char *)&s, sizeof(s));
-
-        s = uint32_t(groups.size());
-        out_file.write((char *)&s, sizeof(s));
+        mesh_data_t mesh;
+        mesh.attrs = attrs.data();
+        mesh.attrs_count = attrs.size();
+        mesh.indices = indices.data();
+        mesh.indices_count = indices.size();
+        mesh.groups = groups.data();
+        mesh.groups_count = groups.size();
 
-        out_file.write((char *)&attrs[0], attrs.size() * sizeof(attrs[0]));
-        out_file.write((char *)&indices[0], indices.size() * sizeof(indices[0]));
-        out_file.write((char *)&groups[0], groups.size() * sizeof(groups[0]));
+        WriteBIN(mesh, out_file_name.c_str());
     }
 #endif
 
@@ -1448,28 +2040,158 @@ std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> Loa
     return std::make_tuple(std::move(attrs), std::move(indices), std::move(groups));
 }
 
-std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> LoadBIN(const char *file_name) {
-    std::ifstream in_file(file_name, std::ios::binary);
-    uint32_t num_attrs;
-    in_file.read((char *)&num_attrs, 4);
-    uint32_t num_indices;
-    in_file.read((char *)&num_indices, 4);
-    uint32_t num_groups;
-    in_file.read((char *)&num_groups, 4);
+namespace {
+// .bin v2 layout: header followed by arrays, each array starts at 64-byte aligned offset, so the file can be mapped
+// and passed to the renderer as is (v1 files have no header and start with three 32-bit counts)
+const char BinMagic[4] = {'R', 'B', 'I', 'N'};
+const uint32_t BinVersion = 2;
+const uint64_t BinAlignment = 64;
+
+struct bin_header_t {
+    char magic[4];
+    uint32_t version;
+    uint64_t attrs_count, indices_count, groups_count;
+    uint64_t attrs_offset, indices_offset, groups_offset;
+};
+static_assert(sizeof(bin_header_t) == 56, "!");
+
+uint64_t AlignUp(const uint64_t offset) { return BinAlignment * ((offset + BinAlignment - 1) / BinAlignment); }
+
+bool ReadBIN_v1(const uint8_t *data, const size_t size, mesh_data_t &out_mesh) {
+    uint32_t counts[3];
+    if (size < sizeof(counts)) {
+        return false;
+    }
+    memcpy(counts, data, sizeof(counts));
+
+    const uint64_t expected_size = sizeof(counts) + sizeof(uint32_t) * (uint64_t(counts[0]) + counts[1] + counts[2]);
+    if (size < expected_size) {
+        return false;
+    }
 
-    std::vector<float> attrs;
-    attrs.resize(num_attrs);
-    in_file.read((char *)&attrs[0], (size_t)num_attrs * 4);
+    const uint8_t *p = data + sizeof(counts);
+    std::vector<float> attrs(counts[0]);
+    memcpy(attrs.data(), p, attrs.size() * sizeof(float));
+    p += attrs.size() * sizeof(float);
 
-    std::vector<unsigned> indices;
-    indices.resize((size_t)num_indices);
-    in_file.read((char *)&indices[0], (size_t)num_indices * 4);
+    std::vector<uint32_t> indices(counts[1]);
+    memcpy(indices.data(), p, indices.size() * sizeof(uint32_t));
+    p += indices.size() * sizeof(uint32_t);
 
-    std::vector<unsigned> groups;
-    groups.resize((size_t)num_groups);
-    in_file.read((char *)&groups[0], (size_t)num_groups * 4);
+    std::vector<uint32_t> groups(counts[2]);
+    memcpy(groups.data(), p, groups.size() * sizeof(uint32_t));
 
-    return std::make_tuple(std::move(attrs), std::move(indices), std::move(groups));
+    out_mesh = mesh_data_t{std::move(attrs), std::move(indices), std::move(groups)};
+    return true;
+}
+
+bool CheckRange(const uint64_t offset, const uint64_t count, const size_t file_size) {
+    return (offset % sizeof(uint32_t)) == 0 && offset <= file_size && count <= (file_size - offset) / sizeof(uint32_t);
+}
+} // namespace
+
+mesh_data_t::mesh_data_t(std::vector<float> &&_attrs, std::vector<uint32_t> &&_indices,
+                         std::vector<uint32_t> &&_groups)
+    : owned_attrs(std::move(_attrs)), owned_indices(std::move(_indices)), owned_groups(std::move(_groups)) {
+    attrs = owned_attrs.data();
+    attrs_count = owned_attrs.size();
+    indices = owned_indices.data();
+    indices_count = owned_indices.size();
+    groups = owned_groups.data();
+    groups_count = owned_groups.size();
+}
+
+mesh_data_t LoadBIN(const char *file_name) {
+    Sys::MappedFile in_file(file_name);
+    if (!in_file) {
+        throw std::runtime_error("File can not be opened!");
+    }
+
+    mesh_data_t ret;
+
+    bin_header_t header = {};
+    if (in_file.size() >= sizeof(bin_header_t)) {
+        memcpy(&header, in_file.data(), sizeof(bin_header_t));
+    }
+
+    if (memcmp(header.magic, BinMagic, sizeof(BinMagic)) != 0) {
+        // Legacy file
+        if (!ReadBIN_v1(in_file.data(), in_file.size(), ret)) {
+            throw std::runtime_error("Invalid mesh file!");
+        }
+        return ret;
+    }
+
+    if (header.version != BinVersion) {
+        throw std::runtime_error("Unsupported mesh file version!");
+    }
+    if (!CheckRange(header.attrs_offset, header.attrs_count, in_file.size()) ||
+        !CheckRange(header.indices_offset, header.indices_count, in_file.size()) ||
+        !CheckRange(header.groups_offset, header.groups_count, in_file.size())) {
+        throw std::runtime_error("Invalid mesh file!");
+    }
+
+    ret.attrs = reinterpret_cast<const float *>(in_file.data() + header.attrs_offset);
+    ret.attrs_count = size_t(header.attrs_count);
+    ret.indices = reinterpret_cast<const uint32_t *>(in_file.data() + header.indices_offset);
+    ret.indices_count = size_t(header.indices_count);
+    ret.groups = reinterpret_cast<const uint32_t *>(in_file.data() + header.groups_offset);
+    ret.groups_count = size_t(header.groups_count);
+    // pointers stay valid as mapping is not affected by move
+    ret.mapped_file = std::move(in_file);
+
+    return ret;
+}
+
+bool WriteBIN(const mesh_data_t &mesh, const char *file_name) {
+    bin_header_t header = {};
+    memcpy(header.magic, BinMagic, sizeof(BinMagic));
+    header.version = BinVersion;
+    header.attrs_count = mesh.attrs_count;
+    header.indices_count = mesh.indices_count;
+    header.groups_count = mesh.groups_count;
+    header.attrs_offset = AlignUp(sizeof(bin_header_t));
+    header.indices_offset = AlignUp(header.attrs_offset + mesh.attrs_count * sizeof(float));
+    header.groups_offset = AlignUp(header.indices_offset + mesh.indices_count * sizeof(uint32_t));
+
+    std::ofstream out_file(file_name, std::ios::binary);
+    if (!out_file) {
+        return false;
+    }
+
+    const char padding[BinAlignment] = {};
+    auto write_at = [&](const uint64_t offset, const void *data, const size_t size) {
+        const uint64_t pos = uint64_t(out_file.tellp());
+        assert(offset >= pos && offset - pos <= BinAlignment);
+        out_file.write(padding, std::streamsize(offset - pos));
+        if (size) {
+            out_file.write(reinterpret_cast<const char *>(data), std::streamsize(size));
+        }
+    };
+
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(bin_header_t));
+    write_at(header.attrs_offset, mesh.attrs, mesh.attrs_count * sizeof(float));
+    write_at(header.indices_offset, mesh.indices, mesh.indices_count * sizeof(uint32_t));
+    write_at(header.groups_offset, mesh.groups, mesh.groups_count * sizeof(uint32_t));
+
+    return out_file.good();
+}
+
+bool ConvertBIN(const char *in_file_name, const char *out_file_name) {
+    mesh_data_t mesh;
+    if (strstr(in_file_name, ".obj")) {
+        std::vector<float> attrs;
+        std::vector<uint32_t> indices, groups;
+        std::tie(attrs, indices, groups) = LoadOBJ(in_file_name);
+        mesh = mesh_data_t{std::move(attrs), std::move(indices), std::move(groups)};
+    } else {
+        mesh = LoadBIN(in_file_name);
+    }
+    // input file is still mapped here, so in-place conversion is not allowed
+    if (strcmp(in_file_name, out_file_name) == 0) {
+        return false;
+    }
+    return WriteBIN(mesh, out_file_name);
 }
 
 std::vector<Ray::color_rgba8_t> LoadTGA(const char *name, int &w, int &h) {
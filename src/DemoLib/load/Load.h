@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -7,6 +8,7 @@
 
 #include <Ray/Types.h>
 #include <Sys/Json.h>
+#include <Sys/MappedFile.h>
 
 namespace Ray {
 class RendererBase;
@@ -17,11 +19,48 @@ namespace Sys {
 class ThreadPool;
 }
 
+// Limits of staged texture loading (used when thread pool is provided)
+struct tex_load_params_t {
+    int max_reads = 16;                     // file reads in flight
+    int max_decodes = 0;                    // concurrently decoded images (0 - number of pool workers)
+    int max_preprocesses = 0;               // concurrently preprocessed images (0 - number of pool workers)
+    int max_commits = 2;                    // concurrent AddTexture calls
+    size_t memory_budget = size_t(1) << 30; // soft cap of memory held by textures in flight (file data and images)
+    std::function<void(int loaded, int total)> on_progress; // called from loading thread
+};
+
+// Scene file is read into memory and parsed in place
+bool ReadSceneFile(const char *file_name, JsObject &out_js_scene);
+
 std::shared_ptr<Ray::SceneBase> LoadScene(Ray::RendererBase *r, const JsObject &js_scene, int max_tex_res,
-                                          Sys::ThreadPool *threads);
+                                          Sys::ThreadPool *threads, const tex_load_params_t &tex_params = {});
+
+// File is parsed in parallel if thread pool is provided (can be called from pool's task)
+std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>>
+LoadOBJ(const char *file_name, Sys::ThreadPool *threads = nullptr);
+
+// Mesh data referenced either from owned arrays or directly from memory-mapped file
+struct mesh_data_t {
+    const float *attrs = nullptr;
+    size_t attrs_count = 0;
+    const uint32_t *indices = nullptr;
+    size_t indices_count = 0;
+    const uint32_t *groups = nullptr;
+    size_t groups_count = 0;
+
+    std::vector<float> owned_attrs;
+    std::vector<uint32_t> owned_indices, owned_groups;
+    Sys::MappedFile mapped_file;
+
+    mesh_data_t() = default;
+    mesh_data_t(std::vector<float> &&_attrs, std::vector<uint32_t> &&_indices, std::vector<uint32_t> &&_groups);
+};
 
-std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> LoadOBJ(const char *file_name);
-std::tuple<std::vector<float>, std::vector<unsigned>, std::vector<unsigned>> LoadBIN(const char *file_name);
+// Version 2 files are mapped into memory without copying, legacy files are read into owned arrays
+mesh_data_t LoadBIN(const char *file_name);
+bool WriteBIN(const mesh_data_t &mesh, const char *file_name);
+// Converts any supported .bin (or .obj) file into version 2 format
+bool ConvertBIN(const char *in_file_name, const char *out_file_name);
 
 std::vector<Ray::color_rgba8_t> LoadTGA(const char *name, int &w, int &h);
 std::vector<Ray::color_rgba8_t> LoadHDR(const char *name, int &w, int &h);
@@ -120,11 +120,8 @@ void GSHybTest::Enter() {
 
     JsObject js_scene;
 
-    {
-        std::ifstream in_file("./assets/scenes/inter.json", std::ios::binary);
-        if (!js_scene.Read(in_file)) {
-            cpu_tracer_->log()->Error("Failed to parse scene file!");
-        }
+    if (!ReadSceneFile("./assets/scenes/inter.json", js_scene)) {
+        cpu_tracer_->log()->Error("Failed to parse scene file!");
     }
 
     if (js_scene.Size()) {
@@ -81,11 +81,8 @@ void GSLightmapTest::Enter() {
 
     JsObject js_scene;
 
-    {
-        std::ifstream in_file("./assets/scenes/test_lmap.json", std::ios::binary);
-        if (!js_scene.Read(in_file)) {
-            ray_renderer_->log()->Error("Failed to parse scene file!");
-        }
+    if (!ReadSceneFile("./assets/scenes/test_lmap.json", js_scene)) {
+        ray_renderer_->log()->Error("Failed to parse scene file!");
     }
 
     if (js_scene.Size()) {
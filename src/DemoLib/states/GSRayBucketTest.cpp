@@ -197,11 +197,8 @@ void GSRayBucketTest::Enter() {
 
     auto app_params = game_->GetComponent<AppParams>(APP_PARAMS_KEY);
 
-    {
-        std::ifstream in_file(app_params->scene_name, std::ios::binary);
-        if (!js_scene.Read(in_file)) {
-            ray_renderer_->log()->Error("Failed to parse scene file!");
-        }
+    if (!ReadSceneFile(app_params->scene_name.c_str(), js_scene)) {
+        ray_renderer_->log()->Error("Failed to parse scene file!");
     }
 
     if (js_scene.Size()) {
@@ -239,6 +236,14 @@ void GSRayBucketTest::Draw(uint64_t dt_us) {
 
     //renderer_->ClearColorAndDepth(0, 0, 0, 1);
 
+    auto app_params = game_->GetComponent<AppParams>(APP_PARAMS_KEY);
+
+    if (invalidate_preview_) {
+        // buckets in flight must finish before camera and accumulated image are changed
+        for (size_t i = 0; i < is_aborted_.size(); i++) is_aborted_[i] = true;
+        for (const auto &e : events_) e.wait();
+    }
+
     {   // update camera
         Ray::camera_desc_t cam_desc;
         ray_scene_->GetCamera(Ray::CameraHandle{0}, cam_desc);
@@ -248,6 +253,9 @@ void GSRayBucketTest::Draw(uint64_t dt_us) {
 
         cam_desc.max_refr_depth = 8;
         cam_desc.max_total_depth = 8;
+        if (app_params->temporal_accumulation) {
+            cam_desc.output_depth_normals = true;
+        }
 
         ray_scene_->SetCamera(Ray::CameraHandle{0}, cam_desc);
     }
@@ -255,7 +263,9 @@ void GSRayBucketTest::Draw(uint64_t dt_us) {
     uint64_t t1 = Sys::GetTimeMs();
 
     if (invalidate_preview_) {
-        ray_renderer_->Clear({0, 0, 0, 0});
+        if (!app_params->temporal_accumulation || !ray_renderer_->ReprojectImage(ray_scene_.get())) {
+            ray_renderer_->Clear({0, 0, 0, 0});
+        }
         UpdateRegionContexts();
         invalidate_preview_ = false;
     }
@@ -10,6 +10,7 @@
 #include <tinyexr/tinyexr.h>
 
 #include <Ray/Log.h>
+#include <Ray/internal/Core.h>
 #include <SW/SW.h>
 #include <SW/SWframebuffer.h>
 #include <Sys/Json.h>
@@ -71,40 +72,60 @@ void GSRayTest::UpdateRegionContexts() {
             ray_renderer_->RenderScene(ray_scene_.get(), region_contexts_[i][j]);
         };
 
-        auto denoise_job = [this](const int i, const int j) {
+        auto denoise_job = [this](const int pass, const int i, const int j) {
 #if !defined(NDEBUG) && defined(_WIN32)
             _controlfp(_EM_INEXACT | _EM_UNDERFLOW | _EM_OVERFLOW, _MCW_EM);
 #endif
-            ray_renderer_->DenoiseImage(region_contexts_[i][j]);
+            ray_renderer_->DenoiseImage(pass, region_contexts_[i][j]);
+        };
+
+        std::vector<Sys::SmallVector<short, 128>> render_task_ids(region_contexts_.size()),
+            variance_task_ids(region_contexts_.size());
+        for (int i = 0; i < int(region_contexts_.size()); ++i) {
+            render_task_ids[i].resize(region_contexts_[i].size());
+            variance_task_ids[i].resize(region_contexts_[i].size());
+        }
+
+        // each denoising pass of a bucket waits only for the previous stage of its neighbours
+        auto add_neighbour_dependencies = [&](const short id, const int i, const int j,
+                                              const std::vector<Sys::SmallVector<short, 128>> &dep_ids) {
+            for (int k = -1; k <= 1; ++k) {
+                if (i + k < 0 || i + k >= int(dep_ids.size())) {
+                    continue;
+                }
+                for (int l = -1; l <= 1; ++l) {
+                    if (j + l < 0 || j + l >= int(dep_ids[i + k].size())) {
+                        continue;
+                    }
+                    render_and_denoise_tasks_->AddDependency(id, dep_ids[i + k][j + l]);
+                }
+            }
         };
 
-        std::vector<Sys::SmallVector<short, 128>> render_task_ids;
-        
         render_tasks_ = std::make_unique<Sys::TaskList>();
         render_and_denoise_tasks_ = std::make_unique<Sys::TaskList>();
 
+        // buckets are scheduled in the same order as pixels inside of them (neighbouring tasks share cached data)
+        auto app_params = game_->GetComponent<AppParams>(APP_PARAMS_KEY);
+        std::vector<uint32_t> bucket_order;
+        Ray::GetTileOrder(Ray::ePixelOrder(app_params->pixel_order), int(region_contexts_[0].size()),
+                          int(region_contexts_.size()), bucket_order);
+
+        for (const uint32_t bucket : bucket_order) {
+            const int i = int(bucket >> 16), j = int(bucket & 0x0000ffff);
+            render_tasks_->AddTask(render_job, i, j);
+            render_task_ids[i][j] = render_and_denoise_tasks_->AddTask(render_job, i, j);
+        }
         for (int i = 0; i < int(region_contexts_.size()); ++i) {
-            render_task_ids.emplace_back();
             for (int j = 0; j < int(region_contexts_[i].size()); ++j) {
-                render_tasks_->AddTask(render_job, i, j);
-                render_task_ids.back().emplace_back(render_and_denoise_tasks_->AddTask(render_job, i, j));
+                variance_task_ids[i][j] = render_and_denoise_tasks_->AddTask(denoise_job, 0, i, j);
+                add_neighbour_dependencies(variance_task_ids[i][j], i, j, render_task_ids);
             }
         }
         for (int i = 0; i < int(region_contexts_.size()); ++i) {
             for (int j = 0; j < int(region_contexts_[i].size()); ++j) {
-                const short id = render_and_denoise_tasks_->AddTask(denoise_job, i, j);
-
-                for (int k = -1; k <= 1; ++k) {
-                    if (i + k < 0 || i + k >= int(render_task_ids.size())) {
-                        continue;
-                    }
-                    for (int l = -1; l <= 1; ++l) {
-                        if (j + l < 0 || j + l >= int(render_task_ids[i + k].size())) {
-                            continue;
-                        }
-                        render_and_denoise_tasks_->AddDependency(id, render_task_ids[i + k][j + l]);
-                    }
-                }
+                const short id = render_and_denoise_tasks_->AddTask(denoise_job, 1, i, j);
+                add_neighbour_dependencies(id, i, j, variance_task_ids);
             }
         }
 
@@ -141,17 +162,37 @@ void GSRayTest::Enter() {
 
     auto app_params = game_->GetComponent<AppParams>(APP_PARAMS_KEY);
 
-    {
-        std::ifstream in_file(app_params->scene_name, std::ios::binary);
-        if (!js_scene.Read(in_file)) {
-            ray_renderer_->log()->Error("Failed to parse scene file!");
-        }
+    if (!ReadSceneFile(app_params->scene_name.c_str(), js_scene)) {
+        ray_renderer_->log()->Error("Failed to parse scene file!");
     }
 
     if (js_scene.Size()) {
         try {
             const uint64_t t1 = Sys::GetTimeMs();
-            ray_scene_ = LoadScene(ray_renderer_.get(), js_scene, app_params->max_tex_res, threads_.get());
+            const char *snapshot_name = app_params->snapshot_name.empty() ? nullptr : app_params->snapshot_name.c_str();
+            if (snapshot_name) {
+                ray_scene_.reset(ray_renderer_->CreateScene());
+                if (ray_scene_->LoadSnapshot(snapshot_name)) {
+                    ray_renderer_->log()->Info("Scene restored from snapshot %s", snapshot_name);
+                } else {
+                    ray_scene_ = nullptr;
+                }
+            }
+            if (!ray_scene_) {
+                tex_load_params_t tex_params;
+                tex_params.on_progress = [this, last_percent = -1](const int loaded, const int total) mutable {
+                    const int percent = (100 * loaded) / std::max(total, 1);
+                    if (percent / 10 != last_percent / 10) {
+                        ray_renderer_->log()->Info("Loading textures: %i/%i (%i%%)", loaded, total, percent);
+                        last_percent = percent;
+                    }
+                };
+                ray_scene_ = LoadScene(ray_renderer_.get(), js_scene, app_params->max_tex_res, threads_.get(),
+                                       tex_params);
+                if (snapshot_name && !ray_scene_->SaveSnapshot(snapshot_name)) {
+                    ray_renderer_->log()->Warning("Failed to write scene snapshot %s", snapshot_name);
+                }
+            }
             const uint64_t t2 = Sys::GetTimeMs();
             ray_renderer_->log()->Info("Scene loaded in %.1fs", double(t2 - t1) * 0.001);
         } catch (std::exception &e) {
@@ -188,8 +229,10 @@ void GSRayTest::Enter() {
     cam_desc.max_refr_depth = app_params->refr_depth;
     cam_desc.max_transp_depth = app_params->transp_depth;
     cam_desc.max_total_depth = total_depth_ = app_params->total_depth;
+    cam_desc.stochastic_texture_filtering = app_params->stochastic_tex_filtering;
 
-    if (app_params->output_aux) {
+    if (app_params->output_aux || app_params->denoise_method == 1 || app_params->temporal_accumulation) {
+        // feature-guided denoiser and reprojection need base color and normals
         cam_desc.output_base_color = true;
         cam_desc.output_depth_normals = true;
     }
@@ -243,7 +286,10 @@ void GSRayTest::Draw(const uint64_t dt_us) {
         memcpy(&cam_desc.up[0], ValuePtr(view_up_), 3 * sizeof(float));
         cam_desc.focus_distance = focal_distance_;
 
-        if (invalidate_preview_) {
+        if (app_params->temporal_accumulation) {
+            // samples are kept after camera movement, so preview must have the same quality
+            cam_desc.max_total_depth = total_depth_;
+        } else if (invalidate_preview_) {
             cam_desc.max_total_depth = std::min(1, total_depth_);
             last_invalidate_ = true;
         } else {
@@ -257,7 +303,9 @@ void GSRayTest::Draw(const uint64_t dt_us) {
         ray_scene_->SetCamera(current_cam_, cam_desc);
 
         if (invalidate_preview_ || last_invalidate_) {
-            ray_renderer_->Clear({0, 0, 0, 0});
+            if (!app_params->temporal_accumulation || !ray_renderer_->ReprojectImage(ray_scene_.get())) {
+                ray_renderer_->Clear({0, 0, 0, 0});
+            }
             UpdateRegionContexts();
             invalidate_preview_ = false;
         }
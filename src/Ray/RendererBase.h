@@ -44,9 +44,32 @@ struct settings_t {
     const char *preferred_device = nullptr;
     bool use_tex_compression = true; // temporarily GPU only
 #endif                               // ENABLE_GPU_IMPL
+    // Store textures block-compressed in CPU backends (lossy, blocks are decoded on access), can be disabled per
+    // texture
+    bool use_cpu_tex_compression = false;
+    // Directory of on-disk tiled texture cache, large textures are paged in on demand if set (CPU backends)
+    const char *tex_cache_dir = nullptr;
+    // Memory budget for resident tiles of paged textures (in megabytes)
+    int tex_cache_budget_mb = 1024;
+    // Directory of on-disk cache of mesh acceleration structures, reused while geometry and build settings match
+    // (CPU backends)
+    const char *bvh_cache_dir = nullptr;
     bool use_hwrt = true;
     bool use_bindless = true;
     bool use_wide_bvh = true;
+    // Primary ray packet footprint of SIMD renderers, packet_w * packet_h must match simd width
+    // (e.g. 4x2, 2x4, 8x1 for AVX2), unsupported values fall back to backend default
+    int packet_w = 0, packet_h = 0;
+    // Order of primary ray packets within render region, space-filling curves improve cache reuse
+    ePixelOrder pixel_order = Scanline;
+    // Denoising method of SIMD CPU renderers, feature-guided a-trous filter uses base color and depth/normals
+    // (falls back to NLM if camera does not output them)
+    eDenoiseMethod denoise_method = NLM;
+    // Keep per-pixel sample counts, so accumulated image can be reprojected after camera change instead of being
+    // cleared (SIMD CPU renderers, camera must output depth and normals)
+    bool use_temporal_accumulation = false;
+    // Maximal number of samples kept in reprojected history (lower values reduce ghosting and blur)
+    int temporal_max_history = 32;
 };
 
 /** Render region context,
@@ -90,6 +113,9 @@ class RendererBase {
 
     virtual bool is_hwrt() const { return false; }
 
+    /// Returns primary ray packet footprint
+    virtual std::pair<int, int> packet_size() const { return std::make_pair(1, 1); }
+
     /// Returns size of rendered image
     virtual std::pair<int, int> size() const = 0;
 
@@ -135,6 +161,25 @@ class RendererBase {
     */
     virtual void DenoiseImage(const RegionContext &region) = 0;
 
+    /** @brief Denoise image region as a part of frame-level denoising (variance is filtered once per frame)
+        @param pass denoising pass (0 - variance filtering, 1 - image filtering)
+        @param region image region to denoise
+        @note Pass 0 of a region requires neighbouring regions to be rendered, pass 1 requires pass 0 to be finished
+              for neighbouring regions. Regions must not be smaller than the filter radius (16 pixels).
+    */
+    virtual void DenoiseImage(const int pass, const RegionContext &region) {
+        if (pass == 1) {
+            DenoiseImage(region);
+        }
+    }
+
+    /** @brief Reproject accumulated image to the current camera of a scene (accumulation continues
+               for surfaces that stay visible), must not be called during rendering
+        @param scene scene with updated camera
+        @return false if reprojection is not possible (image should be cleared instead)
+    */
+    virtual bool ReprojectImage(const SceneBase *scene) { return false; }
+
     struct stats_t {
         unsigned long long time_primary_ray_gen_us;
         unsigned long long time_primary_trace_us;
@@ -145,6 +190,10 @@ class RendererBase {
         unsigned long long time_secondary_shade_us;
         unsigned long long time_secondary_shadow_us;
         unsigned long long time_denoise_us;
+        unsigned long long primary_rays;             ///< Number of traced primary rays
+        unsigned long long primary_packets;          ///< Number of traced primary ray packets
+        unsigned long long primary_coherent_rays;    ///< Primary rays that hit the same object as first ray in packet
+        unsigned long long primary_coherent_packets; ///< Primary packets that start at the same object as previous one
     };
     virtual void GetStats(stats_t &st) = 0;
     virtual void ResetStats() = 0;
@@ -1,5 +1,12 @@
 #include "RendererFactory.h"
 
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
 #ifdef ENABLE_REF_IMPL
 #include "internal/RendererRef.h"
 #else // ENABLE_REF_IMPL
@@ -32,6 +39,9 @@
 
 namespace Ray {
 LogNull g_null_log;
+
+void CreateCalibrationScene(SceneBase *scene);
+double MeasureRendererPerformance(eRendererType type, const settings_t &s, RendererBase::stats_t &out_st);
 } // namespace Ray
 
 Ray::RendererBase *Ray::CreateRenderer(const settings_t &s, ILog *log, const uint32_t enabled_types) {
@@ -46,6 +56,8 @@ Ray::RendererBase *Ray::CreateRenderer(const settings_t &s, ILog *log, const uin
     }
 #endif // ENABLE_GPU_IMPL
 
+    LogCPUFeatures(log);
+
 #if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
 #ifdef ENABLE_SIMD_IMPL
     const CpuFeatures features = GetCpuFeatures();
@@ -104,4 +116,252 @@ int Ray::QueryAvailableGPUDevices(ILog *log, gpu_device_t out_devices[], const i
 #else
     return 0;
 #endif
-}
\ No newline at end of file
+}
+
+Ray::cpu_features_t Ray::QueryCPUFeatures() {
+    const CpuFeatures f = GetCpuFeatures();
+
+    cpu_features_t ret = {};
+    memcpy(ret.vendor, f.vendor, sizeof(ret.vendor));
+    memcpy(ret.brand, f.brand, sizeof(ret.brand));
+    ret.vendor[sizeof(ret.vendor) - 1] = ret.brand[sizeof(ret.brand) - 1] = '\0';
+    ret.sse2 = f.sse2_supported;
+    ret.sse3 = f.sse3_supported;
+    ret.ssse3 = f.ssse3_supported;
+    ret.sse41 = f.sse41_supported;
+    ret.sse42 = f.sse42_supported;
+    ret.popcnt = f.popcnt_supported;
+    ret.avx = f.avx_supported;
+    ret.avx2 = f.avx2_supported;
+    ret.fma = f.fma_supported;
+    ret.f16c = f.f16c_supported;
+    ret.bmi2 = f.bmi2_supported;
+    ret.avx512f = f.avx512f_supported;
+    ret.avx512cd = f.avx512cd_supported;
+    ret.avx512bw = f.avx512bw_supported;
+    ret.avx512dq = f.avx512dq_supported;
+    ret.avx512vl = f.avx512vl_supported;
+    ret.avx512ifma = f.avx512ifma_supported;
+    ret.avx512vbmi = f.avx512vbmi_supported;
+    ret.avx512vnni = f.avx512vnni_supported;
+    ret.l1d_cache_size = f.l1d_cache_size;
+    ret.l2_cache_size = f.l2_cache_size;
+    ret.l3_cache_size = f.l3_cache_size;
+    ret.cache_line_size = f.cache_line_size;
+    return ret;
+}
+
+void Ray::LogCPUFeatures(ILog *log) {
+    const cpu_features_t f = QueryCPUFeatures();
+
+    const char *brand = f.brand;
+    while (*brand == ' ') {
+        ++brand;
+    }
+    log->Info("Ray: CPU: %s (%s)", brand[0] ? brand : "unknown", f.vendor[0] ? f.vendor : "unknown");
+
+    const std::pair<bool, const char *> isa[] = {
+        {f.sse2, "SSE2"},         {f.sse3, "SSE3"},           {f.ssse3, "SSSE3"},         {f.sse41, "SSE4.1"},
+        {f.sse42, "SSE4.2"},      {f.popcnt, "POPCNT"},       {f.avx, "AVX"},             {f.avx2, "AVX2"},
+        {f.fma, "FMA"},           {f.f16c, "F16C"},           {f.bmi2, "BMI2"},           {f.avx512f, "AVX512F"},
+        {f.avx512cd, "AVX512CD"}, {f.avx512bw, "AVX512BW"},   {f.avx512dq, "AVX512DQ"},   {f.avx512vl, "AVX512VL"},
+        {f.avx512ifma, "AVX512IFMA"}, {f.avx512vbmi, "AVX512VBMI"}, {f.avx512vnni, "AVX512VNNI"}};
+
+    std::string isa_list;
+    for (const auto &i : isa) {
+        if (i.first) {
+            isa_list += ' ';
+            isa_list += i.second;
+        }
+    }
+    log->Info("Ray: CPU features:%s", isa_list.empty() ? " none" : isa_list.c_str());
+    log->Info("Ray: CPU caches: L1d %uKB, L2 %uKB, L3 %uKB, line %uB", f.l1d_cache_size / 1024,
+              f.l2_cache_size / 1024, f.l3_cache_size / 1024, f.cache_line_size);
+}
+
+Ray::eRendererType Ray::CalibrateCPURenderers(ILog *log, settings_t &s, const uint32_t enabled_types,
+                                              const char *cache_file) {
+    const cpu_features_t features = QueryCPUFeatures();
+
+    // Result is valid only for the same cpu model and the same set of candidates
+    std::string cache_key = features.brand;
+    cache_key += ";" + std::to_string(enabled_types);
+
+    if (cache_file) {
+        std::ifstream in_file(cache_file);
+        std::string key, name;
+        int packet_w = 0, packet_h = 0;
+        if (std::getline(in_file, key) && key == cache_key && (in_file >> name >> packet_w >> packet_h)) {
+            const eRendererType cached_type = RendererTypeFromName(name.c_str());
+            if (strcmp(RendererTypeName(cached_type), name.c_str()) == 0 && (enabled_types & cached_type)) {
+                log->Info("Ray: Using cached calibration result (%s %ix%i)", name.c_str(), packet_w, packet_h);
+                s.packet_w = packet_w;
+                s.packet_h = packet_h;
+                return cached_type;
+            }
+        }
+    }
+
+    static const eRendererType Candidates[] = {RendererSSE2, RendererSSE41, RendererAVX, RendererAVX2,
+                                               RendererAVX512, RendererNEON, RendererRef};
+    // Renderers that do not support requested packet shape are skipped
+    static const int CandidateShapes[][2] = {{1, 1}, {2, 2}, {4, 1}, {1, 4}, {4, 2}, {2, 4},
+                                             {8, 1}, {4, 4}, {8, 2}, {2, 8}, {16, 1}};
+
+    eRendererType best_type = RendererRef;
+    int best_shape[2] = {0, 0};
+    double best_time = -1.0;
+
+    for (const eRendererType type : Candidates) {
+        if ((enabled_types & type) == 0) {
+            continue;
+        }
+        for (const auto &shape : CandidateShapes) {
+            settings_t test_s = s;
+            test_s.packet_w = shape[0];
+            test_s.packet_h = shape[1];
+
+            RendererBase::stats_t st = {};
+            const double time_ms = MeasureRendererPerformance(type, test_s, st);
+            if (time_ms < 0.0) {
+                continue;
+            }
+
+            const double coherence = st.primary_rays ? double(st.primary_coherent_rays) / double(st.primary_rays) : 1.0;
+            const double primary_mrays =
+                st.time_primary_trace_us ? double(st.primary_rays) / double(st.time_primary_trace_us) : 0.0;
+
+            log->Info("Ray: Calibration %-8s %2ix%-2i %.2fms (primary: %.2f Mrays/s, coherence %.3f)",
+                      RendererTypeName(type), shape[0], shape[1], time_ms, primary_mrays, coherence);
+            if (best_time < 0.0 || time_ms < best_time) {
+                best_type = type;
+                best_shape[0] = shape[0];
+                best_shape[1] = shape[1];
+                best_time = time_ms;
+            }
+        }
+    }
+
+    log->Info("Ray: Calibration picked %s renderer (%ix%i)", RendererTypeName(best_type), best_shape[0],
+              best_shape[1]);
+    s.packet_w = best_shape[0];
+    s.packet_h = best_shape[1];
+
+    if (cache_file && best_time >= 0.0) {
+        std::ofstream out_file(cache_file);
+        out_file << cache_key << "\n"
+                 << RendererTypeName(best_type) << " " << best_shape[0] << " " << best_shape[1] << "\n";
+        if (!out_file) {
+            log->Warning("Ray: Failed to write calibration cache %s", cache_file);
+        }
+    }
+
+    return best_type;
+}
+
+void Ray::CreateCalibrationScene(SceneBase *scene) {
+    { // environment gives cheap but incoherent secondary bounces
+        environment_desc_t env_desc;
+        env_desc.env_col[0] = env_desc.env_col[1] = env_desc.env_col[2] = 0.5f;
+        scene->SetEnvironment(env_desc);
+    }
+
+    principled_mat_desc_t mat_desc;
+    mat_desc.base_color[0] = 0.8f;
+    mat_desc.base_color[1] = 0.5f;
+    mat_desc.base_color[2] = 0.3f;
+    mat_desc.roughness = 0.3f;
+    const MaterialHandle mat = scene->AddMaterial(mat_desc);
+
+    // uv-sphere
+    const int Rings = 24, Segments = 48;
+    const float Pi = 3.14159265358979323846f;
+
+    std::vector<float> attrs;
+    std::vector<uint32_t> indices;
+    for (int r = 0; r <= Rings; ++r) {
+        const float theta = Pi * float(r) / Rings;
+        for (int s = 0; s <= Segments; ++s) {
+            const float phi = 2.0f * Pi * float(s) / Segments;
+            const float n[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+            attrs.insert(end(attrs), {n[0], n[1], n[2], n[0], n[1], n[2], float(s) / Segments, float(r) / Rings});
+        }
+    }
+    for (int r = 0; r < Rings; ++r) {
+        for (int s = 0; s < Segments; ++s) {
+            const uint32_t i0 = r * (Segments + 1) + s, i1 = i0 + Segments + 1;
+            indices.insert(end(indices), {i0, i1, i0 + 1, i0 + 1, i1, i1 + 1});
+        }
+    }
+
+    mesh_desc_t mesh_desc;
+    mesh_desc.name = "calibration_sphere";
+    mesh_desc.prim_type = TriangleList;
+    mesh_desc.layout = PxyzNxyzTuv;
+    mesh_desc.vtx_attrs = attrs.data();
+    mesh_desc.vtx_attrs_count = attrs.size() / 8;
+    mesh_desc.vtx_indices = indices.data();
+    mesh_desc.vtx_indices_count = indices.size();
+    mesh_desc.shapes.emplace_back(mat, mat, 0, indices.size());
+    const MeshHandle mesh = scene->AddMesh(mesh_desc);
+
+    // grid of instances to exercise both top and bottom level trees
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 4; ++i) {
+            const float xform[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                     2.2f * (float(i) - 1.5f), 2.2f * (float(j) - 1.5f), 0.0f, 1.0f};
+            scene->AddMeshInstance(mesh, xform);
+        }
+    }
+
+    sphere_light_desc_t light_desc;
+    light_desc.position[0] = 4.0f;
+    light_desc.position[1] = 4.0f;
+    light_desc.position[2] = 6.0f;
+    light_desc.color[0] = light_desc.color[1] = light_desc.color[2] = 100.0f;
+    light_desc.radius = 0.5f;
+    scene->AddLight(light_desc);
+
+    camera_desc_t cam_desc;
+    cam_desc.origin[2] = 12.0f;
+    cam_desc.fwd[2] = -1.0f;
+    cam_desc.fov = 50.0f;
+    cam_desc.max_total_depth = 3;
+    const CameraHandle cam = scene->AddCamera(cam_desc);
+    scene->set_current_cam(cam);
+
+    scene->Finalize();
+}
+
+double Ray::MeasureRendererPerformance(const eRendererType type, const settings_t &_s, RendererBase::stats_t &out_st) {
+    const int ImgRes = 96, WarmupIterations = 2, MeasuredIterations = 6;
+
+    settings_t s = _s;
+    s.w = s.h = ImgRes;
+
+    std::unique_ptr<RendererBase> renderer(CreateRenderer(s, &g_null_log, type));
+    if (!renderer || renderer->type() != type ||
+        renderer->packet_size() != std::make_pair(s.packet_w, s.packet_h)) {
+        // not supported on this machine
+        return -1.0;
+    }
+
+    std::unique_ptr<SceneBase> scene(renderer->CreateScene());
+    CreateCalibrationScene(scene.get());
+
+    RegionContext region({0, 0, ImgRes, ImgRes});
+    for (int i = 0; i < WarmupIterations; ++i) {
+        renderer->RenderScene(scene.get(), region);
+    }
+    renderer->ResetStats();
+
+    using namespace std::chrono;
+    const auto t1 = high_resolution_clock::now();
+    for (int i = 0; i < MeasuredIterations; ++i) {
+        renderer->RenderScene(scene.get(), region);
+    }
+    const double time_ms = duration<double, std::milli>{high_resolution_clock::now() - t1}.count();
+
+    renderer->GetStats(out_st);
+    return time_ms / MeasuredIterations;
+}
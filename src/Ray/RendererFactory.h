@@ -22,4 +22,24 @@ RendererBase *CreateRenderer(const settings_t &s, ILog *log = &g_null_log,
                              uint32_t enabled_types = DefaultEnabledRenderTypes);
 
 int QueryAvailableGPUDevices(ILog *log, gpu_device_t out_devices[], int capacity);
+
+/// Returns features of host CPU (instruction sets and cache sizes)
+cpu_features_t QueryCPUFeatures();
+
+/// Writes host CPU feature report to log
+void LogCPUFeatures(ILog *log);
+
+/// CPU renderers considered during calibration by default
+const uint32_t DefaultCalibratedRenderTypes =
+    RendererSSE2 | RendererSSE41 | RendererAVX | RendererAVX2 | RendererAVX512 | RendererNEON;
+
+/** @brief Finds the fastest CPU renderer and packet shape for this machine by rendering small built-in scene
+    @param log log used to report timings, primary ray throughput and coherence
+    @param s renderer settings, packet_w/packet_h are set to the fastest found shape
+    @param enabled_types renderers to consider (unsupported ones are skipped)
+    @param cache_file optional file used to store the result between runs (keyed by CPU brand)
+    @return fastest renderer type, can be passed to CreateRenderer as enabled_types
+*/
+eRendererType CalibrateCPURenderers(ILog *log, settings_t &s, uint32_t enabled_types = DefaultCalibratedRenderTypes,
+                                    const char *cache_file = nullptr);
 } // namespace Ray
\ No newline at end of file
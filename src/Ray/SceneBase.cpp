@@ -60,6 +60,7 @@ void Ray::SceneBase::GetCamera(const CameraHandle i, camera_desc_t &c) const {
     c.output_sh = (cam.pass_settings.flags & OutputSH) != 0;
     c.output_base_color = (cam.pass_settings.flags & OutputBaseColor) != 0;
     c.output_depth_normals = (cam.pass_settings.flags & OutputDepthNormals) != 0;
+    c.stochastic_texture_filtering = (cam.pass_settings.flags & StochasticTextureFiltering) != 0;
 
     c.max_diff_depth = cam.pass_settings.max_diff_depth;
     c.max_spec_depth = cam.pass_settings.max_spec_depth;
@@ -113,6 +114,9 @@ void Ray::SceneBase::SetCamera_nolock(const CameraHandle i, const camera_desc_t
     if (c.output_depth_normals) {
         cam.pass_settings.flags |= OutputDepthNormals;
     }
+    if (c.stochastic_texture_filtering) {
+        cam.pass_settings.flags |= StochasticTextureFiltering;
+    }
 
     cam.pass_settings.max_diff_depth = c.max_diff_depth;
     cam.pass_settings.max_spec_depth = c.max_spec_depth;
@@ -251,6 +251,7 @@ struct camera_desc_t {
     bool output_sh = false;              ///< Output 2-band (4 coeff) spherical harmonics data
     bool output_base_color = false;      ///< Output float RGB material base color
     bool output_depth_normals = false;   ///< Output smooth normals and depth
+    bool stochastic_texture_filtering = false; ///< Single jittered texture tap instead of filtering (CPU only)
     uint8_t max_diff_depth = 4;          ///< Maximum tracing depth of diffuse rays
     uint8_t max_spec_depth = 8;          ///< Maximum tracing depth of glossy rays
     uint8_t max_refr_depth = 8;          ///< Maximum tracing depth of glossy rays
@@ -271,6 +272,15 @@ struct environment_desc_t {
     bool multiple_importance = true; ///< Enable explicit env map sampling
 };
 
+/// Texture memory statistics
+struct tex_stats_t {
+    uint32_t textures_count = 0;              ///< Number of texture handles in use
+    uint32_t images_count = 0;                ///< Number of stored (unique) images
+    unsigned long long images_bytes = 0;      ///< Memory occupied by stored images
+    unsigned long long dedup_hits = 0;        ///< Number of added textures which reused already stored image
+    unsigned long long dedup_saved_bytes = 0; ///< Memory which would be occupied by duplicates of stored images
+};
+
 /** Base Scene class,
     cpu and gpu backends have different implementation of SceneBase
 */
@@ -425,5 +435,22 @@ class SceneBase {
 
     /// Overall BVH node count in scene
     virtual uint32_t node_count() const = 0;
+
+    /// Texture memory statistics (backends without texture deduplication report zeroes)
+    virtual void GetTextureStats(tex_stats_t &st) const { st = {}; }
+
+    /** @brief Writes whole scene state (geometry, acceleration structures, materials, lights, textures, cameras)
+               into single file (not supported by GPU backends)
+        @param file_name snapshot file path
+        @return Whether snapshot was written
+    */
+    virtual bool SaveSnapshot(const char *file_name) const { return false; }
+
+    /** @brief Restores scene state from snapshot file, scene must be empty and created by renderer of the same type
+               and settings. Handles of restored objects are the same as in saved scene.
+        @param file_name snapshot file path
+        @return Whether snapshot was loaded (scene is left empty otherwise)
+    */
+    virtual bool LoadSnapshot(const char *file_name) { return false; }
 };
 } // namespace Ray
@@ -39,6 +39,12 @@ enum eCamType { Persp, Ortho, Geo };
 
 enum eFilterType { Box, Tent };
 
+/// Order in which pixel packets (and render regions) are traversed
+enum ePixelOrder { Scanline, Morton, Hilbert };
+
+/// Method used for image denoising
+enum eDenoiseMethod { NLM, ATrous };
+
 enum eDeviceType { None, SRGB };
 
 enum eLensUnits { FOV, FLength };
@@ -51,7 +57,8 @@ enum ePassFlags {
     Clamp = (1 << 4),
     OutputSH = (1 << 5),
     OutputBaseColor = (1 << 6),
-    OutputDepthNormals = (1 << 7)
+    OutputDepthNormals = (1 << 7),
+    StochasticTextureFiltering = (1 << 8)
 };
 
 struct pass_settings_t {
@@ -78,4 +85,15 @@ struct camera_t {
 struct gpu_device_t {
     char name[256];
 };
+
+/// Host CPU capabilities, used to choose SIMD backend
+struct cpu_features_t {
+    char vendor[16];
+    char brand[64];
+    bool sse2, sse3, ssse3, sse41, sse42, popcnt;
+    bool avx, avx2, fma, f16c, bmi2;
+    bool avx512f, avx512cd, avx512bw, avx512dq, avx512vl, avx512ifma, avx512vbmi, avx512vnni;
+    uint32_t l1d_cache_size, l2_cache_size, l3_cache_size; ///< Cache sizes in bytes (0 if unknown)
+    uint32_t cache_line_size;
+};
 } // namespace Ray
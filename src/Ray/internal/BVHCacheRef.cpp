@@ -0,0 +1,209 @@
+#include "BVHCacheRef.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <atomic>
+#include <fstream>
+
+#include "../Log.h"
+#include "../SceneBase.h"
+#include "Utils.h"
+
+namespace Ray {
+namespace Ref {
+const char BVHCacheMagic[4] = {'R', 'B', 'V', 'H'};
+const uint32_t BVHCacheVersion = 2;
+// arrays start at offsets aligned to this value (enough for any node/primitive type)
+const uint64_t BVHCacheAlignment = 64;
+
+enum eBVHCacheArray { NodesArray, MNodesArray, TrisArray, MTrisArray, TriIndicesArray, ArraysCount };
+
+struct bvh_cache_header_t {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    float bbox_min[3], bbox_max[3];
+    uint64_t counts[ArraysCount];
+    uint64_t offsets[ArraysCount];
+    uint64_t payload_hash; // detects corrupted arrays (they are used without any other validation)
+};
+static_assert(sizeof(bvh_cache_header_t) == 128, "!");
+
+const size_t ElementSizes[ArraysCount] = {sizeof(bvh_node_t), sizeof(mbvh_node_t), sizeof(tri_accel_t),
+                                          sizeof(mtri_accel_t), sizeof(uint32_t)};
+
+uint64_t AlignOffset(const uint64_t offset) {
+    return BVHCacheAlignment * ((offset + BVHCacheAlignment - 1) / BVHCacheAlignment);
+}
+
+uint64_t HashArrays(const void *const arrays[ArraysCount], const uint64_t counts[ArraysCount]) {
+    uint64_t hash = 0;
+    for (int i = 0; i < ArraysCount; ++i) {
+        hash = HashData_Fast(arrays[i], size_t(counts[i] * ElementSizes[i]), hash);
+    }
+    return hash;
+}
+} // namespace Ref
+} // namespace Ray
+
+Ray::Ref::BVHCache::Entry::~Entry() {
+    if (mapped_data_) {
+        UnmapFile(mapped_data_, mapped_size_);
+    }
+}
+
+void Ray::Ref::BVHCache::Init(ILog *log, const char *cache_dir) {
+    log_ = log;
+    cache_dir_ = cache_dir;
+}
+
+std::string Ray::Ref::BVHCache::EntryPath(const uint64_t key) const {
+    char file_name[32];
+    snprintf(file_name, sizeof(file_name), "%016llx.bvh", (unsigned long long)key);
+    return cache_dir_ + "/" + file_name;
+}
+
+uint64_t Ray::Ref::BVHCache::GetKey(const mesh_desc_t &m, const bvh_settings_t &s, const bool use_wide_bvh) {
+    // everything that affects resulting structures (including their layout) goes into key
+    struct {
+        uint32_t version;
+        uint32_t layout;
+        int32_t base_vertex;
+        float oversplit_threshold;
+        int32_t min_primitives_in_leaf;
+        uint8_t allow_spatial_splits, use_fast_bvh_build, use_wide_bvh, _unused;
+        uint64_t vtx_attrs_count, vtx_indices_count;
+        uint32_t element_sizes[ArraysCount];
+    } params = {};
+    params.version = BVHCacheVersion;
+    params.layout = uint32_t(m.layout);
+    params.base_vertex = m.base_vertex;
+    params.oversplit_threshold = s.oversplit_threshold;
+    params.min_primitives_in_leaf = s.min_primitives_in_leaf;
+    params.allow_spatial_splits = s.allow_spatial_splits ? 1 : 0;
+    params.use_fast_bvh_build = s.use_fast_bvh_build ? 1 : 0;
+    params.use_wide_bvh = use_wide_bvh ? 1 : 0;
+    params.vtx_attrs_count = m.vtx_attrs_count;
+    params.vtx_indices_count = m.vtx_indices_count;
+    for (int i = 0; i < ArraysCount; ++i) {
+        params.element_sizes[i] = uint32_t(ElementSizes[i]);
+    }
+
+    uint64_t key = HashData(&params, sizeof(params));
+    key = HashData_Fast(m.vtx_attrs, m.vtx_attrs_count * AttrStrides[m.layout] * sizeof(float), key);
+    key = HashData_Fast(m.vtx_indices, m.vtx_indices_count * sizeof(uint32_t), key);
+    return key;
+}
+
+bool Ray::Ref::BVHCache::Load(const uint64_t key, Entry &out_entry) const {
+    assert(enabled() && !out_entry.mapped_data_);
+
+    size_t mapped_size = 0;
+    const uint8_t *mapped_data = MapFile(EntryPath(key).c_str(), mapped_size);
+    if (!mapped_data) {
+        return false;
+    }
+
+    bvh_cache_header_t header = {};
+    bool valid = mapped_size >= sizeof(bvh_cache_header_t);
+    if (valid) {
+        memcpy(&header, mapped_data, sizeof(bvh_cache_header_t));
+        valid = memcmp(header.magic, BVHCacheMagic, 4) == 0 && header.version == BVHCacheVersion &&
+                header.key == key;
+    }
+    for (int i = 0; i < ArraysCount && valid; ++i) {
+        valid = (header.offsets[i] % BVHCacheAlignment) == 0 && header.offsets[i] <= mapped_size &&
+                header.counts[i] <= (mapped_size - header.offsets[i]) / ElementSizes[i];
+    }
+    if (valid) {
+        const void *arrays[ArraysCount];
+        for (int i = 0; i < ArraysCount; ++i) {
+            arrays[i] = mapped_data + header.offsets[i];
+        }
+        valid = HashArrays(arrays, header.counts) == header.payload_hash;
+    }
+    if (!valid) {
+        log_->Warning("Ray: Invalid BVH cache entry %s", EntryPath(key).c_str());
+        UnmapFile(mapped_data, mapped_size);
+        return false;
+    }
+
+    out_entry.mapped_data_ = mapped_data;
+    out_entry.mapped_size_ = mapped_size;
+
+    memcpy(out_entry.bbox_min, header.bbox_min, 3 * sizeof(float));
+    memcpy(out_entry.bbox_max, header.bbox_max, 3 * sizeof(float));
+    out_entry.nodes = reinterpret_cast<const bvh_node_t *>(mapped_data + header.offsets[NodesArray]);
+    out_entry.nodes_count = size_t(header.counts[NodesArray]);
+    out_entry.mnodes = reinterpret_cast<const mbvh_node_t *>(mapped_data + header.offsets[MNodesArray]);
+    out_entry.mnodes_count = size_t(header.counts[MNodesArray]);
+    out_entry.tris = reinterpret_cast<const tri_accel_t *>(mapped_data + header.offsets[TrisArray]);
+    out_entry.tris_count = size_t(header.counts[TrisArray]);
+    out_entry.mtris = reinterpret_cast<const mtri_accel_t *>(mapped_data + header.offsets[MTrisArray]);
+    out_entry.mtris_count = size_t(header.counts[MTrisArray]);
+    out_entry.tri_indices = reinterpret_cast<const uint32_t *>(mapped_data + header.offsets[TriIndicesArray]);
+    out_entry.tri_indices_count = size_t(header.counts[TriIndicesArray]);
+
+    return true;
+}
+
+bool Ray::Ref::BVHCache::Save(const uint64_t key, const bvh_data_t &data) const {
+    assert(enabled());
+
+    bvh_cache_header_t header = {};
+    memcpy(header.magic, BVHCacheMagic, 4);
+    header.version = BVHCacheVersion;
+    header.key = key;
+    memcpy(header.bbox_min, data.bbox_min, 3 * sizeof(float));
+    memcpy(header.bbox_max, data.bbox_max, 3 * sizeof(float));
+    header.counts[NodesArray] = data.nodes_count;
+    header.counts[MNodesArray] = data.mnodes_count;
+    header.counts[TrisArray] = data.tris_count;
+    header.counts[MTrisArray] = data.mtris_count;
+    header.counts[TriIndicesArray] = data.tri_indices_count;
+
+    const void *arrays[ArraysCount] = {data.nodes, data.mnodes, data.tris, data.mtris, data.tri_indices};
+    header.payload_hash = HashArrays(arrays, header.counts);
+
+    uint64_t offset = sizeof(bvh_cache_header_t);
+    for (int i = 0; i < ArraysCount; ++i) {
+        header.offsets[i] = offset = AlignOffset(offset);
+        offset += header.counts[i] * ElementSizes[i];
+    }
+
+    // the same mesh can be added concurrently
+    static std::atomic<uint32_t> temp_counter(0);
+    const std::string path = EntryPath(key);
+    const std::string temp_path = path + "." + std::to_string(temp_counter++) + ".tmp";
+
+    std::ofstream out_file(temp_path, std::ios::binary);
+    if (!out_file) {
+        log_->Warning("Ray: Failed to write %s", path.c_str());
+        return false;
+    }
+
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(bvh_cache_header_t));
+
+    const char padding[BVHCacheAlignment] = {};
+    for (int i = 0; i < ArraysCount; ++i) {
+        const uint64_t pos = uint64_t(out_file.tellp());
+        out_file.write(padding, std::streamsize(header.offsets[i] - pos));
+        if (header.counts[i]) {
+            out_file.write(reinterpret_cast<const char *>(arrays[i]),
+                           std::streamsize(header.counts[i] * ElementSizes[i]));
+        }
+    }
+
+    out_file.close();
+    if (!out_file) {
+        std::remove(temp_path.c_str());
+        log_->Warning("Ray: Failed to write %s", path.c_str());
+        return false;
+    }
+
+    // file appears under its final name only when complete
+    std::remove(path.c_str());
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
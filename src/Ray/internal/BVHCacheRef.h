@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+
+#include "Core.h"
+
+namespace Ray {
+class ILog;
+struct mesh_desc_t;
+namespace Ref {
+// Acceleration structures of a single mesh (node and primitive indices are relative to mesh)
+struct bvh_data_t {
+    float bbox_min[3], bbox_max[3];
+    const bvh_node_t *nodes = nullptr;
+    size_t nodes_count = 0;
+    const mbvh_node_t *mnodes = nullptr;
+    size_t mnodes_count = 0;
+    const tri_accel_t *tris = nullptr;
+    size_t tris_count = 0;
+    const mtri_accel_t *mtris = nullptr;
+    size_t mtris_count = 0;
+    const uint32_t *tri_indices = nullptr;
+    size_t tri_indices_count = 0;
+};
+
+// On-disk cache of mesh BVHs. Entry is keyed by hash of mesh geometry and build settings, file layout matches
+// in-memory one, so loaded entry is used directly from mapped file.
+class BVHCache {
+    ILog *log_ = nullptr;
+    std::string cache_dir_;
+
+    std::string EntryPath(uint64_t key) const;
+
+  public:
+    // Mapped cache entry, unmapped on destruction
+    class Entry : public bvh_data_t {
+        friend class BVHCache;
+
+        const uint8_t *mapped_data_ = nullptr;
+        size_t mapped_size_ = 0;
+
+      public:
+        Entry() = default;
+        Entry(const Entry &rhs) = delete;
+        Entry &operator=(const Entry &rhs) = delete;
+        ~Entry();
+    };
+
+    void Init(ILog *log, const char *cache_dir);
+    bool enabled() const { return !cache_dir_.empty(); }
+
+    static uint64_t GetKey(const mesh_desc_t &m, const bvh_settings_t &s, bool use_wide_bvh);
+
+    bool Load(uint64_t key, Entry &out_entry) const;
+    bool Save(uint64_t key, const bvh_data_t &data) const;
+};
+} // namespace Ref
+} // namespace Ray
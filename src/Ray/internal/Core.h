@@ -3,6 +3,8 @@
 #include <cmath>
 #include <cstdint>
 
+#include <vector>
+
 #include "../SceneBase.h"
 #include "../Types.h"
 #include "Span.h"
@@ -417,9 +419,22 @@ force_inline void rgbe_to_rgb(const uint8_t rgbe[4], float out_rgb[3]) {
 void CanonicalToDir(const float p[2], float y_rotation, float out_d[3]);
 void DirToCanonical(const float d[3], float y_rotation, float out_p[2]);
 
+// Fills list of (y << 16) | x coordinates of tiles in w x h grid visited in specified order
+void GetTileOrder(ePixelOrder order, int w, int h, std::vector<uint32_t> &out_tiles);
+
+// Tile order of the last requested grid (it is rebuilt only when order or grid size changes)
+struct tile_order_t {
+    ePixelOrder order = Scanline;
+    int w = -1, h = -1;
+    std::vector<uint32_t> tiles;
+};
+const uint32_t *GetTileOrder(ePixelOrder order, int w, int h, tile_order_t &cache);
+
 extern const uint8_t morton_table_16[];
 extern const int morton_table_256[];
 
+extern const float unorm8_table[];
+
 extern const float omega_step;
 extern const char omega_table[];
 
@@ -577,6 +577,15 @@ force_inline simd_fvec4 srgb_to_rgb(const simd_fvec4 &col) {
     return ret;
 }
 
+// Fetches single jittered texel if random numbers are provided, bilinear lookup otherwise
+force_inline simd_fvec4 SampleSurfaceTexture(const TexStorageBase *const textures[], const uint32_t index,
+                                             const simd_fvec2 &uvs, const float lod, const float *rand) {
+    if (rand) {
+        return SampleStochastic(textures, index, uvs, lod, rand);
+    }
+    return SampleBilinear(textures, index, uvs, int(lod));
+}
+
 force_inline float fast_log2(float val) {
     // From https://stackoverflow.com/questions/9411823/fast-log2float-x-implementation-c
     union {
@@ -1146,7 +1155,8 @@ Ray::Ref::hit_data_t::hit_data_t() {
 }
 
 void Ray::Ref::GeneratePrimaryRays(const camera_t &cam, const rect_t &r, const int w, const int h,
-                                   const float *random_seq, aligned_vector<ray_data_t> &out_rays) {
+                                   const uint32_t *pixel_order, const float *random_seq,
+                                   aligned_vector<ray_data_t> &out_rays) {
     const simd_fvec4 cam_origin = make_fvec3(cam.origin), fwd = make_fvec3(cam.fwd), side = make_fvec3(cam.side),
                      up = make_fvec3(cam.up);
     const float focus_distance = cam.focus_distance;
@@ -1163,94 +1173,95 @@ void Ray::Ref::GeneratePrimaryRays(const camera_t &cam, const rect_t &r, const i
         return normalize(p - origin);
     };
 
-    size_t i = 0;
     out_rays.resize(size_t(r.w) * r.h);
 
-    for (int y = r.y; y < r.y + r.h; y += RPDimY) {
-        for (int x = r.x; x < r.x + r.w; x += RPDimX) {
-            ray_data_t &out_r = out_rays[i++];
-
-            auto _x = float(x);
-            auto _y = float(y);
+    for (int i = 0; i < r.w * r.h; ++i) {
+        // pixels are either visited in scanline or in specified (e.g. space-filling curve) order
+        const uint32_t pixel = pixel_order ? pixel_order[i] : ((uint32_t(i / r.w) << 16) | uint32_t(i % r.w));
+        const int x = r.x + int(pixel & 0x0000ffff), y = r.y + int(pixel >> 16);
 
-            const int index = y * w + x;
-            const int hash_val = hash(index);
+        ray_data_t &out_r = out_rays[i];
 
-            const float sample_off[2] = {construct_float(hash_val), construct_float(hash(hash_val))};
+        auto _x = float(x);
+        auto _y = float(y);
 
-            if (cam.filter == Tent) {
-                float rx = fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]);
-                if (rx < 0.5f) {
-                    rx = std::sqrt(2.0f * rx) - 1.0f;
-                } else {
-                    rx = 1.0f - std::sqrt(2.0f - 2 * rx);
-                }
+        const int index = y * w + x;
+        const int hash_val = hash(index);
 
-                float ry = fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
-                if (ry < 0.5f) {
-                    ry = std::sqrt(2.0f * ry) - 1.0f;
-                } else {
-                    ry = 1.0f - std::sqrt(2.0f - 2.0f * ry);
-                }
+        const float sample_off[2] = {construct_float(hash_val), construct_float(hash(hash_val))};
 
-                _x += 0.5f + rx;
-                _y += 0.5f + ry;
+        if (cam.filter == Tent) {
+            float rx = fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]);
+            if (rx < 0.5f) {
+                rx = std::sqrt(2.0f * rx) - 1.0f;
             } else {
-                _x += fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]);
-                _y += fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
+                rx = 1.0f - std::sqrt(2.0f - 2 * rx);
             }
 
-            simd_fvec2 offset = 0.0f;
-
-            if (cam.fstop > 0.0f) {
-                const float r1 = fract(random_seq[RAND_DIM_LENS_U] + sample_off[0]);
-                const float r2 = fract(random_seq[RAND_DIM_LENS_V] + sample_off[1]);
+            float ry = fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
+            if (ry < 0.5f) {
+                ry = std::sqrt(2.0f * ry) - 1.0f;
+            } else {
+                ry = 1.0f - std::sqrt(2.0f - 2.0f * ry);
+            }
 
-                offset = 2.0f * simd_fvec2{r1, r2} - simd_fvec2{1.0f, 1.0f};
-                if (offset.get<0>() != 0.0f && offset.get<1>() != 0.0f) {
-                    float theta, r;
-                    if (std::abs(offset.get<0>()) > std::abs(offset.get<1>())) {
-                        r = offset.get<0>();
-                        theta = 0.25f * PI * (offset.get<1>() / offset.get<0>());
-                    } else {
-                        r = offset.get<1>();
-                        theta = 0.5f * PI - 0.25f * PI * (offset.get<0>() / offset.get<1>());
-                    }
+            _x += 0.5f + rx;
+            _y += 0.5f + ry;
+        } else {
+            _x += fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]);
+            _y += fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
+        }
 
-                    if (cam.lens_blades) {
-                        r *= ngon_rad(theta, float(cam.lens_blades));
-                    }
+        simd_fvec2 offset = 0.0f;
 
-                    theta += cam.lens_rotation;
+        if (cam.fstop > 0.0f) {
+            const float r1 = fract(random_seq[RAND_DIM_LENS_U] + sample_off[0]);
+            const float r2 = fract(random_seq[RAND_DIM_LENS_V] + sample_off[1]);
 
-                    offset.set<0>(0.5f * r * std::cos(theta) / cam.lens_ratio);
-                    offset.set<1>(0.5f * r * std::sin(theta));
+            offset = 2.0f * simd_fvec2{r1, r2} - simd_fvec2{1.0f, 1.0f};
+            if (offset.get<0>() != 0.0f && offset.get<1>() != 0.0f) {
+                float theta, r;
+                if (std::abs(offset.get<0>()) > std::abs(offset.get<1>())) {
+                    r = offset.get<0>();
+                    theta = 0.25f * PI * (offset.get<1>() / offset.get<0>());
+                } else {
+                    r = offset.get<1>();
+                    theta = 0.5f * PI - 0.25f * PI * (offset.get<0>() / offset.get<1>());
                 }
 
-                const float coc = 0.5f * (cam.focal_length / cam.fstop);
-                offset *= coc * cam.sensor_height;
-            }
+                if (cam.lens_blades) {
+                    r *= ngon_rad(theta, float(cam.lens_blades));
+                }
 
-            const simd_fvec4 _origin = cam_origin + side * offset.get<0>() + up * offset.get<1>();
-            const simd_fvec4 _d = get_pix_dir(_x, _y, _origin);
-            const float clip_start = cam.clip_start / dot(_d, fwd);
+                theta += cam.lens_rotation;
 
-            for (int j = 0; j < 3; j++) {
-                out_r.o[j] = _origin[j] + _d[j] * clip_start;
-                out_r.d[j] = _d[j];
-                out_r.c[j] = 1.0f;
+                offset.set<0>(0.5f * r * std::cos(theta) / cam.lens_ratio);
+                offset.set<1>(0.5f * r * std::sin(theta));
             }
 
-            // air ior is implicit
-            out_r.ior[0] = out_r.ior[1] = out_r.ior[2] = out_r.ior[3] = -1.0f;
+            const float coc = 0.5f * (cam.focal_length / cam.fstop);
+            offset *= coc * cam.sensor_height;
+        }
 
-            out_r.cone_width = 0.0f;
-            out_r.cone_spread = spread_angle;
+        const simd_fvec4 _origin = cam_origin + side * offset.get<0>() + up * offset.get<1>();
+        const simd_fvec4 _d = get_pix_dir(_x, _y, _origin);
+        const float clip_start = cam.clip_start / dot(_d, fwd);
 
-            out_r.pdf = 1e6f;
-            out_r.xy = (x << 16) | y;
-            out_r.depth = 0;
+        for (int j = 0; j < 3; j++) {
+            out_r.o[j] = _origin[j] + _d[j] * clip_start;
+            out_r.d[j] = _d[j];
+            out_r.c[j] = 1.0f;
         }
+
+        // air ior is implicit
+        out_r.ior[0] = out_r.ior[1] = out_r.ior[2] = out_r.ior[3] = -1.0f;
+
+        out_r.cone_width = 0.0f;
+        out_r.cone_spread = spread_angle;
+
+        out_r.pdf = 1e6f;
+        out_r.xy = (x << 16) | y;
+        out_r.depth = 0;
     }
 }
 
@@ -2652,6 +2663,8 @@ Ray::Ref::simd_fvec4 Ray::Ref::SampleBilinear(const TexStorageBase *const textur
 
     simd_fvec2 _uvs = fract(uvs);
     _uvs = _uvs * img_size - 0.5f;
+    // left/top half of the first texel is blended with the last one
+    where(_uvs < 0.0f, _uvs) += img_size;
 
     const auto &p00 = storage.Fetch(tex, int(_uvs.get<0>()) + 0, int(_uvs.get<1>()) + 0, lod);
     const auto &p01 = storage.Fetch(tex, int(_uvs.get<0>()) + 1, int(_uvs.get<1>()) + 0, lod);
@@ -2698,6 +2711,28 @@ Ray::Ref::simd_fvec4 Ray::Ref::SampleTrilinear(const TexStorageBase *const textu
     return col1 * (1 - k) + col2 * k;
 }
 
+Ray::Ref::simd_fvec4 Ray::Ref::SampleStochastic(const TexStorageBase *const textures[], const uint32_t index,
+                                                const simd_fvec2 &uvs, const float lod, const float rand[3]) {
+    const TexStorageBase &storage = *textures[index >> 28];
+
+    // next level is picked with probability equal to fractional part of lod
+    const int _lod = int(lod + rand[2]);
+
+    const int tex = int(index & 0x00ffffff);
+    simd_fvec2 img_size;
+    storage.GetFRes(tex, _lod, value_ptr(img_size));
+
+    // same as with lod, neighbour texel is picked with probability equal to its bilinear weight
+    simd_fvec2 _uvs = fract(uvs);
+    _uvs = _uvs * img_size - 0.5f;
+    // wrapped the same way as in SampleBilinear
+    where(_uvs < 0.0f, _uvs) += img_size;
+    _uvs += simd_fvec2{rand[0], rand[1]};
+
+    const auto &p = storage.Fetch(tex, int(_uvs.get<0>()), int(_uvs.get<1>()), _lod);
+    return simd_fvec4{p.v[0], p.v[1], p.v[2], p.v[3]};
+}
+
 Ray::Ref::simd_fvec4 Ray::Ref::SampleAnisotropic(const TexStorageBase *const textures[], const uint32_t index,
                                                  const simd_fvec2 &uvs, const simd_fvec2 &duv_dx,
                                                  const simd_fvec2 &duv_dy) {
@@ -4015,11 +4050,24 @@ Ray::color_rgba_t Ray::Ref::ShadeSurface(const pass_settings_t &ps, const hit_da
     float mix_rand = fract(random_seq[RAND_DIM_BSDF_PICK] + sample_off[0]);
     float mix_weight = 1.0f;
 
+    // there is no spare dimension in sequence, so numbers for texture filtering are derived by hashing
+    float _tex_rand[3];
+    const float *tex_rand = nullptr;
+    if (ps.flags & StochasticTextureFiltering) {
+        int h;
+        memcpy(&h, &mix_rand, sizeof(int));
+        h = hash(h ^ hash(hash(hash(ray.xy))));
+        _tex_rand[0] = construct_float(h);
+        _tex_rand[1] = construct_float(hash(h));
+        _tex_rand[2] = construct_float(hash(hash(h)));
+        tex_rand = _tex_rand;
+    }
+
     // resolve mix material
     while (mat->type == MixNode) {
         float mix_val = mat->strength;
         if (mat->textures[BASE_TEXTURE] != 0xffffffff) {
-            mix_val *= SampleBilinear(textures, mat->textures[BASE_TEXTURE], surf.uvs, 0).get<0>();
+            mix_val *= SampleSurfaceTexture(textures, mat->textures[BASE_TEXTURE], surf.uvs, 0.0f, tex_rand).get<0>();
         }
 
         const float eta = is_backfacing ? safe_div_pos(ext_ior, mat->ior) : safe_div_pos(mat->ior, ext_ior);
@@ -4042,7 +4090,7 @@ Ray::color_rgba_t Ray::Ref::ShadeSurface(const pass_settings_t &ps, const hit_da
 
     // apply normal map
     if (mat->textures[NORMALS_TEXTURE] != 0xffffffff) {
-        simd_fvec4 normals = SampleBilinear(textures, mat->textures[NORMALS_TEXTURE], surf.uvs, 0);
+        simd_fvec4 normals = SampleSurfaceTexture(textures, mat->textures[NORMALS_TEXTURE], surf.uvs, 0.0f, tex_rand);
         normals = normals * 2.0f - 1.0f;
         normals.set<2>(1.0f);
         if (mat->textures[NORMALS_TEXTURE] & TEX_RECONSTRUCT_Z_BIT) {
@@ -4088,7 +4136,7 @@ Ray::color_rgba_t Ray::Ref::ShadeSurface(const pass_settings_t &ps, const hit_da
     if (mat->textures[BASE_TEXTURE] != 0xffffffff) {
         const uint32_t base_texture = mat->textures[BASE_TEXTURE];
         const float base_lod = get_texture_lod(textures, base_texture, lambda);
-        simd_fvec4 tex_color = SampleBilinear(textures, base_texture, surf.uvs, int(base_lod));
+        simd_fvec4 tex_color = SampleSurfaceTexture(textures, base_texture, surf.uvs, base_lod, tex_rand);
         if (base_texture & TEX_SRGB_BIT) {
             tex_color = srgb_to_rgb(tex_color);
         }
@@ -4114,7 +4162,8 @@ Ray::color_rgba_t Ray::Ref::ShadeSurface(const pass_settings_t &ps, const hit_da
     if (mat->textures[ROUGH_TEXTURE] != 0xffffffff) {
         const uint32_t roughness_tex = mat->textures[ROUGH_TEXTURE];
         const float roughness_lod = get_texture_lod(textures, roughness_tex, lambda);
-        simd_fvec4 roughness_color = SampleBilinear(textures, roughness_tex, surf.uvs, int(roughness_lod)).get<0>();
+        simd_fvec4 roughness_color =
+            SampleSurfaceTexture(textures, roughness_tex, surf.uvs, roughness_lod, tex_rand).get<0>();
         if (roughness_tex & TEX_SRGB_BIT) {
             roughness_color = srgb_to_rgb(roughness_color);
         }
@@ -4198,14 +4247,14 @@ Ray::color_rgba_t Ray::Ref::ShadeSurface(const pass_settings_t &ps, const hit_da
         if (mat->textures[METALLIC_TEXTURE] != 0xffffffff) {
             const uint32_t metallic_tex = mat->textures[METALLIC_TEXTURE];
             const float metallic_lod = get_texture_lod(textures, metallic_tex, lambda);
-            metallic *= SampleBilinear(textures, metallic_tex, surf.uvs, int(metallic_lod)).get<0>();
+            metallic *= SampleSurfaceTexture(textures, metallic_tex, surf.uvs, metallic_lod, tex_rand).get<0>();
         }
 
         float specular = unpack_unorm_16(mat->specular_unorm);
         if (mat->textures[SPECULAR_TEXTURE] != 0xffffffff) {
             const uint32_t specular_tex = mat->textures[SPECULAR_TEXTURE];
             const float specular_lod = get_texture_lod(textures, specular_tex, lambda);
-            simd_fvec4 specular_color = SampleBilinear(textures, specular_tex, surf.uvs, int(specular_lod));
+            simd_fvec4 specular_color = SampleSurfaceTexture(textures, specular_tex, surf.uvs, specular_lod, tex_rand);
             if (specular_tex & TEX_SRGB_BIT) {
                 specular_color = srgb_to_rgb(specular_color);
             }
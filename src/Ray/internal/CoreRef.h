@@ -101,10 +101,14 @@ class TexStorageBase;
 template <typename T, int N> class TexStorageLinear;
 template <typename T, int N> class TexStorageTiled;
 template <typename T, int N> class TexStorageSwizzled;
+template <int N> class TexStorageBCn;
 using TexStorageRGBA = TexStorageSwizzled<uint8_t, 4>;
 using TexStorageRGB = TexStorageSwizzled<uint8_t, 3>;
 using TexStorageRG = TexStorageSwizzled<uint8_t, 2>;
 using TexStorageR = TexStorageSwizzled<uint8_t, 1>;
+using TexStorageBC3 = TexStorageBCn<3>;
+using TexStorageBC4 = TexStorageBCn<1>;
+using TexStorageBC5 = TexStorageBCn<2>;
 
 force_inline int hash(int x) {
     unsigned ret = reinterpret_cast<const unsigned &>(x);
@@ -136,8 +140,8 @@ force_inline int total_depth(const shadow_ray_t &r) {
 }
 
 // Generation of rays
-void GeneratePrimaryRays(const camera_t &cam, const rect_t &r, int w, int h, const float *random_seq,
-                         aligned_vector<ray_data_t> &out_rays);
+void GeneratePrimaryRays(const camera_t &cam, const rect_t &r, int w, int h, const uint32_t *pixel_order,
+                         const float *random_seq, aligned_vector<ray_data_t> &out_rays);
 void SampleMeshInTextureSpace(int iteration, int obj_index, int uv_layer, const mesh_t &mesh, const transform_t &tr,
                               const uint32_t *vtx_indices, const vertex_t *vertices, const rect_t &r, int w, int h,
                               const float *random_seq, aligned_vector<ray_data_t> &out_rays,
@@ -257,6 +261,9 @@ simd_fvec4 SampleNearest(const TexStorageBase *const textures[], uint32_t index,
 simd_fvec4 SampleBilinear(const TexStorageBase *const textures[], uint32_t index, const simd_fvec2 &uvs, int lod);
 simd_fvec4 SampleBilinear(const TexStorageBase &storage, uint32_t tex, const simd_fvec2 &iuvs, int lod);
 simd_fvec4 SampleTrilinear(const TexStorageBase *const textures[], uint32_t index, const simd_fvec2 &uvs, float lod);
+// Single texel lookup with texel position and lod jittered by random numbers (bilinear/trilinear in expectation)
+simd_fvec4 SampleStochastic(const TexStorageBase *const textures[], uint32_t index, const simd_fvec2 &uvs, float lod,
+                            const float rand[3]);
 simd_fvec4 SampleAnisotropic(const TexStorageBase *const textures[], uint32_t index, const simd_fvec2 &uvs,
                              const simd_fvec2 &duv_dx, const simd_fvec2 &duv_dy);
 simd_fvec4 SampleLatlong_RGBE(const TexStorageRGBA &storage, uint32_t index, const simd_fvec4 &dir, float y_rotation);
@@ -9,6 +9,7 @@
 #include <cfloat>
 
 #include "TextureStorageRef.h"
+#include "TextureStorageVirtualRef.h"
 
 #include "simd/simd_vec.h"
 
@@ -39,25 +40,39 @@ class TexStorageBase;
 template <typename T, int N> class TexStorageLinear;
 template <typename T, int N> class TexStorageTiled;
 template <typename T, int N> class TexStorageSwizzled;
+template <int N> class TexStorageBCn;
 using TexStorageRGBA = TexStorageSwizzled<uint8_t, 4>;
 using TexStorageRGB = TexStorageSwizzled<uint8_t, 3>;
 using TexStorageRG = TexStorageSwizzled<uint8_t, 2>;
 using TexStorageR = TexStorageSwizzled<uint8_t, 1>;
+using TexStorageBC3 = TexStorageBCn<3>;
+using TexStorageBC4 = TexStorageBCn<1>;
+using TexStorageBC5 = TexStorageBCn<2>;
 } // namespace Ref
 namespace NS {
-// Up to 4x4 rays
+// Ray packet layout, pixels are grouped in 2x2 quads when possible, e.g. for 4x4 rays:
 // [ 0] [ 1] [ 4] [ 5]
 // [ 2] [ 3] [ 6] [ 7]
 // [ 8] [ 9] [12] [13]
 // [10] [11] [14] [15]
-alignas(64) const int ray_packet_layout_x[] = {0, 1, 0, 1,  // NOLINT
-                                               2, 3, 2, 3,  // NOLINT
-                                               0, 1, 0, 1,  // NOLINT
-                                               2, 3, 2, 3}; // NOLINT
-alignas(64) const int ray_packet_layout_y[] = {0, 0, 1, 1,  // NOLINT
-                                               0, 0, 1, 1,  // NOLINT
-                                               2, 2, 3, 3,  // NOLINT
-                                               2, 2, 3, 3}; // NOLINT
+// Packets with one of dimensions equal to 1 are laid out linearly.
+template <int DimX, int DimY> struct ray_packet_layout_t {
+    alignas(64) int x[DimX * DimY];
+    alignas(64) int y[DimX * DimY];
+
+    ray_packet_layout_t() {
+        for (int i = 0; i < DimX * DimY; ++i) {
+            if ((DimX % 2) == 0 && (DimY % 2) == 0) {
+                const int quad = i / 4;
+                x[i] = 2 * (quad % (DimX / 2)) + (i & 1);
+                y[i] = 2 * (quad / (DimX / 2)) + ((i >> 1) & 1);
+            } else {
+                x[i] = i % DimX;
+                y[i] = i / DimX;
+            }
+        }
+    }
+};
 
 // Usefull to make index argument for a gather instruction
 alignas(64) const int ascending_counter[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
@@ -90,6 +105,8 @@ template <int S> struct shadow_ray_t {
     simd_fvec<S> c[3];
     // 16-bit pixel coordinates of rays in packet ((x << 16) | y)
     simd_ivec<S> xy;
+    // index of light rays are traced to (-1 if unknown)
+    simd_ivec<S> light_index;
 };
 
 template <int S> struct hit_data_t {
@@ -108,6 +125,27 @@ template <int S> struct hit_data_t {
     }
 };
 
+// Conservative (interval arithmetic) bounds of coherent ray packet, allows to cull BVH node with single test
+struct packet_frustum_t {
+    float o_min[3], o_max[3];
+    float inv_d_min[3], inv_d_max[3];
+    int neg[3]; // direction sign along each axis (the same for all rays in packet)
+    float t_max;
+};
+
+// Packets with larger spread of (normalized) directions are traversed ray-by-ray
+const float FRUSTUM_MAX_DIR_SPREAD = 0.1f;
+
+// Last (solid) triangle that blocked shadow ray going to particular light, tested first for the next rays
+struct shadow_occluder_t {
+    int light_index = -1;
+    uint32_t mi_index, tri_index;
+    tri_accel_t tri; // in object space of mesh instance
+};
+
+// Per-thread occluder cache is indexed by (light_index % SHADOW_OCCLUDER_CACHE_SIZE)
+const int SHADOW_OCCLUDER_CACHE_SIZE = 64;
+
 template <int S> struct surface_t {
     simd_fvec<S> P[3] = {0.0f, 0.0f, 0.0f}, T[3], B[3], N[3], plane_N[3];
     simd_fvec<S> uvs[2];
@@ -120,6 +158,7 @@ template <int S> struct light_sample_t {
     simd_fvec<S> area = 0.0f, dist_mul = 1.0f, pdf = 0.0f;
     // TODO: merge these two into bitflags
     simd_ivec<S> cast_shadow = -1, from_env = 0;
+    simd_ivec<S> light_index = -1;
 
     force_inline light_sample_t() = default;
 };
@@ -142,7 +181,8 @@ template <int S> force_inline int total_depth(const shadow_ray_t<S> &r) {
 
 // Generating rays
 template <int DimX, int DimY>
-void GeneratePrimaryRays(int iteration, const camera_t &cam, const rect_t &r, int w, int h, const float random_seq[],
+void GeneratePrimaryRays(int iteration, const camera_t &cam, const rect_t &r, int w, int h,
+                         const uint32_t packet_order[], const float random_seq[],
                          aligned_vector<ray_data_t<DimX * DimY>> &out_rays,
                          aligned_vector<simd_ivec<DimX * DimY>> &out_masks);
 template <int DimX, int DimY>
@@ -219,6 +259,42 @@ Traverse_MacroTree_WithStack_AnyHit(const simd_fvec<S> ro[3], const simd_fvec<S>
                                     const mesh_instance_t *mesh_instances, const uint32_t *mi_indices,
                                     const mesh_t *meshes, const transform_t *transforms, const mtri_accel_t *mtris,
                                     const tri_mat_data_t *materials, const uint32_t *tri_indices, hit_data_t<S> &inter);
+// Frustum traversal of coherent packets (e.g. primary or shadow rays to point light) through wide bvh, nodes are
+// tested once for the whole packet, per-ray tests are done only for leaves
+template <int S>
+bool InitPacketFrustum(const float ro[3][S], const float rd[3][S], const int ray_mask[S], const float t[S],
+                       float max_dir_spread, packet_frustum_t &out_fr);
+template <int S>
+bool InitPacketFrustum(const simd_fvec<S> ro[3], const simd_fvec<S> rd[3], const simd_ivec<S> &ray_mask,
+                       const simd_fvec<S> &t, float max_dir_spread, packet_frustum_t &out_fr);
+template <int S>
+bool Traverse_MacroTree_Frustum_ClosestHit(packet_frustum_t fr, const simd_fvec<S> ro[3], const simd_fvec<S> rd[3],
+                                           const simd_ivec<S> &ray_mask, const mbvh_node_t *nodes, uint32_t node_index,
+                                           const mesh_instance_t *mesh_instances, const uint32_t *mi_indices,
+                                           const mesh_t *meshes, const transform_t *transforms,
+                                           const mtri_accel_t *mtris, const uint32_t *tri_indices,
+                                           hit_data_t<S> &inter);
+template <int S>
+simd_ivec<S> Traverse_MacroTree_Frustum_AnyHit(packet_frustum_t fr, const simd_fvec<S> ro[3], const simd_fvec<S> rd[3],
+                                               const simd_ivec<S> &ray_mask, const mbvh_node_t *nodes,
+                                               uint32_t node_index, const mesh_instance_t *mesh_instances,
+                                               const uint32_t *mi_indices, const mesh_t *meshes,
+                                               const transform_t *transforms, const mtri_accel_t *mtris,
+                                               const tri_mat_data_t *materials, const uint32_t *tri_indices,
+                                               hit_data_t<S> &inter);
+// returns mask of rays that found closer intersection
+template <int S>
+long Traverse_MicroTree_Frustum_ClosestHit(packet_frustum_t fr, const float ro[3][S], const float rd[3][S],
+                                           const int ray_mask[S], const mbvh_node_t *nodes, uint32_t node_index,
+                                           const mtri_accel_t *mtris, int inter_prim_index[S], float inter_t[S],
+                                           float inter_u[S], float inter_v[S]);
+// returns mask of rays that found intersection, rays that hit solid surface are marked in out_solid_mask
+template <int S>
+long Traverse_MicroTree_Frustum_AnyHit(packet_frustum_t fr, const float ro[3][S], const float rd[3][S],
+                                       const int ray_mask[S], const mbvh_node_t *nodes, uint32_t node_index,
+                                       const mtri_accel_t *mtris, const tri_mat_data_t *materials,
+                                       const uint32_t *tri_indices, int inter_prim_index[S], float inter_t[S],
+                                       float inter_u[S], float inter_v[S], long &out_solid_mask);
 // traditional bvh traversal with stack for inner nodes
 template <int S>
 bool Traverse_MicroTree_WithStack_ClosestHit(const simd_fvec<S> ro[3], const simd_fvec<S> rd[3],
@@ -340,6 +416,11 @@ void SampleBilinear(const Ref::TexStorageBase *const textures[], uint32_t index,
 template <int S>
 void SampleTrilinear(const Ref::TexStorageBase *const textures[], uint32_t index, const simd_fvec<S> uvs[2],
                      const simd_fvec<S> &lod, const simd_ivec<S> &mask, simd_fvec<S> out_rgba[4]);
+// Single texel lookup with texel position and lod jittered by random numbers (bilinear/trilinear in expectation)
+template <int S>
+void SampleStochastic(const Ref::TexStorageBase *const textures[], uint32_t index, const simd_fvec<S> uvs[2],
+                      const simd_fvec<S> &lod, const simd_fvec<S> rand[3], const simd_ivec<S> &mask,
+                      simd_fvec<S> out_rgba[4]);
 template <int S>
 void SampleLatlong_RGBE(const Ref::TexStorageRGBA &storage, uint32_t index, const simd_fvec<S> dir[3], float y_rotation,
                         const simd_ivec<S> &mask, simd_fvec<S> out_rgb[3]);
@@ -349,9 +430,20 @@ template <int S>
 void IntersectScene(ray_data_t<S> &r, const simd_ivec<S> &ray_mask, int min_transp_depth, int max_transp_depth,
                     const float random_seq[], const scene_data_t &sc, uint32_t root_index,
                     const Ref::TexStorageBase *const textures[], hit_data_t<S> &inter);
+// (occluders is optional per-thread cache of SHADOW_OCCLUDER_CACHE_SIZE entries)
 template <int S>
 void IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask, int max_transp_depth, const scene_data_t &sc,
-                    uint32_t node_index, const Ref::TexStorageBase *const textures[], simd_fvec<S> rc[3]);
+                    uint32_t node_index, const Ref::TexStorageBase *const textures[], simd_fvec<S> rc[3],
+                    shadow_occluder_t occluders[]);
+// Test shadow rays against occluders cached for their lights, returns mask of rays that are blocked for sure
+template <int S>
+simd_ivec<S> IntersectCachedOccluders(const shadow_ray_t<S> &r, const simd_ivec<S> &ray_mask,
+                                      const simd_fvec<S> &dist, const scene_data_t &sc,
+                                      const shadow_occluder_t occluders[]);
+// Remember solid triangles hit by shadow rays
+template <int S>
+void UpdateCachedOccluders(const shadow_ray_t<S> &r, const simd_ivec<S> &ray_mask, const hit_data_t<S> &inter,
+                           const scene_data_t &sc, shadow_occluder_t occluders[]);
 
 // Pick point on any light source for evaluation
 template <int S>
@@ -470,6 +562,19 @@ void ShadeSurface(const pass_settings_t &ps, const float *random_seq, const hit_
                   simd_ivec<S> out_secondary_masks[], ray_data_t<S> out_secondary_rays[], int *out_secondary_rays_count,
                   simd_ivec<S> out_shadow_masks[], shadow_ray_t<S> out_shadow_rays[], int *out_shadow_rays_count,
                   simd_fvec<S> out_base_color[4], simd_fvec<S> out_depth_normals[4]);
+
+// Denoise (vectorized across S output pixels, patch distances are box-filtered once per window offset)
+template <int S, int WINDOW_SIZE = 7, int NEIGHBORHOOD_SIZE = 3>
+void NLMFilter(const color_rgba_t input[], const rect_t &rect, int input_stride, float alpha, float damping,
+               const color_rgba_t variance[], const rect_t &output_rect, int output_stride, color_rgba_t output[],
+               aligned_vector<float, 64> &temp_buf);
+// Edge-avoiding a-trous filter guided by normals, depth and albedo (similar to spatial part of SVGF), each
+// iteration applies 5x5 kernel with doubled step, so rect must be surrounded by 2 * (2^iterations - 1) pixels
+template <int S>
+void ATrousFilter(const color_rgba_t input[], const color_rgba_t variance[], const color_rgba_t base_color[],
+                  const color_rgba_t depth_normals[], const rect_t &rect, int input_stride, int iterations,
+                  const rect_t &output_rect, int output_stride, color_rgba_t output[],
+                  aligned_vector<float, 64> &temp_buf);
 } // namespace NS
 } // namespace Ray
 
@@ -1034,6 +1139,48 @@ force_inline bool bbox_test(const float inv_d[3], const float inv_do[3], const f
     return tmin <= tmax && tmin <= t && tmax > 0;
 }
 
+template <int S>
+force_inline long frustum_test_oct(const packet_frustum_t &fr, const float bbox_min[3][8], const float bbox_max[3][8],
+                                   float out_dist[8]) {
+    static const int W = (S < 8) ? S : 8;
+    static const int LanesCount = (8 / W);
+
+    long res = 0;
+    for (int i = LanesCount - 1; i >= 0; i--) {
+        simd_fvec<W> tmin = -MAX_DIST, tmax = MAX_DIST;
+        for (int j = 0; j < 3; j++) {
+            const float *near_plane = fr.neg[j] ? bbox_max[j] : bbox_min[j];
+            const float *far_plane = fr.neg[j] ? bbox_min[j] : bbox_max[j];
+
+            const simd_fvec<W> _near =
+                simd_fvec<W>{&near_plane[W * i], simd_mem_aligned} - (fr.neg[j] ? fr.o_min[j] : fr.o_max[j]);
+            const simd_fvec<W> _far =
+                simd_fvec<W>{&far_plane[W * i], simd_mem_aligned} - (fr.neg[j] ? fr.o_max[j] : fr.o_min[j]);
+
+            tmin = max(tmin, min(_near * fr.inv_d_min[j], _near * fr.inv_d_max[j]));
+            tmax = min(tmax, max(_far * fr.inv_d_min[j], _far * fr.inv_d_max[j]));
+        }
+        tmax *= 1.00000024f;
+
+        const simd_fvec<W> fmask = (tmin <= tmax) & (tmin <= fr.t_max) & (tmax > 0.0f);
+        res <<= W;
+        res |= simd_cast(fmask).movemask();
+        tmin.store_to(&out_dist[W * i], simd_mem_aligned);
+    }
+
+    return res;
+}
+
+template <int S> force_inline float packet_max_t(const float t[S], const int mask[S]) {
+    float ret = 0.0f;
+    for (int i = 0; i < S; i++) {
+        if (mask[i]) {
+            ret = std::max(ret, t[i]);
+        }
+    }
+    return ret;
+}
+
 template <int S>
 force_inline simd_ivec<S> bbox_test(const simd_fvec<S> p[3], const float _bbox_min[3], const float _bbox_max[3]) {
     const simd_fvec<S> mask = (p[0] > _bbox_min[0]) & (p[0] < _bbox_max[0]) & (p[1] > _bbox_min[1]) &
@@ -1480,6 +1627,20 @@ template <int S> force_inline simd_fvec<S> fast_log2(const simd_fvec<S> &val) {
     log_2 += ((-0.34484843f) * u.val + 2.02466578f) * u.val - 0.67487759f;
     return log_2;
 }
+template <int S> force_inline simd_fvec<S> fast_exp(const simd_fvec<S> &val) {
+    // 2^(i + f) = 2^i * 2^f, where 2^f is approximated with polynomial on [0; 1)
+    const simd_fvec<S> t = max(val * 1.44269504f, -126.0f);
+    const simd_fvec<S> i = floor(t), f = t - i;
+    union {
+        simd_fvec<S> val;
+        simd_ivec<S> x;
+    } u = {((((0.0013333558f * f + 0.0096181291f) * f + 0.0555041087f) * f + 0.2402264923f) * f + 0.6931471806f) *
+               f +
+           1.0f};
+    u.x += simd_ivec<S>(i) << 23;
+    return u.val;
+}
+
 template <int S> force_inline simd_fvec<S> lum(const simd_fvec<S> color[3]) {
     return 0.212671f * color[0] + 0.715160f * color[1] + 0.072169f * color[2];
 }
@@ -1493,6 +1654,278 @@ template <int S> force_inline void srgb_to_rgb(const simd_fvec<S> in_col[4], sim
     out_col[3] = in_col[3];
 }
 
+// Offsets of four bilinear taps (x0y0, x1y0, x0y1, x1y1) for all lanes, mirror TexStorage*::Get layouts
+template <int S, typename T, int N>
+force_inline void get_bilinear_offsets(const Ref::TexStorageLinear<T, N> &storage, const int tex,
+                                       const simd_ivec<S> &lod, const simd_ivec<S> x[2], const simd_ivec<S> y[2],
+                                       simd_ivec<S> out_offsets[4]) {
+    const simd_ivec<S> w = gather(storage.res(tex), lod * 2);
+    const simd_ivec<S> base = gather(storage.lod_offsets(tex), lod);
+
+    const simd_ivec<S> row0 = base + w * y[0], row1 = base + w * y[1];
+    out_offsets[0] = row0 + x[0];
+    out_offsets[1] = row0 + x[1];
+    out_offsets[2] = row1 + x[0];
+    out_offsets[3] = row1 + x[1];
+}
+
+template <int S, typename T, int N>
+force_inline void get_bilinear_offsets(const Ref::TexStorageTiled<T, N> &storage, const int tex,
+                                       const simd_ivec<S> &lod, const simd_ivec<S> x[2], const simd_ivec<S> y[2],
+                                       simd_ivec<S> out_offsets[4]) {
+    const int TileSize = Ref::TexStorageTiled<T, N>::TileSize;
+    static_assert(TileSize == 4, "Shifts below assume 4x4 tiles");
+
+    const simd_ivec<S> w_in_tiles = gather(storage.res_in_tiles(tex), lod * 2);
+    const simd_ivec<S> base = gather(storage.lod_offsets(tex), lod);
+
+    simd_ivec<S> row[2], col[2];
+    UNROLLED_FOR(i, 2, {
+        row[i] = base + srai(y[i], 2) * w_in_tiles * (TileSize * TileSize) + (y[i] & (TileSize - 1)) * TileSize;
+        col[i] = srai(x[i], 2) * (TileSize * TileSize) + (x[i] & (TileSize - 1));
+    })
+
+    out_offsets[0] = row[0] + col[0];
+    out_offsets[1] = row[0] + col[1];
+    out_offsets[2] = row[1] + col[0];
+    out_offsets[3] = row[1] + col[1];
+}
+
+template <int S, typename T, int N>
+force_inline void get_bilinear_offsets(const Ref::TexStorageSwizzled<T, N> &storage, const int tex,
+                                       const simd_ivec<S> &lod, const simd_ivec<S> x[2], const simd_ivec<S> y[2],
+                                       simd_ivec<S> out_offsets[4]) {
+    using StorageType = Ref::TexStorageSwizzled<T, N>;
+    static_assert(StorageType::OuterTileH == 64, "Shift below assumes 64 pixels high outer tiles");
+
+    const simd_ivec<S> tile_y_stride = gather(storage.tile_y_stride(tex), lod);
+    const simd_ivec<S> base = gather(storage.lod_offsets(tex), lod);
+
+    simd_ivec<S> row[2], col[2];
+    UNROLLED_FOR(i, 2, {
+        row[i] = base + srai(y[i], 6) * tile_y_stride + StorageType::swizzle_y(y[i]);
+        col[i] = StorageType::swizzle_x_tile(x[i]);
+    })
+
+    out_offsets[0] = row[0] + col[0];
+    out_offsets[1] = row[0] + col[1];
+    out_offsets[2] = row[1] + col[0];
+    out_offsets[3] = row[1] + col[1];
+}
+
+// Loads texels at given offsets and converts them to normalized floats (last channel is replicated, as in Fetch)
+template <int S, int N>
+force_inline void fetch_texels(const color_t<uint8_t, N> *pixels, const simd_ivec<S> &offsets,
+                               simd_fvec<S> out_rgba[4]) {
+    for (int i = 0; i < S; i++) {
+        const color_t<uint8_t, N> &p = pixels[offsets[i]];
+        for (int j = 0; j < N; j++) {
+            out_rgba[j].set(i, unorm8_table[p.v[j]]);
+        }
+    }
+    for (int j = N; j < 4; j++) {
+        out_rgba[j] = out_rgba[N - 1];
+    }
+}
+
+#if defined(USE_AVX2) || defined(USE_AVX512)
+// 4-byte texels can be fetched with a single hardware gather per tap
+template <int S>
+force_inline void fetch_texels(const color_t<uint8_t, 4> *pixels, const simd_ivec<S> &offsets,
+                               simd_fvec<S> out_rgba[4]) {
+    static_assert(sizeof(color_t<uint8_t, 4>) == sizeof(int), "!");
+    const simd_ivec<S> texels = gather(reinterpret_cast<const int *>(pixels), offsets);
+    UNROLLED_FOR(j, 4, { out_rgba[j] = gather(unorm8_table, (texels >> (8 * j)) & 0xff); })
+}
+#endif
+
+// Loads four bilinear taps of uncompressed storage
+template <int S, typename StorageType>
+force_inline void fetch_bilinear_texels(const StorageType &storage, const int tex, const simd_ivec<S> &lod,
+                                        const simd_ivec<S> x[2], const simd_ivec<S> y[2], const simd_ivec<S> &mask,
+                                        simd_fvec<S> p00[4], simd_fvec<S> p01[4], simd_fvec<S> p10[4],
+                                        simd_fvec<S> p11[4]) {
+    simd_ivec<S> offsets[4];
+    get_bilinear_offsets(storage, tex, lod, x, y, offsets);
+
+    fetch_texels(storage.pixels(tex), offsets[0], p00);
+    fetch_texels(storage.pixels(tex), offsets[1], p01);
+    fetch_texels(storage.pixels(tex), offsets[2], p10);
+    fetch_texels(storage.pixels(tex), offsets[3], p11);
+}
+
+// Block-compressed storage decodes whole 4x4 blocks (through per-thread cache), so taps are fetched lane by lane
+template <int S, int N>
+force_inline void fetch_bilinear_texels(const Ref::TexStorageBCn<N> &storage, const int tex, const simd_ivec<S> &lod,
+                                        const simd_ivec<S> x[2], const simd_ivec<S> y[2], const simd_ivec<S> &mask,
+                                        simd_fvec<S> p00[4], simd_fvec<S> p01[4], simd_fvec<S> p10[4],
+                                        simd_fvec<S> p11[4]) {
+    for (int i = 0; i < S; i++) {
+        if (!mask[i]) {
+            continue;
+        }
+
+        const int _x[2] = {x[0][i], x[1][i]}, _y[2] = {y[0][i], y[1][i]};
+
+        color_t<uint8_t, N> texels[4];
+        storage.GetQuad(tex, _x, _y, lod[i], texels);
+
+        for (int j = 0; j < N; j++) {
+            p00[j].set(i, unorm8_table[texels[0].v[j]]);
+            p01[j].set(i, unorm8_table[texels[1].v[j]]);
+            p10[j].set(i, unorm8_table[texels[2].v[j]]);
+            p11[j].set(i, unorm8_table[texels[3].v[j]]);
+        }
+    }
+    for (int j = N; j < 4; j++) {
+        p00[j] = p00[N - 1];
+        p01[j] = p01[N - 1];
+        p10[j] = p10[N - 1];
+        p11[j] = p11[N - 1];
+    }
+}
+
+// Paged storage falls back to coarser mip level per texel, so taps are fetched lane by lane
+template <int S>
+force_inline void fetch_bilinear_texels(const Ref::TexStorageVirtual &storage, const int tex, const simd_ivec<S> &lod,
+                                        const simd_ivec<S> x[2], const simd_ivec<S> y[2], const simd_ivec<S> &mask,
+                                        simd_fvec<S> p00[4], simd_fvec<S> p01[4], simd_fvec<S> p10[4],
+                                        simd_fvec<S> p11[4]) {
+    for (int i = 0; i < S; i++) {
+        if (!mask[i]) {
+            continue;
+        }
+
+        const color_rgba8_t texels[4] = {
+            storage.Get(tex, x[0][i], y[0][i], lod[i]), storage.Get(tex, x[1][i], y[0][i], lod[i]),
+            storage.Get(tex, x[0][i], y[1][i], lod[i]), storage.Get(tex, x[1][i], y[1][i], lod[i])};
+
+        for (int j = 0; j < 4; j++) {
+            p00[j].set(i, unorm8_table[texels[0].v[j]]);
+            p01[j].set(i, unorm8_table[texels[1].v[j]]);
+            p10[j].set(i, unorm8_table[texels[2].v[j]]);
+            p11[j].set(i, unorm8_table[texels[3].v[j]]);
+        }
+    }
+}
+
+// Loads single texel of uncompressed storage (offsets of duplicated taps are folded by compiler)
+template <int S, typename StorageType>
+force_inline void fetch_texel(const StorageType &storage, const int tex, const simd_ivec<S> &lod, const simd_ivec<S> &x,
+                              const simd_ivec<S> &y, const simd_ivec<S> &mask, simd_fvec<S> out_rgba[4]) {
+    const simd_ivec<S> _x[2] = {x, x}, _y[2] = {y, y};
+
+    simd_ivec<S> offsets[4];
+    get_bilinear_offsets(storage, tex, lod, _x, _y, offsets);
+
+    fetch_texels(storage.pixels(tex), offsets[0], out_rgba);
+}
+
+template <int S, int N>
+force_inline void fetch_texel(const Ref::TexStorageBCn<N> &storage, const int tex, const simd_ivec<S> &lod,
+                              const simd_ivec<S> &x, const simd_ivec<S> &y, const simd_ivec<S> &mask,
+                              simd_fvec<S> out_rgba[4]) {
+    for (int i = 0; i < S; i++) {
+        if (!mask[i]) {
+            continue;
+        }
+
+        const color_t<uint8_t, N> texel = storage.Get(tex, x[i], y[i], lod[i]);
+        for (int j = 0; j < N; j++) {
+            out_rgba[j].set(i, unorm8_table[texel.v[j]]);
+        }
+    }
+    for (int j = N; j < 4; j++) {
+        out_rgba[j] = out_rgba[N - 1];
+    }
+}
+
+template <int S>
+force_inline void fetch_texel(const Ref::TexStorageVirtual &storage, const int tex, const simd_ivec<S> &lod,
+                              const simd_ivec<S> &x, const simd_ivec<S> &y, const simd_ivec<S> &mask,
+                              simd_fvec<S> out_rgba[4]) {
+    for (int i = 0; i < S; i++) {
+        if (!mask[i]) {
+            continue;
+        }
+
+        const color_rgba8_t texel = storage.Get(tex, x[i], y[i], lod[i]);
+        for (int j = 0; j < 4; j++) {
+            out_rgba[j].set(i, unorm8_table[texel.v[j]]);
+        }
+    }
+}
+
+template <int S, typename StorageType>
+void SampleBilinear_NonVirtual(const StorageType &storage, const int tex, const simd_fvec<S> uvs[2],
+                               const simd_ivec<S> &lod, const simd_ivec<S> &mask, simd_fvec<S> out_rgba[4]) {
+    // inactive lanes are redirected to the first texel of base level
+    const simd_ivec<S> _lod = lod & mask;
+
+    // stored resolution includes 1-pixel border (same as GetFRes)
+    const int *res = storage.res(tex);
+    const simd_fvec<S> img_size[2] = {simd_fvec<S>(gather(res, _lod * 2) - 1),
+                                      simd_fvec<S>(gather(res, _lod * 2 + 1) - 1)};
+
+    simd_fvec<S> _uvs[2] = {fract(uvs[0]) * img_size[0] - 0.5f, fract(uvs[1]) * img_size[1] - 0.5f};
+    // left/top half of the first texel is blended with the last one
+    where(_uvs[0] < 0.0f, _uvs[0]) += img_size[0];
+    where(_uvs[1] < 0.0f, _uvs[1]) += img_size[1];
+
+    const simd_fvec<S> k[2] = {fract(_uvs[0]), fract(_uvs[1])};
+
+    const simd_ivec<S> x[2] = {simd_ivec<S>(_uvs[0]) & mask, simd_ivec<S>(_uvs[0] + 1.0f) & mask};
+    const simd_ivec<S> y[2] = {simd_ivec<S>(_uvs[1]) & mask, simd_ivec<S>(_uvs[1] + 1.0f) & mask};
+
+    simd_fvec<S> p00[4], p01[4], p10[4], p11[4];
+    fetch_bilinear_texels(storage, tex, _lod, x, y, mask, p00, p01, p10, p11);
+
+    UNROLLED_FOR(i, 4, {
+        const simd_fvec<S> p0 = p01[i] * k[0] + p00[i] * (1.0f - k[0]);
+        const simd_fvec<S> p1 = p11[i] * k[0] + p10[i] * (1.0f - k[0]);
+        where(mask, out_rgba[i]) = (p1 * k[1] + p0 * (1.0f - k[1]));
+    })
+}
+
+template <int S, typename StorageType>
+void SampleStochastic_NonVirtual(const StorageType &storage, const int tex, const simd_fvec<S> uvs[2],
+                                 const simd_fvec<S> &lod, const simd_fvec<S> rand[3], const simd_ivec<S> &mask,
+                                 simd_fvec<S> out_rgba[4]) {
+    // next level is picked with probability equal to fractional part of lod
+    const simd_ivec<S> _lod = simd_ivec<S>(lod + rand[2]) & mask;
+
+    const int *res = storage.res(tex);
+    const simd_fvec<S> img_size[2] = {simd_fvec<S>(gather(res, _lod * 2) - 1),
+                                      simd_fvec<S>(gather(res, _lod * 2 + 1) - 1)};
+
+    // same as with lod, neighbour texel is picked with probability equal to its bilinear weight
+    simd_fvec<S> _uvs[2] = {fract(uvs[0]) * img_size[0] - 0.5f, fract(uvs[1]) * img_size[1] - 0.5f};
+    // wrapped the same way as in SampleBilinear
+    where(_uvs[0] < 0.0f, _uvs[0]) += img_size[0];
+    where(_uvs[1] < 0.0f, _uvs[1]) += img_size[1];
+    _uvs[0] += rand[0];
+    _uvs[1] += rand[1];
+
+    const simd_ivec<S> x = simd_ivec<S>(_uvs[0]) & mask, y = simd_ivec<S>(_uvs[1]) & mask;
+
+    simd_fvec<S> col[4];
+    fetch_texel(storage, tex, _lod, x, y, mask, col);
+
+    UNROLLED_FOR(i, 4, { where(mask, out_rgba[i]) = col[i]; })
+}
+
+// Fetches single jittered texel if random numbers are provided, bilinear lookup otherwise
+template <int S>
+force_inline void SampleSurfaceTexture(const Ref::TexStorageBase *const textures[], const uint32_t index,
+                                       const simd_fvec<S> uvs[2], const simd_fvec<S> &lod, const simd_fvec<S> *rand,
+                                       const simd_ivec<S> &mask, simd_fvec<S> out_rgba[4]) {
+    if (rand) {
+        SampleStochastic(textures, index, uvs, lod, rand, mask, out_rgba);
+    } else {
+        SampleBilinear(textures, index, uvs, simd_ivec<S>(lod), mask, out_rgba);
+    }
+}
+
 template <int S>
 simd_fvec<S> get_texture_lod(const Ref::TexStorageBase *textures[], const uint32_t index, const simd_fvec<S> duv_dx[2],
                              const simd_fvec<S> duv_dy[2], const simd_ivec<S> &mask) {
@@ -2059,7 +2492,7 @@ simd_fvec<S> peek_ior_stack(const simd_fvec<S> stack[4], const simd_ivec<S> &_sk
 
 template <int DimX, int DimY>
 void Ray::NS::GeneratePrimaryRays(const int iteration, const camera_t &cam, const rect_t &r, int w, int h,
-                                  const float random_seq[], aligned_vector<ray_data_t<DimX * DimY>> &out_rays,
+                                  const uint32_t packet_order[], const float random_seq[], aligned_vector<ray_data_t<DimX * DimY>> &out_rays,
                                   aligned_vector<simd_ivec<DimX * DimY>> &out_masks) {
     const int S = DimX * DimY;
     static_assert(S <= 16, "!");
@@ -2070,103 +2503,104 @@ void Ray::NS::GeneratePrimaryRays(const int iteration, const camera_t &cam, cons
     const float fov_k = temp * cam.focus_distance;
     const float spread_angle = std::atan(2.0f * temp / float(h));
 
-    const auto off_x = simd_ivec<S>{ray_packet_layout_x, simd_mem_aligned},
-               off_y = simd_ivec<S>{ray_packet_layout_y, simd_mem_aligned};
+    static const ray_packet_layout_t<DimX, DimY> layout;
+    const auto off_x = simd_ivec<S>{layout.x, simd_mem_aligned}, off_y = simd_ivec<S>{layout.y, simd_mem_aligned};
 
     const int x_res = (r.w + DimX - 1) / DimX, y_res = (r.h + DimY - 1) / DimY;
 
-    size_t i = 0;
     out_rays.resize(x_res * y_res);
     out_masks.resize(x_res * y_res);
 
-    for (int y = r.y; y < r.y + r.h; y += DimY) {
-        for (int x = r.x; x < r.x + r.w; x += DimX) {
-            simd_ivec<S> &out_mask = out_masks[i];
-            ray_data_t<S> &out_r = out_rays[i++];
-
-            const simd_ivec<S> ixx = x + off_x, iyy = y + off_y;
+    for (int i = 0; i < x_res * y_res; ++i) {
+        // packets are either visited in scanline or in specified (e.g. space-filling curve) order
+        const uint32_t packet = packet_order ? packet_order[i] : ((uint32_t(i / x_res) << 16) | uint32_t(i % x_res));
+        const int x = r.x + int(packet & 0x0000ffff) * DimX, y = r.y + int(packet >> 16) * DimY;
 
-            out_mask = (ixx < w) & (iyy < h);
+        simd_ivec<S> &out_mask = out_masks[i];
+        ray_data_t<S> &out_r = out_rays[i];
 
-            const simd_ivec<S> index = iyy * w + ixx;
+        const simd_ivec<S> ixx = x + off_x, iyy = y + off_y;
 
-            auto fxx = (simd_fvec<S>)ixx, fyy = (simd_fvec<S>)iyy;
+        out_mask = (ixx < w) & (iyy < h);
 
-            const simd_ivec<S> hash_val = hash(index);
-            const simd_fvec<S> sample_off[2] = {construct_float(hash_val), construct_float(hash(hash_val))};
+        const simd_ivec<S> index = iyy * w + ixx;
 
-            simd_fvec<S> rxx = fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]),
-                         ryy = fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
+        auto fxx = (simd_fvec<S>)ixx, fyy = (simd_fvec<S>)iyy;
 
-            simd_fvec<S> offset[2] = {0.0f, 0.0f};
-            if (cam.fstop > 0.0f) {
-                const simd_fvec<S> r1 = fract(random_seq[RAND_DIM_LENS_U] + sample_off[0]);
-                const simd_fvec<S> r2 = fract(random_seq[RAND_DIM_LENS_V] + sample_off[1]);
+        const simd_ivec<S> hash_val = hash(index);
+        const simd_fvec<S> sample_off[2] = {construct_float(hash_val), construct_float(hash(hash_val))};
 
-                offset[0] = 2.0f * r1 - 1.0f;
-                offset[1] = 2.0f * r2 - 1.0f;
+        simd_fvec<S> rxx = fract(random_seq[RAND_DIM_FILTER_U] + sample_off[0]),
+                     ryy = fract(random_seq[RAND_DIM_FILTER_V] + sample_off[1]);
 
-                simd_fvec<S> r = offset[1], theta = 0.5f * PI - 0.25f * PI * safe_div(offset[0], offset[1]);
-                where(abs(offset[0]) > abs(offset[1]), r) = offset[0];
-                where(abs(offset[0]) > abs(offset[1]), theta) = 0.25f * PI * safe_div(offset[1], offset[0]);
-
-                if (cam.lens_blades) {
-                    r *= ngon_rad(theta, float(cam.lens_blades));
-                }
+        simd_fvec<S> offset[2] = {0.0f, 0.0f};
+        if (cam.fstop > 0.0f) {
+            const simd_fvec<S> r1 = fract(random_seq[RAND_DIM_LENS_U] + sample_off[0]);
+            const simd_fvec<S> r2 = fract(random_seq[RAND_DIM_LENS_V] + sample_off[1]);
 
-                theta += cam.lens_rotation;
+            offset[0] = 2.0f * r1 - 1.0f;
+            offset[1] = 2.0f * r2 - 1.0f;
 
-                where(offset[0] != 0.0f & offset[1] != 0.0f, offset[0]) = 0.5f * r * cos(theta) / cam.lens_ratio;
-                where(offset[0] != 0.0f & offset[1] != 0.0f, offset[1]) = 0.5f * r * sin(theta);
+            simd_fvec<S> r = offset[1], theta = 0.5f * PI - 0.25f * PI * safe_div(offset[0], offset[1]);
+            where(abs(offset[0]) > abs(offset[1]), r) = offset[0];
+            where(abs(offset[0]) > abs(offset[1]), theta) = 0.25f * PI * safe_div(offset[1], offset[0]);
 
-                const float coc = 0.5f * (cam.focal_length / cam.fstop);
-                offset[0] *= coc * cam.sensor_height;
-                offset[1] *= coc * cam.sensor_height;
+            if (cam.lens_blades) {
+                r *= ngon_rad(theta, float(cam.lens_blades));
             }
 
-            if (cam.filter == Tent) {
-                simd_fvec<S> temp = rxx;
-                rxx = 1.0f - sqrt(2.0f - 2.0f * temp);
-                where(temp < 0.5f, rxx) = sqrt(2.0f * temp) - 1.0f;
+            theta += cam.lens_rotation;
 
-                temp = ryy;
-                ryy = 1.0f - sqrt(2.0f - 2.0f * temp);
-                where(temp < 0.5f, ryy) = sqrt(2.0f * temp) - 1.0f;
+            where(offset[0] != 0.0f & offset[1] != 0.0f, offset[0]) = 0.5f * r * cos(theta) / cam.lens_ratio;
+            where(offset[0] != 0.0f & offset[1] != 0.0f, offset[1]) = 0.5f * r * sin(theta);
 
-                rxx += 0.5f;
-                ryy += 0.5f;
-            }
+            const float coc = 0.5f * (cam.focal_length / cam.fstop);
+            offset[0] *= coc * cam.sensor_height;
+            offset[1] *= coc * cam.sensor_height;
+        }
 
-            fxx += rxx;
-            fyy += ryy;
+        if (cam.filter == Tent) {
+            simd_fvec<S> temp = rxx;
+            rxx = 1.0f - sqrt(2.0f - 2.0f * temp);
+            where(temp < 0.5f, rxx) = sqrt(2.0f * temp) - 1.0f;
 
-            const simd_fvec<S> _origin[3] = {{cam.origin[0] + cam.side[0] * offset[0] + cam.up[0] * offset[1]},
-                                             {cam.origin[1] + cam.side[1] * offset[0] + cam.up[1] * offset[1]},
-                                             {cam.origin[2] + cam.side[2] * offset[0] + cam.up[2] * offset[1]}};
+            temp = ryy;
+            ryy = 1.0f - sqrt(2.0f - 2.0f * temp);
+            where(temp < 0.5f, ryy) = sqrt(2.0f * temp) - 1.0f;
 
-            simd_fvec<S> _d[3], _dx[3], _dy[3];
-            get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx, fyy, _origin, _d);
-            get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx + 1.0f, fyy, _origin, _dx);
-            get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx, fyy + 1.0f, _origin, _dy);
+            rxx += 0.5f;
+            ryy += 0.5f;
+        }
 
-            const simd_fvec<S> clip_start = cam.clip_start / dot3(_d, cam.fwd);
+        fxx += rxx;
+        fyy += ryy;
 
-            for (int j = 0; j < 3; j++) {
-                out_r.d[j] = _d[j];
-                out_r.o[j] = _origin[j] + _d[j] * clip_start;
-                out_r.c[j] = {1.0f};
-            }
+        const simd_fvec<S> _origin[3] = {{cam.origin[0] + cam.side[0] * offset[0] + cam.up[0] * offset[1]},
+                                         {cam.origin[1] + cam.side[1] * offset[0] + cam.up[1] * offset[1]},
+                                         {cam.origin[2] + cam.side[2] * offset[0] + cam.up[2] * offset[1]}};
 
-            // air ior is implicit
-            out_r.ior[0] = out_r.ior[1] = out_r.ior[2] = out_r.ior[3] = -1.0f;
+        simd_fvec<S> _d[3], _dx[3], _dy[3];
+        get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx, fyy, _origin, _d);
+        get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx + 1.0f, fyy, _origin, _dx);
+        get_pix_dirs(float(w), float(h), cam, k, fov_k, fxx, fyy + 1.0f, _origin, _dy);
 
-            out_r.cone_width = 0.0f;
-            out_r.cone_spread = spread_angle;
+        const simd_fvec<S> clip_start = cam.clip_start / dot3(_d, cam.fwd);
 
-            out_r.pdf = {1e6f};
-            out_r.xy = (ixx << 16) | iyy;
-            out_r.depth = 0;
+        for (int j = 0; j < 3; j++) {
+            out_r.d[j] = _d[j];
+            out_r.o[j] = _origin[j] + _d[j] * clip_start;
+            out_r.c[j] = {1.0f};
         }
+
+        // air ior is implicit
+        out_r.ior[0] = out_r.ior[1] = out_r.ior[2] = out_r.ior[3] = -1.0f;
+
+        out_r.cone_width = 0.0f;
+        out_r.cone_spread = spread_angle;
+
+        out_r.pdf = {1e6f};
+        out_r.xy = (ixx << 16) | iyy;
+        out_r.depth = 0;
     }
 }
 
@@ -2182,7 +2616,8 @@ void Ray::NS::SampleMeshInTextureSpace(int iteration, int obj_index, int uv_laye
     out_rays.resize(r.w * r.h / S + ((r.w * r.h) % S != 0));
     out_inters.resize(out_rays.size());
 
-    const auto off_x = simd_ivec<S>{ray_packet_layout_x}, off_y = simd_ivec<S>{ray_packet_layout_y};
+    static const ray_packet_layout_t<DimX, DimY> layout;
+    const auto off_x = simd_ivec<S>{layout.x, simd_mem_aligned}, off_y = simd_ivec<S>{layout.y, simd_mem_aligned};
 
     size_t count = 0;
     for (int y = r.y; y < r.y + r.h - (r.h & (DimY - 1)); y += DimY) {
@@ -3445,102 +3880,610 @@ int Ray::NS::Traverse_MicroTree_WithStack_AnyHit(const float ro[3], const float
 }
 
 template <int S>
-Ray::NS::simd_fvec<S> Ray::NS::BRDF_PrincipledDiffuse(const simd_fvec<S> V[3], const simd_fvec<S> N[3],
-                                                      const simd_fvec<S> L[3], const simd_fvec<S> H[3],
-                                                      const simd_fvec<S> &roughness) {
-    const simd_fvec<S> N_dot_L = dot3(N, L);
-    const simd_fvec<S> N_dot_V = dot3(N, V);
-
-    const simd_fvec<S> FL = schlick_weight(N_dot_L);
-    const simd_fvec<S> FV = schlick_weight(N_dot_V);
-
-    const simd_fvec<S> L_dot_H = dot3(L, H);
-    const simd_fvec<S> Fd90 = 0.5f + 2.0f * L_dot_H * L_dot_H * roughness;
-    const simd_fvec<S> Fd = mix(simd_fvec<S>{1.0f}, Fd90, FL) * mix(simd_fvec<S>{1.0f}, Fd90, FV);
-
-    simd_fvec<S> ret = 0.0f;
-    where(N_dot_L > 0.0f, ret) = Fd;
-
-    return ret;
-}
+bool Ray::NS::InitPacketFrustum(const float ro[3][S], const float rd[3][S], const int ray_mask[S], const float t[S],
+                                const float max_dir_spread, packet_frustum_t &out_fr) {
+    float d_min[3], d_max[3];
+    for (int j = 0; j < 3; j++) {
+        out_fr.o_min[j] = d_min[j] = out_fr.inv_d_min[j] = MAX_DIST;
+        out_fr.o_max[j] = d_max[j] = out_fr.inv_d_max[j] = -MAX_DIST;
+    }
+    out_fr.t_max = 0.0f;
 
-template <int S>
-void Ray::NS::Evaluate_OrenDiffuse_BSDF(const simd_fvec<S> V[3], const simd_fvec<S> N[3], const simd_fvec<S> L[3],
-                                        const simd_fvec<S> &roughness, const simd_fvec<S> base_color[3],
-                                        simd_fvec<S> out_color[4]) {
-    const simd_fvec<S> sigma = roughness;
-    const simd_fvec<S> div = 1.0f / (PI + ((3.0f * PI - 4.0f) / 6.0f) * sigma);
+    bool any_active = false;
+    for (int i = 0; i < S; i++) {
+        if (!ray_mask[i]) {
+            continue;
+        }
+        any_active = true;
 
-    const simd_fvec<S> a = 1.0f * div;
-    const simd_fvec<S> b = sigma * div;
+        for (int j = 0; j < 3; j++) {
+            const float d = rd[j][i];
 
-    ////
+            float inv_d;
+            if (d <= FLT_EPS && d >= 0) {
+                inv_d = MAX_DIST;
+            } else if (d >= -FLT_EPS && d < 0) {
+                inv_d = -MAX_DIST;
+            } else {
+                inv_d = 1.0f / d;
+            }
 
-    const simd_fvec<S> nl = max(dot3(N, L), 0.0f);
-    const simd_fvec<S> nv = max(dot3(N, V), 0.0f);
-    simd_fvec<S> t = dot3(L, V) - nl * nv;
+            out_fr.o_min[j] = std::min(out_fr.o_min[j], ro[j][i]);
+            out_fr.o_max[j] = std::max(out_fr.o_max[j], ro[j][i]);
+            out_fr.inv_d_min[j] = std::min(out_fr.inv_d_min[j], inv_d);
+            out_fr.inv_d_max[j] = std::max(out_fr.inv_d_max[j], inv_d);
+            d_min[j] = std::min(d_min[j], d);
+            d_max[j] = std::max(d_max[j], d);
+        }
+        out_fr.t_max = std::max(out_fr.t_max, t[i]);
+    }
 
-    where(t > 0.0f, t) /= (max(nl, nv) + FLT_MIN);
+    if (!any_active) {
+        return false;
+    }
 
-    const simd_fvec<S> is = nl * (a + b * t);
+    for (int j = 0; j < 3; j++) {
+        if ((out_fr.inv_d_min[j] < 0.0f && out_fr.inv_d_max[j] > 0.0f) || (d_max[j] - d_min[j]) > max_dir_spread) {
+            // interval bounds are too loose (or invalid) for this packet
+            return false;
+        }
+        out_fr.neg[j] = (out_fr.inv_d_max[j] < 0.0f) ? 1 : 0;
+    }
 
-    UNROLLED_FOR(i, 3, { out_color[i] = is * base_color[i]; })
-    out_color[3] = 0.5f / PI;
+    return true;
 }
 
 template <int S>
-void Ray::NS::Sample_OrenDiffuse_BSDF(const simd_fvec<S> T[3], const simd_fvec<S> B[3], const simd_fvec<S> N[3],
-                                      const simd_fvec<S> I[3], const simd_fvec<S> &roughness,
-                                      const simd_fvec<S> base_color[3], const simd_fvec<S> &rand_u,
-                                      const simd_fvec<S> &rand_v, simd_fvec<S> out_V[3], simd_fvec<S> out_color[4]) {
-    const simd_fvec<S> phi = 2 * PI * rand_v;
-    const simd_fvec<S> cos_phi = cos(phi), sin_phi = sin(phi);
-    const simd_fvec<S> dir = sqrt(1.0f - rand_u * rand_u);
-
-    const simd_fvec<S> V[3] = {dir * cos_phi, dir * sin_phi, rand_u}; // in tangent-space
-    world_from_tangent(T, B, N, V, out_V);
+bool Ray::NS::InitPacketFrustum(const simd_fvec<S> ro[3], const simd_fvec<S> rd[3], const simd_ivec<S> &ray_mask,
+                                const simd_fvec<S> &t, const float max_dir_spread, packet_frustum_t &out_fr) {
+    alignas(S * 4) float _ro[3][S], _rd[3][S], _t[S];
+    alignas(S * 4) int _ray_mask[S];
+    UNROLLED_FOR(i, 3, {
+        ro[i].store_to(_ro[i], simd_mem_aligned);
+        rd[i].store_to(_rd[i], simd_mem_aligned);
+    })
+    t.store_to(_t, simd_mem_aligned);
+    ray_mask.store_to(_ray_mask, simd_mem_aligned);
 
-    const simd_fvec<S> neg_I[3] = {-I[0], -I[1], -I[2]};
-    Evaluate_OrenDiffuse_BSDF(neg_I, N, out_V, roughness, base_color, out_color);
+    return InitPacketFrustum<S>(_ro, _rd, _ray_mask, _t, max_dir_spread, out_fr);
 }
 
 template <int S>
-void Ray::NS::Evaluate_PrincipledDiffuse_BSDF(const simd_fvec<S> V[3], const simd_fvec<S> N[3], const simd_fvec<S> L[3],
-                                              const simd_fvec<S> &roughness, const simd_fvec<S> base_color[3],
-                                              const simd_fvec<S> sheen_color[3], const bool uniform_sampling,
-                                              simd_fvec<S> out_color[4]) {
-    simd_fvec<S> weight, pdf;
-    if (uniform_sampling) {
-        weight = 2 * dot3(N, L);
-        pdf = 0.5f / PI;
-    } else {
-        weight = 1.0f;
-        pdf = dot3(N, L) / PI;
-    }
+bool Ray::NS::Traverse_MacroTree_Frustum_ClosestHit(packet_frustum_t fr, const simd_fvec<S> ro[3],
+                                                    const simd_fvec<S> rd[3], const simd_ivec<S> &ray_mask,
+                                                    const mbvh_node_t *nodes, uint32_t node_index,
+                                                    const mesh_instance_t *mesh_instances, const uint32_t *mi_indices,
+                                                    const mesh_t *meshes, const transform_t *transforms,
+                                                    const mtri_accel_t *mtris, const uint32_t *tri_indices,
+                                                    hit_data_t<S> &inter) {
+    bool res = false;
 
-    simd_fvec<S> H[3] = {L[0] + V[0], L[1] + V[1], L[2] + V[2]};
-    safe_normalize(H);
+    simd_fvec<S> inv_d[3], inv_d_o[3];
+    comp_aux_inv_values(ro, rd, inv_d, inv_d_o);
 
-    const simd_fvec<S> dot_VH = dot3(V, H);
-    UNROLLED_FOR(i, 3, { where(dot_VH < 0.0f, H[i]) = -H[i]; })
+    alignas(S * 4) float _ro[3][S], _rd[3][S], _inv_d[3][S], _inv_d_o[3][S];
+    UNROLLED_FOR(i, 3, {
+        ro[i].store_to(_ro[i], simd_mem_aligned);
+        rd[i].store_to(_rd[i], simd_mem_aligned);
+        inv_d[i].store_to(_inv_d[i], simd_mem_aligned);
+        inv_d_o[i].store_to(_inv_d_o[i], simd_mem_aligned);
+    })
 
-    weight *= BRDF_PrincipledDiffuse(V, N, L, H, roughness);
-    UNROLLED_FOR(i, 3, { out_color[i] = base_color[i] * weight; })
+    alignas(S * 4) int ray_masks[S], inter_mask[S], inter_prim_index[S], inter_obj_index[S];
+    alignas(S * 4) float inter_t[S], inter_u[S], inter_v[S];
+    ray_mask.store_to(ray_masks, simd_mem_aligned);
+    inter.mask.store_to(inter_mask, simd_mem_aligned);
+    inter.prim_index.store_to(inter_prim_index, simd_mem_aligned);
+    inter.obj_index.store_to(inter_obj_index, simd_mem_aligned);
+    inter.t.store_to(inter_t, simd_mem_aligned);
+    inter.u.store_to(inter_u, simd_mem_aligned);
+    inter.v.store_to(inter_v, simd_mem_aligned);
 
-    const simd_fvec<S> FH = PI * schlick_weight(dot3(L, H));
-    UNROLLED_FOR(i, 3, { out_color[i] += FH * sheen_color[i]; })
-    out_color[3] = pdf;
-}
+    TraversalStateStack_Single<MAX_STACK_SIZE> st;
+    st.push(node_index, 0.0f);
 
-template <int S>
-void Ray::NS::Sample_PrincipledDiffuse_BSDF(const simd_fvec<S> T[3], const simd_fvec<S> B[3], const simd_fvec<S> N[3],
-                                            const simd_fvec<S> I[3], const simd_fvec<S> &roughness,
-                                            const simd_fvec<S> base_color[3], const simd_fvec<S> sheen_color[3],
-                                            const bool uniform_sampling, const simd_fvec<S> &rand_u,
-                                            const simd_fvec<S> &rand_v, simd_fvec<S> out_V[3],
-                                            simd_fvec<S> out_color[4]) {
-    const simd_fvec<S> phi = 2 * PI * rand_v;
-    const simd_fvec<S> cos_phi = cos(phi), sin_phi = sin(phi);
+    while (!st.empty()) {
+        const stack_entry_t cur = st.pop();
+
+        if (cur.dist > fr.t_max) {
+            continue;
+        }
+
+        if (!is_leaf_node(nodes[cur.index])) {
+            alignas(32) float res_dist[8];
+            long mask = frustum_test_oct<S>(fr, nodes[cur.index].bbox_min, nodes[cur.index].bbox_max, res_dist);
+
+            const uint32_t size_before = st.stack_size;
+            while (mask) {
+                const long i = GetFirstBit(mask);
+                mask = ClearBit(mask, i);
+                // empty child slots have degenerate bounds which can pass conservative test
+                if (nodes[cur.index].child[i] != 0x7fffffff) {
+                    st.push(nodes[cur.index].child[i], res_dist[i]);
+                }
+            }
+            // closest child is visited first
+            st.sort_topN(int(st.stack_size - size_before));
+        } else {
+            const uint32_t prim_index = (nodes[cur.index].child[0] & PRIM_INDEX_BITS);
+            for (uint32_t j = prim_index; j < prim_index + nodes[cur.index].child[1]; j++) {
+                const mesh_instance_t &mi = mesh_instances[mi_indices[j]];
+                const mesh_t &m = meshes[mi.mesh_index];
+                const transform_t &tr = transforms[mi.tr_index];
+
+                alignas(S * 4) int mi_mask[S];
+                alignas(S * 4) float tr_ro[3][S], tr_rd[3][S];
+
+                bool any_active = false;
+                for (int ri = 0; ri < S; ri++) {
+                    mi_mask[ri] = 0;
+
+                    const float r_inv_d[3] = {_inv_d[0][ri], _inv_d[1][ri], _inv_d[2][ri]},
+                                r_inv_d_o[3] = {_inv_d_o[0][ri], _inv_d_o[1][ri], _inv_d_o[2][ri]};
+                    if (!ray_masks[ri] || !bbox_test(r_inv_d, r_inv_d_o, inter_t[ri], mi.bbox_min, mi.bbox_max)) {
+                        continue;
+                    }
+
+                    const float r_o[3] = {_ro[0][ri], _ro[1][ri], _ro[2][ri]},
+                                r_d[3] = {_rd[0][ri], _rd[1][ri], _rd[2][ri]};
+                    float o[3], d[3];
+                    TransformRay(r_o, r_d, tr.inv_xform, o, d);
+                    UNROLLED_FOR(k, 3, {
+                        tr_ro[k][ri] = o[k];
+                        tr_rd[k][ri] = d[k];
+                    })
+
+                    mi_mask[ri] = -1;
+                    any_active = true;
+                }
+
+                if (!any_active) {
+                    continue;
+                }
+
+                long hit_mask = 0;
+
+                packet_frustum_t obj_fr;
+                if (InitPacketFrustum<S>(tr_ro, tr_rd, mi_mask, inter_t, MAX_DIST, obj_fr)) {
+                    hit_mask = Traverse_MicroTree_Frustum_ClosestHit<S>(obj_fr, tr_ro, tr_rd, mi_mask, nodes,
+                                                                        m.node_index, mtris, inter_prim_index,
+                                                                        inter_t, inter_u, inter_v);
+                } else {
+                    for (int ri = 0; ri < S; ri++) {
+                        if (!mi_mask[ri]) {
+                            continue;
+                        }
+                        const float o[3] = {tr_ro[0][ri], tr_ro[1][ri], tr_ro[2][ri]},
+                                    d[3] = {tr_rd[0][ri], tr_rd[1][ri], tr_rd[2][ri]};
+                        if (Traverse_MicroTree_WithStack_ClosestHit<S>(o, d, nodes, m.node_index, mtris, tri_indices,
+                                                                       inter_prim_index[ri], inter_t[ri],
+                                                                       inter_u[ri], inter_v[ri])) {
+                            hit_mask |= (1l << ri);
+                        }
+                    }
+                }
+
+                if (hit_mask) {
+                    for (int ri = 0; ri < S; ri++) {
+                        if (hit_mask & (1l << ri)) {
+                            inter_mask[ri] = -1;
+                            inter_obj_index[ri] = int(mi_indices[j]);
+                        }
+                    }
+                    fr.t_max = packet_max_t<S>(inter_t, ray_masks);
+                    res = true;
+                }
+            }
+        }
+    }
+
+    inter.mask = simd_ivec<S>{inter_mask, simd_mem_aligned};
+    inter.prim_index = simd_ivec<S>{inter_prim_index, simd_mem_aligned};
+    inter.obj_index = simd_ivec<S>{inter_obj_index, simd_mem_aligned};
+    inter.t = simd_fvec<S>{inter_t, simd_mem_aligned};
+    inter.u = simd_fvec<S>{inter_u, simd_mem_aligned};
+    inter.v = simd_fvec<S>{inter_v, simd_mem_aligned};
+
+    // resolve primitive index indirection
+    simd_ivec<S> prim_index = (ray_mask & inter.prim_index);
+
+    const simd_ivec<S> is_backfacing = (prim_index < 0);
+    where(is_backfacing, prim_index) = -prim_index - 1;
+
+    where(ray_mask, inter.prim_index) = gather(reinterpret_cast<const int *>(tri_indices), prim_index);
+    where(ray_mask & is_backfacing, inter.prim_index) = -inter.prim_index - 1;
+
+    return res;
+}
+
+template <int S>
+Ray::NS::simd_ivec<S> Ray::NS::Traverse_MacroTree_Frustum_AnyHit(
+    packet_frustum_t fr, const simd_fvec<S> ro[3], const simd_fvec<S> rd[3], const simd_ivec<S> &ray_mask,
+    const mbvh_node_t *nodes, uint32_t node_index, const mesh_instance_t *mesh_instances, const uint32_t *mi_indices,
+    const mesh_t *meshes, const transform_t *transforms, const mtri_accel_t *mtris, const tri_mat_data_t *materials,
+    const uint32_t *tri_indices, hit_data_t<S> &inter) {
+    simd_ivec<S> solid_hit_mask = {0};
+
+    simd_fvec<S> inv_d[3], inv_d_o[3];
+    comp_aux_inv_values(ro, rd, inv_d, inv_d_o);
+
+    alignas(S * 4) float _ro[3][S], _rd[3][S], _inv_d[3][S], _inv_d_o[3][S];
+    UNROLLED_FOR(i, 3, {
+        ro[i].store_to(_ro[i], simd_mem_aligned);
+        rd[i].store_to(_rd[i], simd_mem_aligned);
+        inv_d[i].store_to(_inv_d[i], simd_mem_aligned);
+        inv_d_o[i].store_to(_inv_d_o[i], simd_mem_aligned);
+    })
+
+    alignas(S * 4) int ray_masks[S], inter_prim_index[S];
+    alignas(S * 4) float inter_t[S], inter_u[S], inter_v[S];
+    ray_mask.store_to(ray_masks, simd_mem_aligned);
+    inter.prim_index.store_to(inter_prim_index, simd_mem_aligned);
+    inter.t.store_to(inter_t, simd_mem_aligned);
+    inter.u.store_to(inter_u, simd_mem_aligned);
+    inter.v.store_to(inter_v, simd_mem_aligned);
+
+    int active_count = 0;
+    for (int ri = 0; ri < S; ri++) {
+        active_count += ray_masks[ri] ? 1 : 0;
+    }
+
+    TraversalStateStack_Single<MAX_STACK_SIZE> st;
+    st.push(node_index, 0.0f);
+
+    while (!st.empty() && active_count) {
+        const stack_entry_t cur = st.pop();
+
+        if (cur.dist > fr.t_max) {
+            continue;
+        }
+
+        if (!is_leaf_node(nodes[cur.index])) {
+            alignas(32) float res_dist[8];
+            long mask = frustum_test_oct<S>(fr, nodes[cur.index].bbox_min, nodes[cur.index].bbox_max, res_dist);
+
+            const uint32_t size_before = st.stack_size;
+            while (mask) {
+                const long i = GetFirstBit(mask);
+                mask = ClearBit(mask, i);
+                // empty child slots have degenerate bounds which can pass conservative test
+                if (nodes[cur.index].child[i] != 0x7fffffff) {
+                    st.push(nodes[cur.index].child[i], res_dist[i]);
+                }
+            }
+            st.sort_topN(int(st.stack_size - size_before));
+        } else {
+            const uint32_t prim_index = (nodes[cur.index].child[0] & PRIM_INDEX_BITS);
+            for (uint32_t j = prim_index; j < prim_index + nodes[cur.index].child[1] && active_count; j++) {
+                const mesh_instance_t &mi = mesh_instances[mi_indices[j]];
+                const mesh_t &m = meshes[mi.mesh_index];
+                const transform_t &tr = transforms[mi.tr_index];
+
+                alignas(S * 4) int mi_mask[S];
+                alignas(S * 4) float tr_ro[3][S], tr_rd[3][S];
+
+                bool any_active = false;
+                for (int ri = 0; ri < S; ri++) {
+                    mi_mask[ri] = 0;
+
+                    const float r_inv_d[3] = {_inv_d[0][ri], _inv_d[1][ri], _inv_d[2][ri]},
+                                r_inv_d_o[3] = {_inv_d_o[0][ri], _inv_d_o[1][ri], _inv_d_o[2][ri]};
+                    if (!ray_masks[ri] || !bbox_test(r_inv_d, r_inv_d_o, inter_t[ri], mi.bbox_min, mi.bbox_max)) {
+                        continue;
+                    }
+
+                    const float r_o[3] = {_ro[0][ri], _ro[1][ri], _ro[2][ri]},
+                                r_d[3] = {_rd[0][ri], _rd[1][ri], _rd[2][ri]};
+                    float o[3], d[3];
+                    TransformRay(r_o, r_d, tr.inv_xform, o, d);
+                    UNROLLED_FOR(k, 3, {
+                        tr_ro[k][ri] = o[k];
+                        tr_rd[k][ri] = d[k];
+                    })
+
+                    mi_mask[ri] = -1;
+                    any_active = true;
+                }
+
+                if (!any_active) {
+                    continue;
+                }
+
+                long hit_mask = 0, solid_mask = 0;
+
+                packet_frustum_t obj_fr;
+                if (InitPacketFrustum<S>(tr_ro, tr_rd, mi_mask, inter_t, MAX_DIST, obj_fr)) {
+                    hit_mask = Traverse_MicroTree_Frustum_AnyHit<S>(obj_fr, tr_ro, tr_rd, mi_mask, nodes, m.node_index,
+                                                                    mtris, materials, tri_indices, inter_prim_index,
+                                                                    inter_t, inter_u, inter_v, solid_mask);
+                } else {
+                    for (int ri = 0; ri < S; ri++) {
+                        if (!mi_mask[ri]) {
+                            continue;
+                        }
+                        const float o[3] = {tr_ro[0][ri], tr_ro[1][ri], tr_ro[2][ri]},
+                                    d[3] = {tr_rd[0][ri], tr_rd[1][ri], tr_rd[2][ri]};
+                        const int hit_type = Traverse_MicroTree_WithStack_AnyHit<S>(
+                            o, d, nodes, m.node_index, mtris, materials, tri_indices, inter_prim_index[ri],
+                            inter_t[ri], inter_u[ri], inter_v[ri]);
+                        if (hit_type) {
+                            hit_mask |= (1l << ri);
+                        }
+                        if (hit_type == 2) {
+                            solid_mask |= (1l << ri);
+                        }
+                    }
+                }
+
+                for (int ri = 0; ri < S; ri++) {
+                    if (hit_mask & (1l << ri)) {
+                        inter.mask.set(ri, -1);
+                        inter.obj_index.set(ri, int(mi_indices[j]));
+                    }
+                    if (solid_mask & (1l << ri)) {
+                        // nothing else to do for this ray
+                        solid_hit_mask.set(ri, -1);
+                        ray_masks[ri] = 0;
+                        --active_count;
+                    }
+                }
+                if (hit_mask) {
+                    fr.t_max = packet_max_t<S>(inter_t, ray_masks);
+                }
+            }
+        }
+    }
+
+    inter.prim_index = simd_ivec<S>{inter_prim_index, simd_mem_aligned};
+    inter.t = simd_fvec<S>{inter_t, simd_mem_aligned};
+    inter.u = simd_fvec<S>{inter_u, simd_mem_aligned};
+    inter.v = simd_fvec<S>{inter_v, simd_mem_aligned};
+
+    // resolve primitive index indirection
+    const simd_ivec<S> is_backfacing = (inter.prim_index < 0);
+    where(is_backfacing, inter.prim_index) = -inter.prim_index - 1;
+
+    inter.prim_index = gather(reinterpret_cast<const int *>(tri_indices), inter.prim_index);
+    where(is_backfacing, inter.prim_index) = -inter.prim_index - 1;
+
+    return solid_hit_mask;
+}
+
+template <int S>
+long Ray::NS::Traverse_MicroTree_Frustum_ClosestHit(packet_frustum_t fr, const float ro[3][S], const float rd[3][S],
+                                                    const int ray_mask[S], const mbvh_node_t *nodes,
+                                                    uint32_t node_index, const mtri_accel_t *mtris,
+                                                    int inter_prim_index[S], float inter_t[S], float inter_u[S],
+                                                    float inter_v[S]) {
+    long res = 0;
+
+    TraversalStateStack_Single<MAX_STACK_SIZE> st;
+    st.push(node_index, 0.0f);
+
+    while (!st.empty()) {
+        const stack_entry_t cur = st.pop();
+
+        if (cur.dist > fr.t_max) {
+            continue;
+        }
+
+        if (!is_leaf_node(nodes[cur.index])) {
+            alignas(32) float res_dist[8];
+            long mask = frustum_test_oct<S>(fr, nodes[cur.index].bbox_min, nodes[cur.index].bbox_max, res_dist);
+
+            const uint32_t size_before = st.stack_size;
+            while (mask) {
+                const long i = GetFirstBit(mask);
+                mask = ClearBit(mask, i);
+                // empty child slots have degenerate bounds which can pass conservative test
+                if (nodes[cur.index].child[i] != 0x7fffffff) {
+                    st.push(nodes[cur.index].child[i], res_dist[i]);
+                }
+            }
+            st.sort_topN(int(st.stack_size - size_before));
+        } else {
+            const int tri_start = int(nodes[cur.index].child[0] & PRIM_INDEX_BITS),
+                      tri_end = int(tri_start + nodes[cur.index].child[1]);
+
+            // per-ray test is done only for leaves
+            bool leaf_hit = false;
+            for (int ri = 0; ri < S; ri++) {
+                if (!ray_mask[ri]) {
+                    continue;
+                }
+
+                const float r_o[3] = {ro[0][ri], ro[1][ri], ro[2][ri]}, r_d[3] = {rd[0][ri], rd[1][ri], rd[2][ri]};
+                if (IntersectTris_ClosestHit<S>(r_o, r_d, mtris, tri_start, tri_end, inter_prim_index[ri],
+                                                inter_t[ri], inter_u[ri], inter_v[ri])) {
+                    res |= (1l << ri);
+                    leaf_hit = true;
+                }
+            }
+            if (leaf_hit) {
+                fr.t_max = packet_max_t<S>(inter_t, ray_mask);
+            }
+        }
+    }
+
+    return res;
+}
+
+template <int S>
+long Ray::NS::Traverse_MicroTree_Frustum_AnyHit(packet_frustum_t fr, const float ro[3][S], const float rd[3][S],
+                                                const int _ray_mask[S], const mbvh_node_t *nodes,
+                                                uint32_t node_index, const mtri_accel_t *mtris,
+                                                const tri_mat_data_t *materials, const uint32_t *tri_indices,
+                                                int inter_prim_index[S], float inter_t[S], float inter_u[S],
+                                                float inter_v[S], long &out_solid_mask) {
+    long res = 0;
+    out_solid_mask = 0;
+
+    alignas(S * 4) int ray_mask[S];
+    int active_count = 0;
+    for (int ri = 0; ri < S; ri++) {
+        ray_mask[ri] = _ray_mask[ri];
+        active_count += ray_mask[ri] ? 1 : 0;
+    }
+
+    TraversalStateStack_Single<MAX_STACK_SIZE> st;
+    st.push(node_index, 0.0f);
+
+    while (!st.empty() && active_count) {
+        const stack_entry_t cur = st.pop();
+
+        if (cur.dist > fr.t_max) {
+            continue;
+        }
+
+        if (!is_leaf_node(nodes[cur.index])) {
+            alignas(32) float res_dist[8];
+            long mask = frustum_test_oct<S>(fr, nodes[cur.index].bbox_min, nodes[cur.index].bbox_max, res_dist);
+
+            const uint32_t size_before = st.stack_size;
+            while (mask) {
+                const long i = GetFirstBit(mask);
+                mask = ClearBit(mask, i);
+                // empty child slots have degenerate bounds which can pass conservative test
+                if (nodes[cur.index].child[i] != 0x7fffffff) {
+                    st.push(nodes[cur.index].child[i], res_dist[i]);
+                }
+            }
+            st.sort_topN(int(st.stack_size - size_before));
+        } else {
+            const int tri_start = int(nodes[cur.index].child[0] & PRIM_INDEX_BITS),
+                      tri_end = int(tri_start + nodes[cur.index].child[1]);
+
+            bool leaf_hit = false;
+            for (int ri = 0; ri < S; ri++) {
+                if (!ray_mask[ri]) {
+                    continue;
+                }
+
+                const float r_o[3] = {ro[0][ri], ro[1][ri], ro[2][ri]}, r_d[3] = {rd[0][ri], rd[1][ri], rd[2][ri]};
+                if (!IntersectTris_AnyHit<S>(r_o, r_d, mtris, materials, tri_indices, tri_start, tri_end,
+                                             inter_prim_index[ri], inter_t[ri], inter_u[ri], inter_v[ri])) {
+                    continue;
+                }
+                res |= (1l << ri);
+                leaf_hit = true;
+
+                const bool is_backfacing = inter_prim_index[ri] < 0;
+                const uint32_t prim_index = is_backfacing ? -inter_prim_index[ri] - 1 : inter_prim_index[ri];
+
+                if ((!is_backfacing && (materials[tri_indices[prim_index]].front_mi & MATERIAL_SOLID_BIT)) ||
+                    (is_backfacing && (materials[tri_indices[prim_index]].back_mi & MATERIAL_SOLID_BIT))) {
+                    // ray is fully occluded, exclude it from further traversal
+                    out_solid_mask |= (1l << ri);
+                    ray_mask[ri] = 0;
+                    --active_count;
+                }
+            }
+            if (leaf_hit) {
+                fr.t_max = packet_max_t<S>(inter_t, ray_mask);
+            }
+        }
+    }
+
+    return res;
+}
+
+template <int S>
+Ray::NS::simd_fvec<S> Ray::NS::BRDF_PrincipledDiffuse(const simd_fvec<S> V[3], const simd_fvec<S> N[3],
+                                                      const simd_fvec<S> L[3], const simd_fvec<S> H[3],
+                                                      const simd_fvec<S> &roughness) {
+    const simd_fvec<S> N_dot_L = dot3(N, L);
+    const simd_fvec<S> N_dot_V = dot3(N, V);
+
+    const simd_fvec<S> FL = schlick_weight(N_dot_L);
+    const simd_fvec<S> FV = schlick_weight(N_dot_V);
+
+    const simd_fvec<S> L_dot_H = dot3(L, H);
+    const simd_fvec<S> Fd90 = 0.5f + 2.0f * L_dot_H * L_dot_H * roughness;
+    const simd_fvec<S> Fd = mix(simd_fvec<S>{1.0f}, Fd90, FL) * mix(simd_fvec<S>{1.0f}, Fd90, FV);
+
+    simd_fvec<S> ret = 0.0f;
+    where(N_dot_L > 0.0f, ret) = Fd;
+
+    return ret;
+}
+
+template <int S>
+void Ray::NS::Evaluate_OrenDiffuse_BSDF(const simd_fvec<S> V[3], const simd_fvec<S> N[3], const simd_fvec<S> L[3],
+                                        const simd_fvec<S> &roughness, const simd_fvec<S> base_color[3],
+                                        simd_fvec<S> out_color[4]) {
+    const simd_fvec<S> sigma = roughness;
+    const simd_fvec<S> div = 1.0f / (PI + ((3.0f * PI - 4.0f) / 6.0f) * sigma);
+
+    const simd_fvec<S> a = 1.0f * div;
+    const simd_fvec<S> b = sigma * div;
+
+    ////
+
+    const simd_fvec<S> nl = max(dot3(N, L), 0.0f);
+    const simd_fvec<S> nv = max(dot3(N, V), 0.0f);
+    simd_fvec<S> t = dot3(L, V) - nl * nv;
+
+    where(t > 0.0f, t) /= (max(nl, nv) + FLT_MIN);
+
+    const simd_fvec<S> is = nl * (a + b * t);
+
+    UNROLLED_FOR(i, 3, { out_color[i] = is * base_color[i]; })
+    out_color[3] = 0.5f / PI;
+}
+
+template <int S>
+void Ray::NS::Sample_OrenDiffuse_BSDF(const simd_fvec<S> T[3], const simd_fvec<S> B[3], const simd_fvec<S> N[3],
+                                      const simd_fvec<S> I[3], const simd_fvec<S> &roughness,
+                                      const simd_fvec<S> base_color[3], const simd_fvec<S> &rand_u,
+                                      const simd_fvec<S> &rand_v, simd_fvec<S> out_V[3], simd_fvec<S> out_color[4]) {
+    const simd_fvec<S> phi = 2 * PI * rand_v;
+    const simd_fvec<S> cos_phi = cos(phi), sin_phi = sin(phi);
+    const simd_fvec<S> dir = sqrt(1.0f - rand_u * rand_u);
+
+    const simd_fvec<S> V[3] = {dir * cos_phi, dir * sin_phi, rand_u}; // in tangent-space
+    world_from_tangent(T, B, N, V, out_V);
+
+    const simd_fvec<S> neg_I[3] = {-I[0], -I[1], -I[2]};
+    Evaluate_OrenDiffuse_BSDF(neg_I, N, out_V, roughness, base_color, out_color);
+}
+
+template <int S>
+void Ray::NS::Evaluate_PrincipledDiffuse_BSDF(const simd_fvec<S> V[3], const simd_fvec<S> N[3], const simd_fvec<S> L[3],
+                                              const simd_fvec<S> &roughness, const simd_fvec<S> base_color[3],
+                                              const simd_fvec<S> sheen_color[3], const bool uniform_sampling,
+                                              simd_fvec<S> out_color[4]) {
+    simd_fvec<S> weight, pdf;
+    if (uniform_sampling) {
+        weight = 2 * dot3(N, L);
+        pdf = 0.5f / PI;
+    } else {
+        weight = 1.0f;
+        pdf = dot3(N, L) / PI;
+    }
+
+    simd_fvec<S> H[3] = {L[0] + V[0], L[1] + V[1], L[2] + V[2]};
+    safe_normalize(H);
+
+    const simd_fvec<S> dot_VH = dot3(V, H);
+    UNROLLED_FOR(i, 3, { where(dot_VH < 0.0f, H[i]) = -H[i]; })
+
+    weight *= BRDF_PrincipledDiffuse(V, N, L, H, roughness);
+    UNROLLED_FOR(i, 3, { out_color[i] = base_color[i] * weight; })
+
+    const simd_fvec<S> FH = PI * schlick_weight(dot3(L, H));
+    UNROLLED_FOR(i, 3, { out_color[i] += FH * sheen_color[i]; })
+    out_color[3] = pdf;
+}
+
+template <int S>
+void Ray::NS::Sample_PrincipledDiffuse_BSDF(const simd_fvec<S> T[3], const simd_fvec<S> B[3], const simd_fvec<S> N[3],
+                                            const simd_fvec<S> I[3], const simd_fvec<S> &roughness,
+                                            const simd_fvec<S> base_color[3], const simd_fvec<S> sheen_color[3],
+                                            const bool uniform_sampling, const simd_fvec<S> &rand_u,
+                                            const simd_fvec<S> &rand_v, simd_fvec<S> out_V[3],
+                                            simd_fvec<S> out_color[4]) {
+    const simd_fvec<S> phi = 2 * PI * rand_v;
+    const simd_fvec<S> cos_phi = cos(phi), sin_phi = sin(phi);
 
     simd_fvec<S> V[3];
     if (uniform_sampling) {
@@ -4118,54 +5061,37 @@ void Ray::NS::SampleBilinear(const Ref::TexStorageBase *const textures[], const
                              const simd_fvec<S> uvs[2], const simd_ivec<S> &lod, const simd_ivec<S> &mask,
                              simd_fvec<S> out_rgba[4]) {
     const Ref::TexStorageBase &storage = *textures[index >> 28];
-
     const int tex = int(index & 0x00ffffff);
 
-    simd_fvec<S> _uvs[2];
-    _uvs[0] = fract(uvs[0]);
-    _uvs[1] = fract(uvs[1]);
-
-    for (int i = 0; i < S; i++) {
-        if (!mask[i]) {
-            continue;
-        }
-
-        float img_size[2];
-        storage.GetFRes(tex, lod[i], img_size);
-
-        _uvs[0].set(i, _uvs[0][i] * img_size[0] - 0.5f);
-        _uvs[1].set(i, _uvs[1][i] * img_size[1] - 0.5f);
-    }
-
-    const simd_fvec<S> k[2] = {fract(_uvs[0]), fract(_uvs[1])};
-
-    simd_fvec<S> p0[4] = {}, p1[4] = {};
-
-    for (int i = 0; i < S; i++) {
-        if (!mask[i]) {
-            continue;
-        }
-
-        const auto &p00 = storage.Fetch(tex, int(_uvs[0][i]), int(_uvs[1][i]), lod[i]);
-        const auto &p01 = storage.Fetch(tex, int(_uvs[0][i] + 1), int(_uvs[1][i]), lod[i]);
-        const auto &p10 = storage.Fetch(tex, int(_uvs[0][i]), int(_uvs[1][i] + 1), lod[i]);
-        const auto &p11 = storage.Fetch(tex, int(_uvs[0][i] + 1), int(_uvs[1][i] + 1), lod[i]);
-
-        p0[0].set(i, p01.v[0] * k[0][i] + p00.v[0] * (1 - k[0][i]));
-        p0[1].set(i, p01.v[1] * k[0][i] + p00.v[1] * (1 - k[0][i]));
-        p0[2].set(i, p01.v[2] * k[0][i] + p00.v[2] * (1 - k[0][i]));
-        p0[3].set(i, p01.v[3] * k[0][i] + p00.v[3] * (1 - k[0][i]));
-
-        p1[0].set(i, p11.v[0] * k[0][i] + p10.v[0] * (1 - k[0][i]));
-        p1[1].set(i, p11.v[1] * k[0][i] + p10.v[1] * (1 - k[0][i]));
-        p1[2].set(i, p11.v[2] * k[0][i] + p10.v[2] * (1 - k[0][i]));
-        p1[3].set(i, p11.v[3] * k[0][i] + p10.v[3] * (1 - k[0][i]));
+    // Storage type is encoded in texture index, so virtual Fetch can be avoided
+    switch (index >> 28) {
+    case 0:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageRGBA &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 1:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageRGB &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 2:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageRG &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 3:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageR &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 4:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageBC3 &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 5:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageBC4 &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 6:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageBC5 &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    case 7:
+        SampleBilinear_NonVirtual(static_cast<const Ref::TexStorageVirtual &>(storage), tex, uvs, lod, mask, out_rgba);
+        break;
+    default:
+        break;
     }
-
-    where(mask, out_rgba[0]) = (p1[0] * k[1] + p0[0] * (1.0f - k[1]));
-    where(mask, out_rgba[1]) = (p1[1] * k[1] + p0[1] * (1.0f - k[1]));
-    where(mask, out_rgba[2]) = (p1[2] * k[1] + p0[2] * (1.0f - k[1]));
-    where(mask, out_rgba[3]) = (p1[3] * k[1] + p0[3] * (1.0f - k[1]));
 }
 
 template <int S>
@@ -4181,6 +5107,51 @@ void Ray::NS::SampleTrilinear(const Ref::TexStorageBase *const textures[], const
     UNROLLED_FOR(i, 4, { out_rgba[i] = col1[i] * (1.0f - k) + col2[i] * k; })
 }
 
+template <int S>
+void Ray::NS::SampleStochastic(const Ref::TexStorageBase *const textures[], const uint32_t index,
+                               const simd_fvec<S> uvs[2], const simd_fvec<S> &lod, const simd_fvec<S> rand[3],
+                               const simd_ivec<S> &mask, simd_fvec<S> out_rgba[4]) {
+    const Ref::TexStorageBase &storage = *textures[index >> 28];
+    const int tex = int(index & 0x00ffffff);
+
+    switch (index >> 28) {
+    case 0:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageRGBA &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 1:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageRGB &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 2:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageRG &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 3:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageR &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 4:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageBC3 &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 5:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageBC4 &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 6:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageBC5 &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    case 7:
+        SampleStochastic_NonVirtual(static_cast<const Ref::TexStorageVirtual &>(storage), tex, uvs, lod, rand, mask,
+                                    out_rgba);
+        break;
+    default:
+        break;
+    }
+}
+
 template <int S>
 void Ray::NS::SampleLatlong_RGBE(const Ref::TexStorageRGBA &storage, const uint32_t index, const simd_fvec<S> dir[3],
                                  const float y_rotation, const simd_ivec<S> &mask, simd_fvec<S> out_rgb[3]) {
@@ -4263,10 +5234,21 @@ void Ray::NS::IntersectScene(ray_data_t<S> &r, const simd_ivec<S> &mask, const i
     while (keep_going.not_all_zeros()) {
         const simd_fvec<S> t_val = inter.t;
 
+        // coherent packets (e.g. primary rays) are culled against BVH nodes all at once
+        packet_frustum_t fr;
+        const bool is_coherent =
+            sc.mnodes && InitPacketFrustum(ro, r.d, keep_going, inter.t, FRUSTUM_MAX_DIR_SPREAD, fr);
+
         if (sc.mnodes) {
-            NS::Traverse_MacroTree_WithStack_ClosestHit(ro, r.d, keep_going, sc.mnodes, root_index, sc.mesh_instances,
-                                                        sc.mi_indices, sc.meshes, sc.transforms, sc.mtris,
-                                                        sc.tri_indices, inter);
+            if (is_coherent) {
+                NS::Traverse_MacroTree_Frustum_ClosestHit(fr, ro, r.d, keep_going, sc.mnodes, root_index,
+                                                          sc.mesh_instances, sc.mi_indices, sc.meshes, sc.transforms,
+                                                          sc.mtris, sc.tri_indices, inter);
+            } else {
+                NS::Traverse_MacroTree_WithStack_ClosestHit(ro, r.d, keep_going, sc.mnodes, root_index,
+                                                            sc.mesh_instances, sc.mi_indices, sc.meshes,
+                                                            sc.transforms, sc.mtris, sc.tri_indices, inter);
+            }
         } else {
             NS::Traverse_MacroTree_WithStack_ClosestHit(ro, r.d, keep_going, sc.nodes, root_index, sc.mesh_instances,
                                                         sc.mi_indices, sc.meshes, sc.transforms, sc.tris,
@@ -4434,7 +5416,7 @@ void Ray::NS::IntersectScene(ray_data_t<S> &r, const simd_ivec<S> &mask, const i
 template <int S>
 void Ray::NS::IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask, const int max_transp_depth,
                              const scene_data_t &sc, uint32_t node_index, const Ref::TexStorageBase *const textures[],
-                             simd_fvec<S> rc[3]) {
+                             simd_fvec<S> rc[3], shadow_occluder_t occluders[]) {
     simd_fvec<S> ro[3] = {r.o[0], r.o[1], r.o[2]};
     UNROLLED_FOR(i, 3, { rc[i] = r.c[i]; })
     simd_fvec<S> dist = r.dist;
@@ -4442,21 +5424,44 @@ void Ray::NS::IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask,
     simd_ivec<S> depth = (r.depth >> 24);
 
     simd_ivec<S> keep_going = simd_cast(dist > HIT_EPS) & mask;
+    if (occluders && keep_going.not_all_zeros()) {
+        // most of the rays going to the same light are blocked by the same few triangles
+        const simd_ivec<S> blocked = IntersectCachedOccluders(r, keep_going, dist, sc, occluders);
+        UNROLLED_FOR(i, 3, { where(blocked, rc[i]) = 0.0f; })
+        keep_going &= ~blocked;
+    }
     while (keep_going.not_all_zeros()) {
         hit_data_t<S> inter;
         inter.t = dist;
 
+        // shadow rays towards the same (point) light from nearby surface points are coherent enough for frustum
+        packet_frustum_t fr;
+        const bool is_coherent =
+            sc.mnodes && InitPacketFrustum(ro, r.d, keep_going, inter.t, FRUSTUM_MAX_DIR_SPREAD, fr);
+
         simd_ivec<S> solid_hit;
         if (sc.mnodes) {
-            solid_hit = Traverse_MacroTree_WithStack_AnyHit(ro, r.d, keep_going, sc.mnodes, node_index,
-                                                            sc.mesh_instances, sc.mi_indices, sc.meshes, sc.transforms,
-                                                            sc.mtris, sc.tri_materials, sc.tri_indices, inter);
+            if (is_coherent) {
+                solid_hit = Traverse_MacroTree_Frustum_AnyHit(fr, ro, r.d, keep_going, sc.mnodes, node_index,
+                                                              sc.mesh_instances, sc.mi_indices, sc.meshes,
+                                                              sc.transforms, sc.mtris, sc.tri_materials,
+                                                              sc.tri_indices, inter);
+            } else {
+                solid_hit = Traverse_MacroTree_WithStack_AnyHit(ro, r.d, keep_going, sc.mnodes, node_index,
+                                                                sc.mesh_instances, sc.mi_indices, sc.meshes,
+                                                                sc.transforms, sc.mtris, sc.tri_materials,
+                                                                sc.tri_indices, inter);
+            }
         } else {
             solid_hit = Traverse_MacroTree_WithStack_AnyHit(ro, r.d, keep_going, sc.nodes, node_index,
                                                             sc.mesh_instances, sc.mi_indices, sc.meshes, sc.transforms,
                                                             sc.tris, sc.tri_materials, sc.tri_indices, inter);
         }
 
+        if (occluders) {
+            UpdateCachedOccluders(r, keep_going & inter.mask, inter, sc, occluders);
+        }
+
         const simd_ivec<S> terminate_mask = solid_hit | (depth > max_transp_depth);
         UNROLLED_FOR(i, 3, { where(terminate_mask, rc[i]) = 0.0f; })
 
@@ -4471,24 +5476,9 @@ void Ray::NS::IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask,
         const simd_ivec<S> is_backfacing = (tri_index < 0);
         where(is_backfacing, tri_index) = -tri_index - 1;
 
-        const simd_ivec<S> vtx_indices[3] = {gather(reinterpret_cast<const int *>(sc.vtx_indices + 0), tri_index * 3),
-                                             gather(reinterpret_cast<const int *>(sc.vtx_indices + 1), tri_index * 3),
-                                             gather(reinterpret_cast<const int *>(sc.vtx_indices + 2), tri_index * 3)};
-
+        // uvs are fetched only when textured mix node is encountered (fully transparent surfaces skip this)
         simd_fvec<S> sh_uvs[2];
-
-        { // Fetch vertex uvs
-            const float *vtx_uvs = &sc.vertices[0].t[0][0];
-            const int VtxUVsStride = sizeof(vertex_t) / sizeof(float);
-
-            UNROLLED_FOR(i, 2, {
-                const simd_fvec<S> temp1 = gather(vtx_uvs + i, vtx_indices[0] * VtxUVsStride);
-                const simd_fvec<S> temp2 = gather(vtx_uvs + i, vtx_indices[1] * VtxUVsStride);
-                const simd_fvec<S> temp3 = gather(vtx_uvs + i, vtx_indices[2] * VtxUVsStride);
-
-                sh_uvs[i] = temp1 * w + temp2 * inter.u + temp3 * inter.v;
-            })
-        }
+        bool uvs_fetched = false;
 
         simd_ivec<S> mat_index = gather(reinterpret_cast<const int *>(sc.tri_materials), tri_index) &
                                  simd_ivec<S>((MATERIAL_INDEX_BITS << 16) | MATERIAL_INDEX_BITS);
@@ -4534,6 +5524,25 @@ void Ray::NS::IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask,
                         if (mat->type == MixNode) {
                             simd_fvec<S> mix_val = mat->strength;
                             if (mat->textures[BASE_TEXTURE] != 0xffffffff) {
+                                if (!uvs_fetched) {
+                                    const simd_ivec<S> vtx_indices[3] = {
+                                        gather(reinterpret_cast<const int *>(sc.vtx_indices + 0), tri_index * 3),
+                                        gather(reinterpret_cast<const int *>(sc.vtx_indices + 1), tri_index * 3),
+                                        gather(reinterpret_cast<const int *>(sc.vtx_indices + 2), tri_index * 3)};
+
+                                    const float *vtx_uvs = &sc.vertices[0].t[0][0];
+                                    const int VtxUVsStride = sizeof(vertex_t) / sizeof(float);
+
+                                    UNROLLED_FOR(i, 2, {
+                                        const simd_fvec<S> temp1 = gather(vtx_uvs + i, vtx_indices[0] * VtxUVsStride);
+                                        const simd_fvec<S> temp2 = gather(vtx_uvs + i, vtx_indices[1] * VtxUVsStride);
+                                        const simd_fvec<S> temp3 = gather(vtx_uvs + i, vtx_indices[2] * VtxUVsStride);
+
+                                        sh_uvs[i] = temp1 * w + temp2 * inter.u + temp3 * inter.v;
+                                    })
+                                    uvs_fetched = true;
+                                }
+
                                 simd_fvec<S> mix[4] = {};
                                 SampleBilinear(textures, mat->textures[BASE_TEXTURE], sh_uvs, {0}, same_mi, mix);
                                 mix_val *= mix[0];
@@ -4564,6 +5573,97 @@ void Ray::NS::IntersectScene(const shadow_ray_t<S> &r, const simd_ivec<S> &mask,
     }
 }
 
+template <int S>
+Ray::NS::simd_ivec<S> Ray::NS::IntersectCachedOccluders(const shadow_ray_t<S> &r, const simd_ivec<S> &ray_mask,
+                                                        const simd_fvec<S> &dist, const scene_data_t &sc,
+                                                        const shadow_occluder_t occluders[]) {
+    simd_ivec<S> blocked = 0;
+
+    simd_ivec<S> ray_queue[S];
+    ray_queue[0] = ray_mask;
+
+    int index = 0, num = 1;
+    while (index != num) {
+        const long mask = ray_queue[index].movemask();
+        const int first_li = r.light_index[GetFirstBit(mask)];
+
+        const simd_ivec<S> same_li = (r.light_index == first_li);
+        const simd_ivec<S> diff_li = and_not(same_li, ray_queue[index]);
+
+        if (diff_li.not_all_zeros()) {
+            ray_queue[index] &= same_li;
+            ray_queue[num++] = diff_li;
+        }
+
+        if (first_li != -1 && occluders[first_li % SHADOW_OCCLUDER_CACHE_SIZE].light_index == first_li) {
+            const shadow_occluder_t &occ = occluders[first_li % SHADOW_OCCLUDER_CACHE_SIZE];
+            const transform_t &tr = sc.transforms[sc.mesh_instances[occ.mi_index].tr_index];
+
+            simd_fvec<S> ro[3], rd[3];
+            TransformRay(r.o, r.d, tr.inv_xform, ro, rd);
+
+            const simd_fvec<S> det = dot3(rd, occ.tri.n_plane);
+            const simd_fvec<S> dett = occ.tri.n_plane[3] - dot3(ro, occ.tri.n_plane);
+
+            // compare sign bits
+            simd_ivec<S> hit = ~srai(simd_cast(dett ^ (det * dist - dett)), 31) & ray_queue[index];
+            if (hit.not_all_zeros()) {
+                const simd_fvec<S> p[3] = {det * ro[0] + dett * rd[0], det * ro[1] + dett * rd[1],
+                                           det * ro[2] + dett * rd[2]};
+
+                const simd_fvec<S> detu = dot3(p, occ.tri.u_plane) + det * occ.tri.u_plane[3];
+                hit &= ~srai(simd_cast(detu ^ (det - detu)), 31);
+
+                const simd_fvec<S> detv = dot3(p, occ.tri.v_plane) + det * occ.tri.v_plane[3];
+                hit &= ~srai(simd_cast(detv ^ (det - detu - detv)), 31);
+
+                const simd_fvec<S> t = dett / det;
+                blocked |= hit & simd_cast((t > 0.0f) & (t < dist));
+            }
+        }
+
+        ++index;
+    }
+
+    return blocked;
+}
+
+template <int S>
+void Ray::NS::UpdateCachedOccluders(const shadow_ray_t<S> &r, const simd_ivec<S> &ray_mask,
+                                    const hit_data_t<S> &inter, const scene_data_t &sc,
+                                    shadow_occluder_t occluders[]) {
+    for (int ri = 0; ri < S; ri++) {
+        const int light_index = r.light_index[ri];
+        if (!ray_mask[ri] || light_index == -1) {
+            continue;
+        }
+
+        const int prim_index = inter.prim_index[ri];
+        const uint32_t tri_index = prim_index < 0 ? uint32_t(-prim_index - 1) : uint32_t(prim_index);
+        const uint32_t mi_index = uint32_t(inter.obj_index[ri]);
+
+        // only triangles that block rays from both sides are cached (no need to track hit side)
+        const tri_mat_data_t &mat = sc.tri_materials[tri_index];
+        if ((mat.front_mi & mat.back_mi & MATERIAL_SOLID_BIT) == 0) {
+            continue;
+        }
+
+        shadow_occluder_t &occ = occluders[light_index % SHADOW_OCCLUDER_CACHE_SIZE];
+        if (occ.light_index == light_index && occ.mi_index == mi_index && occ.tri_index == tri_index) {
+            continue;
+        }
+
+        float p[9];
+        for (int j = 0; j < 3; ++j) {
+            memcpy(&p[j * 3], sc.vertices[sc.vtx_indices[tri_index * 3 + j]].p, 3 * sizeof(float));
+        }
+
+        occ.light_index = PreprocessTri(p, 3, &occ.tri) ? light_index : -1;
+        occ.mi_index = mi_index;
+        occ.tri_index = tri_index;
+    }
+}
+
 // Pick point on any light source for evaluation
 template <int S>
 void Ray::NS::SampleLightSource(const simd_fvec<S> P[3], const simd_fvec<S> T[3], const simd_fvec<S> B[3],
@@ -4597,6 +5697,7 @@ void Ray::NS::SampleLightSource(const simd_fvec<S> P[3], const simd_fvec<S> T[3]
 
         UNROLLED_FOR(i, 3, { where(ray_queue[index], ls.col[i]) = l.col[i] * float(sc.li_indices.size()); })
         where(ray_queue[index], ls.cast_shadow) = l.cast_shadow ? -1 : 0;
+        where(ray_queue[index], ls.light_index) = int(sc.li_indices[first_li]);
 
         if (l.type == LIGHT_TYPE_SPHERE) {
             simd_fvec<S> center_to_surface[3];
@@ -5913,6 +7014,17 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
     simd_fvec<S> mix_rand = fract(gather(random_seq + RAND_DIM_BSDF_PICK, rand_index) + sample_off[0]);
     simd_fvec<S> mix_weight = 1.0f;
 
+    // there is no spare dimension in sequence, so numbers for texture filtering are derived by hashing
+    simd_fvec<S> _tex_rand[3];
+    const simd_fvec<S> *tex_rand = nullptr;
+    if (ps.flags & StochasticTextureFiltering) {
+        const simd_ivec<S> h = hash(simd_cast(mix_rand) ^ hash(hash(hash(ray.xy))));
+        _tex_rand[0] = construct_float(h);
+        _tex_rand[1] = construct_float(hash(h));
+        _tex_rand[2] = construct_float(hash(hash(h)));
+        tex_rand = _tex_rand;
+    }
+
     // resolve mix material
     const simd_ivec<S> is_mix_mat = mat_type == MixNode;
     if (is_mix_mat.not_all_zeros()) {
@@ -5943,7 +7055,7 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                 const simd_fvec<S> base_lod = get_texture_lod(textures, first_t, lambda, ray_queue[index]);
 
                 simd_fvec<S> tex_color[4] = {};
-                SampleBilinear(textures, first_t, surf.uvs, simd_ivec<S>(base_lod), ray_queue[index], tex_color);
+                SampleSurfaceTexture(textures, first_t, surf.uvs, base_lod, tex_rand, ray_queue[index], tex_color);
 
                 where(ray_queue[index], mix_val) *= tex_color[0];
 
@@ -6007,7 +7119,8 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                     ray_queue[num++] = diff_t;
                 }
 
-                SampleBilinear(textures, first_t, surf.uvs, simd_ivec<S>{0}, ray_queue[index], normals_tex);
+                SampleSurfaceTexture(textures, first_t, surf.uvs, simd_fvec<S>{0.0f}, tex_rand, ray_queue[index],
+                                     normals_tex);
                 if (first_t & TEX_RECONSTRUCT_Z_BIT) {
                     reconstruct_z |= ray_queue[index];
                 }
@@ -6099,7 +7212,7 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                 const simd_fvec<S> base_lod = get_texture_lod(textures, first_t, lambda, ray_queue[index]);
 
                 simd_fvec<S> tex_color[4] = {};
-                SampleBilinear(textures, first_t, surf.uvs, simd_ivec<S>(base_lod), ray_queue[index], tex_color);
+                SampleSurfaceTexture(textures, first_t, surf.uvs, base_lod, tex_rand, ray_queue[index], tex_color);
                 if (first_t & TEX_SRGB_BIT) {
                     srgb_to_rgb(tex_color, tex_color);
                 }
@@ -6153,8 +7266,8 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                 const simd_fvec<S> roughness_lod = get_texture_lod(textures, first_t, lambda, ray_queue[index]);
 
                 simd_fvec<S> roughness_color[4] = {};
-                SampleBilinear(textures, first_t, surf.uvs, simd_ivec<S>(roughness_lod), ray_queue[index],
-                               roughness_color);
+                SampleSurfaceTexture(textures, first_t, surf.uvs, roughness_lod, tex_rand, ray_queue[index],
+                                     roughness_color);
                 if (first_t & TEX_SRGB_BIT) {
                     srgb_to_rgb(roughness_color, roughness_color);
                 }
@@ -6187,6 +7300,7 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
     sh_r = {};
     sh_r.depth = ray.depth;
     sh_r.xy = ray.xy;
+    sh_r.light_index = -1;
 
     { // Sample materials
         simd_ivec<S> ray_queue[S];
@@ -6305,8 +7419,8 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                     const uint32_t metallic_tex = mat->textures[METALLIC_TEXTURE];
                     const simd_fvec<S> metallic_lod = get_texture_lod(textures, metallic_tex, lambda, ray_queue[index]);
                     simd_fvec<S> metallic_color[4] = {};
-                    SampleBilinear(textures, metallic_tex, surf.uvs, simd_ivec<S>(metallic_lod), ray_queue[index],
-                                   metallic_color);
+                    SampleSurfaceTexture(textures, metallic_tex, surf.uvs, metallic_lod, tex_rand, ray_queue[index],
+                                         metallic_color);
 
                     metallic *= metallic_color[0];
                 }
@@ -6316,8 +7430,8 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
                     const uint32_t specular_tex = mat->textures[SPECULAR_TEXTURE];
                     const simd_fvec<S> specular_lod = get_texture_lod(textures, specular_tex, lambda, ray_queue[index]);
                     simd_fvec<S> specular_color[4] = {};
-                    SampleBilinear(textures, specular_tex, surf.uvs, simd_ivec<S>(specular_lod), ray_queue[index],
-                                   specular_color);
+                    SampleSurfaceTexture(textures, specular_tex, surf.uvs, specular_lod, tex_rand, ray_queue[index],
+                                         specular_color);
                     if (specular_tex & TEX_SRGB_BIT) {
                         srgb_to_rgb(specular_color, specular_color);
                     }
@@ -6424,6 +7538,7 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
 
         sh_r.dist = length(to_light);
         UNROLLED_FOR(i, 3, { where(shadow_mask, sh_r.d[i]) = safe_div_pos(to_light[i], sh_r.dist); })
+        where(shadow_mask, sh_r.light_index) = ls.light_index;
         sh_r.dist *= ls.dist_mul;
         // NOTE: hacky way to identify env ray
         where(ls.from_env & shadow_mask, sh_r.dist) = -sh_r.dist;
@@ -6437,6 +7552,274 @@ void Ray::NS::ShadeSurface(const pass_settings_t &ps, const float *random_seq, c
     where(is_active_lane, out_rgba[3]) = 1.0f;
 }
 
+template <int S, int WINDOW_SIZE, int NEIGHBORHOOD_SIZE>
+void Ray::NS::NLMFilter(const color_rgba_t input[], const rect_t &rect, const int input_stride, const float alpha,
+                        const float damping, const color_rgba_t variance[], const rect_t &output_rect,
+                        const int output_stride, color_rgba_t output[], aligned_vector<float, 64> &temp_buf) {
+    const int WindowRadius = (WINDOW_SIZE - 1) / 2;
+    const float PatchDistanceNormFactor = NEIGHBORHOOD_SIZE * NEIGHBORHOOD_SIZE;
+    const int NeighborRadius = (NEIGHBORHOOD_SIZE - 1) / 2;
+    const int Radius = WindowRadius + NeighborRadius;
+
+    assert(rect.w == output_rect.w);
+    assert(rect.h == output_rect.h);
+
+    // rows are processed by S pixels, padded pixels are computed and thrown away
+    const int w = S * ((rect.w + S - 1) / S);
+    // per-pixel distances are needed in neighborhood of each output pixel
+    const int dist_w = S * ((w + 2 * NeighborRadius + S - 1) / S), dist_h = rect.h + 2 * NeighborRadius;
+    // input is converted to SoA layout
+    const int planes_w = dist_w + 2 * WindowRadius, planes_h = rect.h + 2 * Radius;
+
+    // all buffers start at 64-byte boundary
+    const int planes_size = 16 * ((planes_w * planes_h + 15) / 16), dist_size = 16 * ((dist_w * dist_h + 15) / 16),
+              hdist_size = w * dist_h, sum_size = w * rect.h;
+
+    temp_buf.resize(8 * planes_size + dist_size + hdist_size + 5 * sum_size);
+
+    float *color[4], *var[4];
+    for (int c = 0; c < 4; ++c) {
+        color[c] = &temp_buf[c * planes_size];
+        var[c] = &temp_buf[(4 + c) * planes_size];
+    }
+    float *dist = &temp_buf[8 * planes_size];
+    float *hdist = dist + dist_size;
+    float *sum_color[4] = {hdist + hdist_size, hdist + hdist_size + sum_size, hdist + hdist_size + 2 * sum_size,
+                           hdist + hdist_size + 3 * sum_size};
+    float *sum_weight = hdist + hdist_size + 4 * sum_size;
+
+    for (int y = 0; y < planes_h; ++y) {
+        const int iy = rect.y - Radius + y;
+        for (int x = 0; x < planes_w; ++x) {
+            const int ix = rect.x - Radius + x;
+            const bool is_valid = (ix < rect.x + rect.w + Radius);
+            for (int c = 0; c < 4; ++c) {
+                color[c][y * planes_w + x] = is_valid ? input[iy * input_stride + ix].v[c] : 0.0f;
+                var[c][y * planes_w + x] = is_valid ? variance[iy * input_stride + ix].v[c] : 0.0f;
+            }
+        }
+    }
+
+    std::fill(sum_color[0], sum_weight + sum_size, 0.0f);
+
+    for (int k = -WindowRadius; k <= WindowRadius; ++k) {
+        for (int l = -WindowRadius; l <= WindowRadius; ++l) {
+            // per-pixel distances between images shifted by (l, k)
+            for (int y = 0; y < dist_h; ++y) {
+                const int iy = y + WindowRadius, jy = iy + k;
+                for (int x = 0; x < dist_w; x += S) {
+                    const int ix = x + WindowRadius, jx = ix + l;
+
+                    simd_fvec<S> distance = 0.0f;
+                    for (int c = 0; c < 4; ++c) {
+                        const simd_fvec<S> ipx{&color[c][iy * planes_w + ix]};
+                        const simd_fvec<S> jpx{&color[c][jy * planes_w + jx]};
+
+                        const simd_fvec<S> ivar{&var[c][iy * planes_w + ix]};
+                        const simd_fvec<S> jvar{&var[c][jy * planes_w + jx]};
+                        const simd_fvec<S> min_var = min(ivar, jvar);
+
+                        distance += ((ipx - jpx) * (ipx - jpx) - alpha * (ivar + min_var)) /
+                                    (0.0001f + damping * damping * (ivar + jvar));
+                    }
+                    distance.store_to(&dist[y * dist_w + x]);
+                }
+            }
+
+            // box filter (horizontal pass)
+            for (int y = 0; y < dist_h; ++y) {
+                for (int x = 0; x < w; x += S) {
+                    simd_fvec<S> res{&dist[y * dist_w + x]};
+                    for (int p = 1; p < NEIGHBORHOOD_SIZE; ++p) {
+                        res += simd_fvec<S>{&dist[y * dist_w + x + p]};
+                    }
+                    res.store_to(&hdist[y * w + x], simd_mem_aligned);
+                }
+            }
+
+            // box filter (vertical pass) and accumulation
+            for (int y = 0; y < rect.h; ++y) {
+                const int jy = y + Radius + k;
+                for (int x = 0; x < w; x += S) {
+                    const int jx = x + Radius + l;
+
+                    simd_fvec<S> patch_distance{&hdist[y * w + x], simd_mem_aligned};
+                    for (int q = 1; q < NEIGHBORHOOD_SIZE; ++q) {
+                        patch_distance += simd_fvec<S>{&hdist[(y + q) * w + x], simd_mem_aligned};
+                    }
+                    patch_distance *= 0.25f * PatchDistanceNormFactor;
+
+                    const simd_fvec<S> weight = fast_exp(-max(patch_distance, 0.0f));
+
+                    for (int c = 0; c < 4; ++c) {
+                        simd_fvec<S> sum{&sum_color[c][y * w + x], simd_mem_aligned};
+                        sum += simd_fvec<S>{&color[c][jy * planes_w + jx]} * weight;
+                        sum.store_to(&sum_color[c][y * w + x], simd_mem_aligned);
+                    }
+
+                    simd_fvec<S> sum{&sum_weight[y * w + x], simd_mem_aligned};
+                    sum += weight;
+                    sum.store_to(&sum_weight[y * w + x], simd_mem_aligned);
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < rect.h; ++y) {
+        for (int x = 0; x < rect.w; ++x) {
+            const float weight = sum_weight[y * w + x];
+            const float norm = (weight != 0.0f) ? (1.0f / weight) : 1.0f;
+
+            color_rgba_t &out = output[(output_rect.y + y) * output_stride + (output_rect.x + x)];
+            for (int c = 0; c < 4; ++c) {
+                out.v[c] = sum_color[c][y * w + x] * norm;
+            }
+        }
+    }
+}
+
+template <int S>
+void Ray::NS::ATrousFilter(const color_rgba_t input[], const color_rgba_t variance[], const color_rgba_t base_color[],
+                           const color_rgba_t depth_normals[], const rect_t &rect, const int input_stride,
+                           const int iterations, const rect_t &output_rect, const int output_stride,
+                           color_rgba_t output[], aligned_vector<float, 64> &temp_buf) {
+    const float SigmaLum = 4.0f, SigmaDepth = 0.1f;
+    const float MinAlbedo = 0.01f;
+    static const float KernelWeights[] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+    const int Radius = 2 * ((1 << iterations) - 1);
+
+    assert(rect.w == output_rect.w);
+    assert(rect.h == output_rect.h);
+
+    const int work_w = rect.w + 2 * Radius, work_h = rect.h + 2 * Radius;
+    // extra S columns allow to process rows by S pixels without handling of the tail
+    const int plane_w = work_w + S, plane_size = 16 * ((plane_w * work_h + 15) / 16);
+
+    // illumination (color with albedo divided out) and its variance are ping-ponged between iterations
+    enum { IllumR, IllumG, IllumB, IllumVar, IllumR2, IllumG2, IllumB2, IllumVar2, NormalX, NormalY, NormalZ, Depth };
+    const int PlanesCount = Depth + 1;
+
+    temp_buf.resize(PlanesCount * plane_size);
+    std::fill(temp_buf.begin(), temp_buf.end(), 0.0f);
+
+    float *planes[PlanesCount];
+    for (int i = 0; i < PlanesCount; ++i) {
+        planes[i] = &temp_buf[i * plane_size];
+    }
+
+    for (int y = 0; y < work_h; ++y) {
+        const int iy = rect.y - Radius + y;
+        for (int x = 0; x < work_w; ++x) {
+            const int ix = rect.x - Radius + x;
+
+            const color_rgba_t &col = input[iy * input_stride + ix], &var = variance[iy * input_stride + ix],
+                               &alb = base_color[iy * input_stride + ix],
+                               &dn = depth_normals[iy * input_stride + ix];
+
+            float illum_var[3];
+            for (int c = 0; c < 3; ++c) {
+                const float albedo = std::max(alb.v[c], MinAlbedo);
+                planes[IllumR + c][y * plane_w + x] = col.v[c] / albedo;
+                illum_var[c] = var.v[c] / (albedo * albedo);
+            }
+            planes[IllumVar][y * plane_w + x] =
+                0.212671f * illum_var[0] + 0.715160f * illum_var[1] + 0.072169f * illum_var[2];
+
+            // accumulated normals are not unit length anymore
+            const float n_len = std::sqrt(dn.v[0] * dn.v[0] + dn.v[1] * dn.v[1] + dn.v[2] * dn.v[2]);
+            for (int c = 0; c < 3; ++c) {
+                planes[NormalX + c][y * plane_w + x] = (n_len > 0.0f) ? dn.v[c] / n_len : 0.0f;
+            }
+            planes[Depth][y * plane_w + x] = dn.v[3];
+        }
+    }
+
+    int src = IllumR, dst = IllumR2;
+    for (int it = 0; it < iterations; ++it) {
+        const int step = (1 << it);
+        // pixels closer to the border are not needed for the next iterations
+        const int margin = 2 * ((2 << it) - 1);
+
+        for (int y = margin; y < work_h - margin; ++y) {
+            for (int x = margin; x < work_w - margin; x += S) {
+                const int i = y * plane_w + x;
+
+                const simd_fvec<S> n_p[3] = {simd_fvec<S>{&planes[NormalX][i]}, simd_fvec<S>{&planes[NormalY][i]},
+                                             simd_fvec<S>{&planes[NormalZ][i]}};
+                const simd_fvec<S> z_p{&planes[Depth][i]};
+                const simd_fvec<S> illum_p[3] = {simd_fvec<S>{&planes[src + 0][i]}, simd_fvec<S>{&planes[src + 1][i]},
+                                                 simd_fvec<S>{&planes[src + 2][i]}};
+                const simd_fvec<S> var_p{&planes[src + 3][i]};
+
+                const simd_fvec<S> lum_p = lum(illum_p);
+                const simd_fvec<S> lum_norm = 1.0f / (SigmaLum * sqrt(max(var_p, 0.0f)) + 0.0001f);
+                const simd_fvec<S> depth_norm = 1.0f / (SigmaDepth * max(abs(z_p), 0.0001f));
+
+                // center tap always has full weight
+                const float center_weight = KernelWeights[2] * KernelWeights[2];
+                simd_fvec<S> sum_illum[3] = {illum_p[0] * center_weight, illum_p[1] * center_weight,
+                                             illum_p[2] * center_weight};
+                simd_fvec<S> sum_var = var_p * (center_weight * center_weight);
+                simd_fvec<S> sum_weight = center_weight;
+
+                for (int dy = -2; dy <= 2; ++dy) {
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        if (dx == 0 && dy == 0) {
+                            continue;
+                        }
+
+                        const int j = i + (dy * plane_w + dx) * step;
+                        const float inv_dist = 1.0f / (float(step) * std::sqrt(float(dx * dx + dy * dy)));
+
+                        const simd_fvec<S> n_q[3] = {simd_fvec<S>{&planes[NormalX][j]},
+                                                     simd_fvec<S>{&planes[NormalY][j]},
+                                                     simd_fvec<S>{&planes[NormalZ][j]}};
+                        const simd_fvec<S> z_q{&planes[Depth][j]};
+                        const simd_fvec<S> illum_q[3] = {simd_fvec<S>{&planes[src + 0][j]},
+                                                         simd_fvec<S>{&planes[src + 1][j]},
+                                                         simd_fvec<S>{&planes[src + 2][j]}};
+                        const simd_fvec<S> var_q{&planes[src + 3][j]};
+
+                        // pow(cos, 128)
+                        simd_fvec<S> normal_weight = max(dot3(n_p, n_q), 0.0f);
+                        UNROLLED_FOR(k, 7, { normal_weight *= normal_weight; })
+
+                        const simd_fvec<S> lum_dist = abs(lum_p - lum(illum_q)) * lum_norm;
+                        const simd_fvec<S> depth_dist = abs(z_p - z_q) * depth_norm * inv_dist;
+
+                        const simd_fvec<S> weight = (KernelWeights[dy + 2] * KernelWeights[dx + 2]) * normal_weight *
+                                                    fast_exp(-(lum_dist + depth_dist));
+
+                        UNROLLED_FOR(c, 3, { sum_illum[c] += illum_q[c] * weight; })
+                        sum_var += var_q * weight * weight;
+                        sum_weight += weight;
+                    }
+                }
+
+                const simd_fvec<S> inv_weight = 1.0f / sum_weight;
+                UNROLLED_FOR(c, 3, { (sum_illum[c] * inv_weight).store_to(&planes[dst + c][i]); })
+                (sum_var * inv_weight * inv_weight).store_to(&planes[dst + 3][i]);
+            }
+        }
+
+        std::swap(src, dst);
+    }
+
+    for (int y = 0; y < rect.h; ++y) {
+        for (int x = 0; x < rect.w; ++x) {
+            const int i = (y + Radius) * plane_w + (x + Radius);
+            const int ii = (rect.y + y) * input_stride + (rect.x + x);
+
+            color_rgba_t &out = output[(output_rect.y + y) * output_stride + (output_rect.x + x)];
+            for (int c = 0; c < 3; ++c) {
+                out.v[c] = planes[src + c][i] * std::max(base_color[ii].v[c], MinAlbedo);
+            }
+            out.v[3] = input[ii].v[3];
+        }
+    }
+}
+
 #undef sqr
 
 #undef USE_VNDF_GGX_SAMPLING
@@ -72,15 +72,24 @@ template void SampleLatlong_RGBE<RPSize>(const Ref::TexStorageRGBA &storage, uin
                                          const simd_ivec<RPSize> &mask, simd_fvec<RPSize> out_rgb[3]);
 
 template class RendererSIMD<RPDimX, RPDimY>;
+template class RendererSIMD<2, 4>;
+template class RendererSIMD<8, 1>;
 
-class Renderer : public RendererSIMD<RPDimX, RPDimY> {
+template <int DimX, int DimY> class Renderer : public RendererSIMD<DimX, DimY> {
   public:
-    Renderer(const settings_t &s, ILog *log) : RendererSIMD(s, log) {}
+    Renderer(const settings_t &s, ILog *log) : RendererSIMD<DimX, DimY>(s, log) {}
 
     eRendererType type() const override { return RendererAVX2; }
 };
 
-RendererBase *CreateRenderer(const settings_t &s, ILog *log) { return new Renderer(s, log); }
+RendererBase *CreateRenderer(const settings_t &s, ILog *log) {
+    if (s.packet_w == 2 && s.packet_h == 4) {
+        return new Renderer<2, 4>(s, log);
+    } else if (s.packet_w == 8 && s.packet_h == 1) {
+        return new Renderer<8, 1>(s, log);
+    }
+    return new Renderer<RPDimX, RPDimY>(s, log);
+}
 } // namespace Avx2
 } // namespace Ray
 
@@ -72,15 +72,27 @@ template void SampleLatlong_RGBE<RPSize>(const Ref::TexStorageRGBA &storage, uin
                                          const simd_ivec<RPSize> &mask, simd_fvec<RPSize> out_rgb[3]);
 
 template class RendererSIMD<RPDimX, RPDimY>;
+template class RendererSIMD<8, 2>;
+template class RendererSIMD<2, 8>;
+template class RendererSIMD<16, 1>;
 
-class Renderer : public RendererSIMD<RPDimX, RPDimY> {
+template <int DimX, int DimY> class Renderer : public RendererSIMD<DimX, DimY> {
   public:
-    Renderer(const settings_t &s, ILog *log) : RendererSIMD(s, log) {}
+    Renderer(const settings_t &s, ILog *log) : RendererSIMD<DimX, DimY>(s, log) {}
 
     eRendererType type() const override { return RendererAVX512; }
 };
 
-RendererBase *CreateRenderer(const settings_t &s, ILog *log) { return new Renderer(s, log); }
+RendererBase *CreateRenderer(const settings_t &s, ILog *log) {
+    if (s.packet_w == 8 && s.packet_h == 2) {
+        return new Renderer<8, 2>(s, log);
+    } else if (s.packet_w == 2 && s.packet_h == 8) {
+        return new Renderer<2, 8>(s, log);
+    } else if (s.packet_w == 16 && s.packet_h == 1) {
+        return new Renderer<16, 1>(s, log);
+    }
+    return new Renderer<RPDimX, RPDimY>(s, log);
+}
 } // namespace Avx512
 } // namespace Ray
 
@@ -76,15 +76,24 @@ template void IntersectAreaLights<RPSize>(const ray_data_t<RPSize> &r, const sim
                                           const transform_t transforms[], hit_data_t<RPSize> &inout_inter);
 
 template class RendererSIMD<RPDimX, RPDimY>;
+template class RendererSIMD<4, 1>;
+template class RendererSIMD<1, 4>;
 
-class Renderer : public RendererSIMD<RPDimX, RPDimY> {
+template <int DimX, int DimY> class Renderer : public RendererSIMD<DimX, DimY> {
   public:
-    Renderer(const settings_t &s, ILog *log) : RendererSIMD(s, log) {}
+    Renderer(const settings_t &s, ILog *log) : RendererSIMD<DimX, DimY>(s, log) {}
 
     eRendererType type() const override { return RendererNEON; }
 };
 
-RendererBase *CreateRenderer(const settings_t &s, ILog *log) { return new Renderer(s, log); }
+RendererBase *CreateRenderer(const settings_t &s, ILog *log) {
+    if (s.packet_w == 4 && s.packet_h == 1) {
+        return new Renderer<4, 1>(s, log);
+    } else if (s.packet_w == 1 && s.packet_h == 4) {
+        return new Renderer<1, 4>(s, log);
+    }
+    return new Renderer<RPDimX, RPDimY>(s, log);
+}
 } // namespace Neon
 } // namespace Ray
 
@@ -12,14 +12,22 @@ namespace Ray {
 thread_local Ray::Ref::PassData g_per_thread_pass_data;
 }
 
-Ray::Ref::Renderer::Renderer(const settings_t &s, ILog *log) : log_(log), use_wide_bvh_(s.use_wide_bvh) {
+Ray::Ref::Renderer::Renderer(const settings_t &s, ILog *log)
+    : log_(log), use_wide_bvh_(s.use_wide_bvh), use_tex_compression_(s.use_cpu_tex_compression),
+      tex_cache_dir_(s.tex_cache_dir ? s.tex_cache_dir : ""), tex_cache_budget_(size_t(s.tex_cache_budget_mb) << 20),
+      bvh_cache_dir_(s.bvh_cache_dir ? s.bvh_cache_dir : ""),
+      pixel_order_(s.pixel_order) {
     auto rand_func = std::bind(UniformIntDistribution<uint32_t>(), std::mt19937(0));
     permutations_ = Ray::ComputeRadicalInversePermutations(g_primes, PrimesCount, rand_func);
 
     Resize(s.w, s.h);
 }
 
-Ray::SceneBase *Ray::Ref::Renderer::CreateScene() { return new Ref::Scene(log_, use_wide_bvh_); }
+Ray::SceneBase *Ray::Ref::Renderer::CreateScene() {
+    return new Ref::Scene(log_, use_wide_bvh_, use_tex_compression_,
+                          tex_cache_dir_.empty() ? nullptr : tex_cache_dir_.c_str(), tex_cache_budget_,
+                          bvh_cache_dir_.empty() ? nullptr : bvh_cache_dir_.c_str());
+}
 
 void Ray::Ref::Renderer::RenderScene(const SceneBase *scene, RegionContext &region) {
     const auto s = dynamic_cast<const Ref::Scene *>(scene);
@@ -125,7 +133,12 @@ void Ray::Ref::Renderer::RenderScene(const SceneBase *scene, RegionContext &regi
     const uint32_t hi = (region.iteration & (HALTON_SEQ_LEN - 1)) * HALTON_COUNT;
 
     if (cam.type != Geo) {
-        GeneratePrimaryRays(cam, rect, w_, h_, &region.halton_seq[hi], p.primary_rays);
+        const uint32_t *pixel_order = nullptr;
+        if (pixel_order_ != Scanline) {
+            pixel_order = GetTileOrder(pixel_order_, rect.w, rect.h, p.pixel_order);
+        }
+
+        GeneratePrimaryRays(cam, rect, w_, h_, pixel_order, &region.halton_seq[hi], p.primary_rays);
 
         time_after_ray_gen = high_resolution_clock::now();
 
@@ -399,29 +412,60 @@ void Ray::Ref::Renderer::DenoiseImage(const RegionContext &region) {
     const auto denoise_start = high_resolution_clock::now();
 
     const rect_t &rect = region.rect();
+    const rect_t rect_ext = {rect.x - NLM_RADIUS, rect.y - NLM_RADIUS, rect.w + 2 * NLM_RADIUS,
+                             rect.h + 2 * NLM_RADIUS};
 
-    // TODO: determine radius precisely!
-    const int EXT_RADIUS = 8;
-    const rect_t rect_ext = {rect.x - EXT_RADIUS, rect.y - EXT_RADIUS, rect.w + 2 * EXT_RADIUS,
-                             rect.h + 2 * EXT_RADIUS};
-
+    // region is denoised independently, so variance has to be filtered for the whole halo
     PassData &p = g_per_thread_pass_data;
-    p.temp_final_buf.resize(rect_ext.w * rect_ext.h);
-    p.variance_buf.resize(rect_ext.w * rect_ext.h);
     p.filtered_variance_buf.resize(rect_ext.w * rect_ext.h);
+    FilterVariance(rect_ext, p.filtered_variance_buf.data(), rect_ext.w);
+    FilterImage(rect, p.filtered_variance_buf.data());
+
+    const auto denoise_end = high_resolution_clock::now();
+
+    {
+        std::lock_guard<std::mutex> _(mtx_);
+        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+    }
+}
+
+void Ray::Ref::Renderer::DenoiseImage(const int pass, const RegionContext &region) {
+    using namespace std::chrono;
+    const auto denoise_start = high_resolution_clock::now();
+
+    const rect_t &rect = region.rect();
+
+    if (pass == 0) {
+        FilterVariance(rect, &filtered_variance_buf_[rect.y * w_ + rect.x], w_);
+    } else if (pass == 1) {
+        FilterImage(rect, nullptr);
+    }
+
+    const auto denoise_end = high_resolution_clock::now();
+
+    {
+        std::lock_guard<std::mutex> _(mtx_);
+        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+    }
+}
+
+void Ray::Ref::Renderer::FilterVariance(const rect_t &rect, color_rgba_t out_variance[], const int out_stride) {
+    PassData &p = g_per_thread_pass_data;
+
+    // variance is prefiltered with 9-tap kernel, so 4 more rows are needed
+    const int rows_count = rect.h + 8;
+    p.variance_buf.resize(rect.w * rows_count);
 
-#define FETCH_FINAL_BUF(_x, _y) final_buf_[std::min(std::max(_y, 0), h_ - 1) * w_ + std::min(std::max(_x, 0), w_ - 1)]
 #define FETCH_VARIANCE(_x, _y)                                                                                         \
     simd_fvec4(temp_buf_[std::min(std::max(_y, 0), h_ - 1) * w_ + std::min(std::max(_x, 0), w_ - 1)].v,                \
                simd_mem_aligned)
 
     static const float GaussWeights[] = {0.2270270270f, 0.1945945946f, 0.1216216216f, 0.0540540541f, 0.0162162162f};
 
-    for (int y = 0; y < rect_ext.h; ++y) {
-        const int yy = rect_ext.y + y;
-        for (int x = 0; x < rect_ext.w; ++x) {
-            const int xx = rect_ext.x + x;
-            p.temp_final_buf[y * rect_ext.w + x] = FETCH_FINAL_BUF(xx, yy);
+    for (int y = 0; y < rows_count; ++y) {
+        const int yy = rect.y - 4 + y;
+        for (int x = 0; x < rect.w; ++x) {
+            const int xx = rect.x + x;
 
             const simd_fvec4 center_val = FETCH_VARIANCE(xx, yy);
 
@@ -432,45 +476,67 @@ void Ray::Ref::Renderer::DenoiseImage(const RegionContext &region) {
             })
 
             res = max(res, center_val);
-            res.store_to(p.variance_buf[y * rect_ext.w + x].v, simd_mem_aligned);
+            res.store_to(p.variance_buf[y * rect.w + x].v, simd_mem_aligned);
         }
     }
 
 #undef FETCH_VARIANCE
-#undef FETCH_FINAL_BUF
 
-    for (int y = 4; y < rect_ext.h - 4; ++y) {
-        for (int x = 4; x < rect_ext.w - 4; ++x) {
-            const simd_fvec4 center_val = {p.variance_buf[(y + 0) * rect_ext.w + x].v, simd_mem_aligned};
+    for (int y = 0; y < rect.h; ++y) {
+        const int yy = y + 4;
+        for (int x = 0; x < rect.w; ++x) {
+            const simd_fvec4 center_val = {p.variance_buf[yy * rect.w + x].v, simd_mem_aligned};
 
             simd_fvec4 res = center_val * GaussWeights[0];
             UNROLLED_FOR(i, 4, {
-                res +=
-                    simd_fvec4(p.variance_buf[(y - i + 1) * rect_ext.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
-                res +=
-                    simd_fvec4(p.variance_buf[(y + i + 1) * rect_ext.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
+                res += simd_fvec4(p.variance_buf[(yy - i + 1) * rect.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
+                res += simd_fvec4(p.variance_buf[(yy + i + 1) * rect.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
             })
 
             res = max(res, center_val);
-            res.store_to(p.filtered_variance_buf[y * rect_ext.w + x].v, simd_mem_aligned);
+            res.store_to(out_variance[y * out_stride + x].v, simd_mem_aligned);
         }
     }
+}
 
-    const int NLM_WINDOW_SIZE = 7;
-    const int NLM_NEIGHBORHOOD_SIZE = 3;
+void Ray::Ref::Renderer::FilterImage(const rect_t &rect, const color_rgba_t halo_variance[]) {
+    PassData &p = g_per_thread_pass_data;
 
-    static_assert(EXT_RADIUS >= (NLM_WINDOW_SIZE - 1) / 2 + (NLM_NEIGHBORHOOD_SIZE - 1) / 2, "!");
+    const rect_t rect_ext = {rect.x - NLM_RADIUS, rect.y - NLM_RADIUS, rect.w + 2 * NLM_RADIUS,
+                             rect.h + 2 * NLM_RADIUS};
 
-    NLMFilter<NLM_WINDOW_SIZE, NLM_NEIGHBORHOOD_SIZE>(
-        p.temp_final_buf.data(), rect_t{EXT_RADIUS, EXT_RADIUS, rect.w, rect.h}, rect_ext.w, 1.0f, 0.45f,
-        p.filtered_variance_buf.data(), rect, w_, filtered_final_buf_.data());
+    const color_rgba_t *input = final_buf_.data(), *variance = filtered_variance_buf_.data();
+    rect_t input_rect = rect;
+    int input_stride = w_;
 
-    const auto denoise_end = high_resolution_clock::now();
+    if (halo_variance || rect_ext.x < 0 || rect_ext.y < 0 || rect_ext.x + rect_ext.w > w_ ||
+        rect_ext.y + rect_ext.h > h_) {
+        // halo is gathered into separate buffers (with edge pixels repeated outside of image)
+        p.temp_final_buf.resize(rect_ext.w * rect_ext.h);
+        if (!halo_variance) {
+            p.filtered_variance_buf.resize(rect_ext.w * rect_ext.h);
+        }
 
-    {
-        std::lock_guard<std::mutex> _(mtx_);
-        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+        for (int y = 0; y < rect_ext.h; ++y) {
+            const int yy = std::min(std::max(rect_ext.y + y, 0), h_ - 1);
+            for (int x = 0; x < rect_ext.w; ++x) {
+                const int xx = std::min(std::max(rect_ext.x + x, 0), w_ - 1);
+
+                p.temp_final_buf[y * rect_ext.w + x] = final_buf_[yy * w_ + xx];
+                if (!halo_variance) {
+                    p.filtered_variance_buf[y * rect_ext.w + x] = filtered_variance_buf_[yy * w_ + xx];
+                }
+            }
+        }
+
+        input = p.temp_final_buf.data();
+        variance = halo_variance ? halo_variance : p.filtered_variance_buf.data();
+        input_rect = rect_t{NLM_RADIUS, NLM_RADIUS, rect.w, rect.h};
+        input_stride = rect_ext.w;
     }
+
+    NLMFilter<NLM_WINDOW_SIZE, NLM_NEIGHBORHOOD_SIZE>(input, input_rect, input_stride, 1.0f, 0.45f, variance, rect, w_,
+                                                      filtered_final_buf_.data());
 }
 
 void Ray::Ref::Renderer::UpdateHaltonSequence(const int iteration, std::unique_ptr<float[]> &seq) {
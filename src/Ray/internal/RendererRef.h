@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mutex>
+#include <string>
 
 #include "../RendererBase.h"
 #include "CoreRef.h"
@@ -25,14 +26,20 @@ struct PassData {
 
     std::vector<ray_chunk_t> chunks, chunks_temp;
     std::vector<uint32_t> skeleton;
+
+    tile_order_t pixel_order;
 };
 
 class Renderer : public RendererBase {
     ILog *log_;
 
-    bool use_wide_bvh_;
+    bool use_wide_bvh_, use_tex_compression_;
+    std::string tex_cache_dir_;
+    size_t tex_cache_budget_;
+    std::string bvh_cache_dir_;
+    ePixelOrder pixel_order_;
     aligned_vector<color_rgba_t, 16> dual_buf_[2], base_color_buf_, depth_normals_buf_, temp_buf_, final_buf_,
-        raw_final_buf_, filtered_final_buf_;
+        raw_final_buf_, filtered_final_buf_, filtered_variance_buf_;
 
     std::mutex mtx_;
 
@@ -42,6 +49,15 @@ class Renderer : public RendererBase {
     std::vector<uint16_t> permutations_;
     void UpdateHaltonSequence(int iteration, std::unique_ptr<float[]> &seq);
 
+    static const int NLM_WINDOW_SIZE = 7, NLM_NEIGHBORHOOD_SIZE = 3;
+    // number of pixels around region needed for image filtering
+    static const int NLM_RADIUS = (NLM_WINDOW_SIZE - 1) / 2 + (NLM_NEIGHBORHOOD_SIZE - 1) / 2;
+
+    // filters variance of rect (which can exceed image bounds)
+    void FilterVariance(const rect_t &rect, color_rgba_t out_variance[], int out_stride);
+    // filters image region, halo of filtered variance is taken from frame-level buffer if not provided
+    void FilterImage(const rect_t &rect, const color_rgba_t halo_variance[]);
+
   public:
     Renderer(const settings_t &s, ILog *log);
 
@@ -81,6 +97,8 @@ class Renderer : public RendererBase {
             raw_final_buf_.shrink_to_fit();
             filtered_final_buf_.assign(w * h, {});
             filtered_final_buf_.shrink_to_fit();
+            filtered_variance_buf_.assign(w * h, {});
+            filtered_variance_buf_.shrink_to_fit();
 
             w_ = w;
             h_ = h;
@@ -96,6 +114,7 @@ class Renderer : public RendererBase {
     SceneBase *CreateScene() override;
     void RenderScene(const SceneBase *scene, RegionContext &region) override;
     void DenoiseImage(const RegionContext &region) override;
+    void DenoiseImage(int pass, const RegionContext &region) override;
 
     void GetStats(stats_t &st) override { st = stats_; }
     void ResetStats() override { stats_ = {0}; }
@@ -1,8 +1,10 @@
 
 #include <chrono>
 #include <functional>
+#include <limits>
 #include <mutex>
 #include <random>
+#include <string>
 
 #include "../RendererBase.h"
 #include "CoreSIMD.h"
@@ -23,28 +25,67 @@ template <int S> struct PassData {
     aligned_vector<color_rgba_t, 16> temp_final_buf;
     aligned_vector<color_rgba_t, 16> variance_buf;
     aligned_vector<color_rgba_t, 16> filtered_variance_buf;
+    aligned_vector<color_rgba_t, 16> temp_base_color_buf, temp_depth_normals_buf;
+    aligned_vector<float, 64> denoise_temp_buf;
 
     aligned_vector<simd_ivec<S>> hash_values;
     std::vector<int> head_flags;
     std::vector<uint32_t> scan_values;
     std::vector<ray_chunk_t> chunks, chunks_temp;
     std::vector<uint32_t> skeleton;
+
+    tile_order_t packet_order;
+
+    shadow_occluder_t occluders[SHADOW_OCCLUDER_CACHE_SIZE];
 };
 
 template <int DimX, int DimY> class RendererSIMD : public RendererBase {
     ILog *log_;
     aligned_vector<color_rgba_t, 16> dual_buf_[2], base_color_buf_, depth_normals_buf_, temp_buf_, final_buf_,
-        raw_final_buf_, filtered_final_buf_;
+        raw_final_buf_, filtered_final_buf_, filtered_variance_buf_;
 
     std::mutex mtx_;
 
-    bool use_wide_bvh_;
+    bool use_wide_bvh_, use_tex_compression_;
+    std::string tex_cache_dir_;
+    size_t tex_cache_budget_;
+    std::string bvh_cache_dir_;
+    ePixelOrder pixel_order_;
+    eDenoiseMethod denoise_method_;
+    bool use_temporal_accumulation_;
+    int temporal_max_history_;
     stats_t stats_ = {0};
     int w_ = 0, h_ = 0;
 
+    // per-pixel number of samples in each of dual buffers (only with temporal accumulation)
+    std::vector<float> sample_count_buf_[2];
+    // camera used for accumulated image
+    camera_t last_cam_ = {};
+    bool has_last_cam_ = false;
+    // scratch data used during reprojection
+    std::vector<int> reproj_index_, reproj_temp_index_;
+    std::vector<float> reproj_dist_, reproj_temp_count_;
+    aligned_vector<color_rgba_t, 16> reproj_temp_buf_;
+
     std::vector<uint16_t> permutations_;
     void UpdateHaltonSequence(int iteration, std::unique_ptr<float[]> &seq);
 
+    static const int NLM_WINDOW_SIZE = 7, NLM_NEIGHBORHOOD_SIZE = 3, ATROUS_ITERATIONS = 3;
+    // number of pixels around region needed for image filtering
+    static const int NLM_RADIUS = (NLM_WINDOW_SIZE - 1) / 2 + (NLM_NEIGHBORHOOD_SIZE - 1) / 2,
+                     ATROUS_RADIUS = 2 * ((1 << ATROUS_ITERATIONS) - 1);
+
+    // feature-guided filter requires aux buffers
+    bool use_atrous_denoiser() const {
+        return denoise_method_ == ATrous && int(base_color_buf_.size()) == w_ * h_ &&
+               int(depth_normals_buf_.size()) == w_ * h_;
+    }
+
+    // filters variance of rect (which can exceed image bounds)
+    void FilterVariance(const rect_t &rect, color_rgba_t out_variance[], int out_stride);
+    // filters image region, halo of filtered variance is taken from frame-level buffer if not provided
+    void FilterImage(const rect_t &rect, bool use_atrous, const color_rgba_t halo_variance[]);
+
   public:
     RendererSIMD(const settings_t &s, ILog *log);
 
@@ -54,6 +95,8 @@ template <int DimX, int DimY> class RendererSIMD : public RendererBase {
 
     const char *device_name() const override { return "CPU"; }
 
+    std::pair<int, int> packet_size() const override { return std::make_pair(DimX, DimY); }
+
     const color_rgba_t *get_pixels_ref() const override { return final_buf_.data(); }
     const color_rgba_t *get_raw_pixels_ref() const override { return raw_final_buf_.data(); }
     const color_rgba_t *get_aux_pixels_ref(const eAUXBuffer buf) const override {
@@ -82,6 +125,14 @@ template <int DimX, int DimY> class RendererSIMD : public RendererBase {
             raw_final_buf_.shrink_to_fit();
             filtered_final_buf_.assign(w * h, {});
             filtered_final_buf_.shrink_to_fit();
+            filtered_variance_buf_.assign(w * h, {});
+            filtered_variance_buf_.shrink_to_fit();
+            if (use_temporal_accumulation_) {
+                for (auto &buf : sample_count_buf_) {
+                    buf.assign(w * h, 0.0f);
+                    buf.shrink_to_fit();
+                }
+            }
 
             w_ = w;
             h_ = h;
@@ -91,11 +142,16 @@ template <int DimX, int DimY> class RendererSIMD : public RendererBase {
         for (auto &buf : dual_buf_) {
             buf.assign(w_ * h_, c);
         }
+        for (auto &buf : sample_count_buf_) {
+            std::fill(buf.begin(), buf.end(), 0.0f);
+        }
     }
 
     SceneBase *CreateScene() override;
     void RenderScene(const SceneBase *scene, RegionContext &region) override;
     void DenoiseImage(const RegionContext &region) override;
+    void DenoiseImage(int pass, const RegionContext &region) override;
+    bool ReprojectImage(const SceneBase *scene) override;
 
     void GetStats(stats_t &st) override { st = stats_; }
     void ResetStats() override { stats_ = {0}; }
@@ -116,7 +172,11 @@ template <int S> Ray::NS::PassData<S> &get_per_thread_pass_data() {
 
 template <int DimX, int DimY>
 Ray::NS::RendererSIMD<DimX, DimY>::RendererSIMD(const settings_t &s, ILog *log)
-    : log_(log), use_wide_bvh_(s.use_wide_bvh) {
+    : log_(log), use_wide_bvh_(s.use_wide_bvh), use_tex_compression_(s.use_cpu_tex_compression),
+      tex_cache_dir_(s.tex_cache_dir ? s.tex_cache_dir : ""), tex_cache_budget_(size_t(s.tex_cache_budget_mb) << 20),
+      bvh_cache_dir_(s.bvh_cache_dir ? s.bvh_cache_dir : ""),
+      pixel_order_(s.pixel_order), denoise_method_(s.denoise_method),
+      use_temporal_accumulation_(s.use_temporal_accumulation), temporal_max_history_(s.temporal_max_history) {
     auto mt = std::mt19937(0);
     auto dist = UniformIntDistribution<uint32_t>{};
     auto rand_func = [&]() { return dist(mt); };
@@ -126,7 +186,9 @@ Ray::NS::RendererSIMD<DimX, DimY>::RendererSIMD(const settings_t &s, ILog *log)
 }
 
 template <int DimX, int DimY> Ray::SceneBase *Ray::NS::RendererSIMD<DimX, DimY>::CreateScene() {
-    return new Ref::Scene(log_, use_wide_bvh_);
+    return new Ref::Scene(log_, use_wide_bvh_, use_tex_compression_,
+                          tex_cache_dir_.empty() ? nullptr : tex_cache_dir_.c_str(), tex_cache_budget_,
+                          bvh_cache_dir_.empty() ? nullptr : bvh_cache_dir_.c_str());
 }
 
 template <int DimX, int DimY>
@@ -211,6 +273,11 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
 
     PassData<S> &p = get_per_thread_pass_data<S>();
 
+    // cached occluders are only valid for current scene state
+    for (shadow_occluder_t &occ : p.occluders) {
+        occ.light_index = -1;
+    }
+
     // allocate aux data on demand
     if (cam.pass_settings.flags & (OutputBaseColor | OutputDepthNormals)) {
         // TODO: Skip locking here
@@ -235,9 +302,18 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
 
     const uint32_t hi = (region.iteration & (HALTON_SEQ_LEN - 1)) * HALTON_COUNT;
 
+    unsigned long long prim_rays_count = 0, prim_packets_count = 0, prim_coherent_count = 0,
+                       prim_coherent_packets_count = 0;
+
     if (cam.type != Geo) {
-        GeneratePrimaryRays<DimX, DimY>(region.iteration, cam, rect, w_, h_, &region.halton_seq[hi], p.primary_rays,
-                                        p.primary_masks);
+        const uint32_t *packet_order = nullptr;
+        if (pixel_order_ != Scanline) {
+            packet_order =
+                GetTileOrder(pixel_order_, (rect.w + DimX - 1) / DimX, (rect.h + DimY - 1) / DimY, p.packet_order);
+        }
+
+        GeneratePrimaryRays<DimX, DimY>(region.iteration, cam, rect, w_, h_, packet_order, &region.halton_seq[hi],
+                                        p.primary_rays, p.primary_masks);
 
         time_after_ray_gen = high_resolution_clock::now();
 
@@ -257,6 +333,31 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
             }
             // NS::IntersectAreaLights(r, {-1}, sc_data.lights, sc_data.visible_lights, sc_data.transforms, inter);
         }
+
+        int prev_obj_index = -2;
+        for (size_t i = 0; i < p.intersections.size(); i++) {
+            const simd_ivec<S> &mask = p.primary_masks[i];
+            const hit_data_t<S> &inter = p.intersections[i];
+
+            bool first_found = false;
+            int first_obj_index = 0;
+            UNROLLED_FOR_S(j, S, {
+                if (mask.template get<j>()) {
+                    const int obj_index = inter.obj_index.template get<j>();
+                    if (!first_found) {
+                        first_obj_index = obj_index;
+                        first_found = true;
+                    }
+                    ++prim_rays_count;
+                    prim_coherent_count += (obj_index == first_obj_index);
+                }
+            })
+            if (first_found) {
+                prim_coherent_packets_count += (first_obj_index == prev_obj_index);
+                prev_obj_index = first_obj_index;
+            }
+        }
+        prim_packets_count += p.intersections.size();
     } else {
         const mesh_instance_t &mi = sc_data.mesh_instances[cam.mi_index];
         SampleMeshInTextureSpace<DimX, DimY>(region.iteration, cam.mi_index, cam.uv_index,
@@ -300,13 +401,19 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
                 UNROLLED_FOR(j, 4, {
                     temp_buf_[y.template get<i>() * w_ + x.template get<i>()].v[j] = out_rgba[j].template get<i>();
                 })
+                // reprojected pixels have their own number of samples
+                const float aux_mix_factor =
+                    use_temporal_accumulation_
+                        ? 1.0f / (sample_count_buf_[0][y.template get<i>() * w_ + x.template get<i>()] +
+                                  sample_count_buf_[1][y.template get<i>() * w_ + x.template get<i>()] + 1.0f)
+                        : mix_factor;
                 if (cam.pass_settings.flags & OutputBaseColor) {
                     auto old_val =
                         simd_fvec4(base_color_buf_[y.template get<i>() * w_ + x.template get<i>()].v, simd_mem_aligned);
                     old_val += (simd_fvec4{out_base_color[0].template get<i>(), out_base_color[1].template get<i>(),
                                            out_base_color[2].template get<i>(), 0.0f} -
                                 old_val) *
-                               mix_factor;
+                               aux_mix_factor;
                     old_val.store_to(base_color_buf_[y.template get<i>() * w_ + x.template get<i>()].v,
                                      simd_mem_aligned);
                 }
@@ -317,7 +424,7 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
                         (simd_fvec4{out_depth_normal[0].template get<i>(), out_depth_normal[1].template get<i>(),
                                     out_depth_normal[2].template get<i>(), out_depth_normal[3].template get<i>()} -
                          old_val) *
-                        mix_factor;
+                        aux_mix_factor;
                     old_val.store_to(depth_normals_buf_[y.template get<i>() * w_ + x.template get<i>()].v,
                                      simd_mem_aligned);
                 }
@@ -334,8 +441,11 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
 
         simd_fvec<S> rc[3];
         NS::IntersectScene(sh_r, p.shadow_masks[ri], cam.pass_settings.max_transp_depth, sc_data, macro_tree_root,
-                           s->tex_storages_, rc);
-        const simd_fvec<S> k = NS::IntersectAreaLights(sh_r, p.shadow_masks[ri], sc_data.lights, sc_data.blocker_lights,
+                           s->tex_storages_, rc, p.occluders);
+        // fully blocked rays are not tested against blocker lights
+        const simd_ivec<S> unblocked_mask =
+            p.shadow_masks[ri] & simd_cast((rc[0] != 0.0f) | (rc[1] != 0.0f) | (rc[2] != 0.0f));
+        const simd_fvec<S> k = NS::IntersectAreaLights(sh_r, unblocked_mask, sc_data.lights, sc_data.blocker_lights,
                                                        sc_data.transforms);
         UNROLLED_FOR(i, 3, { rc[i] *= k; })
 
@@ -426,8 +536,10 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
 
             simd_fvec<S> rc[3];
             IntersectScene(sh_r, p.shadow_masks[ri], cam.pass_settings.max_transp_depth, sc_data, macro_tree_root,
-                           s->tex_storages_, rc);
-            const simd_fvec<S> k = NS::IntersectAreaLights(sh_r, p.shadow_masks[ri], sc_data.lights,
+                           s->tex_storages_, rc, p.occluders);
+            const simd_ivec<S> unblocked_mask =
+                p.shadow_masks[ri] & simd_cast((rc[0] != 0.0f) | (rc[1] != 0.0f) | (rc[2] != 0.0f));
+            const simd_fvec<S> k = NS::IntersectAreaLights(sh_r, unblocked_mask, sc_data.lights,
                                                            sc_data.blocker_lights, sc_data.transforms);
             UNROLLED_FOR(i, 3, { rc[i] *= k; })
 
@@ -467,17 +579,31 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
         stats_.time_secondary_trace_us += (unsigned long long)secondary_trace_time.count();
         stats_.time_secondary_shade_us += (unsigned long long)secondary_shade_time.count();
         stats_.time_secondary_shadow_us += (unsigned long long)secondary_shadow_time.count();
+        stats_.primary_rays += prim_rays_count;
+        stats_.primary_packets += prim_packets_count;
+        stats_.primary_coherent_rays += prim_coherent_count;
+        stats_.primary_coherent_packets += prim_coherent_packets_count;
+
+        last_cam_ = cam;
+        has_last_cam_ = true;
     }
 
     color_rgba_t *clean_buf = dual_buf_[(region.iteration - 1) % 2].data();
+    float *clean_count = use_temporal_accumulation_ ? sample_count_buf_[(region.iteration - 1) % 2].data() : nullptr;
 
     const float half_mix_factor = 1.0f / float((region.iteration + 1) / 2);
     for (int y = rect.y; y < rect.y + rect.h; ++y) {
         for (int x = rect.x; x < rect.x + rect.w; ++x) {
             const simd_fvec4 new_val = {temp_buf_[y * w_ + x].v, simd_mem_aligned};
 
+            float pix_mix_factor = half_mix_factor;
+            if (clean_count) {
+                clean_count[y * w_ + x] += 1.0f;
+                pix_mix_factor = 1.0f / clean_count[y * w_ + x];
+            }
+
             simd_fvec4 cur_val = {clean_buf[y * w_ + x].v, simd_mem_aligned};
-            cur_val += (new_val - cur_val) * half_mix_factor;
+            cur_val += (new_val - cur_val) * pix_mix_factor;
             cur_val.store_to(clean_buf[y * w_ + x].v, simd_mem_aligned);
         }
     }
@@ -514,11 +640,14 @@ void Ray::NS::RendererSIMD<DimX, DimY>::RenderScene(const SceneBase *scene, Regi
             simd_fvec4 p1 = {dual_buf_[0][y * w_ + x].v, simd_mem_aligned};
             simd_fvec4 p2 = {dual_buf_[1][y * w_ + x].v, simd_mem_aligned};
 
-            const int p1_samples = (region.iteration + 1) / 2;
-            const int p2_samples = (region.iteration) / 2;
+            float p1_samples = float((region.iteration + 1) / 2), p2_samples = float(region.iteration / 2);
+            if (use_temporal_accumulation_) {
+                p1_samples = sample_count_buf_[0][y * w_ + x];
+                p2_samples = sample_count_buf_[1][y * w_ + x];
+            }
 
-            const float p1_weight = float(p1_samples) / float(region.iteration);
-            const float p2_weight = float(p2_samples) / float(region.iteration);
+            const float p1_weight = p1_samples / (p1_samples + p2_samples);
+            const float p2_weight = p2_samples / (p1_samples + p2_samples);
 
             const simd_fvec4 untonemapped_res = p1_weight * p1 + p2_weight * p2;
             untonemapped_res.store_to(raw_final_buf_[y * w_ + x].v, simd_mem_aligned);
@@ -543,28 +672,66 @@ template <int DimX, int DimY> void Ray::NS::RendererSIMD<DimX, DimY>::DenoiseIma
 
     const rect_t &rect = region.rect();
 
-    const int EXT_RADIUS = 8;
-    const rect_t rect_ext = {rect.x - EXT_RADIUS, rect.y - EXT_RADIUS, rect.w + 2 * EXT_RADIUS,
-                             rect.h + 2 * EXT_RADIUS};
+    const bool use_atrous = use_atrous_denoiser();
+    const int radius = use_atrous ? ATROUS_RADIUS : NLM_RADIUS;
+    const rect_t rect_ext = {rect.x - radius, rect.y - radius, rect.w + 2 * radius, rect.h + 2 * radius};
 
+    // region is denoised independently, so variance has to be filtered for the whole halo
     PassData<S> &p = get_per_thread_pass_data<S>();
-
-    p.temp_final_buf.resize(rect_ext.w * rect_ext.h);
-    p.variance_buf.resize(rect_ext.w * rect_ext.h);
     p.filtered_variance_buf.resize(rect_ext.w * rect_ext.h);
+    FilterVariance(rect_ext, p.filtered_variance_buf.data(), rect_ext.w);
+    FilterImage(rect, use_atrous, p.filtered_variance_buf.data());
+
+    const auto denoise_end = high_resolution_clock::now();
+
+    {
+        std::lock_guard<std::mutex> _(mtx_);
+        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+    }
+}
+
+template <int DimX, int DimY>
+void Ray::NS::RendererSIMD<DimX, DimY>::DenoiseImage(const int pass, const RegionContext &region) {
+    using namespace std::chrono;
+    const auto denoise_start = high_resolution_clock::now();
+
+    const rect_t &rect = region.rect();
+
+    if (pass == 0) {
+        FilterVariance(rect, &filtered_variance_buf_[rect.y * w_ + rect.x], w_);
+    } else if (pass == 1) {
+        FilterImage(rect, use_atrous_denoiser(), nullptr);
+    }
+
+    const auto denoise_end = high_resolution_clock::now();
+
+    {
+        std::lock_guard<std::mutex> _(mtx_);
+        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+    }
+}
+
+template <int DimX, int DimY>
+void Ray::NS::RendererSIMD<DimX, DimY>::FilterVariance(const rect_t &rect, color_rgba_t out_variance[],
+                                                       const int out_stride) {
+    const int S = DimX * DimY;
+
+    PassData<S> &p = get_per_thread_pass_data<S>();
+
+    // variance is prefiltered with 9-tap kernel, so 4 more rows are needed
+    const int rows_count = rect.h + 8;
+    p.variance_buf.resize(rect.w * rows_count);
 
-#define FETCH_FINAL_BUF(_x, _y) final_buf_[std::min(std::max(_y, 0), h_ - 1) * w_ + std::min(std::max(_x, 0), w_ - 1)]
 #define FETCH_VARIANCE(_x, _y)                                                                                         \
     simd_fvec4(temp_buf_[std::min(std::max(_y, 0), h_ - 1) * w_ + std::min(std::max(_x, 0), w_ - 1)].v,                \
                simd_mem_aligned)
 
     static const float GaussWeights[] = {0.2270270270f, 0.1945945946f, 0.1216216216f, 0.0540540541f, 0.0162162162f};
 
-    for (int y = 0; y < rect_ext.h; ++y) {
-        const int yy = rect_ext.y + y;
-        for (int x = 0; x < rect_ext.w; ++x) {
-            const int xx = rect_ext.x + x;
-            p.temp_final_buf[y * rect_ext.w + x] = FETCH_FINAL_BUF(xx, yy);
+    for (int y = 0; y < rows_count; ++y) {
+        const int yy = rect.y - 4 + y;
+        for (int x = 0; x < rect.w; ++x) {
+            const int xx = rect.x + x;
 
             const simd_fvec4 center_val = FETCH_VARIANCE(xx, yy);
 
@@ -575,45 +742,302 @@ template <int DimX, int DimY> void Ray::NS::RendererSIMD<DimX, DimY>::DenoiseIma
             })
 
             res = max(res, center_val);
-            res.store_to(p.variance_buf[y * rect_ext.w + x].v, simd_mem_aligned);
+            res.store_to(p.variance_buf[y * rect.w + x].v, simd_mem_aligned);
         }
     }
 
 #undef FETCH_VARIANCE
-#undef FETCH_FINAL_BUF
 
-    for (int y = 4; y < rect_ext.h - 4; ++y) {
-        for (int x = 4; x < rect_ext.w - 4; ++x) {
-            const simd_fvec4 center_val = {p.variance_buf[(y + 0) * rect_ext.w + x].v, simd_mem_aligned};
+    for (int y = 0; y < rect.h; ++y) {
+        const int yy = y + 4;
+        for (int x = 0; x < rect.w; ++x) {
+            const simd_fvec4 center_val = {p.variance_buf[yy * rect.w + x].v, simd_mem_aligned};
 
             simd_fvec4 res = center_val * GaussWeights[0];
             UNROLLED_FOR(i, 4, {
-                res +=
-                    simd_fvec4(p.variance_buf[(y - i + 1) * rect_ext.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
-                res +=
-                    simd_fvec4(p.variance_buf[(y + i + 1) * rect_ext.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
+                res += simd_fvec4(p.variance_buf[(yy - i + 1) * rect.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
+                res += simd_fvec4(p.variance_buf[(yy + i + 1) * rect.w + x].v, simd_mem_aligned) * GaussWeights[i + 1];
             })
 
             res = max(res, center_val);
-            res.store_to(p.filtered_variance_buf[y * rect_ext.w + x].v, simd_mem_aligned);
+            res.store_to(out_variance[y * out_stride + x].v, simd_mem_aligned);
         }
     }
+}
 
-    const int NLM_WINDOW_SIZE = 7;
-    const int NLM_NEIGHBORHOOD_SIZE = 3;
+template <int DimX, int DimY>
+void Ray::NS::RendererSIMD<DimX, DimY>::FilterImage(const rect_t &rect, const bool use_atrous,
+                                                    const color_rgba_t halo_variance[]) {
+    const int S = DimX * DimY;
 
-    static_assert(EXT_RADIUS >= (NLM_WINDOW_SIZE - 1) / 2 + (NLM_NEIGHBORHOOD_SIZE - 1) / 2, "!");
+    PassData<S> &p = get_per_thread_pass_data<S>();
 
-    Ref::NLMFilter<NLM_WINDOW_SIZE, NLM_NEIGHBORHOOD_SIZE>(
-        p.temp_final_buf.data(), rect_t{EXT_RADIUS, EXT_RADIUS, rect.w, rect.h}, rect_ext.w, 1.0f, 0.45f,
-        p.filtered_variance_buf.data(), rect, w_, filtered_final_buf_.data());
+    const int radius = use_atrous ? ATROUS_RADIUS : NLM_RADIUS;
+    const rect_t rect_ext = {rect.x - radius, rect.y - radius, rect.w + 2 * radius, rect.h + 2 * radius};
 
-    const auto denoise_end = high_resolution_clock::now();
+    const color_rgba_t *input = final_buf_.data(), *variance = filtered_variance_buf_.data(),
+                       *base_color = base_color_buf_.data(), *depth_normals = depth_normals_buf_.data();
+    rect_t input_rect = rect;
+    int input_stride = w_;
 
-    {
-        std::lock_guard<std::mutex> _(mtx_);
-        stats_.time_denoise_us += (unsigned long long)duration<double, std::micro>{denoise_end - denoise_start}.count();
+    if (halo_variance || rect_ext.x < 0 || rect_ext.y < 0 || rect_ext.x + rect_ext.w > w_ ||
+        rect_ext.y + rect_ext.h > h_) {
+        // halo is gathered into separate buffers (with edge pixels repeated outside of image)
+        p.temp_final_buf.resize(rect_ext.w * rect_ext.h);
+        if (!halo_variance) {
+            p.filtered_variance_buf.resize(rect_ext.w * rect_ext.h);
+        }
+        if (use_atrous) {
+            p.temp_base_color_buf.resize(rect_ext.w * rect_ext.h);
+            p.temp_depth_normals_buf.resize(rect_ext.w * rect_ext.h);
+        }
+
+        for (int y = 0; y < rect_ext.h; ++y) {
+            const int yy = std::min(std::max(rect_ext.y + y, 0), h_ - 1);
+            for (int x = 0; x < rect_ext.w; ++x) {
+                const int xx = std::min(std::max(rect_ext.x + x, 0), w_ - 1);
+
+                p.temp_final_buf[y * rect_ext.w + x] = final_buf_[yy * w_ + xx];
+                if (!halo_variance) {
+                    p.filtered_variance_buf[y * rect_ext.w + x] = filtered_variance_buf_[yy * w_ + xx];
+                }
+                if (use_atrous) {
+                    p.temp_base_color_buf[y * rect_ext.w + x] = base_color_buf_[yy * w_ + xx];
+                    p.temp_depth_normals_buf[y * rect_ext.w + x] = depth_normals_buf_[yy * w_ + xx];
+                }
+            }
+        }
+
+        input = p.temp_final_buf.data();
+        variance = halo_variance ? halo_variance : p.filtered_variance_buf.data();
+        base_color = p.temp_base_color_buf.data();
+        depth_normals = p.temp_depth_normals_buf.data();
+        input_rect = rect_t{radius, radius, rect.w, rect.h};
+        input_stride = rect_ext.w;
     }
+
+    if (use_atrous) {
+        NS::ATrousFilter<S>(input, variance, base_color, depth_normals, input_rect, input_stride, ATROUS_ITERATIONS,
+                            rect, w_, filtered_final_buf_.data(), p.denoise_temp_buf);
+    } else {
+        NS::NLMFilter<S, NLM_WINDOW_SIZE, NLM_NEIGHBORHOOD_SIZE>(input, input_rect, input_stride, 1.0f, 0.45f,
+                                                                 variance, rect, w_, filtered_final_buf_.data(),
+                                                                 p.denoise_temp_buf);
+    }
+}
+
+template <int DimX, int DimY> bool Ray::NS::RendererSIMD<DimX, DimY>::ReprojectImage(const SceneBase *scene) {
+    const auto s = dynamic_cast<const Ref::Scene *>(scene);
+    if (!s || !use_temporal_accumulation_ || !has_last_cam_ || int(depth_normals_buf_.size()) != w_ * h_) {
+        return false;
+    }
+
+    const camera_t &old_cam = last_cam_, &new_cam = s->cams_[s->current_cam()._index].cam;
+    if (old_cam.type == Geo || new_cam.type == Geo) {
+        return false;
+    }
+
+    // averaged normals of pixels that cover several surfaces are shorter
+    const float MinNormalLength = 0.9f;
+    // relative distance tolerance used when holes are filled from neighbouring pixels
+    const float MaxDistanceDifference = 0.05f;
+
+    const float k = float(w_) / float(h_);
+
+    // direction through pixel center (lens offset is ignored)
+    auto get_pixel_dir = [&](const camera_t &cam, const int x, const int y, float d[3]) {
+        const float fov_k = std::tan(0.5f * cam.fov * PI / 180.0f) * cam.focus_distance;
+        const float _dx = 2 * fov_k * ((float(x) + 0.5f) / float(w_) + cam.shift[0] / k) - fov_k;
+        const float _dy = 2 * fov_k * (-(float(y) + 0.5f) / float(h_) + cam.shift[1]) + fov_k;
+
+        float len = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            d[i] = k * _dx * cam.side[i] + _dy * cam.up[i] + cam.fwd[i] * cam.focus_distance;
+            len += d[i] * d[i];
+        }
+        len = std::sqrt(len);
+        for (int i = 0; i < 3; ++i) {
+            d[i] /= len;
+        }
+    };
+
+    // projects point of old image onto new image, returns false if it is not visible for the new camera
+    auto reproject_pixel = [&](const int old_index, float &out_x, float &out_y, float &out_dist, float &out_t) {
+        if (sample_count_buf_[0][old_index] + sample_count_buf_[1][old_index] == 0.0f) {
+            return false;
+        }
+
+        const color_rgba_t &dn = depth_normals_buf_[old_index];
+        const float n_len = std::sqrt(dn.v[0] * dn.v[0] + dn.v[1] * dn.v[1] + dn.v[2] * dn.v[2]);
+
+        float d[3];
+        get_pixel_dir(old_cam, old_index % w_, old_index / w_, d);
+
+        float v[3];
+        const bool is_env = (n_len == 0.0f && dn.v[3] == 0.0f);
+        if (is_env) {
+            // environment is infinitely far away, only direction matters
+            UNROLLED_FOR(i, 3, { v[i] = d[i]; })
+        } else {
+            if (n_len < MinNormalLength) {
+                return false;
+            }
+
+            const float dist =
+                old_cam.clip_start / (d[0] * old_cam.fwd[0] + d[1] * old_cam.fwd[1] + d[2] * old_cam.fwd[2]) + dn.v[3];
+
+            float old_side = 0.0f, new_side = 0.0f;
+            UNROLLED_FOR(i, 3, {
+                const float p = old_cam.origin[i] + d[i] * dist;
+                v[i] = p - new_cam.origin[i];
+                old_side += dn.v[i] * d[i];
+                new_side += dn.v[i] * v[i];
+            })
+            // surface is seen from the other side now
+            if ((old_side < 0.0f) != (new_side < 0.0f)) {
+                return false;
+            }
+        }
+
+        const float a = v[0] * new_cam.side[0] + v[1] * new_cam.side[1] + v[2] * new_cam.side[2];
+        const float b = v[0] * new_cam.up[0] + v[1] * new_cam.up[1] + v[2] * new_cam.up[2];
+        const float c = v[0] * new_cam.fwd[0] + v[1] * new_cam.fwd[1] + v[2] * new_cam.fwd[2];
+        if (c <= (is_env ? 0.0f : new_cam.clip_start)) {
+            return false;
+        }
+
+        const float tan_half_fov = std::tan(0.5f * new_cam.fov * PI / 180.0f);
+        out_x = float(w_) * (0.5f * (a / (c * tan_half_fov * k) + 1.0f) - new_cam.shift[0] / k);
+        out_y = float(h_) * (new_cam.shift[1] - 0.5f * (b / (c * tan_half_fov) - 1.0f));
+        if (out_x < 0.0f || out_y < 0.0f || out_x >= float(w_) || out_y >= float(h_)) {
+            return false;
+        }
+
+        if (is_env) {
+            out_dist = std::numeric_limits<float>::max();
+            out_t = 0.0f;
+        } else {
+            out_dist = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            out_t = out_dist - new_cam.clip_start * out_dist / c;
+        }
+
+        return true;
+    };
+
+    reproj_index_.assign(w_ * h_, -1);
+    reproj_dist_.assign(w_ * h_, std::numeric_limits<float>::max());
+
+    // old pixels are splatted into new image, the closest one wins
+    for (int i = 0; i < w_ * h_; ++i) {
+        float x, y, dist, t;
+        if (!reproject_pixel(i, x, y, dist, t)) {
+            continue;
+        }
+
+        const int j = int(y) * w_ + int(x);
+        if (reproj_index_[j] == -1 || dist < reproj_dist_[j]) {
+            reproj_index_[j] = i;
+            reproj_dist_[j] = dist;
+        }
+    }
+
+    // holes (e.g. due to magnification) are filled by continuing mapping of neighbouring pixels
+    reproj_temp_index_ = reproj_index_;
+    for (int y = 0; y < h_; ++y) {
+        for (int x = 0; x < w_; ++x) {
+            if (reproj_index_[y * w_ + x] != -1) {
+                continue;
+            }
+
+            float best_dist = std::numeric_limits<float>::max();
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= w_ || ny >= h_ || reproj_index_[ny * w_ + nx] == -1) {
+                        continue;
+                    }
+
+                    const int src = reproj_index_[ny * w_ + nx];
+                    const int sx = src % w_ - dx, sy = src / w_ - dy;
+                    if (sx < 0 || sy < 0 || sx >= w_ || sy >= h_) {
+                        continue;
+                    }
+
+                    float px, py, dist, t;
+                    if (!reproject_pixel(sy * w_ + sx, px, py, dist, t) || std::abs(px - float(x) - 0.5f) > 1.0f ||
+                        std::abs(py - float(y) - 0.5f) > 1.0f) {
+                        continue;
+                    }
+
+                    // candidate must belong to the same surface
+                    const float neighbour_dist = reproj_dist_[ny * w_ + nx];
+                    if (dist != neighbour_dist &&
+                        std::abs(dist - neighbour_dist) > MaxDistanceDifference * neighbour_dist) {
+                        continue;
+                    }
+
+                    if (dist < best_dist) {
+                        reproj_temp_index_[y * w_ + x] = sy * w_ + sx;
+                        best_dist = dist;
+                    }
+                }
+            }
+        }
+    }
+    std::swap(reproj_index_, reproj_temp_index_);
+
+    // history is gathered into new image
+    for (auto &buf : dual_buf_) {
+        reproj_temp_buf_.resize(w_ * h_);
+        for (int j = 0; j < w_ * h_; ++j) {
+            reproj_temp_buf_[j] = (reproj_index_[j] != -1) ? buf[reproj_index_[j]] : color_rgba_t{};
+        }
+        std::swap(buf, reproj_temp_buf_);
+    }
+    if (int(base_color_buf_.size()) == w_ * h_) {
+        reproj_temp_buf_.resize(w_ * h_);
+        for (int j = 0; j < w_ * h_; ++j) {
+            reproj_temp_buf_[j] = (reproj_index_[j] != -1) ? base_color_buf_[reproj_index_[j]] : color_rgba_t{};
+        }
+        std::swap(base_color_buf_, reproj_temp_buf_);
+    }
+    reproj_temp_buf_.resize(w_ * h_);
+    for (int j = 0; j < w_ * h_; ++j) {
+        const int i = reproj_index_[j];
+
+        float x, y, dist, t;
+        if (i != -1 && reproject_pixel(i, x, y, dist, t)) {
+            // depth is relative to the new camera
+            reproj_temp_buf_[j] = depth_normals_buf_[i];
+            reproj_temp_buf_[j].v[3] = t;
+        } else {
+            reproj_temp_buf_[j] = color_rgba_t{};
+        }
+    }
+    std::swap(depth_normals_buf_, reproj_temp_buf_);
+
+    // history is clamped to limit ghosting and blurring caused by repeated resampling
+    const float max_history = float(std::max(temporal_max_history_, 2));
+    reproj_temp_count_.resize(2 * w_ * h_);
+    for (int j = 0; j < w_ * h_; ++j) {
+        const int i = reproj_index_[j];
+        float c1 = (i != -1) ? sample_count_buf_[0][i] : 0.0f, c2 = (i != -1) ? sample_count_buf_[1][i] : 0.0f;
+        if (c1 + c2 > max_history) {
+            const float scale = max_history / (c1 + c2);
+            c1 = std::floor(c1 * scale);
+            c2 = std::floor(c2 * scale);
+        }
+        reproj_temp_count_[2 * j + 0] = c1;
+        reproj_temp_count_[2 * j + 1] = c2;
+    }
+    for (int j = 0; j < w_ * h_; ++j) {
+        sample_count_buf_[0][j] = reproj_temp_count_[2 * j + 0];
+        sample_count_buf_[1][j] = reproj_temp_count_[2 * j + 1];
+    }
+
+    last_cam_ = new_cam;
+
+    return true;
 }
 
 template <int DimX, int DimY>
@@ -6,12 +6,145 @@
 #include "../Log.h"
 #include "BVHSplit.h"
 #include "CoreRef.h"
+#include "SnapshotRef.h"
 #include "TextureUtilsRef.h"
 #include "Time_.h"
+#include "Utils.h"
 
 #define CLAMP(val, min, max) (val < min ? min : (val > max ? max : val))
 
-Ray::Ref::Scene::Scene(ILog *log, const bool use_wide_bvh) : log_(log), use_wide_bvh_(use_wide_bvh) {}
+namespace Ray {
+namespace Ref {
+// Textures smaller than this are always kept in memory (when out-of-core storage is enabled)
+const int VirtualTextureMinRes = 2048;
+
+// Blue channel of normal map is dropped, z is reconstructed if it does not look like 'flat' normal
+bool NeedsZReconstruction(const uint8_t *data, const int channels, const int res[2]) {
+    for (int i = 0; i < res[0] * res[1]; ++i) {
+        if (data[channels * i + 2] < 250) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Heavy part (conversion, compression) is done without holding the lock, so renderer is not blocked
+template <typename StorageType, typename ColorType>
+int AddToStorage(StorageType &storage, std::shared_timed_mutex &mtx, const ColorType *data, const int res[2],
+                 const bool mips) {
+    typename StorageType::ImgData img = StorageType::Prepare(data, res, mips);
+
+    std::unique_lock<std::shared_timed_mutex> lock(mtx);
+    return storage.Insert(std::move(img));
+}
+
+const char SnapshotSceneMagic[4] = {'R', 'S', 'C', 'N'};
+// should be incremented when snapshot_header_t or order of stored arrays is changed
+const uint32_t SnapshotSceneVersion = 1;
+
+// Scalar part of scene state stored in snapshot
+struct snapshot_header_t {
+    char magic[4];
+    uint32_t version;
+    uint64_t layout_fingerprint;
+    uint32_t use_wide_bvh;
+    uint32_t macro_nodes_root, macro_nodes_count;
+    LightHandle env_map_light;
+    int32_t env_map_qtree_res;
+    uint32_t env_map_qtree_levels;
+    CameraHandle cam_first_free, current_cam;
+    uint64_t tex_dedup_hits;
+    environment_t env; // qtree pointers are restored on load
+};
+
+struct snapshot_tex_hash_t {
+    uint64_t hash;
+    uint32_t handle, _unused;
+};
+
+struct snapshot_tex_ref_t {
+    uint64_t hash;
+    uint32_t handle, ref_count;
+};
+
+// Arrays are stored as raw memory, so snapshot is only usable by build with identical structure layout
+uint64_t SnapshotLayoutFingerprint() {
+    const uint32_t one = 1;
+    uint8_t little_endian;
+    memcpy(&little_endian, &one, 1);
+
+    const uint32_t sizes[] = {uint32_t(sizeof(void *)),
+                              uint32_t(little_endian),
+                              uint32_t(sizeof(snapshot_header_t)),
+                              uint32_t(sizeof(snapshot_tex_hash_t)),
+                              uint32_t(sizeof(snapshot_tex_ref_t)),
+                              uint32_t(sizeof(camera_t)),
+                              uint32_t(sizeof(bvh_node_t)),
+                              uint32_t(sizeof(mbvh_node_t)),
+                              uint32_t(sizeof(tri_accel_t)),
+                              uint32_t(sizeof(mtri_accel_t)),
+                              uint32_t(sizeof(tri_mat_data_t)),
+                              uint32_t(sizeof(vertex_t)),
+                              uint32_t(sizeof(transform_t)),
+                              uint32_t(sizeof(mesh_t)),
+                              uint32_t(sizeof(mesh_instance_t)),
+                              uint32_t(sizeof(material_t)),
+                              uint32_t(sizeof(light_t)),
+                              uint32_t(sizeof(environment_t))};
+    return HashData(sizes, sizeof(sizes));
+}
+
+// Sparse storage is written densely up to the last occupied slot, so handles stay the same after loading
+template <typename T> void WriteSparse(SnapshotWriter &w, const SparseStorage<T> &storage) {
+    std::vector<uint8_t> occupied;
+    std::vector<T> data;
+    for (auto it = storage.cbegin(); it != storage.cend(); ++it) {
+        occupied.resize(it.index() + 1, 0);
+        data.resize(it.index() + 1);
+        occupied[it.index()] = 1;
+        data[it.index()] = *it;
+    }
+    w.WriteArray(occupied);
+    w.WriteArray(data);
+}
+
+template <typename T> bool ReadSparse(SnapshotReader &r, SparseStorage<T> &storage) {
+    assert(storage.empty());
+
+    size_t occupied_count = 0, data_count = 0;
+    const uint8_t *occupied = r.ReadArray<uint8_t>(occupied_count);
+    const T *data = r.ReadArray<T>(data_count);
+    if (!occupied || !data || occupied_count != data_count) {
+        return false;
+    }
+
+    // slots are allocated sequentially in empty storage, then unused ones are released
+    storage.reserve(uint32_t(data_count));
+    for (size_t i = 0; i < data_count; ++i) {
+        const uint32_t index = storage.push(data[i]);
+        assert(index == uint32_t(i));
+        (void)index;
+    }
+    for (size_t i = 0; i < data_count; ++i) {
+        if (!occupied[i]) {
+            storage.erase(uint32_t(i));
+        }
+    }
+    return true;
+}
+} // namespace Ref
+} // namespace Ray
+
+Ray::Ref::Scene::Scene(ILog *log, const bool use_wide_bvh, const bool use_tex_compression,
+                       const char *tex_cache_dir, const size_t tex_cache_budget, const char *bvh_cache_dir)
+    : log_(log), use_wide_bvh_(use_wide_bvh), use_tex_compression_(use_tex_compression) {
+    if (tex_cache_dir) {
+        tex_storage_virtual_.Init(log, tex_cache_dir, tex_cache_budget);
+    }
+    if (bvh_cache_dir) {
+        bvh_cache_.Init(log, bvh_cache_dir);
+    }
+}
 
 Ray::Ref::Scene::~Scene() {
     std::unique_lock<std::shared_timed_mutex> lock(mtx_);
@@ -54,73 +187,419 @@ void Ray::Ref::Scene::SetEnvironment(const environment_desc_t &env) {
 }
 
 Ray::TextureHandle Ray::Ref::Scene::AddTexture(const tex_desc_t &_t) {
-    std::unique_lock<std::shared_timed_mutex> lock(mtx_);
-
     const int res[2] = {_t.w, _t.h};
 
-    bool recostruct_z = false;
+    const bool use_compression = use_tex_compression_ && !_t.force_no_compression;
+    const bool mips = _t.generate_mipmaps;
+
+    const int channels = (_t.format == eTextureFormat::RGBA8888)  ? 4
+                         : (_t.format == eTextureFormat::RGB888) ? 3
+                         : (_t.format == eTextureFormat::RG88)   ? 2
+                                                                 : 1;
+
+    // textures with the same content (and the same storage parameters) share stored image
+    const uint64_t hash = HashData_Fast(_t.data, size_t(res[0]) * res[1] * channels,
+                                        uint64_t(res[0]) | (uint64_t(res[1]) << 24) | (uint64_t(_t.format) << 48) |
+                                            (uint64_t(_t.is_normalmap) << 52) | (uint64_t(mips) << 53) |
+                                            (uint64_t(_t.force_no_compression) << 54));
+    const uint32_t srgb_bit = _t.is_srgb ? TEX_SRGB_BIT : 0;
+
+    const bool recostruct_z = _t.is_normalmap && channels > 2 &&
+                              NeedsZReconstruction(reinterpret_cast<const uint8_t *>(_t.data), channels, res);
+
+    // hash match is confirmed by comparing texels with stored image (scene lock must be held)
+    auto find_existing = [&](uint32_t &out_existing) {
+        const auto it = tex_by_hash_.find(hash);
+        if (it == tex_by_hash_.end() || ((it->second & TEX_RECONSTRUCT_Z_BIT) != 0) != recostruct_z) {
+            return false;
+        }
+        out_existing = it->second;
+        return tex_storages_[it->second >> 28]->Matches(int(it->second & 0x00ffffff),
+                                                        reinterpret_cast<const uint8_t *>(_t.data), channels, res);
+    };
+
+    auto reuse_existing = [&](const uint32_t existing) {
+        ++tex_refs_[existing & ~(TEX_SRGB_BIT | TEX_RECONSTRUCT_Z_BIT)].ref_count;
+        ++tex_dedup_hits_;
+        log_->Info("Ray: Texture reused (storage = %i, %ix%i)", int(existing >> 28), _t.w, _t.h);
+        return TextureHandle{existing | srgb_bit};
+    };
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mtx_);
+        uint32_t existing;
+        if (find_existing(existing)) {
+            return reuse_existing(existing);
+        }
+    }
 
     int storage = -1, index = -1;
-    if (_t.format == eTextureFormat::RGBA8888) {
-        const auto *rgba_data = reinterpret_cast<const color_rgba8_t *>(_t.data);
-        if (!_t.is_normalmap) {
-            storage = 0;
-            index = tex_storage_rgba_.Allocate(rgba_data, res, _t.generate_mipmaps);
-        } else {
-            // TODO: get rid of this allocation
-            std::unique_ptr<color_rg8_t[]> repacked_data(new color_rg8_t[res[0] * res[1]]);
+    if (tex_storage_virtual_.enabled() && std::max(_t.w, _t.h) >= VirtualTextureMinRes) {
+        const auto *data = reinterpret_cast<const uint8_t *>(_t.data);
+
+        TexStorageVirtual::ImgData img;
+        bool prepared = false;
+        if (_t.is_normalmap && channels > 2) {
+            // cache file is written from tightly packed data
+            std::unique_ptr<uint8_t[]> repacked_data(new uint8_t[2 * res[0] * res[1]]);
             for (int i = 0; i < res[0] * res[1]; ++i) {
-                repacked_data[i].v[0] = rgba_data[i].v[0];
-                repacked_data[i].v[1] = rgba_data[i].v[1];
-                recostruct_z |= (rgba_data[i].v[2] < 250);
+                repacked_data[2 * i + 0] = data[channels * i + 0];
+                repacked_data[2 * i + 1] = data[channels * i + 1];
             }
-            storage = 2;
-            index = tex_storage_rg_.Allocate(repacked_data.get(), res, _t.generate_mipmaps);
-        }
-    } else if (_t.format == eTextureFormat::RGB888) {
-        const auto *rgb_data = reinterpret_cast<const color_rgb8_t *>(_t.data);
-        if (!_t.is_normalmap) {
-            storage = 1;
-            index = tex_storage_rgb_.Allocate(rgb_data, res, _t.generate_mipmaps);
+            prepared = tex_storage_virtual_.Prepare(repacked_data.get(), 2, res, mips, img);
         } else {
-            // TODO: get rid of this allocation
-            std::unique_ptr<color_rg8_t[]> repacked_data(new color_rg8_t[res[0] * res[1]]);
-            for (int i = 0; i < res[0] * res[1]; ++i) {
-                repacked_data[i].v[0] = rgb_data[i].v[0];
-                repacked_data[i].v[1] = rgb_data[i].v[1];
-                recostruct_z |= (rgb_data[i].v[2] < 250);
-            }
-            storage = 2;
-            index = tex_storage_rg_.Allocate(repacked_data.get(), res, _t.generate_mipmaps);
+            prepared = tex_storage_virtual_.Prepare(data, channels, res, mips, img);
+        }
+        if (prepared) {
+            std::unique_lock<std::shared_timed_mutex> lock(mtx_);
+            index = tex_storage_virtual_.Insert(std::move(img));
+            storage = 7;
         }
-    } else if (_t.format == eTextureFormat::RG88) {
-        storage = 2;
-        index = tex_storage_rg_.Allocate(reinterpret_cast<const color_rg8_t *>(_t.data), res, _t.generate_mipmaps);
-    } else if (_t.format == eTextureFormat::R8) {
-        storage = 3;
-        index = tex_storage_r_.Allocate(reinterpret_cast<const color_r8_t *>(_t.data), res, _t.generate_mipmaps);
     }
 
     if (storage == -1) {
-        return InvalidTextureHandle;
+        // texture is kept in memory if it is small or out-of-core storage failed (e.g. cache dir is not writable)
+        if (_t.format == eTextureFormat::RGBA8888) {
+            const auto *rgba_data = reinterpret_cast<const color_rgba8_t *>(_t.data);
+            if (!_t.is_normalmap) {
+                storage = 0;
+                index = AddToStorage(tex_storage_rgba_, mtx_, rgba_data, res, mips);
+            } else if (use_compression) {
+                // first two channels are taken directly from source data
+                storage = 6;
+                index = AddToStorage(tex_storage_bc5_, mtx_, rgba_data, res, mips);
+            } else {
+                storage = 2;
+                index = AddToStorage(tex_storage_rg_, mtx_, rgba_data, res, mips);
+            }
+        } else if (_t.format == eTextureFormat::RGB888) {
+            const auto *rgb_data = reinterpret_cast<const color_rgb8_t *>(_t.data);
+            if (!_t.is_normalmap) {
+                if (use_compression) {
+                    // stored as YCoCg internally, converted back to RGB during block decoding
+                    storage = 4;
+                    index = AddToStorage(tex_storage_bc3_, mtx_, rgb_data, res, mips);
+                } else {
+                    storage = 1;
+                    index = AddToStorage(tex_storage_rgb_, mtx_, rgb_data, res, mips);
+                }
+            } else if (use_compression) {
+                storage = 6;
+                index = AddToStorage(tex_storage_bc5_, mtx_, rgb_data, res, mips);
+            } else {
+                storage = 2;
+                index = AddToStorage(tex_storage_rg_, mtx_, rgb_data, res, mips);
+            }
+        } else if (_t.format == eTextureFormat::RG88) {
+            const auto *rg_data = reinterpret_cast<const color_rg8_t *>(_t.data);
+            if (use_compression) {
+                storage = 6;
+                index = AddToStorage(tex_storage_bc5_, mtx_, rg_data, res, mips);
+            } else {
+                storage = 2;
+                index = AddToStorage(tex_storage_rg_, mtx_, rg_data, res, mips);
+            }
+        } else if (_t.format == eTextureFormat::R8) {
+            const auto *r_data = reinterpret_cast<const color_r8_t *>(_t.data);
+            if (use_compression) {
+                storage = 5;
+                index = AddToStorage(tex_storage_bc4_, mtx_, r_data, res, mips);
+            } else {
+                storage = 3;
+                index = AddToStorage(tex_storage_r_, mtx_, r_data, res, mips);
+            }
+        }
     }
 
-    log_->Info("Ray: Texture loaded (storage = %i, %ix%i)", storage, _t.w, _t.h);
-    log_->Info("Ray: Storages are (RGBA[%i], RGB[%i], RG[%i], R[%i])", tex_storage_rgba_.img_count(),
-               tex_storage_rgb_.img_count(), tex_storage_rg_.img_count(), tex_storage_r_.img_count());
+    if (storage == -1 || index == -1) {
+        return InvalidTextureHandle;
+    }
 
     uint32_t ret = 0;
 
     ret |= uint32_t(storage) << 28;
-    if (_t.is_srgb) {
-        ret |= TEX_SRGB_BIT;
-    }
     if (recostruct_z) {
         ret |= TEX_RECONSTRUCT_Z_BIT;
     }
     ret |= index;
 
-    return TextureHandle{ret};
+    std::unique_lock<std::shared_timed_mutex> lock(mtx_);
+
+    uint32_t existing;
+    if (find_existing(existing)) {
+        // the same texture was added concurrently
+        tex_storages_[storage]->Free(index);
+        return reuse_existing(existing);
+    }
+
+    // on hash collision with different content the first image stays shareable
+    tex_by_hash_.emplace(hash, ret);
+    tex_refs_[ret & ~TEX_RECONSTRUCT_Z_BIT] = {hash, 1};
+
+    log_->Info("Ray: Texture loaded (storage = %i, %ix%i)", storage, _t.w, _t.h);
+    log_->Info("Ray: Storages are (RGBA[%i], RGB[%i], RG[%i], R[%i], BC3[%i], BC4[%i], BC5[%i], Virtual[%i])",
+               tex_storage_rgba_.img_count(), tex_storage_rgb_.img_count(), tex_storage_rg_.img_count(),
+               tex_storage_r_.img_count(), tex_storage_bc3_.img_count(), tex_storage_bc4_.img_count(),
+               tex_storage_bc5_.img_count(), tex_storage_virtual_.img_count());
+
+    return TextureHandle{ret | srgb_bit};
+}
+
+void Ray::Ref::Scene::RemoveTexture_nolock(const TextureHandle t) {
+    const int storage = int(t._index >> 28), index = int(t._index & 0x00ffffff);
+
+    const auto it = tex_refs_.find((uint32_t(storage) << 28) | uint32_t(index));
+    if (it != tex_refs_.end()) {
+        if (--it->second.ref_count) {
+            // image is still referenced by other handles
+            return;
+        }
+        const auto hash_it = tex_by_hash_.find(it->second.hash);
+        if (hash_it != tex_by_hash_.end() && (hash_it->second & ~TEX_RECONSTRUCT_Z_BIT) == it->first) {
+            tex_by_hash_.erase(hash_it);
+        }
+        tex_refs_.erase(it);
+    }
+
+    tex_storages_[storage]->Free(index);
+}
+
+void Ray::Ref::Scene::GetTextureStats(tex_stats_t &st) const {
+    std::shared_lock<std::shared_timed_mutex> lock(mtx_);
+
+    st = {};
+    for (const auto &ref : tex_refs_) {
+        const size_t img_size = tex_storages_[ref.first >> 28]->mem_size(int(ref.first & 0x00ffffff));
+
+        st.textures_count += ref.second.ref_count;
+        ++st.images_count;
+        st.images_bytes += img_size;
+        st.dedup_saved_bytes += (ref.second.ref_count - 1) * img_size;
+    }
+    st.dedup_hits = tex_dedup_hits_;
+}
+
+bool Ray::Ref::Scene::SaveSnapshot(const char *file_name) const {
+    std::shared_lock<std::shared_timed_mutex> lock(mtx_);
+
+    if (tex_storage_virtual_.img_count()) {
+        log_->Error("Ray: Scene with out-of-core textures can not be saved to snapshot");
+        return false;
+    }
+
+    SnapshotWriter w(file_name);
+    if (!w.ok()) {
+        log_->Error("Ray: Failed to open %s", file_name);
+        return false;
+    }
+
+    snapshot_header_t header = {};
+    memcpy(header.magic, SnapshotSceneMagic, 4);
+    header.version = SnapshotSceneVersion;
+    header.layout_fingerprint = SnapshotLayoutFingerprint();
+    header.use_wide_bvh = use_wide_bvh_ ? 1 : 0;
+    header.macro_nodes_root = macro_nodes_root_;
+    header.macro_nodes_count = macro_nodes_count_;
+    header.env_map_light = env_map_light_;
+    header.env_map_qtree_res = env_map_qtree_.res;
+    header.env_map_qtree_levels = uint32_t(env_map_qtree_.mips.size());
+    header.cam_first_free = cam_first_free_;
+    header.current_cam = current_cam_;
+    header.tex_dedup_hits = tex_dedup_hits_;
+    header.env = env_;
+    for (const float *&mip : header.env.qtree_mips) {
+        mip = nullptr;
+    }
+    w.Write(header);
+
+    w.WriteArray(cams_);
+
+    w.WriteArray(nodes_);
+    w.WriteArray(mnodes_);
+    w.WriteArray(tris_);
+    w.WriteArray(tri_indices_);
+    w.WriteArray(mtris_);
+    w.WriteArray(tri_materials_);
+    w.WriteArray(mi_indices_);
+    w.WriteArray(vertices_);
+    w.WriteArray(vtx_indices_);
+    w.WriteArray(li_indices_);
+    w.WriteArray(visible_lights_);
+    w.WriteArray(blocker_lights_);
+
+    WriteSparse(w, transforms_);
+    WriteSparse(w, meshes_);
+    WriteSparse(w, mesh_instances_);
+    WriteSparse(w, materials_);
+    WriteSparse(w, lights_);
+
+    for (const aligned_vector<float, 16> &mip : env_map_qtree_.mips) {
+        w.WriteArray(mip);
+    }
+
+    std::vector<snapshot_tex_hash_t> tex_hashes;
+    for (const auto &el : tex_by_hash_) {
+        tex_hashes.push_back({el.first, el.second, 0});
+    }
+    w.WriteArray(tex_hashes);
+
+    std::vector<snapshot_tex_ref_t> tex_refs;
+    for (const auto &el : tex_refs_) {
+        tex_refs.push_back({el.second.hash, el.first, el.second.ref_count});
+    }
+    w.WriteArray(tex_refs);
+
+    tex_storage_rgba_.Save(w);
+    tex_storage_rgb_.Save(w);
+    tex_storage_rg_.Save(w);
+    tex_storage_r_.Save(w);
+    tex_storage_bc3_.Save(w);
+    tex_storage_bc4_.Save(w);
+    tex_storage_bc5_.Save(w);
+
+    if (!w.Finish()) {
+        log_->Error("Ray: Failed to write %s", file_name);
+        return false;
+    }
+
+    return true;
+}
+
+bool Ray::Ref::Scene::LoadSnapshot(const char *file_name) {
+    SnapshotReader r(file_name);
+    if (!r.ok()) {
+        log_->Error("Ray: Failed to open snapshot %s", file_name);
+        return false;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lock(mtx_);
+
+    const int tex_count = tex_storage_rgba_.img_count() + tex_storage_rgb_.img_count() +
+                          tex_storage_rg_.img_count() + tex_storage_r_.img_count() + tex_storage_bc3_.img_count() +
+                          tex_storage_bc4_.img_count() + tex_storage_bc5_.img_count() +
+                          tex_storage_virtual_.img_count();
+    if (!meshes_.empty() || !mesh_instances_.empty() || !transforms_.empty() || !materials_.empty() ||
+        !lights_.empty() || !cams_.empty() || tex_count) {
+        log_->Error("Ray: Snapshot can only be loaded into empty scene");
+        return false;
+    }
+
+    snapshot_header_t header;
+    if (!r.Read(header)) {
+        log_->Error("Ray: Invalid snapshot %s", file_name);
+        return false;
+    }
+    if (memcmp(header.magic, SnapshotSceneMagic, 4) != 0 || header.version != SnapshotSceneVersion) {
+        log_->Error("Ray: Snapshot %s has unsupported format version", file_name);
+        return false;
+    }
+    if (header.layout_fingerprint != SnapshotLayoutFingerprint()) {
+        log_->Error("Ray: Snapshot %s was created by incompatible build", file_name);
+        return false;
+    }
+    if (header.use_wide_bvh != (use_wide_bvh_ ? 1u : 0u)) {
+        log_->Error("Ray: Snapshot %s was created with different BVH settings", file_name);
+        return false;
+    }
+    if (header.env_map_qtree_levels > countof(env_.qtree_mips)) {
+        log_->Error("Ray: Invalid snapshot %s", file_name);
+        return false;
+    }
+
+    bool ok = r.ReadArray(cams_);
+
+    ok = ok && r.ReadArray(nodes_) && r.ReadArray(mnodes_) && r.ReadArray(tris_) && r.ReadArray(tri_indices_) &&
+         r.ReadArray(mtris_) && r.ReadArray(tri_materials_) && r.ReadArray(mi_indices_) && r.ReadArray(vertices_) &&
+         r.ReadArray(vtx_indices_) && r.ReadArray(li_indices_) && r.ReadArray(visible_lights_) &&
+         r.ReadArray(blocker_lights_);
+
+    ok = ok && ReadSparse(r, transforms_) && ReadSparse(r, meshes_) && ReadSparse(r, mesh_instances_) &&
+         ReadSparse(r, materials_) && ReadSparse(r, lights_);
+
+    env_map_qtree_ = {};
+    for (uint32_t i = 0; i < header.env_map_qtree_levels && ok; ++i) {
+        env_map_qtree_.mips.emplace_back();
+        ok = r.ReadArray(env_map_qtree_.mips.back());
+    }
+
+    size_t tex_hashes_count = 0, tex_refs_count = 0;
+    const snapshot_tex_hash_t *tex_hashes = ok ? r.ReadArray<snapshot_tex_hash_t>(tex_hashes_count) : nullptr;
+    const snapshot_tex_ref_t *tex_refs = tex_hashes ? r.ReadArray<snapshot_tex_ref_t>(tex_refs_count) : nullptr;
+    ok = tex_refs != nullptr;
+    for (size_t i = 0; i < tex_hashes_count && ok; ++i) {
+        tex_by_hash_[tex_hashes[i].hash] = tex_hashes[i].handle;
+    }
+    for (size_t i = 0; i < tex_refs_count && ok; ++i) {
+        tex_refs_[tex_refs[i].handle] = {tex_refs[i].hash, tex_refs[i].ref_count};
+    }
+
+    ok = ok && tex_storage_rgba_.Load(r) && tex_storage_rgb_.Load(r) && tex_storage_rg_.Load(r) &&
+         tex_storage_r_.Load(r) && tex_storage_bc3_.Load(r) && tex_storage_bc4_.Load(r) &&
+         tex_storage_bc5_.Load(r);
+
+    if (!ok) {
+        log_->Error("Ray: Failed to read snapshot %s", file_name);
+        Clear_nolock();
+        return false;
+    }
+
+    macro_nodes_root_ = header.macro_nodes_root;
+    macro_nodes_count_ = header.macro_nodes_count;
+    env_map_light_ = header.env_map_light;
+    env_map_qtree_.res = header.env_map_qtree_res;
+    cam_first_free_ = header.cam_first_free;
+    current_cam_ = header.current_cam;
+    tex_dedup_hits_ = header.tex_dedup_hits;
+
+    env_ = header.env;
+    env_.qtree_levels = int(env_map_qtree_.mips.size());
+    for (int i = 0; i < env_.qtree_levels; ++i) {
+        env_.qtree_mips[i] = env_map_qtree_.mips[i].data();
+    }
+
+    return true;
+}
+
+void Ray::Ref::Scene::Clear_nolock() {
+    cams_.clear();
+    cam_first_free_ = current_cam_ = InvalidCameraHandle;
+
+    nodes_.clear();
+    mnodes_.clear();
+    tris_.clear();
+    tri_indices_.clear();
+    mtris_.clear();
+    tri_materials_.clear();
+    mi_indices_.clear();
+    vertices_.clear();
+    vtx_indices_.clear();
+    li_indices_.clear();
+    visible_lights_.clear();
+    blocker_lights_.clear();
+
+    transforms_.clear();
+    meshes_.clear();
+    mesh_instances_.clear();
+    materials_.clear();
+    lights_.clear();
+
+    tex_by_hash_.clear();
+    tex_refs_.clear();
+    tex_dedup_hits_ = 0;
+
+    tex_storage_rgba_ = {};
+    tex_storage_rgb_ = {};
+    tex_storage_rg_ = {};
+    tex_storage_r_ = {};
+    tex_storage_bc3_ = {};
+    tex_storage_bc4_ = {};
+    tex_storage_bc5_ = {};
+
+    env_map_qtree_ = {};
+    env_.qtree_levels = 0;
+    env_map_light_ = InvalidLightHandle;
+    macro_nodes_root_ = 0xffffffff;
+    macro_nodes_count_ = 0;
 }
 
 Ray::MaterialHandle Ray::Ref::Scene::AddMaterial_nolock(const shading_node_desc_t &m) {
@@ -259,29 +738,89 @@ Ray::MeshHandle Ray::Ref::Scene::AddMesh(const mesh_desc_t &_m) {
     s.allow_spatial_splits = _m.allow_spatial_splits;
     s.use_fast_bvh_build = _m.use_fast_bvh_build;
 
+    const char *mesh_name = _m.name ? _m.name : "(unknown)";
+
     const uint64_t t1 = Ray::GetTimeMs();
 
+    // Acceleration structures are taken from cache or built without holding the lock
+    const uint64_t cache_key = bvh_cache_.enabled() ? BVHCache::GetKey(_m, s, use_wide_bvh_) : 0;
+
+    BVHCache::Entry cached;
     std::vector<bvh_node_t> temp_nodes;
+    aligned_vector<mbvh_node_t> temp_mnodes;
     aligned_vector<tri_accel_t> temp_tris;
     aligned_vector<mtri_accel_t> temp_mtris;
     std::vector<uint32_t> temp_tri_indices;
 
-    PreprocessMesh(_m.vtx_attrs, {_m.vtx_indices, _m.vtx_indices_count}, _m.layout, _m.base_vertex, s, temp_nodes,
-                   temp_tris, temp_tri_indices, temp_mtris);
+    bvh_data_t built;
+    const bvh_data_t *bvh = &built;
 
-    log_->Info("Ray: Mesh \'%s\' preprocessed in %lldms", _m.name ? _m.name : "(unknown)", (Ray::GetTimeMs() - t1));
+    if (bvh_cache_.enabled() && bvh_cache_.Load(cache_key, cached)) {
+        bvh = &cached;
+        log_->Info("Ray: Mesh \'%s\' BVH loaded from cache in %lldms", mesh_name, (Ray::GetTimeMs() - t1));
+    } else {
+        PreprocessMesh(_m.vtx_attrs, {_m.vtx_indices, _m.vtx_indices_count}, _m.layout, _m.base_vertex, s, temp_nodes,
+                       temp_tris, temp_tri_indices, temp_mtris);
+
+        log_->Info("Ray: Mesh \'%s\' preprocessed in %lldms", mesh_name, (Ray::GetTimeMs() - t1));
+
+        memcpy(built.bbox_min, temp_nodes[0].bbox_min, 3 * sizeof(float));
+        memcpy(built.bbox_max, temp_nodes[0].bbox_max, 3 * sizeof(float));
+
+        if (use_wide_bvh_) {
+            const uint64_t t2 = Ray::GetTimeMs();
+
+            FlattenBVH_Recursive(temp_nodes.data(), 0, 0xffffffff, temp_mnodes);
+            built.mnodes = temp_mnodes.data();
+            built.mnodes_count = temp_mnodes.size();
+
+            log_->Info("Ray: Mesh \'%s\' BVH flattened in %lldms", mesh_name, (Ray::GetTimeMs() - t2));
+        } else {
+            built.nodes = temp_nodes.data();
+            built.nodes_count = temp_nodes.size();
+        }
+
+        built.tris = temp_tris.data();
+        built.tris_count = temp_tris.size();
+        built.mtris = temp_mtris.data();
+        built.mtris_count = temp_mtris.size();
+        built.tri_indices = temp_tri_indices.data();
+        built.tri_indices_count = temp_tri_indices.size();
+
+        if (bvh_cache_.enabled()) {
+            bvh_cache_.Save(cache_key, built);
+        }
+    }
 
     std::unique_lock<std::shared_timed_mutex> lock(mtx_);
 
     mesh_t m;
-    m.node_index = uint32_t(nodes_.size());
-    m.node_count = uint32_t(temp_nodes.size());
 
-    { // Apply required offsets
-        const uint32_t nodes_offset = uint32_t(nodes_.size());
-        const uint32_t tris_indices_offset = uint32_t(tri_indices_.size());
+    // Append structures applying required offsets
+    const uint32_t tris_indices_offset = uint32_t(tri_indices_.size());
+    if (use_wide_bvh_) {
+        const auto nodes_offset = uint32_t(mnodes_.size());
+        mnodes_.insert(mnodes_.end(), bvh->mnodes, bvh->mnodes + bvh->mnodes_count);
+        for (size_t i = nodes_offset; i < mnodes_.size(); ++i) {
+            mbvh_node_t &n = mnodes_[i];
+            if (n.child[0] & LEAF_NODE_BIT) {
+                n.child[0] += tris_indices_offset;
+            } else {
+                for (uint32_t &child : n.child) {
+                    if (child != 0x7fffffff) {
+                        child += nodes_offset;
+                    }
+                }
+            }
+        }
 
-        for (bvh_node_t &n : temp_nodes) {
+        m.node_index = nodes_offset;
+        m.node_count = uint32_t(bvh->mnodes_count);
+    } else {
+        const auto nodes_offset = uint32_t(nodes_.size());
+        nodes_.insert(nodes_.end(), bvh->nodes, bvh->nodes + bvh->nodes_count);
+        for (size_t i = nodes_offset; i < nodes_.size(); ++i) {
+            bvh_node_t &n = nodes_[i];
             if (n.prim_index & LEAF_NODE_BIT) {
                 n.prim_index += tris_indices_offset;
             } else {
@@ -290,33 +829,21 @@ Ray::MeshHandle Ray::Ref::Scene::AddMesh(const mesh_desc_t &_m) {
             }
         }
 
-        const uint32_t tris_offset = uint32_t(tri_materials_.size());
-        for (uint32_t &tri_index : temp_tri_indices) {
-            tri_index += tris_offset;
-        }
+        m.node_index = nodes_offset;
+        m.node_count = uint32_t(bvh->nodes_count);
     }
 
-    tris_.insert(tris_.end(), temp_tris.begin(), temp_tris.end());
-    mtris_.insert(mtris_.end(), temp_mtris.begin(), temp_mtris.end());
-    tri_indices_.insert(tri_indices_.end(), temp_tri_indices.begin(), temp_tri_indices.end());
-
-    memcpy(m.bbox_min, temp_nodes[0].bbox_min, 3 * sizeof(float));
-    memcpy(m.bbox_max, temp_nodes[0].bbox_max, 3 * sizeof(float));
-
-    if (use_wide_bvh_) {
-        const uint64_t t2 = Ray::GetTimeMs();
-
-        const auto before_count = uint32_t(mnodes_.size());
-        const uint32_t new_root = FlattenBVH_Recursive(temp_nodes.data(), m.node_index, 0xffffffff, mnodes_);
+    const uint32_t tris_offset = uint32_t(tri_materials_.size());
+    tri_indices_.insert(tri_indices_.end(), bvh->tri_indices, bvh->tri_indices + bvh->tri_indices_count);
+    for (size_t i = tris_indices_offset; i < tri_indices_.size(); ++i) {
+        tri_indices_[i] += tris_offset;
+    }
 
-        m.node_index = new_root;
-        m.node_count = uint32_t(mnodes_.size() - before_count);
+    tris_.insert(tris_.end(), bvh->tris, bvh->tris + bvh->tris_count);
+    mtris_.insert(mtris_.end(), bvh->mtris, bvh->mtris + bvh->mtris_count);
 
-        log_->Info("Ray: Mesh \'%s\' BVH flattened in %lldms", _m.name ? _m.name : "(unknown)",
-                   (Ray::GetTimeMs() - t2));
-    } else {
-        nodes_.insert(nodes_.end(), temp_nodes.begin(), temp_nodes.end());
-    }
+    memcpy(m.bbox_min, bvh->bbox_min, 3 * sizeof(float));
+    memcpy(m.bbox_max, bvh->bbox_max, 3 * sizeof(float));
 
     const auto tri_materials_start = uint32_t(tri_materials_.size());
     tri_materials_.resize(tri_materials_start + (_m.vtx_indices_count / 3));
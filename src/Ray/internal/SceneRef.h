@@ -1,12 +1,15 @@
 #pragma once
 
+#include <unordered_map>
 #include <vector>
 
 #include "../SceneBase.h"
+#include "BVHCacheRef.h"
 #include "CoreRef.h"
 #include "SmallVector.h"
 #include "SparseStorage.h"
 #include "TextureStorageRef.h"
+#include "TextureStorageVirtualRef.h"
 
 namespace Ray {
 namespace Sse2 {
@@ -45,7 +48,7 @@ class Scene : public SceneBase {
 
     ILog *log_;
 
-    bool use_wide_bvh_;
+    bool use_wide_bvh_, use_tex_compression_;
 
     std::vector<bvh_node_t> nodes_;
     aligned_vector<mbvh_node_t> mnodes_;
@@ -66,8 +69,23 @@ class Scene : public SceneBase {
     TexStorageRGB tex_storage_rgb_;
     TexStorageRG tex_storage_rg_;
     TexStorageR tex_storage_r_;
-
-    TexStorageBase *tex_storages_[4] = {&tex_storage_rgba_, &tex_storage_rgb_, &tex_storage_rg_, &tex_storage_r_};
+    TexStorageBC3 tex_storage_bc3_;
+    TexStorageBC4 tex_storage_bc4_;
+    TexStorageBC5 tex_storage_bc5_;
+    TexStorageVirtual tex_storage_virtual_;
+
+    TexStorageBase *tex_storages_[8] = {&tex_storage_rgba_, &tex_storage_rgb_, &tex_storage_rg_,
+                                        &tex_storage_r_,    &tex_storage_bc3_, &tex_storage_bc4_,
+                                        &tex_storage_bc5_,  &tex_storage_virtual_};
+
+    // identical textures share stored image, (storage << 28) | index -> reference
+    struct tex_ref_t {
+        uint64_t hash;
+        uint32_t ref_count;
+    };
+    std::unordered_map<uint64_t, uint32_t> tex_by_hash_; // content hash -> texture handle (without sRGB flag)
+    std::unordered_map<uint32_t, tex_ref_t> tex_refs_;
+    unsigned long long tex_dedup_hits_ = 0;
 
     SparseStorage<light_t> lights_;
     std::vector<uint32_t> li_indices_;     // compacted list of all lights
@@ -83,6 +101,9 @@ class Scene : public SceneBase {
 
     uint32_t macro_nodes_root_ = 0xffffffff, macro_nodes_count_ = 0;
 
+    BVHCache bvh_cache_;
+
+    void RemoveTexture_nolock(TextureHandle t);
     void RemoveMesh_nolock(MeshHandle m);
     void RemoveMeshInstance_nolock(MeshInstanceHandle);
     void RemoveLight_nolock(LightHandle l);
@@ -91,12 +112,14 @@ class Scene : public SceneBase {
     void RebuildTLAS_nolock();
 
     void PrepareEnvMapQTree_nolock();
+    void Clear_nolock();
 
     MaterialHandle AddMaterial_nolock(const shading_node_desc_t &m);
     void SetMeshInstanceTransform_nolock(MeshInstanceHandle mi, const float *xform);
 
   public:
-    Scene(ILog *log, bool use_wide_bvh);
+    Scene(ILog *log, bool use_wide_bvh, bool use_tex_compression, const char *tex_cache_dir = nullptr,
+          size_t tex_cache_budget = 0, const char *bvh_cache_dir = nullptr);
     ~Scene() override;
 
     void GetEnvironment(environment_desc_t &env) override;
@@ -105,7 +128,7 @@ class Scene : public SceneBase {
     TextureHandle AddTexture(const tex_desc_t &t) override;
     void RemoveTexture(const TextureHandle t) override {
         std::unique_lock<std::shared_timed_mutex> lock(mtx_);
-        tex_storages_[t._index >> 24]->Free(t._index & 0x00ffffff);
+        RemoveTexture_nolock(t);
     }
 
     MaterialHandle AddMaterial(const shading_node_desc_t &m) override {
@@ -155,6 +178,11 @@ class Scene : public SceneBase {
         std::shared_lock<std::shared_timed_mutex> lock(mtx_);
         return use_wide_bvh_ ? uint32_t(mnodes_.size()) : uint32_t(nodes_.size());
     }
+
+    void GetTextureStats(tex_stats_t &st) const override;
+
+    bool SaveSnapshot(const char *file_name) const override;
+    bool LoadSnapshot(const char *file_name) override;
 };
 } // namespace Ref
 } // namespace Ray
\ No newline at end of file
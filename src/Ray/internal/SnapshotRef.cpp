@@ -0,0 +1,92 @@
+#include "SnapshotRef.h"
+
+#include <cstring>
+
+#include <algorithm>
+
+#include "Utils.h"
+
+namespace Ray {
+namespace Ref {
+const char SnapshotMagic[4] = {'R', 'S', 'N', 'P'};
+const uint32_t SnapshotVersion = 1;
+
+// chunk header occupies whole alignment block
+struct snapshot_chunk_t {
+    uint64_t size;
+    uint8_t _padding[SnapshotAlignment - sizeof(uint64_t)];
+};
+static_assert(sizeof(snapshot_chunk_t) == SnapshotAlignment, "!");
+} // namespace Ref
+} // namespace Ray
+
+Ray::Ref::SnapshotWriter::SnapshotWriter(const char *file_name) : out_file_(file_name, std::ios::binary) {
+    char header[SnapshotAlignment] = {};
+    memcpy(header, SnapshotMagic, 4);
+    memcpy(header + 4, &SnapshotVersion, sizeof(uint32_t));
+    out_file_.write(header, sizeof(header));
+}
+
+void Ray::Ref::SnapshotWriter::WriteChunk(const void *data, const size_t size) {
+    snapshot_chunk_t chunk = {};
+    chunk.size = size;
+    out_file_.write(reinterpret_cast<const char *>(&chunk), sizeof(snapshot_chunk_t));
+    if (size) {
+        out_file_.write(reinterpret_cast<const char *>(data), std::streamsize(size));
+    }
+
+    const char padding[SnapshotAlignment] = {};
+    const size_t padding_size = (SnapshotAlignment - size % SnapshotAlignment) % SnapshotAlignment;
+    out_file_.write(padding, std::streamsize(padding_size));
+}
+
+bool Ray::Ref::SnapshotWriter::Finish() {
+    out_file_.close();
+    return bool(out_file_);
+}
+
+Ray::Ref::SnapshotReader::SnapshotReader(const char *file_name) {
+    mapped_data_ = MapFile(file_name, mapped_size_);
+    if (!mapped_data_) {
+        return;
+    }
+
+    uint32_t version = 0;
+    if (mapped_size_ >= SnapshotAlignment) {
+        memcpy(&version, mapped_data_ + 4, sizeof(uint32_t));
+    }
+    if (mapped_size_ < SnapshotAlignment || memcmp(mapped_data_, SnapshotMagic, 4) != 0 ||
+        version != SnapshotVersion) {
+        error_ = true;
+        return;
+    }
+
+    pos_ = SnapshotAlignment;
+}
+
+Ray::Ref::SnapshotReader::~SnapshotReader() {
+    if (mapped_data_) {
+        UnmapFile(mapped_data_, mapped_size_);
+    }
+}
+
+const uint8_t *Ray::Ref::SnapshotReader::ReadChunk(size_t &out_size) {
+    if (!ok() || mapped_size_ - pos_ < sizeof(snapshot_chunk_t)) {
+        error_ = true;
+        return nullptr;
+    }
+
+    snapshot_chunk_t chunk;
+    memcpy(&chunk, mapped_data_ + pos_, sizeof(snapshot_chunk_t));
+
+    const size_t data_pos = pos_ + sizeof(snapshot_chunk_t);
+    if (chunk.size > mapped_size_ - data_pos) {
+        error_ = true;
+        return nullptr;
+    }
+
+    out_size = size_t(chunk.size);
+    pos_ = std::min(data_pos + SnapshotAlignment * ((out_size + SnapshotAlignment - 1) / SnapshotAlignment),
+                    mapped_size_);
+    return mapped_data_ + data_pos;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+namespace Ray {
+namespace Ref {
+// Snapshot file is a sequence of chunks, each chunk is prefixed with its size and its data starts at 64-byte aligned
+// offset, so arrays can be used directly from mapped file. Chunks are written and read back in the same order.
+const uint32_t SnapshotAlignment = 64;
+
+class SnapshotWriter {
+    std::ofstream out_file_;
+
+  public:
+    explicit SnapshotWriter(const char *file_name);
+
+    bool ok() const { return bool(out_file_); }
+
+    void WriteChunk(const void *data, size_t size);
+
+    template <typename T> void Write(const T &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "!");
+        WriteChunk(&v, sizeof(T));
+    }
+
+    template <typename T, typename Alloc> void WriteArray(const std::vector<T, Alloc> &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "!");
+        WriteChunk(v.data(), v.size() * sizeof(T));
+    }
+
+    // Returns false if any of writes failed
+    bool Finish();
+};
+
+class SnapshotReader {
+    const uint8_t *mapped_data_ = nullptr;
+    size_t mapped_size_ = 0, pos_ = 0;
+    bool error_ = false;
+
+  public:
+    explicit SnapshotReader(const char *file_name);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader &rhs) = delete;
+    SnapshotReader &operator=(const SnapshotReader &rhs) = delete;
+
+    // Reading past the end or chunk of unexpected size puts reader in error state
+    bool ok() const { return mapped_data_ && !error_; }
+
+    // Returns pointer to next chunk data inside of mapped file (valid while reader is alive)
+    const uint8_t *ReadChunk(size_t &out_size);
+
+    template <typename T> bool Read(T &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "!");
+        size_t size = 0;
+        const uint8_t *data = ReadChunk(size);
+        if (!data || size != sizeof(T)) {
+            error_ = true;
+            return false;
+        }
+        memcpy(&v, data, sizeof(T));
+        return true;
+    }
+
+    template <typename T> const T *ReadArray(size_t &out_count) {
+        static_assert(std::is_trivially_copyable<T>::value, "!");
+        size_t size = 0;
+        const uint8_t *data = ReadChunk(size);
+        if (!data || (size % sizeof(T)) != 0) {
+            error_ = true;
+            return nullptr;
+        }
+        out_count = size / sizeof(T);
+        return reinterpret_cast<const T *>(data);
+    }
+
+    template <typename T, typename Alloc> bool ReadArray(std::vector<T, Alloc> &v) {
+        size_t count = 0;
+        const T *data = ReadArray<T>(count);
+        if (!data) {
+            return false;
+        }
+        v.assign(data, data + count);
+        return true;
+    }
+};
+} // namespace Ref
+} // namespace Ray
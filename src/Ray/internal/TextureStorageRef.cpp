@@ -3,6 +3,27 @@
 #include <cstring>
 
 #include <algorithm> // for std::max
+#include <atomic>
+
+#include "SnapshotRef.h"
+#include "Utils.h"
+
+namespace Ray {
+namespace Ref {
+// Fixed parts of image descriptions stored in snapshot
+struct snapshot_swizzled_img_t {
+    int res[NUM_MIP_LEVELS][2], tile_y_stride[NUM_MIP_LEVELS];
+    int lod_offsets[NUM_MIP_LEVELS];
+    uint64_t data_size; // zero for free slot
+};
+
+struct snapshot_bcn_img_t {
+    int res[NUM_MIP_LEVELS][2], res_in_blocks[NUM_MIP_LEVELS][2];
+    int lod_offsets[NUM_MIP_LEVELS];
+    uint64_t data_size; // zero for free slot
+};
+} // namespace Ref
+} // namespace Ray
 
 template <typename T, int N>
 int Ray::Ref::TexStorageLinear<T, N>::Allocate(const ColorType data[], const int _res[2], const bool mips) {
@@ -271,17 +292,56 @@ template class Ray::Ref::TexStorageTiled<uint8_t, 1>;
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T, int N>
-int Ray::Ref::TexStorageSwizzled<T, N>::Allocate(const ColorType *data, const int _res[2], bool mips) {
-    int index = -1;
-    if (!free_slots_.empty()) {
-        index = free_slots_.back();
-        free_slots_.pop_back();
-    } else {
-        index = int(images_.size());
-        images_.resize(images_.size() + 1);
+template <int M>
+void Ray::Ref::TexStorageSwizzled<T, N>::WriteLevel(ImgData &p, const int lod, const color_t<T, M> *data,
+                                                    const int _res[2]) {
+    static_assert(M >= N, "Not enough source channels!");
+
+    ColorType *out_pixels = &p.pixels[p.lod_offsets[lod]];
+    const uint32_t tile_y_stride = p.tile_y_stride[lod];
+
+    auto copy_texel = [](ColorType &dst, const color_t<T, M> &src) {
+        for (int i = 0; i < N; ++i) {
+            dst.v[i] = src.v[i];
+        }
+    };
+
+    for (int y = 0; y < _res[1]; ++y) {
+        const uint32_t y_off = (y / OuterTileH) * tile_y_stride + swizzle_y(y);
+
+        for (int x = 0; x < _res[0]; ++x) {
+            const uint32_t x_off = swizzle_x_tile(x);
+            copy_texel(out_pixels[y_off + x_off], data[y * _res[0] + x]);
+        }
+
+        { // write additional row to the right
+            const uint32_t x_off = swizzle_x_tile(_res[0]);
+            copy_texel(out_pixels[y_off + x_off], data[y * _res[0]]);
+        }
     }
 
-    ImgData &p = images_[index];
+    { // write additional line at the bottom
+        const uint32_t y_off = (_res[1] / OuterTileH) * tile_y_stride + swizzle_y(_res[1]);
+
+        for (int x = 0; x < _res[0]; ++x) {
+            const uint32_t x_off = swizzle_x_tile(x);
+            copy_texel(out_pixels[y_off + x_off], data[x]);
+        }
+    }
+
+    { // write additional corner pixel
+        const uint32_t y_off = (_res[1] / OuterTileH) * tile_y_stride + swizzle_y(_res[1]);
+        const uint32_t x_off = swizzle_x_tile(_res[0]);
+
+        copy_texel(out_pixels[y_off + x_off], data[0]);
+    }
+}
+
+template <typename T, int N>
+template <int M>
+typename Ray::Ref::TexStorageSwizzled<T, N>::ImgData
+Ray::Ref::TexStorageSwizzled<T, N>::Prepare(const color_t<T, M> *data, const int _res[2], bool mips) {
+    ImgData p;
 
     p.lod_offsets[0] = 0;
     p.res[0][0] = _res[0] + 1;
@@ -312,106 +372,437 @@ int Ray::Ref::TexStorageSwizzled<T, N>::Allocate(const ColorType *data, const in
 
     p.pixels.reset(new ColorType[total_size]);
 
-    for (int y = 0; y < _res[1]; ++y) {
-        const uint32_t y_off = (y / OuterTileH) * p.tile_y_stride[0] + swizzle_y(y);
+    WriteLevel(p, 0, data, _res);
 
-        for (int x = 0; x < _res[0]; ++x) {
-            const uint32_t x_off = swizzle_x_tile(x);
-            p.pixels[y_off + x_off] = data[y * _res[0] + x];
-        }
+    return p;
+}
 
-        { // write additional row to the right
-            const uint32_t x_off = swizzle_x_tile(_res[0]);
-            p.pixels[y_off + x_off] = data[y * _res[0]];
-        }
+template <typename T, int N> int Ray::Ref::TexStorageSwizzled<T, N>::Insert(ImgData &&img) {
+    int index = -1;
+    if (!free_slots_.empty()) {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        index = int(images_.size());
+        images_.resize(images_.size() + 1);
     }
 
-    { // write additional line at the bottom
-        const uint32_t y_off = (_res[1] / OuterTileH) * p.tile_y_stride[0] + swizzle_y(_res[1]);
+    images_[index] = std::move(img);
 
-        for (int x = 0; x < _res[0]; ++x) {
-            const uint32_t x_off = swizzle_x_tile(x);
-            p.pixels[y_off + x_off] = data[x];
-        }
+    return index;
+}
+
+template <typename T, int N> bool Ray::Ref::TexStorageSwizzled<T, N>::Free(const int index) {
+    if (index < 0 || index > int(images_.size())) {
+        return false;
     }
 
-    { // write additional corner pixel
-        const uint32_t y_off = (_res[1] / OuterTileH) * p.tile_y_stride[0] + swizzle_y(_res[1]);
-        const uint32_t x_off = swizzle_x_tile(_res[0]);
+#ifndef NDEBUG
+    memset(images_[index].res, 0, sizeof(images_[index].res));
+    memset(images_[index].tile_y_stride, 0, sizeof(images_[index].tile_y_stride));
+    memset(images_[index].lod_offsets, 0, sizeof(images_[index].lod_offsets));
+#endif
 
-        p.pixels[y_off + x_off] = data[0];
+    images_[index].pixels.reset();
+    free_slots_.push_back(index);
+
+    return true;
+}
+
+template <typename T, int N>
+bool Ray::Ref::TexStorageSwizzled<T, N>::Matches(const int index, const uint8_t *data, const int channels,
+                                                 const int res[2]) const {
+    const ImgData &p = images_[index];
+    if (channels < N || p.res[0][0] != res[0] + 1 || p.res[0][1] != res[1] + 1) {
+        return false;
     }
 
-    for (int i = 1; i < NUM_MIP_LEVELS && mips; ++i) {
-        ColorType *out_pixels = &p.pixels[p.lod_offsets[i]];
+    for (int y = 0; y < res[1]; ++y) {
+        for (int x = 0; x < res[0]; ++x) {
+            const ColorType col = Get(index, x, y, 0);
+            if (memcmp(&col.v[0], &data[(size_t(y) * res[0] + x) * channels], N * sizeof(T)) != 0) {
+                return false;
+            }
+        }
+    }
 
-        for (int y = 0; y < p.res[i - 1][1] - 1; y += 2) {
-            const uint32_t y_off = ((y / 2) / OuterTileH) * p.tile_y_stride[i] + swizzle_y(y / 2);
+    return true;
+}
 
-            for (int x = 0; x < p.res[i - 1][0] - 1; x += 2) {
-                const ColorType c00 = Get(index, x + 0, y + 0, i - 1);
-                const ColorType c10 = Get(index, x + 1, y + 0, i - 1);
-                const ColorType c11 = Get(index, x + 1, y + 1, i - 1);
-                const ColorType c01 = Get(index, x + 0, y + 1, i - 1);
+template <typename T, int N> void Ray::Ref::TexStorageSwizzled<T, N>::Save(SnapshotWriter &w) const {
+    std::vector<snapshot_swizzled_img_t> headers(images_.size());
+    for (int i = 0; i < int(images_.size()); ++i) {
+        const ImgData &p = images_[i];
+        memcpy(headers[i].res, p.res, sizeof(p.res));
+        memcpy(headers[i].tile_y_stride, p.tile_y_stride, sizeof(p.tile_y_stride));
+        memcpy(headers[i].lod_offsets, p.lod_offsets, sizeof(p.lod_offsets));
+        headers[i].data_size = p.pixels ? mem_size(i) : 0;
+    }
 
-                ColorType res;
-                for (int i = 0; i < N; ++i) {
-                    res.v[i] = (c00.v[i] + c10.v[i] + c11.v[i] + c01.v[i]) / 4;
-                }
+    w.WriteArray(headers);
+    w.WriteArray(free_slots_);
+    for (int i = 0; i < int(images_.size()); ++i) {
+        if (images_[i].pixels) {
+            w.WriteChunk(images_[i].pixels.get(), size_t(headers[i].data_size));
+        }
+    }
+}
 
-                const uint32_t x_off = swizzle_x_tile(x / 2);
+template <typename T, int N> bool Ray::Ref::TexStorageSwizzled<T, N>::Load(SnapshotReader &r) {
+    std::vector<snapshot_swizzled_img_t> headers;
+    std::vector<int> free_slots;
+    if (!r.ReadArray(headers) || !r.ReadArray(free_slots)) {
+        return false;
+    }
 
-                out_pixels[y_off + x_off] = res;
+    std::vector<ImgData> images(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        ImgData &p = images[i];
+        memcpy(p.res, headers[i].res, sizeof(p.res));
+        memcpy(p.tile_y_stride, headers[i].tile_y_stride, sizeof(p.tile_y_stride));
+        memcpy(p.lod_offsets, headers[i].lod_offsets, sizeof(p.lod_offsets));
+        if (headers[i].data_size) {
+            size_t count = 0;
+            const ColorType *pixels = r.ReadArray<ColorType>(count);
+            if (!pixels || count * sizeof(ColorType) != headers[i].data_size) {
+                return false;
             }
+            p.pixels.reset(new ColorType[count]);
+            memcpy(p.pixels.get(), pixels, count * sizeof(ColorType));
         }
+    }
 
-        // write additional row to the right
-        for (int y = 0; y < p.res[i][1]; ++y) {
-            const uint32_t y_off = (y / OuterTileH) * p.tile_y_stride[i] + swizzle_y(y);
-            const uint32_t x_off = swizzle_x_tile(p.res[i][0] - 1);
+    images_ = std::move(images);
+    free_slots_ = std::move(free_slots);
 
-            out_pixels[y_off + x_off] = Get(index, 0, y, i);
+    // make sure image descriptions are consistent with data
+    for (int i = 0; i < int(images_.size()); ++i) {
+        if (headers[i].data_size && mem_size(i) != headers[i].data_size) {
+            images_.clear();
+            free_slots_.clear();
+            return false;
         }
+    }
 
-        { // write additional line at the bottom
-            const uint32_t y_off = ((p.res[i][1] - 1) / OuterTileH) * p.tile_y_stride[i] + swizzle_y(p.res[i][1] - 1);
+    return true;
+}
 
-            for (int x = 0; x < p.res[i][0]; ++x) {
-                const uint32_t x_off = swizzle_x_tile(x);
+template class Ray::Ref::TexStorageSwizzled<uint8_t, 4>;
+template class Ray::Ref::TexStorageSwizzled<uint8_t, 3>;
+template class Ray::Ref::TexStorageSwizzled<uint8_t, 2>;
+template class Ray::Ref::TexStorageSwizzled<uint8_t, 1>;
+
+// normal maps are stored as 2-channel images regardless of the source format
+template Ray::Ref::TexStorageSwizzled<uint8_t, 4>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 4>::Prepare<4>(const color_t<uint8_t, 4> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageSwizzled<uint8_t, 3>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 3>::Prepare<3>(const color_t<uint8_t, 3> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageSwizzled<uint8_t, 2>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 2>::Prepare<4>(const color_t<uint8_t, 4> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageSwizzled<uint8_t, 2>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 2>::Prepare<3>(const color_t<uint8_t, 3> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageSwizzled<uint8_t, 2>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 2>::Prepare<2>(const color_t<uint8_t, 2> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageSwizzled<uint8_t, 1>::ImgData
+Ray::Ref::TexStorageSwizzled<uint8_t, 1>::Prepare<1>(const color_t<uint8_t, 1> *data, const int res[2], bool mips);
+
+namespace Ray {
+namespace Ref {
+std::atomic<uint32_t> g_bcn_image_counter(0);
+
+uint32_t NextBCnImageUid() {
+    uint32_t uid = ++g_bcn_image_counter;
+    if (uid == 0) {
+        // skip zero on overflow
+        uid = ++g_bcn_image_counter;
+    }
+    return uid;
+}
+
+// Compresses first N channels of source texels
+template <int N, int M> void CompressImage_BCn(const color_t<uint8_t, M> *data, int w, int h, uint8_t out_blocks[]);
 
-                out_pixels[y_off + x_off] = Get(index, x, 0, i);
+template <>
+void CompressImage_BCn<3, 3>(const color_t<uint8_t, 3> *data, const int w, const int h, uint8_t out_blocks[]) {
+    std::unique_ptr<uint8_t[]> temp_YCoCg = ConvertRGB_to_CoCgxY(&data[0].v[0], w, h);
+    CompressImage_BC3<true /* Is_YCoCg */>(temp_YCoCg.get(), w, h, out_blocks);
+}
+template <>
+void CompressImage_BCn<2, 4>(const color_t<uint8_t, 4> *data, const int w, const int h, uint8_t out_blocks[]) {
+    CompressImage_BC5<4>(&data[0].v[0], w, h, out_blocks);
+}
+template <>
+void CompressImage_BCn<2, 3>(const color_t<uint8_t, 3> *data, const int w, const int h, uint8_t out_blocks[]) {
+    CompressImage_BC5<3>(&data[0].v[0], w, h, out_blocks);
+}
+template <>
+void CompressImage_BCn<2, 2>(const color_t<uint8_t, 2> *data, const int w, const int h, uint8_t out_blocks[]) {
+    CompressImage_BC5<2>(&data[0].v[0], w, h, out_blocks);
+}
+template <>
+void CompressImage_BCn<1, 1>(const color_t<uint8_t, 1> *data, const int w, const int h, uint8_t out_blocks[]) {
+    CompressImage_BC4<1>(&data[0].v[0], w, h, out_blocks);
+}
+
+// Compresses raw texels with given channels count, returns false if combination is not supported
+template <int N> bool CompressRawImage_BCn(const uint8_t data[], int channels, int w, int h, uint8_t out_blocks[]);
+
+template <> bool CompressRawImage_BCn<3>(const uint8_t data[], const int channels, const int w, const int h,
+                                         uint8_t out_blocks[]) {
+    if (channels != 3) {
+        return false;
+    }
+    CompressImage_BCn<3>(reinterpret_cast<const color_t<uint8_t, 3> *>(data), w, h, out_blocks);
+    return true;
+}
+template <> bool CompressRawImage_BCn<2>(const uint8_t data[], const int channels, const int w, const int h,
+                                         uint8_t out_blocks[]) {
+    if (channels == 4) {
+        CompressImage_BCn<2>(reinterpret_cast<const color_t<uint8_t, 4> *>(data), w, h, out_blocks);
+    } else if (channels == 3) {
+        CompressImage_BCn<2>(reinterpret_cast<const color_t<uint8_t, 3> *>(data), w, h, out_blocks);
+    } else if (channels == 2) {
+        CompressImage_BCn<2>(reinterpret_cast<const color_t<uint8_t, 2> *>(data), w, h, out_blocks);
+    } else {
+        return false;
+    }
+    return true;
+}
+template <> bool CompressRawImage_BCn<1>(const uint8_t data[], const int channels, const int w, const int h,
+                                         uint8_t out_blocks[]) {
+    if (channels != 1) {
+        return false;
+    }
+    CompressImage_BCn<1>(reinterpret_cast<const color_t<uint8_t, 1> *>(data), w, h, out_blocks);
+    return true;
+}
+
+force_inline void DecodeBlock_BCn(const uint8_t block[], color_t<uint8_t, 3> out_texels[16]) {
+    alignas(16) uint8_t temp_rgba[64];
+    DecodeBlock_BC3<true /* Is_YCoCg */>(block, temp_rgba);
+    for (int i = 0; i < 16; ++i) {
+        out_texels[i].v[0] = temp_rgba[4 * i + 0];
+        out_texels[i].v[1] = temp_rgba[4 * i + 1];
+        out_texels[i].v[2] = temp_rgba[4 * i + 2];
+    }
+}
+force_inline void DecodeBlock_BCn(const uint8_t block[], color_t<uint8_t, 2> out_texels[16]) {
+    DecodeBlock_BC5(block, &out_texels[0].v[0]);
+}
+force_inline void DecodeBlock_BCn(const uint8_t block[], color_t<uint8_t, 1> out_texels[16]) {
+    DecodeBlock_BC4(block, &out_texels[0].v[0]);
+}
+} // namespace Ref
+} // namespace Ray
+
+template <int N>
+thread_local typename Ray::Ref::TexStorageBCn<N>::cached_block_t
+    Ray::Ref::TexStorageBCn<N>::block_cache_[BlockCacheSize];
+template <int N> thread_local uint64_t Ray::Ref::TexStorageBCn<N>::block_cache_misses_ = 0;
+
+template <int N> uint64_t Ray::Ref::TexStorageBCn<N>::block_cache_misses() { return block_cache_misses_; }
+
+template <int N>
+const typename Ray::Ref::TexStorageBCn<N>::ColorType *
+Ray::Ref::TexStorageBCn<N>::GetDecodedBlock(const ImgData &p, const int block) const {
+    // uid is never zero, so zero-initialized entries are always a miss
+    const uint64_t key = (uint64_t(p.uid) << 32) | uint32_t(block);
+    cached_block_t &entry = block_cache_[(block ^ (p.uid * 0x9e3779b9u >> 24)) % BlockCacheSize];
+    if (entry.key != key) {
+        DecodeBlock_BCn(&p.blocks[size_t(block) * BlockSize], entry.texels);
+        entry.key = key;
+        ++block_cache_misses_;
+    }
+    return entry.texels;
+}
+
+template <int N>
+typename Ray::Ref::TexStorageBCn<N>::ColorType Ray::Ref::TexStorageBCn<N>::Get(const int index, int x, int y,
+                                                                             const int lod) const {
+    const ImgData &p = images_[index];
+
+    // last row/column is a copy of the first one
+    x = (x < p.res[lod][0] - 1) ? x : 0;
+    y = (y < p.res[lod][1] - 1) ? y : 0;
+
+    const int block = p.lod_offsets[lod] + (y / 4) * p.res_in_blocks[lod][0] + (x / 4);
+    return GetDecodedBlock(p, block)[(y % 4) * 4 + (x % 4)];
+}
+
+template <int N>
+void Ray::Ref::TexStorageBCn<N>::GetQuad(const int index, const int _x[2], const int _y[2], const int lod,
+                                         ColorType out_texels[4]) const {
+    const ImgData &p = images_[index];
+
+    int x[2], y[2];
+    for (int i = 0; i < 2; ++i) {
+        x[i] = (_x[i] < p.res[lod][0] - 1) ? _x[i] : 0;
+        y[i] = (_y[i] < p.res[lod][1] - 1) ? _y[i] : 0;
+    }
+
+    const ColorType *last_texels = nullptr;
+    int last_block = -1;
+
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            const int block = p.lod_offsets[lod] + (y[j] / 4) * p.res_in_blocks[lod][0] + (x[i] / 4);
+            if (block != last_block) {
+                last_texels = GetDecodedBlock(p, block);
+                last_block = block;
             }
+            out_texels[j * 2 + i] = last_texels[(y[j] % 4) * 4 + (x[i] % 4)];
         }
+    }
+}
 
-        { // write additional corner pixel
-            const uint32_t y_off = ((p.res[i][1] - 1) / OuterTileH) * p.tile_y_stride[i] + swizzle_y((p.res[i][1] - 1));
-            const uint32_t x_off = swizzle_x_tile(p.res[i][0] - 1);
+template <int N>
+template <int M>
+typename Ray::Ref::TexStorageBCn<N>::ImgData
+Ray::Ref::TexStorageBCn<N>::Prepare(const color_t<uint8_t, M> *data, const int _res[2], bool mips) {
+    ImgData p;
 
-            out_pixels[y_off + x_off] = Get(index, 0, 0, i);
-        }
+    // mip levels are not generated (same as for swizzled storage), all lods refer to the base level
+    mips = false;
+
+    for (int i = 0; i < NUM_MIP_LEVELS; ++i) {
+        p.res[i][0] = _res[0] + 1;
+        p.res[i][1] = _res[1] + 1;
+        p.res_in_blocks[i][0] = (_res[0] + 3) / 4;
+        p.res_in_blocks[i][1] = (_res[1] + 3) / 4;
+        p.lod_offsets[i] = 0;
     }
 
+    p.uid = NextBCnImageUid();
+
+    const int blocks_count = p.res_in_blocks[0][0] * p.res_in_blocks[0][1];
+    p.blocks.reset(new uint8_t[size_t(blocks_count) * BlockSize]);
+
+    CompressImage_BCn<N>(data, _res[0], _res[1], p.blocks.get());
+
+    return p;
+}
+
+template <int N> int Ray::Ref::TexStorageBCn<N>::Insert(ImgData &&img) {
+    int index = -1;
+    if (!free_slots_.empty()) {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        index = int(images_.size());
+        images_.resize(images_.size() + 1);
+    }
+
+    images_[index] = std::move(img);
+
     return index;
 }
 
-template <typename T, int N> bool Ray::Ref::TexStorageSwizzled<T, N>::Free(const int index) {
-    if (index < 0 || index > int(images_.size())) {
+template <int N> bool Ray::Ref::TexStorageBCn<N>::Free(const int index) {
+    if (index < 0 || index >= int(images_.size())) {
         return false;
     }
 
 #ifndef NDEBUG
     memset(images_[index].res, 0, sizeof(images_[index].res));
-    memset(images_[index].tile_y_stride, 0, sizeof(images_[index].tile_y_stride));
+    memset(images_[index].res_in_blocks, 0, sizeof(images_[index].res_in_blocks));
     memset(images_[index].lod_offsets, 0, sizeof(images_[index].lod_offsets));
 #endif
 
-    images_[index].pixels.reset();
+    // uid is not reused, so blocks of freed image can not be picked from cache
+    images_[index].blocks.reset();
     free_slots_.push_back(index);
 
     return true;
 }
 
-template class Ray::Ref::TexStorageSwizzled<uint8_t, 4>;
-template class Ray::Ref::TexStorageSwizzled<uint8_t, 3>;
-template class Ray::Ref::TexStorageSwizzled<uint8_t, 2>;
-template class Ray::Ref::TexStorageSwizzled<uint8_t, 1>;
+template <int N>
+bool Ray::Ref::TexStorageBCn<N>::Matches(const int index, const uint8_t *data, const int channels,
+                                         const int res[2]) const {
+    const ImgData &p = images_[index];
+    if (!p.blocks || p.res[0][0] != res[0] + 1 || p.res[0][1] != res[1] + 1) {
+        return false;
+    }
+
+    const size_t blocks_size = size_t(p.res_in_blocks[0][0]) * p.res_in_blocks[0][1] * BlockSize;
+    std::unique_ptr<uint8_t[]> blocks(new uint8_t[blocks_size]);
+    if (!CompressRawImage_BCn<N>(data, channels, res[0], res[1], blocks.get())) {
+        return false;
+    }
+
+    return memcmp(blocks.get(), p.blocks.get(), blocks_size) == 0;
+}
+
+template <int N> void Ray::Ref::TexStorageBCn<N>::Save(SnapshotWriter &w) const {
+    std::vector<snapshot_bcn_img_t> headers(images_.size());
+    for (int i = 0; i < int(images_.size()); ++i) {
+        const ImgData &p = images_[i];
+        memcpy(headers[i].res, p.res, sizeof(p.res));
+        memcpy(headers[i].res_in_blocks, p.res_in_blocks, sizeof(p.res_in_blocks));
+        memcpy(headers[i].lod_offsets, p.lod_offsets, sizeof(p.lod_offsets));
+        headers[i].data_size = p.blocks ? mem_size(i) : 0;
+    }
+
+    w.WriteArray(headers);
+    w.WriteArray(free_slots_);
+    for (int i = 0; i < int(images_.size()); ++i) {
+        if (images_[i].blocks) {
+            w.WriteChunk(images_[i].blocks.get(), size_t(headers[i].data_size));
+        }
+    }
+}
+
+template <int N> bool Ray::Ref::TexStorageBCn<N>::Load(SnapshotReader &r) {
+    std::vector<snapshot_bcn_img_t> headers;
+    std::vector<int> free_slots;
+    if (!r.ReadArray(headers) || !r.ReadArray(free_slots)) {
+        return false;
+    }
+
+    std::vector<ImgData> images(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        ImgData &p = images[i];
+        memcpy(p.res, headers[i].res, sizeof(p.res));
+        memcpy(p.res_in_blocks, headers[i].res_in_blocks, sizeof(p.res_in_blocks));
+        memcpy(p.lod_offsets, headers[i].lod_offsets, sizeof(p.lod_offsets));
+        // uids are unique within process only
+        p.uid = NextBCnImageUid();
+        if (headers[i].data_size) {
+            size_t size = 0;
+            const uint8_t *blocks = r.ReadChunk(size);
+            if (!blocks || size != headers[i].data_size) {
+                return false;
+            }
+            p.blocks.reset(new uint8_t[size]);
+            memcpy(p.blocks.get(), blocks, size);
+        }
+    }
+
+    images_ = std::move(images);
+    free_slots_ = std::move(free_slots);
+
+    // make sure image descriptions are consistent with data
+    for (int i = 0; i < int(images_.size()); ++i) {
+        if (headers[i].data_size && mem_size(i) != headers[i].data_size) {
+            images_.clear();
+            free_slots_.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template class Ray::Ref::TexStorageBCn<3>;
+template class Ray::Ref::TexStorageBCn<2>;
+template class Ray::Ref::TexStorageBCn<1>;
+
+template Ray::Ref::TexStorageBCn<3>::ImgData
+Ray::Ref::TexStorageBCn<3>::Prepare<3>(const color_t<uint8_t, 3> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageBCn<2>::ImgData
+Ray::Ref::TexStorageBCn<2>::Prepare<4>(const color_t<uint8_t, 4> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageBCn<2>::ImgData
+Ray::Ref::TexStorageBCn<2>::Prepare<3>(const color_t<uint8_t, 3> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageBCn<2>::ImgData
+Ray::Ref::TexStorageBCn<2>::Prepare<2>(const color_t<uint8_t, 2> *data, const int res[2], bool mips);
+template Ray::Ref::TexStorageBCn<1>::ImgData
+Ray::Ref::TexStorageBCn<1>::Prepare<1>(const color_t<uint8_t, 1> *data, const int res[2], bool mips);
@@ -8,17 +8,26 @@
 
 namespace Ray {
 namespace Ref {
+class SnapshotReader;
+class SnapshotWriter;
+
 class TexStorageBase {
   public:
     virtual ~TexStorageBase() = default;
 
     virtual void GetIRes(int index, int lod, int res[2]) const = 0;
+    // Memory occupied by image data (in bytes)
+    virtual size_t mem_size(int index) const = 0;
     virtual void GetFRes(int index, int lod, float res[2]) const = 0;
 
     virtual color_rgba_t Fetch(int index, int x, int y, int lod) const = 0;
     virtual color_rgba_t Fetch(int index, float x, float y, int lod) const = 0;
 
     virtual bool Free(int index) = 0;
+
+    // Checks that image was created from the same source texels (only channels kept by storage are compared),
+    // storages that can not tell this never match
+    virtual bool Matches(int index, const uint8_t *data, int channels, const int res[2]) const { return false; }
 };
 
 template <typename T, int N> class TexStorageLinear : public TexStorageBase {
@@ -37,6 +46,11 @@ template <typename T, int N> class TexStorageLinear : public TexStorageBase {
   public:
     force_inline int img_count() const { return int(images_.size() - free_slots_.size()); }
 
+    // Raw image data, used by vectorized samplers to compute texel addresses without going through Fetch
+    force_inline const ColorType *pixels(const int index) const { return images_[index].pixels.get(); }
+    force_inline const int *res(const int index) const { return &images_[index].res[0][0]; }
+    force_inline const int *lod_offsets(const int index) const { return images_[index].lod_offsets; }
+
     force_inline ColorType Get(const int index, const int x, const int y, const int lod) const {
         const ImgData &p = images_[index];
         const int w = p.res[lod][0];
@@ -54,6 +68,12 @@ template <typename T, int N> class TexStorageLinear : public TexStorageBase {
         return p.pixels[p.lod_offsets[lod] + w * int(y * h - 0.5f) + int(x * w - 0.5f)];
     }
 
+    size_t mem_size(const int index) const override {
+        const ImgData &p = images_[index];
+        // last lod refers to the last allocated level
+        return size_t(p.lod_offsets[NUM_MIP_LEVELS - 1] + p.res[NUM_MIP_LEVELS - 1][0] * p.res[NUM_MIP_LEVELS - 1][1]) * sizeof(ColorType);
+    }
+
     void GetIRes(const int index, const int lod, int res[2]) const override {
         const ImgData &p = images_[index];
 
@@ -116,8 +136,10 @@ extern template class Ray::Ref::TexStorageLinear<uint8_t, 2>;
 extern template class Ray::Ref::TexStorageLinear<uint8_t, 1>;
 
 template <typename T, int N> class TexStorageTiled : public TexStorageBase {
+  public:
     static const int TileSize = 4;
 
+  private:
     using ColorType = color_t<T, N>;
     struct ImgData {
         int res[NUM_MIP_LEVELS][2], res_in_tiles[NUM_MIP_LEVELS][2];
@@ -131,6 +153,12 @@ template <typename T, int N> class TexStorageTiled : public TexStorageBase {
   public:
     force_inline int img_count() const { return int(images_.size() - free_slots_.size()); }
 
+    // Raw image data, used by vectorized samplers to compute texel addresses without going through Fetch
+    force_inline const ColorType *pixels(const int index) const { return images_[index].pixels.get(); }
+    force_inline const int *res(const int index) const { return &images_[index].res[0][0]; }
+    force_inline const int *lod_offsets(const int index) const { return images_[index].lod_offsets; }
+    force_inline const int *res_in_tiles(const int index) const { return &images_[index].res_in_tiles[0][0]; }
+
     force_inline ColorType Get(const int index, const int x, const int y, const int lod) const {
         const ImgData &p = images_[index];
 
@@ -153,6 +181,12 @@ template <typename T, int N> class TexStorageTiled : public TexStorageBase {
         return Get(index, int(x * w - 0.5f), int(y * h - 0.5f), lod);
     }
 
+    size_t mem_size(const int index) const override {
+        const ImgData &p = images_[index];
+        return size_t(p.lod_offsets[NUM_MIP_LEVELS - 1] + p.res_in_tiles[NUM_MIP_LEVELS - 1][0] * p.res_in_tiles[NUM_MIP_LEVELS - 1][1] * TileSize * TileSize) *
+               sizeof(ColorType);
+    }
+
     void GetIRes(const int index, const int lod, int res[2]) const override {
         const ImgData &p = images_[index];
 
@@ -215,25 +249,20 @@ extern template class TexStorageTiled<uint8_t, 2>;
 extern template class TexStorageTiled<uint8_t, 1>;
 
 template <typename T, int N> class TexStorageSwizzled : public TexStorageBase {
+  public:
     using ColorType = color_t<T, N>;
+    // Image converted into storage layout
     struct ImgData {
         int res[NUM_MIP_LEVELS][2], tile_y_stride[NUM_MIP_LEVELS];
         int lod_offsets[NUM_MIP_LEVELS];
         std::unique_ptr<ColorType[]> pixels;
     };
 
+  private:
     std::vector<ImgData> images_;
     std::vector<int> free_slots_;
 
-    static const uint32_t OuterTileW = 64;
-    static const uint32_t OuterTileH = 64;
-
-    force_inline static uint32_t swizzle_x_tile(uint32_t x) {
-        return ((x & 0x03) << 0) | ((x & 0x04) << 2) | ((x & 0x38) << 4) | ((x & ~0x3f) << 6);
-    }
-    force_inline static uint32_t swizzle_y(uint32_t y) {
-        return ((y & 0x03) << 2) | ((y & 0x0c) << 3) | ((y & 0x30) << 6);
-    }
+    template <int M> static void WriteLevel(ImgData &p, int lod, const color_t<T, M> *data, const int res[2]);
 
     force_inline uint32_t EncodeSwizzle(const uint32_t x, const uint32_t y, const uint32_t tile_y_stride) const {
         const uint32_t y_off = (y / OuterTileH) * tile_y_stride + swizzle_y(y);
@@ -242,8 +271,25 @@ template <typename T, int N> class TexStorageSwizzled : public TexStorageBase {
     }
 
   public:
+    static const uint32_t OuterTileW = 64;
+    static const uint32_t OuterTileH = 64;
+
+    // Templated to be usable with both scalar and SIMD integer types
+    template <typename U> force_inline static U swizzle_x_tile(const U &x) {
+        return ((x & 0x03) << 0) | ((x & 0x04) << 2) | ((x & 0x38) << 4) | ((x & ~0x3f) << 6);
+    }
+    template <typename U> force_inline static U swizzle_y(const U &y) {
+        return ((y & 0x03) << 2) | ((y & 0x0c) << 3) | ((y & 0x30) << 6);
+    }
+
     force_inline int img_count() const { return int(images_.size() - free_slots_.size()); }
 
+    // Raw image data, used by vectorized samplers to compute texel addresses without going through Fetch
+    force_inline const ColorType *pixels(const int index) const { return images_[index].pixels.get(); }
+    force_inline const int *res(const int index) const { return &images_[index].res[0][0]; }
+    force_inline const int *lod_offsets(const int index) const { return images_[index].lod_offsets; }
+    force_inline const int *tile_y_stride(const int index) const { return images_[index].tile_y_stride; }
+
     force_inline ColorType Get(const int index, const int x, const int y, const int lod) const {
         const ImgData &p = images_[index];
         return p.pixels[p.lod_offsets[lod] + EncodeSwizzle(x, y, p.tile_y_stride[lod])];
@@ -260,6 +306,12 @@ template <typename T, int N> class TexStorageSwizzled : public TexStorageBase {
         return Get(index, int(x * w - 0.5f), int(y * h - 0.5f), lod);
     }
 
+    size_t mem_size(const int index) const override {
+        const ImgData &p = images_[index];
+        const int last_size = p.tile_y_stride[NUM_MIP_LEVELS - 1] * int((p.res[NUM_MIP_LEVELS - 1][1] + OuterTileH - 1) / OuterTileH);
+        return size_t(p.lod_offsets[NUM_MIP_LEVELS - 1] + last_size) * sizeof(ColorType);
+    }
+
     void GetIRes(const int index, const int lod, int res[2]) const override {
         const ImgData &p = images_[index];
 
@@ -312,8 +364,20 @@ template <typename T, int N> class TexStorageSwizzled : public TexStorageBase {
         return ret;
     }
 
-    int Allocate(const ColorType *data, const int res[2], bool mips);
+    // Converts image into storage layout without touching the storage itself (can be called outside of scene lock),
+    // only first N channels of source texels are used
+    template <int M> static ImgData Prepare(const color_t<T, M> *data, const int res[2], bool mips);
+    int Insert(ImgData &&img);
+
+    int Allocate(const ColorType *data, const int res[2], const bool mips) {
+        return Insert(Prepare(data, res, mips));
+    }
     bool Free(int index) override;
+    bool Matches(int index, const uint8_t *data, int channels, const int res[2]) const override;
+
+    // Images are written with their indices, so texture handles stay valid after loading
+    void Save(SnapshotWriter &w) const;
+    bool Load(SnapshotReader &r);
 };
 
 extern template class TexStorageSwizzled<uint8_t, 4>;
@@ -321,5 +385,136 @@ extern template class TexStorageSwizzled<uint8_t, 3>;
 extern template class TexStorageSwizzled<uint8_t, 2>;
 extern template class TexStorageSwizzled<uint8_t, 1>;
 
+// Block-compressed storage (BC4 for 1 channel, BC5 for 2 channels, BC3 with YCoCg color for 3 channels). Blocks are
+// decoded on access and kept in small per-thread cache, additional border row/column is emulated with wrapping
+template <int N> class TexStorageBCn : public TexStorageBase {
+  public:
+    using ColorType = color_t<uint8_t, N>;
+    // Compressed image
+    struct ImgData {
+        int res[NUM_MIP_LEVELS][2], res_in_blocks[NUM_MIP_LEVELS][2];
+        int lod_offsets[NUM_MIP_LEVELS]; // in blocks
+        uint32_t uid;                    // unique across all allocations, used as a cache key
+        std::unique_ptr<uint8_t[]> blocks;
+    };
+
+  private:
+    std::vector<ImgData> images_;
+    std::vector<int> free_slots_;
+
+    static const int BlockSize = (N == 1) ? 8 : 16;
+
+    struct cached_block_t {
+        uint64_t key;
+        ColorType texels[16];
+    };
+    static const int BlockCacheSize = 256;
+    static thread_local cached_block_t block_cache_[BlockCacheSize];
+    static thread_local uint64_t block_cache_misses_;
+
+    const ColorType *GetDecodedBlock(const ImgData &p, int block) const;
+
+  public:
+    force_inline int img_count() const { return int(images_.size() - free_slots_.size()); }
+
+    // Number of blocks decoded by the calling thread (block cache misses)
+    static uint64_t block_cache_misses();
+
+    ColorType Get(int index, int x, int y, int lod) const;
+
+    force_inline ColorType Get(const int index, float x, float y, const int lod) const {
+        const ImgData &p = images_[index];
+        const int w = p.res[lod][0] - 1;
+        const int h = p.res[lod][1] - 1;
+
+        x -= std::floor(x);
+        y -= std::floor(y);
+
+        return Get(index, int(x * w - 0.5f), int(y * h - 0.5f), lod);
+    }
+
+    // Fetches texels (x[0], y[0]), (x[1], y[0]), (x[0], y[1]), (x[1], y[1]) reusing decoded blocks
+    void GetQuad(int index, const int x[2], const int y[2], int lod, ColorType out_texels[4]) const;
+
+    force_inline const int *res(const int index) const { return &images_[index].res[0][0]; }
+
+    size_t mem_size(const int index) const override {
+        const ImgData &p = images_[index];
+        return size_t(p.lod_offsets[NUM_MIP_LEVELS - 1] + p.res_in_blocks[NUM_MIP_LEVELS - 1][0] * p.res_in_blocks[NUM_MIP_LEVELS - 1][1]) * BlockSize;
+    }
+
+    void GetIRes(const int index, const int lod, int res[2]) const override {
+        const ImgData &p = images_[index];
+
+        res[0] = p.res[lod][0] - 1;
+        res[1] = p.res[lod][1] - 1;
+    }
+
+    void GetFRes(const int index, const int lod, float res[2]) const override {
+        const ImgData &p = images_[index];
+
+        res[0] = float(p.res[lod][0] - 1);
+        res[1] = float(p.res[lod][1] - 1);
+    }
+
+    color_rgba_t Fetch(const int index, const int x, const int y, const int lod) const override {
+        const ColorType col = Get(index, x, y, lod);
+
+        color_rgba_t ret;
+        for (int i = 0; i < N; ++i) {
+            ret.v[i] = float(col.v[i]);
+        }
+        for (int i = N; i < 4; ++i) {
+            ret.v[i] = ret.v[N - 1];
+        }
+
+        ret.v[0] /= 255.0f;
+        ret.v[1] /= 255.0f;
+        ret.v[2] /= 255.0f;
+        ret.v[3] /= 255.0f;
+
+        return ret;
+    }
+
+    color_rgba_t Fetch(const int index, const float x, const float y, const int lod) const override {
+        const ColorType col = Get(index, x, y, lod);
+
+        color_rgba_t ret;
+        for (int i = 0; i < N; ++i) {
+            ret.v[i] = float(col.v[i]);
+        }
+        for (int i = N; i < 4; ++i) {
+            ret.v[i] = ret.v[N - 1];
+        }
+
+        ret.v[0] /= 255.0f;
+        ret.v[1] /= 255.0f;
+        ret.v[2] /= 255.0f;
+        ret.v[3] /= 255.0f;
+
+        return ret;
+    }
+
+    // Compresses image without touching the storage itself (can be called outside of scene lock), only first N
+    // channels of source texels are used
+    template <int M> static ImgData Prepare(const color_t<uint8_t, M> *data, const int res[2], bool mips);
+    int Insert(ImgData &&img);
+
+    int Allocate(const ColorType *data, const int res[2], const bool mips) {
+        return Insert(Prepare(data, res, mips));
+    }
+    bool Free(int index) override;
+    // Source texels are compressed again and compared with stored blocks
+    bool Matches(int index, const uint8_t *data, int channels, const int res[2]) const override;
+
+    // Images are written with their indices, so texture handles stay valid after loading
+    void Save(SnapshotWriter &w) const;
+    bool Load(SnapshotReader &r);
+};
+
+extern template class TexStorageBCn<3>;
+extern template class TexStorageBCn<2>;
+extern template class TexStorageBCn<1>;
+
 } // namespace Ref
 } // namespace Ray
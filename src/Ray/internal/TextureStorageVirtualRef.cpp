@@ -0,0 +1,451 @@
+#include "TextureStorageVirtualRef.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+
+#include "../Log.h"
+#include "Utils.h"
+
+namespace Ray {
+namespace Ref {
+const char VirtualTextureMagic[4] = {'R', 'V', 'T', 'X'};
+const uint32_t VirtualTextureVersion = 1;
+
+struct vtex_header_t {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    int32_t w, h, channels, tile_size;
+    int32_t mip_count, first_tail_mip;
+    uint64_t file_offsets[NUM_MIP_LEVELS];
+};
+static_assert(sizeof(vtex_header_t) == 40 + 8 * NUM_MIP_LEVELS, "!");
+} // namespace Ref
+} // namespace Ray
+
+Ray::Ref::TexStorageVirtual::~TexStorageVirtual() {
+    if (loader_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(requests_mtx_);
+            stop_loader_ = true;
+        }
+        requests_cnd_.notify_one();
+        loader_thread_.join();
+    }
+
+    for (ImgData &p : images_) {
+        if (p.mapped_data) {
+            UnmapFile(p.mapped_data, p.mapped_size);
+        }
+    }
+}
+
+void Ray::Ref::TexStorageVirtual::Init(ILog *log, const char *cache_dir, const size_t budget) {
+    assert(!enabled() && "Storage is already initialized!");
+
+    log_ = log;
+    cache_dir_ = cache_dir;
+
+    slots_count_ = std::max(int(budget / SlotSize), 16);
+    slots_.reset(new slot_t[slots_count_]);
+    for (int i = 0; i < slots_count_; ++i) {
+        slots_[i].tag = 0;
+        slots_[i].referenced = 0;
+        slots_[i].img_index = slots_[i].page = -1;
+    }
+    slots_data_.reset(new uint8_t[size_t(slots_count_) * SlotSize]);
+
+    loader_thread_ = std::thread(&TexStorageVirtual::LoaderProc, this);
+}
+
+int Ray::Ref::TexStorageVirtual::resident_tiles_count() const {
+    int count = 0;
+    for (int i = 0; i < slots_count_; ++i) {
+        count += (slots_[i].tag.load(std::memory_order_relaxed) != 0) ? 1 : 0;
+    }
+    return count;
+}
+
+void Ray::Ref::TexStorageVirtual::InitLayout(ImgData &p, const int res[2], const int channels, const bool mips) {
+    p.channels = channels;
+    p.use_mips = mips;
+
+    p.mip_res[0][0] = res[0];
+    p.mip_res[0][1] = res[1];
+    p.mip_count = 1;
+    for (int i = 1; i < NUM_MIP_LEVELS; ++i) {
+        if (p.mip_res[i - 1][0] > 1 || p.mip_res[i - 1][1] > 1) {
+            p.mip_res[i][0] = std::max(p.mip_res[i - 1][0] / 2, 1);
+            p.mip_res[i][1] = std::max(p.mip_res[i - 1][1] / 2, 1);
+            ++p.mip_count;
+        } else {
+            p.mip_res[i][0] = p.mip_res[i - 1][0];
+            p.mip_res[i][1] = p.mip_res[i - 1][1];
+        }
+    }
+
+    p.first_tail_mip = p.mip_count - 1;
+    for (int i = 0; i < p.mip_count; ++i) {
+        if (p.mip_res[i][0] <= TileSize && p.mip_res[i][1] <= TileSize) {
+            p.first_tail_mip = i;
+            break;
+        }
+    }
+
+    const size_t tile_size = size_t(TileSize) * TileSize * channels;
+
+    int page_offset = 0, tail_offset = 0;
+    uint64_t file_offset = sizeof(vtex_header_t);
+    for (int i = 0; i < NUM_MIP_LEVELS; ++i) {
+        const int lod = std::min(i, p.mip_count - 1);
+
+        p.res[i][0] = (mips ? p.mip_res[lod][0] : res[0]) + 1;
+        p.res[i][1] = (mips ? p.mip_res[lod][1] : res[1]) + 1;
+
+        p.res_in_tiles[i][0] = (p.mip_res[i][0] + TileSize - 1) / TileSize;
+        p.res_in_tiles[i][1] = (p.mip_res[i][1] + TileSize - 1) / TileSize;
+
+        p.page_offsets[i] = page_offset;
+        p.tail_offsets[i] = tail_offset;
+        p.file_offsets[i] = file_offset;
+
+        if (i >= p.mip_count) {
+            // levels outside of mip chain are never accessed
+        } else if (i < p.first_tail_mip) {
+            const int tiles_count = p.res_in_tiles[i][0] * p.res_in_tiles[i][1];
+            page_offset += tiles_count;
+            file_offset += tiles_count * tile_size;
+        } else {
+            const int level_size = p.mip_res[i][0] * p.mip_res[i][1] * channels;
+            tail_offset += level_size;
+            file_offset += level_size;
+        }
+    }
+}
+
+bool Ray::Ref::TexStorageVirtual::WriteFile(const std::string &path, const uint8_t *data, const ImgData &p,
+                                            const uint64_t hash) {
+    // the same texture can be converted concurrently
+    static std::atomic<uint32_t> temp_counter(0);
+    const std::string temp_path = path + "." + std::to_string(temp_counter++) + ".tmp";
+
+    std::ofstream out_file(temp_path, std::ios::binary);
+    if (!out_file) {
+        return false;
+    }
+
+    vtex_header_t header = {};
+    memcpy(header.magic, VirtualTextureMagic, 4);
+    header.version = VirtualTextureVersion;
+    header.hash = hash;
+    header.w = p.mip_res[0][0];
+    header.h = p.mip_res[0][1];
+    header.channels = p.channels;
+    header.tile_size = TileSize;
+    header.mip_count = p.mip_count;
+    header.first_tail_mip = p.first_tail_mip;
+    memcpy(header.file_offsets, p.file_offsets, sizeof(header.file_offsets));
+
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(vtex_header_t));
+
+    const int channels = p.channels;
+    const int tile_row_size = TileSize * channels;
+    std::unique_ptr<uint8_t[]> tile(new uint8_t[TileSize * tile_row_size]);
+
+    // only current mip level is kept in memory
+    std::unique_ptr<uint8_t[]> level_data;
+    const uint8_t *cur_level = data;
+
+    for (int i = 0; i < p.mip_count; ++i) {
+        const int w = p.mip_res[i][0], h = p.mip_res[i][1];
+
+        if (i < p.first_tail_mip) {
+            for (int ty = 0; ty < p.res_in_tiles[i][1]; ++ty) {
+                for (int tx = 0; tx < p.res_in_tiles[i][0]; ++tx) {
+                    // edge tiles are padded with zeroes
+                    const int tile_w = std::min(TileSize, w - tx * TileSize);
+                    const int tile_h = std::min(TileSize, h - ty * TileSize);
+                    if (tile_w != TileSize || tile_h != TileSize) {
+                        memset(tile.get(), 0, TileSize * tile_row_size);
+                    }
+                    for (int y = 0; y < tile_h; ++y) {
+                        memcpy(&tile[y * tile_row_size],
+                               &cur_level[(size_t(ty * TileSize + y) * w + tx * TileSize) * channels],
+                               tile_w * channels);
+                    }
+                    out_file.write(reinterpret_cast<const char *>(tile.get()), TileSize * tile_row_size);
+                }
+            }
+        } else {
+            out_file.write(reinterpret_cast<const char *>(cur_level), std::streamsize(w) * h * channels);
+        }
+
+        if (i + 1 < p.mip_count) {
+            const int next_w = p.mip_res[i + 1][0], next_h = p.mip_res[i + 1][1];
+            std::unique_ptr<uint8_t[]> next_level(new uint8_t[size_t(next_w) * next_h * channels]);
+            DownsampleImage_Box(cur_level, w, h, channels, next_level.get(), next_w, next_h);
+
+            level_data = std::move(next_level);
+            cur_level = level_data.get();
+        }
+    }
+
+    out_file.close();
+    if (!out_file) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    // file appears under its final name only when complete
+    std::remove(path.c_str());
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool Ray::Ref::TexStorageVirtual::ValidateFile(const uint8_t *mapped_data, const size_t mapped_size,
+                                               const ImgData &p, const uint64_t hash) {
+    if (mapped_size < sizeof(vtex_header_t)) {
+        return false;
+    }
+
+    vtex_header_t header;
+    memcpy(&header, mapped_data, sizeof(vtex_header_t));
+
+    const int last_level = p.mip_count - 1;
+    const uint64_t expected_size =
+        p.file_offsets[last_level] + uint64_t(p.mip_res[last_level][0]) * p.mip_res[last_level][1] * p.channels;
+
+    return memcmp(header.magic, VirtualTextureMagic, 4) == 0 && header.version == VirtualTextureVersion &&
+           header.hash == hash && header.w == p.mip_res[0][0] && header.h == p.mip_res[0][1] &&
+           header.channels == p.channels && header.tile_size == TileSize && header.mip_count == p.mip_count &&
+           header.first_tail_mip == p.first_tail_mip &&
+           memcmp(header.file_offsets, p.file_offsets, sizeof(header.file_offsets)) == 0 &&
+           mapped_size >= expected_size;
+}
+
+bool Ray::Ref::TexStorageVirtual::Prepare(const uint8_t *data, const int channels, const int res[2], const bool mips,
+                                          ImgData &p) const {
+    assert(enabled() && "Storage is not initialized!");
+    assert(channels >= 1 && channels <= 4);
+
+    p = {};
+    InitLayout(p, res, channels, mips);
+
+    const uint64_t hash =
+        HashData(data, size_t(res[0]) * res[1] * channels,
+                 uint64_t(res[0]) | (uint64_t(res[1]) << 24) | (uint64_t(channels) << 48));
+
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "%016llx_%ix%i_%i.vtex", (unsigned long long)hash, res[0], res[1],
+             channels);
+    const std::string path = cache_dir_ + "/" + file_name;
+
+    p.mapped_data = MapFile(path.c_str(), p.mapped_size, true /* random_access */);
+    if (p.mapped_data && !ValidateFile(p.mapped_data, p.mapped_size, p, hash)) {
+        UnmapFile(p.mapped_data, p.mapped_size);
+        p.mapped_data = nullptr;
+    }
+
+    if (!p.mapped_data) {
+        log_->Info("Ray: Converting texture to %s", path.c_str());
+        if (!WriteFile(path, data, p, hash)) {
+            // file could be replaced by concurrent conversion of the same texture, try to use it
+            log_->Warning("Ray: Failed to write %s", path.c_str());
+        }
+        p.mapped_data = MapFile(path.c_str(), p.mapped_size, true /* random_access */);
+        if (!p.mapped_data || !ValidateFile(p.mapped_data, p.mapped_size, p, hash)) {
+            log_->Error("Ray: Failed to map %s", path.c_str());
+            if (p.mapped_data) {
+                UnmapFile(p.mapped_data, p.mapped_size);
+                p.mapped_data = nullptr;
+            }
+            return false;
+        }
+    }
+
+    const int pages_count = p.page_offsets[NUM_MIP_LEVELS - 1];
+    p.page_table.reset(new std::atomic<uint32_t>[std::max(pages_count, 1)]);
+    for (int i = 0; i < pages_count; ++i) {
+        p.page_table[i] = PageNotResident;
+    }
+
+    const int tail_size = p.tail_offsets[NUM_MIP_LEVELS - 1];
+    p.tail.reset(new uint8_t[tail_size]);
+    memcpy(p.tail.get(), &p.mapped_data[p.file_offsets[p.first_tail_mip]], tail_size);
+
+    return true;
+}
+
+int Ray::Ref::TexStorageVirtual::Insert(ImgData &&p) {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    int index = -1;
+    if (!free_slots_.empty()) {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        index = int(images_.size());
+        images_.resize(images_.size() + 1);
+    }
+
+    p.uid = next_uid_++;
+    if (!p.uid) {
+        // skip zero on overflow
+        p.uid = next_uid_++;
+    }
+
+    images_[index] = std::move(p);
+
+    return index;
+}
+
+int Ray::Ref::TexStorageVirtual::Allocate(const uint8_t *data, const int channels, const int res[2],
+                                          const bool mips) {
+    ImgData p;
+    if (!Prepare(data, channels, res, mips, p)) {
+        return -1;
+    }
+    return Insert(std::move(p));
+}
+
+bool Ray::Ref::TexStorageVirtual::Free(const int index) {
+    if (index < 0 || index >= int(images_.size())) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    for (int i = 0; i < slots_count_; ++i) {
+        slot_t &slot = slots_[i];
+        if (slot.img_index == index && slot.tag.load(std::memory_order_relaxed) != 0) {
+            slot.tag.store(0, std::memory_order_relaxed);
+            slot.img_index = slot.page = -1;
+        }
+    }
+
+    ImgData &p = images_[index];
+    UnmapFile(p.mapped_data, p.mapped_size);
+    p.mapped_data = nullptr;
+    p.mapped_size = 0;
+    // pending requests are dropped
+    p.uid = 0;
+    p.page_table.reset();
+    p.tail.reset();
+
+    free_slots_.push_back(index);
+
+    return true;
+}
+
+bool Ray::Ref::TexStorageVirtual::Matches(const int index, const uint8_t *data, const int channels,
+                                          const int res[2]) const {
+    const ImgData &p = images_[index];
+    if (!p.mapped_data || channels < p.channels || p.mip_res[0][0] != res[0] || p.mip_res[0][1] != res[1]) {
+        return false;
+    }
+
+    const int w = res[0], h = res[1];
+    const uint8_t *level = &p.mapped_data[p.file_offsets[0]];
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const uint8_t *texel;
+            if (p.first_tail_mip > 0) {
+                const int tile = (y / TileSize) * p.res_in_tiles[0][0] + (x / TileSize);
+                texel = &level[(size_t(tile) * TileSize * TileSize + (y % TileSize) * TileSize + (x % TileSize)) *
+                               p.channels];
+            } else {
+                texel = &level[(size_t(y) * w + x) * p.channels];
+            }
+            if (memcmp(texel, &data[(size_t(y) * w + x) * channels], p.channels) != 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void Ray::Ref::TexStorageVirtual::RequestTile(const int index, const int page, const int lod, const int tile) const {
+    const ImgData &p = images_[index];
+
+    uint32_t expected = PageNotResident;
+    if (!p.page_table[page].compare_exchange_strong(expected, PageRequested)) {
+        // already requested by other thread
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(requests_mtx_);
+        requests_.push_back({index, p.uid, page, lod, tile});
+    }
+    requests_cnd_.notify_one();
+}
+
+void Ray::Ref::TexStorageVirtual::LoaderProc() {
+    std::vector<request_t> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(requests_mtx_);
+            requests_cnd_.wait(lock, [this]() { return stop_loader_ || !requests_.empty(); });
+            if (stop_loader_) {
+                return;
+            }
+            std::swap(batch, requests_);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const request_t &req : batch) {
+            LoadTile_nolock(req);
+        }
+        batch.clear();
+    }
+}
+
+void Ray::Ref::TexStorageVirtual::LoadTile_nolock(const request_t &req) {
+    if (req.img_index >= int(images_.size()) || images_[req.img_index].uid != req.uid) {
+        // image was freed
+        return;
+    }
+
+    ImgData &p = images_[req.img_index];
+
+    const int slot_index = FindVictimSlot_nolock();
+    slot_t &slot = slots_[slot_index];
+
+    if (slot.tag.load(std::memory_order_relaxed) != 0) {
+        // evict previous tile
+        images_[slot.img_index].page_table[slot.page].store(PageNotResident, std::memory_order_relaxed);
+    }
+
+    // readers that use this slot concurrently will notice tag change and discard fetched texels
+    slot.tag.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t tile_size = size_t(TileSize) * TileSize * p.channels;
+    memcpy(&slots_data_[size_t(slot_index) * SlotSize], &p.mapped_data[p.file_offsets[req.lod] + req.tile * tile_size],
+           tile_size);
+
+    slot.img_index = req.img_index;
+    slot.page = req.page;
+    slot.referenced.store(1, std::memory_order_relaxed);
+    slot.tag.store(MakeTag(p.uid, req.page), std::memory_order_release);
+
+    p.page_table[req.page].store(uint32_t(slot_index) + 2, std::memory_order_release);
+}
+
+int Ray::Ref::TexStorageVirtual::FindVictimSlot_nolock() {
+    // Clock algorithm (approximates LRU), recently accessed slots are given second chance
+    for (int i = 0; i < 2 * slots_count_; ++i) {
+        const int ret = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % slots_count_;
+
+        slot_t &slot = slots_[ret];
+        if (slot.tag.load(std::memory_order_relaxed) == 0 || !slot.referenced.exchange(0, std::memory_order_relaxed)) {
+            return ret;
+        }
+    }
+    return clock_hand_;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "TextureStorageRef.h"
+
+namespace Ray {
+class ILog;
+namespace Ref {
+// Out-of-core texture storage. Texture is converted into tiled mip-mapped file in cache directory (once, file is reused
+// while content matches), file is memory-mapped and tiles are copied into fixed-size resident cache by background
+// thread on demand. Access to non-resident tile returns texel of coarser mip level, mip tail (levels that fit in
+// single tile) is always resident.
+class TexStorageVirtual : public TexStorageBase {
+  public:
+    static const int TileSize = 64;
+
+    struct ImgData {
+        int res[NUM_MIP_LEVELS][2];      // includes additional row/column (same as other storages)
+        int mip_res[NUM_MIP_LEVELS][2];  // actual mip level resolution (used for fallback to coarser level)
+        int res_in_tiles[NUM_MIP_LEVELS][2];
+        int page_offsets[NUM_MIP_LEVELS];
+        int tail_offsets[NUM_MIP_LEVELS];
+        uint64_t file_offsets[NUM_MIP_LEVELS];
+        int channels, mip_count, first_tail_mip;
+        bool use_mips;
+        uint32_t uid; // zero for free images
+        std::unique_ptr<std::atomic<uint32_t>[]> page_table;
+        std::unique_ptr<uint8_t[]> tail;
+        const uint8_t *mapped_data;
+        size_t mapped_size;
+    };
+
+  private:
+    // cache slot fits tile of 4-channel texture
+    static const int SlotSize = TileSize * TileSize * 4;
+
+    // values of page table entries (otherwise it is resident slot index + 2)
+    static const uint32_t PageNotResident = 0;
+    static const uint32_t PageRequested = 1;
+
+    struct slot_t {
+        std::atomic<uint64_t> tag; // (uid << 32) | page, zero for free slot
+        std::atomic<uint8_t> referenced;
+        int img_index, page; // owner, accessed by loader only
+    };
+
+    struct request_t {
+        int img_index;
+        uint32_t uid;
+        int page, lod, tile;
+    };
+
+    ILog *log_ = nullptr;
+    std::string cache_dir_;
+    uint32_t next_uid_ = 1;
+
+    std::vector<ImgData> images_;
+    std::vector<int> free_slots_;
+
+    std::unique_ptr<slot_t[]> slots_;
+    std::unique_ptr<uint8_t[]> slots_data_;
+    int slots_count_ = 0, clock_hand_ = 0;
+
+    // guards images_ and slots against concurrent access from loader thread
+    std::mutex mtx_;
+
+    mutable std::mutex requests_mtx_;
+    mutable std::condition_variable requests_cnd_;
+    mutable std::vector<request_t> requests_;
+    std::thread loader_thread_;
+    bool stop_loader_ = false;
+
+    static uint64_t MakeTag(const uint32_t uid, const int page) { return (uint64_t(uid) << 32) | uint32_t(page); }
+
+    static void InitLayout(ImgData &p, const int res[2], int channels, bool mips);
+    static bool WriteFile(const std::string &path, const uint8_t *data, const ImgData &layout, uint64_t hash);
+    static bool ValidateFile(const uint8_t *mapped_data, size_t mapped_size, const ImgData &layout, uint64_t hash);
+    void RequestTile(int index, int page, int lod, int tile) const;
+    void LoaderProc();
+    void LoadTile_nolock(const request_t &req);
+    int FindVictimSlot_nolock();
+
+    force_inline static color_rgba8_t ExpandTexel(const uint8_t *texel, const int channels) {
+        color_rgba8_t ret;
+        for (int i = 0; i < 4; ++i) {
+            ret.v[i] = texel[std::min(i, channels - 1)];
+        }
+        return ret;
+    }
+
+    force_inline bool TryGetResident(const int index, const int x, const int y, const int lod,
+                                     color_rgba8_t &out_col) const {
+        const ImgData &p = images_[index];
+
+        const int tile = (y / TileSize) * p.res_in_tiles[lod][0] + (x / TileSize);
+        const int page = p.page_offsets[lod] + tile;
+
+        const uint32_t entry = p.page_table[page].load(std::memory_order_acquire);
+        if (entry == PageNotResident) {
+            RequestTile(index, page, lod, tile);
+            return false;
+        } else if (entry == PageRequested) {
+            return false;
+        }
+
+        slot_t &slot = slots_[entry - 2];
+        const uint64_t tag = MakeTag(p.uid, page);
+        if (slot.tag.load(std::memory_order_acquire) != tag) {
+            // slot is being reused
+            return false;
+        }
+
+        const uint8_t *texel = &slots_data_[size_t(entry - 2) * SlotSize +
+                                            ((y % TileSize) * TileSize + (x % TileSize)) * p.channels];
+        out_col = ExpandTexel(texel, p.channels);
+
+        // make sure slot was not evicted while texel was read (seqlock-like check)
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.tag.load(std::memory_order_relaxed) != tag) {
+            return false;
+        }
+
+        // avoid writing shared cache line if not needed
+        if (!slot.referenced.load(std::memory_order_relaxed)) {
+            slot.referenced.store(1, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+  public:
+    TexStorageVirtual() = default;
+    TexStorageVirtual(const TexStorageVirtual &rhs) = delete;
+    ~TexStorageVirtual() override;
+
+    // Storage is unusable until initialized
+    void Init(ILog *log, const char *cache_dir, size_t budget);
+    bool enabled() const { return slots_count_ != 0; }
+    int slots_count() const { return slots_count_; }
+    // Number of tiles currently held in cache slots (never exceeds slots count)
+    int resident_tiles_count() const;
+
+    force_inline int img_count() const { return int(images_.size() - free_slots_.size()); }
+
+    force_inline color_rgba8_t Get(const int index, int x, int y, int lod) const {
+        const ImgData &p = images_[index];
+
+        lod = p.use_mips ? std::min(lod, p.mip_count - 1) : 0;
+
+        // last row/column is a copy of the first one
+        x = (x < p.res[lod][0] - 1) ? x : 0;
+        y = (y < p.res[lod][1] - 1) ? y : 0;
+
+        color_rgba8_t ret;
+        while (lod < p.first_tail_mip) {
+            if (TryGetResident(index, x, y, lod, ret)) {
+                return ret;
+            }
+            // fall back to coarser level until tile arrives
+            ++lod;
+            x = std::min(x / 2, p.mip_res[lod][0] - 1);
+            y = std::min(y / 2, p.mip_res[lod][1] - 1);
+        }
+
+        return ExpandTexel(&p.tail[p.tail_offsets[lod] + size_t(y * p.mip_res[lod][0] + x) * p.channels], p.channels);
+    }
+
+    force_inline color_rgba8_t Get(const int index, float x, float y, const int lod) const {
+        const ImgData &p = images_[index];
+        const int w = p.res[lod][0] - 1;
+        const int h = p.res[lod][1] - 1;
+
+        x -= std::floor(x);
+        y -= std::floor(y);
+
+        return Get(index, int(x * w - 0.5f), int(y * h - 0.5f), lod);
+    }
+
+    force_inline const int *res(const int index) const { return &images_[index].res[0][0]; }
+
+    // Resident part only (mip tail and page table), tiles are accounted in cache budget
+    size_t mem_size(const int index) const override {
+        const ImgData &p = images_[index];
+        return size_t(p.tail_offsets[NUM_MIP_LEVELS - 1]) +
+               size_t(p.page_offsets[NUM_MIP_LEVELS - 1]) * sizeof(std::atomic<uint32_t>);
+    }
+
+    void GetIRes(const int index, const int lod, int res[2]) const override {
+        const ImgData &p = images_[index];
+
+        res[0] = p.res[lod][0] - 1;
+        res[1] = p.res[lod][1] - 1;
+    }
+
+    void GetFRes(const int index, const int lod, float res[2]) const override {
+        const ImgData &p = images_[index];
+
+        res[0] = float(p.res[lod][0] - 1);
+        res[1] = float(p.res[lod][1] - 1);
+    }
+
+    color_rgba_t Fetch(const int index, const int x, const int y, const int lod) const override {
+        const color_rgba8_t col = Get(index, x, y, lod);
+
+        color_rgba_t ret;
+        for (int i = 0; i < 4; ++i) {
+            ret.v[i] = float(col.v[i]) / 255.0f;
+        }
+        return ret;
+    }
+
+    color_rgba_t Fetch(const int index, const float x, const float y, const int lod) const override {
+        const color_rgba8_t col = Get(index, x, y, lod);
+
+        color_rgba_t ret;
+        for (int i = 0; i < 4; ++i) {
+            ret.v[i] = float(col.v[i]) / 255.0f;
+        }
+        return ret;
+    }
+
+    // Converts texture into cache file and maps it (can be called concurrently), returns false if file can not be
+    // written or mapped
+    bool Prepare(const uint8_t *data, int channels, const int res[2], bool mips, ImgData &out_img) const;
+    int Insert(ImgData &&img);
+
+    // Returns -1 if cache file can not be written or mapped
+    int Allocate(const uint8_t *data, int channels, const int res[2], bool mips);
+    bool Free(int index) override;
+    // Compared with base level in cache file
+    bool Matches(int index, const uint8_t *data, int channels, const int res[2]) const override;
+};
+} // namespace Ref
+} // namespace Ray
@@ -7,6 +7,18 @@
 
 #include "simd/detect.h"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define _MIN(x, y) ((x) < (y) ? (x) : (y))
 #define _MAX(x, y) ((x) < (y) ? (y) : (x))
 #define _ABS(x) ((x) < 0 ? -(x) : (x))
@@ -149,6 +161,151 @@ const uint8_t _blank_ASTC_block_4x4[] = {0xFC, 0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xF
 const int _blank_ASTC_block_4x4_len = sizeof(_blank_ASTC_block_4x4);
 } // namespace Ray
 
+// MurmurHash64A
+uint64_t Ray::HashData(const void *data, const size_t size, const uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+
+    uint64_t h = seed ^ (uint64_t(size) * m);
+
+    const auto *p = reinterpret_cast<const uint8_t *>(data);
+    const uint8_t *end = p + (size & ~size_t(7));
+    for (; p != end; p += 8) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(uint64_t));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    if (size & 7) {
+        uint64_t k = 0;
+        for (int i = int(size & 7) - 1; i >= 0; --i) {
+            k = (k << 8) | p[i];
+        }
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+namespace Ray {
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+void HashAccumulate_SSE2(const uint8_t data[], size_t stripes_count, const uint64_t secret[8], uint64_t acc[8]);
+#endif
+
+const uint64_t HashSecret[8] = {0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+                                0x85EBCA77C2B2AE63ull, 0x27D4EB2F165667C5ull, 0xBE4BA423396CFEB8ull,
+                                0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull};
+
+// Accumulates 64-byte stripes, accumulators are scrambled after each 16 stripes (xxh3-style)
+void HashAccumulate_Ref(const uint8_t data[], const size_t stripes_count, const uint64_t secret[8], uint64_t acc[8]) {
+    for (size_t i = 0; i < stripes_count; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            uint64_t v;
+            memcpy(&v, &data[64 * i + 8 * j], sizeof(uint64_t));
+            const uint64_t k = v ^ secret[j];
+            acc[j ^ 1] += v;
+            acc[j] += (k & 0xffffffff) * (k >> 32);
+        }
+        if ((i % 16) == 15) {
+            for (int j = 0; j < 8; ++j) {
+                acc[j] = (acc[j] ^ (acc[j] >> 47) ^ secret[j]) * 0x9E3779B1ull;
+            }
+        }
+    }
+}
+} // namespace Ray
+
+uint64_t Ray::HashData_Fast(const void *data, const size_t size, const uint64_t seed) {
+    uint64_t acc[8] = {0x00000000C2B2AE3Dull, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+                       0x85EBCA77C2B2AE63ull, 0x0000000085EBCA77ull, 0x27D4EB2F165667C5ull, 0x000000009E3779B1ull};
+
+    const auto *p = reinterpret_cast<const uint8_t *>(data);
+    const size_t stripes_count = size / 64;
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+    HashAccumulate_SSE2(p, stripes_count, HashSecret, acc);
+#else
+    HashAccumulate_Ref(p, stripes_count, HashSecret, acc);
+#endif
+
+    // accumulators and remaining bytes are merged with regular hash
+    const uint64_t h = HashData(acc, sizeof(acc), seed ^ uint64_t(size));
+    return HashData(&p[64 * stripes_count], size % 64, h);
+}
+
+const uint8_t *Ray::MapFile(const char *path, size_t &out_size, const bool random_access) {
+#ifdef _WIN32
+    const DWORD access_hint = random_access ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | access_hint, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    // view keeps mapping alive
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        return nullptr;
+    }
+
+    out_size = size_t(size.QuadPart);
+    return reinterpret_cast<const uint8_t *>(data);
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    // readahead is not helpful for sparse access
+    madvise(data, size_t(st.st_size), random_access ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+    out_size = size_t(st.st_size);
+    return reinterpret_cast<const uint8_t *>(data);
+#endif
+}
+
+void Ray::UnmapFile(const uint8_t *data, const size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<uint8_t *>(data), size);
+#endif
+}
+
 void Ray::RGBMDecode(const uint8_t rgbm[4], float out_rgb[3]) {
     out_rgb[0] = 4.0f * (rgbm[0] / 255.0f) * (rgbm[3] / 255.0f);
     out_rgb[1] = 4.0f * (rgbm[1] / 255.0f) * (rgbm[3] / 255.0f);
@@ -518,6 +675,72 @@ int Ray::InitMipMapsRGBM(std::unique_ptr<uint8_t[]> mipmaps[16], int widths[16],
     return mip_count;
 }
 
+namespace Ray {
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+template <int Channels>
+int DownsampleRow_Box_SSE2(const uint8_t row0[], const uint8_t row1[], int count, uint8_t out_row[]);
+#endif
+
+// Returns number of processed texels (vectorized part)
+template <int Channels>
+force_inline int DownsampleRow_Box_Fast(const uint8_t row0[], const uint8_t row1[], const int count,
+                                        uint8_t out_row[]) {
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+    return DownsampleRow_Box_SSE2<Channels>(row0, row1, count, out_row);
+#else
+    return 0;
+#endif
+}
+// 3-channel texels do not map onto 16-byte vectors
+template <>
+force_inline int DownsampleRow_Box_Fast<3>(const uint8_t row0[], const uint8_t row1[], const int count,
+                                           uint8_t out_row[]) {
+    return 0;
+}
+
+template <int Channels>
+void DownsampleImage_Box(const uint8_t in_data[], const int w, const int h, uint8_t out_data[], const int out_w,
+                         const int out_h) {
+    // output texels which do not need clamping
+    const int full_count = std::min(out_w, w / 2);
+
+    for (int y = 0; y < out_h; ++y) {
+        const uint8_t *row0 = &in_data[size_t(std::min(2 * y + 0, h - 1)) * w * Channels];
+        const uint8_t *row1 = &in_data[size_t(std::min(2 * y + 1, h - 1)) * w * Channels];
+        uint8_t *out_row = &out_data[size_t(y) * out_w * Channels];
+
+        int x = DownsampleRow_Box_Fast<Channels>(row0, row1, full_count, out_row);
+        for (; x < out_w; ++x) {
+            const int x0 = std::min(2 * x + 0, w - 1) * Channels, x1 = std::min(2 * x + 1, w - 1) * Channels;
+            for (int j = 0; j < Channels; ++j) {
+                const int sum = row0[x0 + j] + row0[x1 + j] + row1[x0 + j] + row1[x1 + j];
+                out_row[x * Channels + j] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+}
+} // namespace Ray
+
+void Ray::DownsampleImage_Box(const uint8_t in_data[], const int w, const int h, const int channels,
+                              uint8_t out_data[], const int out_w, const int out_h) {
+    switch (channels) {
+    case 1:
+        DownsampleImage_Box<1>(in_data, w, h, out_data, out_w, out_h);
+        break;
+    case 2:
+        DownsampleImage_Box<2>(in_data, w, h, out_data, out_w, out_h);
+        break;
+    case 3:
+        DownsampleImage_Box<3>(in_data, w, h, out_data, out_w, out_h);
+        break;
+    case 4:
+        DownsampleImage_Box<4>(in_data, w, h, out_data, out_w, out_h);
+        break;
+    default:
+        assert(false && "Unsupported channels count!");
+    }
+}
+
 void Ray::ReorderTriangleIndices(const uint32_t *indices, const uint32_t indices_count, const uint32_t vtx_count,
                                  uint32_t *out_indices) {
     // From https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
@@ -1566,6 +1789,117 @@ template void Ray::CompressImage_BC5<4 /* SrcChannels */>(const uint8_t img_src[
 template void Ray::CompressImage_BC5<3 /* SrcChannels */>(const uint8_t img_src[], int w, int h, uint8_t img_dst[]);
 template void Ray::CompressImage_BC5<2 /* SrcChannels */>(const uint8_t img_src[], int w, int h, uint8_t img_dst[]);
 
+namespace Ray {
+void DecodeAlphaBlock_Ref(const uint8_t block[8], uint8_t out_alpha[16]) {
+    const int a0 = block[0], a1 = block[1];
+
+    uint8_t alphas[8] = {uint8_t(a0), uint8_t(a1)};
+    if (a0 > a1) {
+        for (int i = 1; i < 7; ++i) {
+            alphas[i + 1] = uint8_t(((7 - i) * a0 + i * a1) / 7);
+        }
+    } else {
+        for (int i = 1; i < 5; ++i) {
+            alphas[i + 1] = uint8_t(((5 - i) * a0 + i * a1) / 5);
+        }
+        alphas[6] = 0;
+        alphas[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) {
+        bits |= uint64_t(block[2 + i]) << (8 * i);
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        out_alpha[i] = alphas[(bits >> (3 * i)) & 0x7];
+    }
+}
+
+void DecodeColorBlock_Ref(const uint8_t block[8], const uint8_t alpha[16], uint8_t out_rgba[64]) {
+    uint8_t colors[4][3];
+    for (int i = 0; i < 2; ++i) {
+        const uint16_t c = uint16_t(block[2 * i] | (block[2 * i + 1] << 8));
+        // expanded the same way as during compression (see EmitColorIndices_Ref)
+        colors[i][0] = uint8_t(((c >> 11) << 3) | ((c >> 11) >> 2));
+        colors[i][1] = uint8_t((((c >> 5) & 0x3f) << 2) | (((c >> 5) & 0x3f) >> 4));
+        colors[i][2] = uint8_t(((c & 0x1f) << 3) | ((c & 0x1f) >> 2));
+    }
+    for (int j = 0; j < 3; ++j) {
+        colors[2][j] = uint8_t((2 * colors[0][j] + 1 * colors[1][j]) / 3);
+        colors[3][j] = uint8_t((1 * colors[0][j] + 2 * colors[1][j]) / 3);
+    }
+
+    const uint32_t bits = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) |
+                          (uint32_t(block[7]) << 24);
+    for (int i = 0; i < 16; ++i) {
+        const uint8_t *col = colors[(bits >> (2 * i)) & 0x3];
+        out_rgba[4 * i + 0] = col[0];
+        out_rgba[4 * i + 1] = col[1];
+        out_rgba[4 * i + 2] = col[2];
+        out_rgba[4 * i + 3] = alpha[i];
+    }
+}
+
+// Inverse of ScaleYCoCg_Ref + RGB_to_YCoCg, block is converted in-place (alpha is set to 255)
+void ConvertCoCgxY_to_RGB_Block_Ref(uint8_t block[64]) {
+    // scale is the same for the whole block (stored in unused blue channel)
+    const int scale = (block[2] >> 3) + 1;
+    const int shift = (scale == 4) ? 2 : (scale == 2 ? 1 : 0);
+    const int round = (scale >> 1);
+
+    for (int i = 0; i < 16; ++i) {
+        const int Co = int(block[4 * i + 0]) - 128, Cg = int(block[4 * i + 1]) - 128, Y = int(block[4 * i + 3]);
+
+        block[4 * i + 0] = to_clamped_uint8((Y * scale + Co - Cg + round) >> shift);
+        block[4 * i + 1] = to_clamped_uint8((Y * scale + Cg + round) >> shift);
+        block[4 * i + 2] = to_clamped_uint8((Y * scale - Co - Cg + round) >> shift);
+        block[4 * i + 3] = 255;
+    }
+}
+
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+void DecodeAlphaBlock_SSE2(const uint8_t block[8], uint8_t out_alpha[16]);
+void DecodeColorBlock_SSE2(const uint8_t block[8], const uint8_t alpha[16], uint8_t out_rgba[64]);
+#endif
+} // namespace Ray
+
+// NOTE: SSE2 is always available on x86-64 (and required by the rest of the library), so there is no runtime check
+template <bool Is_YCoCg> void Ray::DecodeBlock_BC3(const uint8_t block[16], uint8_t out_rgba[64]) {
+    alignas(16) uint8_t alpha[16];
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+    DecodeAlphaBlock_SSE2(block, alpha);
+    DecodeColorBlock_SSE2(block + 8, alpha, out_rgba);
+#else
+    DecodeAlphaBlock_Ref(block, alpha);
+    DecodeColorBlock_Ref(block + 8, alpha, out_rgba);
+#endif
+    if (Is_YCoCg) {
+        ConvertCoCgxY_to_RGB_Block_Ref(out_rgba);
+    }
+}
+
+template void Ray::DecodeBlock_BC3<false /* Is_YCoCg */>(const uint8_t block[16], uint8_t out_rgba[64]);
+template void Ray::DecodeBlock_BC3<true /* Is_YCoCg */>(const uint8_t block[16], uint8_t out_rgba[64]);
+
+void Ray::DecodeBlock_BC4(const uint8_t block[8], uint8_t out_r[16]) {
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+    DecodeAlphaBlock_SSE2(block, out_r);
+#else
+    DecodeAlphaBlock_Ref(block, out_r);
+#endif
+}
+
+void Ray::DecodeBlock_BC5(const uint8_t block[16], uint8_t out_rg[32]) {
+    uint8_t r[16], g[16];
+    DecodeBlock_BC4(block, r);
+    DecodeBlock_BC4(block + 8, g);
+    for (int i = 0; i < 16; ++i) {
+        out_rg[2 * i + 0] = r[i];
+        out_rg[2 * i + 1] = g[i];
+    }
+}
+
 #undef _MIN
 #undef _MAX
 #undef _ABS
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include <memory>
@@ -44,6 +45,10 @@ int InitMipMaps(std::unique_ptr<uint8_t[]> mipmaps[16], int widths[16], int heig
                 const eMipOp op[4]);
 int InitMipMapsRGBM(std::unique_ptr<uint8_t[]> mipmaps[16], int widths[16], int heights[16]);
 
+// Builds next mip level with 2x2 box filter (rounded average, texels outside of image are clamped), out_w/out_h must
+// be either rounded down or rounded up half of w/h
+void DownsampleImage_Box(const uint8_t in_data[], int w, int h, int channels, uint8_t out_data[], int out_w, int out_h);
+
 void ReorderTriangleIndices(const uint32_t *indices, uint32_t indices_count, uint32_t vtx_count, uint32_t *out_indices);
 
 uint16_t f32_to_f16(float value);
@@ -127,6 +132,15 @@ static_assert(sizeof(DDSHeader) == 128, "!");
 extern const uint8_t _blank_BC3_block_4x4[];
 extern const int _blank_BC3_block_4x4_len;
 
+// Fast non-cryptographic hash (used to identify data cached on disk)
+uint64_t HashData(const void *data, size_t size, uint64_t seed = 0);
+// Hash with independent accumulators (xxh3-style, SSE2), several times faster than HashData on large buffers
+uint64_t HashData_Fast(const void *data, size_t size, uint64_t seed = 0);
+
+// Read-only file mapping (empty files can not be mapped)
+const uint8_t *MapFile(const char *path, size_t &out_size, bool random_access = false);
+void UnmapFile(const uint8_t *data, size_t size);
+
 extern const uint8_t _blank_ASTC_block_4x4[];
 extern const int _blank_ASTC_block_4x4_len;
 
@@ -144,4 +158,12 @@ template <int SrcChannels> void CompressImage_BC1(const uint8_t img_src[], int w
 template <bool Is_YCoCg = false> void CompressImage_BC3(const uint8_t img_src[], int w, int h, uint8_t img_dst[]);
 template <int SrcChannels = 1> void CompressImage_BC4(const uint8_t img_src[], int w, int h, uint8_t img_dst[]);
 template <int SrcChannels = 2> void CompressImage_BC5(const uint8_t img_src[], int w, int h, uint8_t img_dst[]);
+
+//
+// BCn decompression (single 4x4 block, texels are written row by row)
+//
+
+template <bool Is_YCoCg = false> void DecodeBlock_BC3(const uint8_t block[16], uint8_t out_rgba[64]);
+void DecodeBlock_BC4(const uint8_t block[8], uint8_t out_r[16]);
+void DecodeBlock_BC5(const uint8_t block[16], uint8_t out_rg[32]);
 }
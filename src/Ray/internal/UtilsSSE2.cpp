@@ -577,6 +577,191 @@ void EmitAlphaIndices_SSE2(const uint8_t block[64], const uint8_t min_alpha, con
     out_data += 6;
 }
 
+//
+// Decompression
+//
+
+static const __m128i AlphaIndexMask[8] = {
+    _mm_setr_epi8(7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0),
+    _mm_setr_epi8(0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0),
+    _mm_setr_epi8(0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0),
+    _mm_setr_epi8(0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0),
+    _mm_setr_epi8(0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0),
+    _mm_setr_epi8(0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0),
+    _mm_setr_epi8(0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7, 0),
+    _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 7)};
+
+static const __m128i ColorIndexMask[4] = {_mm_set1_epi32(3 << 0), _mm_set1_epi32(3 << 8), _mm_set1_epi32(3 << 16),
+                                          _mm_set1_epi32(3 << 24)};
+
+void DecodeAlphaBlock_SSE2(const uint8_t block[8], uint8_t out_alpha[16]) {
+    const int a0 = block[0], a1 = block[1];
+
+    alignas(16) uint8_t alphas[8] = {uint8_t(a0), uint8_t(a1)};
+    if (a0 > a1) {
+        for (int i = 1; i < 7; ++i) {
+            alphas[i + 1] = uint8_t(((7 - i) * a0 + i * a1) / 7);
+        }
+    } else {
+        for (int i = 1; i < 5; ++i) {
+            alphas[i + 1] = uint8_t(((5 - i) * a0 + i * a1) / 5);
+        }
+        alphas[6] = 0;
+        alphas[7] = 255;
+    }
+
+    // 3-bit indices of texels 0-7 go to lower half, 8-15 to upper half
+    const uint64_t lo = uint64_t(block[2]) | (uint64_t(block[3]) << 8) | (uint64_t(block[4]) << 16);
+    const uint64_t hi = uint64_t(block[5]) | (uint64_t(block[6]) << 8) | (uint64_t(block[7]) << 16);
+    const __m128i bits = _mm_set_epi64x(int64_t(hi), int64_t(lo));
+
+    // spread indices to separate bytes (index k is moved from bit 3 * k to bit 8 * k)
+    __m128i index = _mm_and_si128(bits, AlphaIndexMask[0]);
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 5), AlphaIndexMask[1]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 10), AlphaIndexMask[2]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 15), AlphaIndexMask[3]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 20), AlphaIndexMask[4]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 25), AlphaIndexMask[5]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 30), AlphaIndexMask[6]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi64(bits, 35), AlphaIndexMask[7]));
+
+    // select palette entries
+    __m128i alpha = _mm_setzero_si128();
+    for (int i = 0; i < 8; ++i) {
+        const __m128i sel = _mm_cmpeq_epi8(index, _mm_set1_epi8(char(i)));
+        alpha = _mm_or_si128(alpha, _mm_and_si128(sel, _mm_set1_epi8(char(alphas[i]))));
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out_alpha), alpha);
+}
+
+void DecodeColorBlock_SSE2(const uint8_t block[8], const uint8_t alpha[16], uint8_t out_rgba[64]) {
+    uint32_t colors[4];
+    { // endpoints are expanded the same way as during compression
+        const uint16_t c0 = uint16_t(block[0] | (block[1] << 8)), c1 = uint16_t(block[2] | (block[3] << 8));
+        uint8_t rgb[4][3];
+        rgb[0][0] = uint8_t(((c0 >> 11) << 3) | ((c0 >> 11) >> 2));
+        rgb[0][1] = uint8_t((((c0 >> 5) & 0x3f) << 2) | (((c0 >> 5) & 0x3f) >> 4));
+        rgb[0][2] = uint8_t(((c0 & 0x1f) << 3) | ((c0 & 0x1f) >> 2));
+        rgb[1][0] = uint8_t(((c1 >> 11) << 3) | ((c1 >> 11) >> 2));
+        rgb[1][1] = uint8_t((((c1 >> 5) & 0x3f) << 2) | (((c1 >> 5) & 0x3f) >> 4));
+        rgb[1][2] = uint8_t(((c1 & 0x1f) << 3) | ((c1 & 0x1f) >> 2));
+        for (int j = 0; j < 3; ++j) {
+            rgb[2][j] = uint8_t((2 * rgb[0][j] + 1 * rgb[1][j]) / 3);
+            rgb[3][j] = uint8_t((1 * rgb[0][j] + 2 * rgb[1][j]) / 3);
+        }
+        for (int i = 0; i < 4; ++i) {
+            colors[i] = uint32_t(rgb[i][0]) | (uint32_t(rgb[i][1]) << 8) | (uint32_t(rgb[i][2]) << 16);
+        }
+    }
+
+    // each 32-bit lane holds 2-bit indices of one row, they are spread to separate bytes
+    const uint32_t bits = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) |
+                          (uint32_t(block[7]) << 24);
+    const __m128i row_bits = _mm_setr_epi32(int(bits), int(bits >> 8), int(bits >> 16), int(bits >> 24));
+
+    __m128i index = _mm_and_si128(row_bits, ColorIndexMask[0]);
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi32(row_bits, 6), ColorIndexMask[1]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi32(row_bits, 12), ColorIndexMask[2]));
+    index = _mm_or_si128(index, _mm_and_si128(_mm_slli_epi32(row_bits, 18), ColorIndexMask[3]));
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha));
+    const __m128i index16[2] = {_mm_unpacklo_epi8(index, zero), _mm_unpackhi_epi8(index, zero)};
+    const __m128i alpha16[2] = {_mm_unpacklo_epi8(zero, alpha8), _mm_unpackhi_epi8(zero, alpha8)};
+
+    for (int i = 0; i < 4; ++i) {
+        // one row of 4 texels
+        const __m128i index32 = (i % 2) == 0 ? _mm_unpacklo_epi16(index16[i / 2], zero)
+                                             : _mm_unpackhi_epi16(index16[i / 2], zero);
+        __m128i rgba = (i % 2) == 0 ? _mm_unpacklo_epi16(zero, alpha16[i / 2])
+                                    : _mm_unpackhi_epi16(zero, alpha16[i / 2]);
+        for (int j = 0; j < 4; ++j) {
+            const __m128i sel = _mm_cmpeq_epi32(index32, _mm_set1_epi32(j));
+            rgba = _mm_or_si128(rgba, _mm_and_si128(sel, _mm_set1_epi32(int(colors[j]))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&out_rgba[16 * i]), rgba);
+    }
+}
+
+// Sums of horizontally adjacent texels (in 16-bit lanes) are packed into lower 4 lanes
+template <int Channels> inline __m128i SumTexelPairs(__m128i v);
+template <> inline __m128i SumTexelPairs<1>(const __m128i v) {
+    const __m128i sums = _mm_madd_epi16(v, _mm_set1_epi16(1));
+    return _mm_packs_epi32(sums, sums);
+}
+template <> inline __m128i SumTexelPairs<2>(const __m128i v) {
+    return _mm_shuffle_epi32(_mm_add_epi16(v, _mm_srli_si128(v, 4)), _MM_SHUFFLE(3, 1, 2, 0));
+}
+template <> inline __m128i SumTexelPairs<4>(const __m128i v) { return _mm_add_epi16(v, _mm_srli_si128(v, 8)); }
+
+template <int Channels>
+int DownsampleRow_Box_SSE2(const uint8_t row0[], const uint8_t row1[], const int count, uint8_t out_row[]) {
+    const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+
+    // 32 bytes of each source row produce 16 output bytes
+    int i = 0;
+    for (; i + 16 <= count * Channels; i += 16) {
+        const __m128i r0[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i *>(&row0[2 * i])),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i *>(&row0[2 * i + 16]))};
+        const __m128i r1[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i *>(&row1[2 * i])),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i *>(&row1[2 * i + 16]))};
+
+        __m128i sums[4];
+        for (int j = 0; j < 2; ++j) {
+            sums[2 * j + 0] = SumTexelPairs<Channels>(
+                _mm_add_epi16(_mm_unpacklo_epi8(r0[j], zero), _mm_unpacklo_epi8(r1[j], zero)));
+            sums[2 * j + 1] = SumTexelPairs<Channels>(
+                _mm_add_epi16(_mm_unpackhi_epi8(r0[j], zero), _mm_unpackhi_epi8(r1[j], zero)));
+        }
+
+        const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[0], sums[1]), two), 2);
+        const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[2], sums[3]), two), 2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&out_row[i]), _mm_packus_epi16(lo, hi));
+    }
+
+    return i / Channels;
+}
+
+template int DownsampleRow_Box_SSE2<1>(const uint8_t row0[], const uint8_t row1[], int count, uint8_t out_row[]);
+template int DownsampleRow_Box_SSE2<2>(const uint8_t row0[], const uint8_t row1[], int count, uint8_t out_row[]);
+template int DownsampleRow_Box_SSE2<4>(const uint8_t row0[], const uint8_t row1[], int count, uint8_t out_row[]);
+
+void HashAccumulate_SSE2(const uint8_t data[], const size_t stripes_count, const uint64_t secret[8], uint64_t acc[8]) {
+    __m128i vacc[4], vsecret[4];
+    for (int j = 0; j < 4; ++j) {
+        vacc[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&acc[2 * j]));
+        vsecret[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&secret[2 * j]));
+    }
+
+    const __m128i prime = _mm_set1_epi32(int(0x9E3779B1));
+
+    for (size_t i = 0; i < stripes_count; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&data[64 * i + 16 * j]));
+            const __m128i k = _mm_xor_si128(v, vsecret[j]);
+            // acc[i] += lo32(k) * hi32(k), acc[i ^ 1] += v
+            const __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+            vacc[j] = _mm_add_epi64(vacc[j], _mm_add_epi64(product, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        if ((i % 16) == 15) {
+            // scramble
+            for (int j = 0; j < 4; ++j) {
+                __m128i a = _mm_xor_si128(vacc[j], _mm_srli_epi64(vacc[j], 47));
+                a = _mm_xor_si128(a, vsecret[j]);
+                const __m128i lo = _mm_mul_epu32(a, prime);
+                const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+                vacc[j] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+            }
+        }
+    }
+
+    for (int j = 0; j < 4; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&acc[2 * j]), vacc[j]);
+    }
+}
+
 } // namespace Ren
 
 #undef _ABS
@@ -1,5 +1,7 @@
 #include "detect.h"
 
+#include <cstring>
+
 namespace Ray {
 bool g_cpu_features_initialized = false;
 CpuFeatures g_cpu_features;
@@ -13,6 +15,9 @@ CpuFeatures g_cpu_features;
 inline void cpuid(int info[4], int InfoType) {
     __cpuid_count(InfoType, 0, info[0], info[1], info[2], info[3]);
 }
+inline void cpuidex(int info[4], int InfoType, int SubType) {
+    __cpuid_count(InfoType, SubType, info[0], info[1], info[2], info[3]);
+}
 #if defined(__GNUC__) && (__GNUC__ < 9)
 inline unsigned long long _xgetbv(unsigned int index) {
     unsigned int eax, edx;
@@ -26,6 +31,7 @@ inline unsigned long long _xgetbv(unsigned int index) {
 #endif
 #else
 #define cpuid(info, x)    __cpuidex(info, x, 0)
+#define cpuidex(info, x, sub)    __cpuidex(info, x, sub)
 #endif
 
 #else
@@ -37,6 +43,9 @@ inline unsigned long long _xgetbv(unsigned int index) {
 inline void cpuid(int info[4], int InfoType) {
     __cpuid_count(InfoType, 0, info[0], info[1], info[2], info[3]);
 }
+inline void cpuidex(int info[4], int InfoType, int SubType) {
+    __cpuid_count(InfoType, SubType, info[0], info[1], info[2], info[3]);
+}
 #if defined(__GNUC__) && (__GNUC__ < 9) && !defined(__APPLE__) && !defined(_xgetbv)
 inline unsigned long long _xgetbv(unsigned int index) {
     unsigned int eax, edx;
@@ -52,15 +61,71 @@ inline unsigned long long _xgetbv(unsigned int index) {
 
 #endif
 
+namespace Ray {
+#if !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64) && !defined(__ANDROID__)
+void DetectCacheSizes(const int ids_count, const unsigned ex_ids_count, CpuFeatures &out_features) {
+    int info[4];
+    if (strcmp(out_features.vendor, "GenuineIntel") == 0 && ids_count >= 0x00000004) {
+        // Deterministic cache parameters leaf
+        for (int i = 0; i < 16; ++i) {
+            cpuidex(info, 0x00000004, i);
+            const int type = (info[0] & 0x1f);
+            if (type == 0) {
+                break;
+            }
+            const int level = (info[0] >> 5) & 0x7;
+            const unsigned ways = ((unsigned(info[1]) >> 22) & 0x3ff) + 1;
+            const unsigned partitions = ((unsigned(info[1]) >> 12) & 0x3ff) + 1;
+            const unsigned line_size = (unsigned(info[1]) & 0xfff) + 1;
+            const unsigned sets = unsigned(info[2]) + 1;
+            const unsigned size = ways * partitions * line_size * sets;
+            if (level == 1 && type == 1) { // data cache
+                out_features.l1d_cache_size = size;
+                out_features.cache_line_size = line_size;
+            } else if (level == 2 && type != 2) {
+                out_features.l2_cache_size = size;
+            } else if (level == 3 && type != 2) {
+                out_features.l3_cache_size = size;
+            }
+        }
+    } else {
+        // AMD-style extended leaves
+        if (ex_ids_count >= 0x80000005) {
+            cpuid(info, 0x80000005);
+            out_features.l1d_cache_size = ((unsigned(info[2]) >> 24) & 0xff) * 1024;
+            out_features.cache_line_size = (unsigned(info[2]) & 0xff);
+        }
+        if (ex_ids_count >= 0x80000006) {
+            cpuid(info, 0x80000006);
+            out_features.l2_cache_size = ((unsigned(info[2]) >> 16) & 0xffff) * 1024;
+            out_features.l3_cache_size = ((unsigned(info[3]) >> 18) & 0x3fff) * 512 * 1024;
+        }
+    }
+}
+#endif
+} // namespace Ray
+
 Ray::CpuFeatures Ray::GetCpuFeatures() {
     if (!g_cpu_features_initialized) {
+        memset(&g_cpu_features, 0, sizeof(CpuFeatures));
 #if !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64) && !defined(__ANDROID__)
         int info[4];
         cpuid(info, 0);
         int ids_count = info[0];
 
+        memcpy(&g_cpu_features.vendor[0], &info[1], 4);
+        memcpy(&g_cpu_features.vendor[4], &info[3], 4);
+        memcpy(&g_cpu_features.vendor[8], &info[2], 4);
+
         cpuid(info, 0x80000000);
-        // unsigned ex_ids_count = info[0];
+        const unsigned ex_ids_count = unsigned(info[0]);
+
+        if (ex_ids_count >= 0x80000004) {
+            for (int i = 0; i < 3; ++i) {
+                cpuid(info, 0x80000002 + i);
+                memcpy(&g_cpu_features.brand[16 * i], info, 16);
+            }
+        }
 
         //  Detect Features
         if (ids_count >= 0x00000001) {
@@ -69,17 +134,23 @@ Ray::CpuFeatures Ray::GetCpuFeatures() {
             g_cpu_features.sse3_supported = (info[2] & ((int)1 << 0)) != 0;
             g_cpu_features.ssse3_supported = (info[2] & ((int)1 << 9)) != 0;
             g_cpu_features.sse41_supported = (info[2] & ((int)1 << 19)) != 0;
+            g_cpu_features.sse42_supported = (info[2] & ((int)1 << 20)) != 0;
+            g_cpu_features.popcnt_supported = (info[2] & ((int)1 << 23)) != 0;
 
             bool os_uses_XSAVE_XRSTORE = (info[2] & (1 << 27)) != 0;
-            bool os_saves_YMM = false;
+            bool os_saves_YMM = false, os_saves_ZMM = false;
             if (os_uses_XSAVE_XRSTORE) {
                 // Check if the OS will save the YMM registers
                 // _XCR_XFEATURE_ENABLED_MASK = 0
                 unsigned long long xcr_feature_mask = _xgetbv(0);
                 os_saves_YMM = (xcr_feature_mask & 0x6) != 0;
+                // opmask, upper halves of ZMM0-15 and ZMM16-31
+                os_saves_ZMM = (xcr_feature_mask & 0xe6) == 0xe6;
             }
 
             bool cpu_FMA_support = (info[2] & ((int)1 << 12)) != 0;
+            g_cpu_features.fma_supported = os_saves_YMM && cpu_FMA_support;
+            g_cpu_features.f16c_supported = os_saves_YMM && (info[2] & ((int)1 << 29)) != 0;
 
             bool cpu_AVX_support = (info[2] & (1 << 28)) != 0;
             g_cpu_features.avx_supported = os_saves_YMM && cpu_AVX_support;
@@ -90,18 +161,24 @@ Ray::CpuFeatures Ray::GetCpuFeatures() {
                 bool cpu_AVX2_support = (info[1] & (1 << 5)) != 0;
                 // use fma in conjunction with avx2 support (like microsoft compiler does)
                 g_cpu_features.avx2_supported = os_saves_YMM && cpu_AVX2_support && cpu_FMA_support;
+                g_cpu_features.bmi2_supported = (info[1] & (1 << 8)) != 0;
 
-                g_cpu_features.avx512_supported = (info[1] & (1 << 16)) != 0; // HW_AVX512F
-                // g_cpu_features.avx512_supported &= (info[1] & (1 << 28)) != 0;   // HW_AVX512CD
-                // g_cpu_features.avx512_supported &= (info[1] & (1 << 26)) != 0;   // HW_AVX512PF
-                // g_cpu_features.avx512_supported &= (info[1] & (1 << 27)) != 0;   // HW_AVX512ER
-                // g_cpu_features.avx512_supported &= (info[1] & (1 << 31)) != 0;   // HW_AVX512VL
-                g_cpu_features.avx512_supported &= (info[1] & (1 << 30)) != 0; // HW_AVX512BW
-                g_cpu_features.avx512_supported &= (info[1] & (1 << 17)) != 0; // HW_AVX512DQ
-                // g_cpu_features.avx512_supported &= (info[1] & (1 << 21)) != 0;   // HW_AVX512IFMA
-                // g_cpu_features.avx512_supported &= (info[2] & (1 << 1)) != 0;    // HW_AVX512VBMI
+                g_cpu_features.avx512f_supported = os_saves_ZMM && (info[1] & (1 << 16)) != 0;
+                g_cpu_features.avx512dq_supported = os_saves_ZMM && (info[1] & (1 << 17)) != 0;
+                g_cpu_features.avx512ifma_supported = os_saves_ZMM && (info[1] & (1 << 21)) != 0;
+                g_cpu_features.avx512cd_supported = os_saves_ZMM && (info[1] & (1 << 28)) != 0;
+                g_cpu_features.avx512bw_supported = os_saves_ZMM && (info[1] & (1 << 30)) != 0;
+                g_cpu_features.avx512vl_supported = os_saves_ZMM && (info[1] & (1u << 31)) != 0;
+                g_cpu_features.avx512vbmi_supported = os_saves_ZMM && (info[2] & (1 << 1)) != 0;
+                g_cpu_features.avx512vnni_supported = os_saves_ZMM && (info[2] & (1 << 11)) != 0;
+
+                g_cpu_features.avx512_supported = g_cpu_features.avx512f_supported &&
+                                                  g_cpu_features.avx512bw_supported &&
+                                                  g_cpu_features.avx512dq_supported;
             }
         }
+
+        DetectCacheSizes(ids_count, ex_ids_count, g_cpu_features);
 #elif defined(__i386__) || defined(__x86_64__)
         g_cpu_features.sse2_supported = true;
 #endif
@@ -111,3 +188,4 @@ Ray::CpuFeatures Ray::GetCpuFeatures() {
 }
 
 #undef cpuid
+#undef cpuidex
@@ -6,9 +6,29 @@ namespace Ray {
         unsigned sse3_supported : 1;
         unsigned ssse3_supported : 1;
         unsigned sse41_supported : 1;
+        unsigned sse42_supported : 1;
+        unsigned popcnt_supported : 1;
         unsigned avx_supported : 1;
         unsigned avx2_supported : 1;
-        unsigned avx512_supported : 1;
+        unsigned fma_supported : 1;
+        unsigned f16c_supported : 1;
+        unsigned bmi2_supported : 1;
+        unsigned avx512_supported : 1; // F + BW + DQ (what RendererAVX512 is compiled for)
+        unsigned avx512f_supported : 1;
+        unsigned avx512cd_supported : 1;
+        unsigned avx512bw_supported : 1;
+        unsigned avx512dq_supported : 1;
+        unsigned avx512vl_supported : 1;
+        unsigned avx512ifma_supported : 1;
+        unsigned avx512vbmi_supported : 1;
+        unsigned avx512vnni_supported : 1;
+
+        // cache sizes in bytes (0 if unknown)
+        unsigned l1d_cache_size, l2_cache_size, l3_cache_size;
+        unsigned cache_line_size;
+
+        char vendor[16];
+        char brand[64];
     };
 
     CpuFeatures GetCpuFeatures();
@@ -6,7 +6,9 @@
 #include <atomic>
 #include <chrono>
 
+void test_core();
 void test_tex_storage();
+void test_scene_ref();
 void test_oren_mat0(const char *arch_list[], const char *preferred_device);
 void test_oren_mat1(const char *arch_list[], const char *preferred_device);
 void test_oren_mat2(const char *arch_list[], const char *preferred_device);
@@ -140,7 +142,9 @@ int main(int argc, char *argv[]) {
 #endif
 
     test_simd();
+    test_core();
     test_tex_storage();
+    test_scene_ref();
 
 #ifdef _WIN32
     // Stupid workaround that should not exist.
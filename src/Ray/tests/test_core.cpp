@@ -0,0 +1,207 @@
+#include "test_common.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../internal/Core.h"
+#include "../internal/CoreRef.h"
+#include "../internal/TextureStorageRef.h"
+
+#if !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+#define NS Sse2Test
+#define USE_SSE2
+#include "../internal/CoreSIMD.h"
+#undef USE_SSE2
+#undef NS
+#define SIMD_NS Sse2Test
+#else
+#define NS NeonTest
+#define USE_NEON
+#include "../internal/CoreSIMD.h"
+#undef USE_NEON
+#undef NS
+#define SIMD_NS NeonTest
+#endif
+
+namespace {
+// Procedural texture with distinct mip levels (CPU storages keep only base level), last row and column are border
+// texels which repeat the first ones
+class TestMipStorage : public Ray::Ref::TexStorageBase {
+    static const int BaseRes = 8;
+
+  public:
+    void GetIRes(int index, const int lod, int res[2]) const override { res[0] = res[1] = BaseRes >> lod; }
+    size_t mem_size(int index) const override { return 0; }
+    void GetFRes(int index, const int lod, float res[2]) const override { res[0] = res[1] = float(BaseRes >> lod); }
+
+    Ray::color_rgba_t Fetch(int index, int x, int y, const int lod) const override {
+        const int res = BaseRes >> lod;
+        x %= res;
+        y %= res;
+
+        Ray::color_rgba_t ret;
+        ret.v[0] = float((x * 5 + y * 3) % 7) / 6.0f;
+        ret.v[1] = float(x) / float(res - 1 + (res == 1));
+        ret.v[2] = float(y) / float(res - 1 + (res == 1));
+        ret.v[3] = float(lod) / 4.0f;
+        return ret;
+    }
+    Ray::color_rgba_t Fetch(int index, const float x, const float y, const int lod) const override {
+        return Fetch(index, int(x), int(y), lod);
+    }
+
+    bool Free(int index) override { return true; }
+};
+} // namespace
+
+void test_core() {
+    { // Test tile order
+        const int sizes[][2] = {{1, 1}, {1, 7}, {7, 1},  {2, 3},   {3, 2},  {5, 5},  {4, 7},    {7, 4},
+                                {6, 9}, {9, 6}, {16, 16}, {13, 31}, {64, 3}, {3, 64}, {120, 68}, {97, 101}};
+        for (const Ray::ePixelOrder order : {Ray::Scanline, Ray::Morton, Ray::Hilbert}) {
+            for (const auto &size : sizes) {
+                const int w = size[0], h = size[1];
+
+                std::vector<uint32_t> tiles;
+                Ray::GetTileOrder(order, w, h, tiles);
+
+                // every tile is visited exactly once
+                std::vector<uint32_t> sorted_tiles = tiles, expected_tiles;
+                for (int y = 0; y < h; ++y) {
+                    for (int x = 0; x < w; ++x) {
+                        expected_tiles.push_back((y << 16) | x);
+                    }
+                }
+                std::sort(sorted_tiles.begin(), sorted_tiles.end());
+                require(sorted_tiles == expected_tiles);
+
+                if (order == Ray::Hilbert) {
+                    // consecutive tiles are neighbours
+                    for (size_t i = 1; i < tiles.size(); ++i) {
+                        const int dx = int(tiles[i] & 0xffff) - int(tiles[i - 1] & 0xffff),
+                                  dy = int(tiles[i] >> 16) - int(tiles[i - 1] >> 16);
+                        require(std::abs(dx) + std::abs(dy) == 1);
+                    }
+                }
+            }
+        }
+
+        // cached order is rebuilt only when grid changes
+        Ray::tile_order_t cache;
+        const uint32_t *tiles = Ray::GetTileOrder(Ray::Hilbert, 13, 31, cache);
+        require(Ray::GetTileOrder(Ray::Hilbert, 13, 31, cache) == tiles);
+        require(cache.tiles.size() == 13 * 31);
+        Ray::GetTileOrder(Ray::Morton, 13, 31, cache);
+        require(cache.order == Ray::Morton && cache.tiles.size() == 13 * 31);
+        Ray::GetTileOrder(Ray::Morton, 7, 5, cache);
+        require(cache.w == 7 && cache.h == 5 && cache.tiles.size() == 7 * 5);
+
+        std::vector<uint32_t> expected_tiles;
+        Ray::GetTileOrder(Ray::Morton, 7, 5, expected_tiles);
+        require(cache.tiles == expected_tiles);
+    }
+
+    { // Test stochastic texture sampling (Ref)
+        TestMipStorage storage;
+        const Ray::Ref::TexStorageBase *textures[] = {&storage};
+
+        // bilinear lookup at the wrap edge blends the first texel with the last one
+        const Ray::Ref::simd_fvec4 edge = Ray::Ref::SampleBilinear(textures, 0, Ray::Ref::simd_fvec2{0.0f, 0.5625f}, 0);
+        const Ray::color_rgba_t first = storage.Fetch(0, 0, 4, 0), last = storage.Fetch(0, 7, 4, 0);
+        for (int j = 0; j < 4; ++j) {
+            require(std::abs(edge[j] - 0.5f * (first.v[j] + last.v[j])) < 1e-6f);
+        }
+
+        const float test_uvs[][2] = {{0.37f, 0.61f}, {0.01f, 0.5f}, {0.99f, 0.02f}, {0.0f, 0.0f}, {-0.3f, 1.7f}};
+        const float test_lods[] = {0.0f, 0.3f, 1.5f, 2.75f};
+
+        // stratified random numbers
+        const int N = 48;
+        for (const auto &uv : test_uvs) {
+            for (const float lod : test_lods) {
+                const Ray::Ref::simd_fvec2 uvs = {uv[0], uv[1]};
+
+                Ray::Ref::simd_fvec4 sum = 0.0f;
+                for (int i = 0; i < N * N * N; ++i) {
+                    const float rand[3] = {(float(i % N) + 0.5f) / N, (float((i / N) % N) + 0.5f) / N,
+                                           (float(i / (N * N)) + 0.5f) / N};
+                    sum += Ray::Ref::SampleStochastic(textures, 0, uvs, lod, rand);
+                }
+                const Ray::Ref::simd_fvec4 expected = Ray::Ref::SampleTrilinear(textures, 0, uvs, lod);
+                for (int j = 0; j < 4; ++j) {
+                    // discontinuities are hit by stratified samples with error of at most half of stratum
+                    require(std::abs(sum[j] / float(N * N * N) - expected[j]) < 0.025f);
+                }
+            }
+        }
+    }
+
+    { // Test stochastic texture sampling (SIMD against Ref)
+        const int S = 4;
+        const int res[2] = {61, 37};
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+        std::vector<Ray::color_rgba8_t> pixels(res[0] * res[1]);
+        std::vector<Ray::color_r8_t> pixels_r(res[0] * res[1]);
+        for (int i = 0; i < res[0] * res[1]; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                pixels[i].v[j] = uint8_t(255.0f * dist(gen));
+            }
+            pixels_r[i].v[0] = pixels[i].v[0];
+        }
+
+        Ray::Ref::TexStorageRGBA storage_rgba;
+        Ray::Ref::TexStorageR storage_r;
+        Ray::Ref::TexStorageBC4 storage_bc4;
+        require_fatal(storage_rgba.Insert(Ray::Ref::TexStorageRGBA::Prepare(pixels.data(), res, false)) == 0);
+        require_fatal(storage_r.Insert(Ray::Ref::TexStorageR::Prepare(pixels_r.data(), res, false)) == 0);
+        require_fatal(storage_bc4.Insert(Ray::Ref::TexStorageBC4::Prepare(pixels_r.data(), res, false)) == 0);
+
+        const Ray::Ref::TexStorageBase *textures[] = {&storage_rgba, nullptr, nullptr, &storage_r,
+                                                      nullptr,       &storage_bc4};
+
+        for (const uint32_t index : {0u << 28, 3u << 28, 5u << 28}) {
+            for (int i = 0; i < 1000; ++i) {
+                alignas(16) float uvs[2][S], lod[S], rand[3][S];
+                alignas(16) int mask[S];
+                for (int k = 0; k < S; ++k) {
+                    // values outside of [0; 1) and exactly at the wrap edge are included
+                    uvs[0][k] = (i % 10 == 0) ? 0.0f : 3.0f * dist(gen) - 1.0f;
+                    uvs[1][k] = (i % 10 == 1) ? 0.0f : 3.0f * dist(gen) - 1.0f;
+                    lod[k] = 3.0f * dist(gen);
+                    for (int j = 0; j < 3; ++j) {
+                        rand[j][k] = dist(gen);
+                    }
+                    mask[k] = (k == (i % S)) ? 0 : -1;
+                }
+
+                const Ray::SIMD_NS::simd_fvec<S> _uvs[2] = {{uvs[0], Ray::SIMD_NS::simd_mem_aligned},
+                                                            {uvs[1], Ray::SIMD_NS::simd_mem_aligned}};
+                const Ray::SIMD_NS::simd_fvec<S> _rand[3] = {{rand[0], Ray::SIMD_NS::simd_mem_aligned},
+                                                             {rand[1], Ray::SIMD_NS::simd_mem_aligned},
+                                                             {rand[2], Ray::SIMD_NS::simd_mem_aligned}};
+                const Ray::SIMD_NS::simd_fvec<S> _lod = {lod, Ray::SIMD_NS::simd_mem_aligned};
+                const Ray::SIMD_NS::simd_ivec<S> _mask = {mask, Ray::SIMD_NS::simd_mem_aligned};
+
+                Ray::SIMD_NS::simd_fvec<S> out_rgba[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
+                Ray::SIMD_NS::SampleStochastic(textures, index, _uvs, _lod, _rand, _mask, out_rgba);
+
+                for (int k = 0; k < S; ++k) {
+                    const float lane_rand[3] = {rand[0][k], rand[1][k], rand[2][k]};
+                    const Ray::Ref::simd_fvec4 expected = Ray::Ref::SampleStochastic(
+                        textures, index, Ray::Ref::simd_fvec2{uvs[0][k], uvs[1][k]}, lod[k], lane_rand);
+                    for (int j = 0; j < 4; ++j) {
+                        // inactive lanes are left untouched
+                        require(std::abs(out_rgba[j][k] - (mask[k] ? expected[j] : -1.0f)) < 1e-6f);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -762,13 +762,13 @@ void schedule_render_jobs(Ray::RendererBase &renderer, const Ray::SceneBase *sce
             }
         };
 
-        auto denoise_job = [&](const int j) {
+        auto denoise_job = [&](const int pass, const int j) {
 #if defined(_WIN32)
             if (g_catch_flt_exceptions) {
                 _controlfp(_EM_INEXACT | _EM_UNDERFLOW | _EM_OVERFLOW, _MCW_EM);
             }
 #endif
-            renderer.DenoiseImage(region_contexts[j]);
+            renderer.DenoiseImage(pass, region_contexts[j]);
         };
 
         static const int SamplePortion = 16;
@@ -783,13 +783,16 @@ void schedule_render_jobs(Ray::RendererBase &renderer, const Ray::SceneBase *sce
             job_res.clear();
 
             if (i + std::min(SamplePortion, samples - i) == samples) {
-                for (int j = 0; j < int(region_contexts.size()); ++j) {
-                    job_res.push_back(threads.Enqueue(denoise_job, j));
+                // variance is filtered for all regions before image filtering
+                for (int pass = 0; pass < 2; ++pass) {
+                    for (int j = 0; j < int(region_contexts.size()); ++j) {
+                        job_res.push_back(threads.Enqueue(denoise_job, pass, j));
+                    }
+                    for (auto &res : job_res) {
+                        res.wait();
+                    }
+                    job_res.clear();
                 }
-                for (auto &res : job_res) {
-                    res.wait();
-                }
-                job_res.clear();
             }
 
             // report progress percentage
@@ -0,0 +1,461 @@
+#include "test_common.h"
+
+#include <cstdarg>
+#include <cstring>
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "../Log.h"
+#include "../internal/BVHCacheRef.h"
+#include "../internal/SceneRef.h"
+#include "../internal/SnapshotRef.h"
+#include "utils.h"
+
+namespace {
+// Counts messages which contain given substrings
+class LogCounter : public Ray::ILog {
+    void Count(const char *fmt, va_list args) {
+        char buf[4096];
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        if (strstr(buf, "loaded from cache")) {
+            ++cache_hits;
+        }
+        if (strstr(buf, "Invalid BVH cache entry")) {
+            ++cache_rejects;
+        }
+    }
+
+  public:
+    int cache_hits = 0, cache_rejects = 0;
+
+    void Info(const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        Count(fmt, args);
+        va_end(args);
+    }
+    void Warning(const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        Count(fmt, args);
+        va_end(args);
+    }
+    void Error(const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        Count(fmt, args);
+        va_end(args);
+    }
+};
+
+// Slightly displaced grid of quads
+void MakeGridMesh(const int quads_count, const float height, std::vector<float> &out_attrs,
+                  std::vector<uint32_t> &out_indices) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(0.0f, height);
+
+    const int verts_count = quads_count + 1;
+    for (int j = 0; j < verts_count; ++j) {
+        for (int i = 0; i < verts_count; ++i) {
+            const float attrs[8] = {float(i), dist(gen), float(j), 0.0f, 1.0f, 0.0f, float(i) / quads_count,
+                                    float(j) / quads_count};
+            out_attrs.insert(out_attrs.end(), attrs, attrs + 8);
+        }
+    }
+    for (int j = 0; j < quads_count; ++j) {
+        for (int i = 0; i < quads_count; ++i) {
+            const uint32_t v0 = j * verts_count + i, v1 = v0 + 1, v2 = v0 + verts_count, v3 = v2 + 1;
+            const uint32_t indices[6] = {v0, v2, v1, v1, v2, v3};
+            out_indices.insert(out_indices.end(), indices, indices + 6);
+        }
+    }
+}
+
+std::vector<char> ReadFile(const std::string &path) {
+    std::ifstream in_file(path, std::ios::binary | std::ios::ate);
+    std::vector<char> ret(in_file ? size_t(in_file.tellg()) : 0);
+    in_file.seekg(0);
+    in_file.read(ret.data(), ret.size());
+    return ret;
+}
+
+void WriteFile(const std::string &path, const std::vector<char> &data) {
+    std::ofstream out_file(path, std::ios::binary | std::ios::trunc);
+    out_file.write(data.data(), data.size());
+}
+
+template <typename T> bool ArraysEqual(const T *lhs, const size_t lhs_count, const T *rhs, const size_t rhs_count) {
+    return lhs_count == rhs_count && (!lhs_count || memcmp(lhs, rhs, lhs_count * sizeof(T)) == 0);
+}
+} // namespace
+
+void test_scene_ref() {
+    Ray::LogNull log;
+
+    { // Test deduplication of identical textures
+        const int TextureRes = 64;
+
+        std::uniform_int_distribution<int> dist(0, 255);
+        std::mt19937 gen(42);
+
+        std::vector<uint8_t> pixels1(TextureRes * TextureRes * 3), pixels2(pixels1.size());
+        for (uint8_t &p : pixels1) {
+            p = uint8_t(dist(gen));
+        }
+        pixels2 = pixels1;
+        pixels2[pixels2.size() / 2] ^= 0xff;
+
+        for (const bool use_tex_compression : {false, true}) {
+            Ray::Ref::Scene scene(&log, false /* use_wide_bvh */, use_tex_compression);
+
+            Ray::tex_desc_t tex_desc;
+            tex_desc.format = Ray::eTextureFormat::RGB888;
+            tex_desc.w = tex_desc.h = TextureRes;
+            tex_desc.is_srgb = false;
+            tex_desc.data = pixels1.data();
+
+            const Ray::TextureHandle t1 = scene.AddTexture(tex_desc);
+            // copy of the same data
+            const std::vector<uint8_t> pixels1_copy = pixels1;
+            tex_desc.data = pixels1_copy.data();
+            const Ray::TextureHandle t2 = scene.AddTexture(tex_desc);
+            // single texel differs
+            tex_desc.data = pixels2.data();
+            const Ray::TextureHandle t3 = scene.AddTexture(tex_desc);
+            // the same data with sRGB flag shares image, but handle differs
+            tex_desc.data = pixels1.data();
+            tex_desc.is_srgb = true;
+            const Ray::TextureHandle t4 = scene.AddTexture(tex_desc);
+
+            require(t1 != Ray::InvalidTextureHandle);
+            require(t1 == t2);
+            require(t3 != t1);
+            require(t4 != t1);
+
+            Ray::tex_stats_t st;
+            scene.GetTextureStats(st);
+            require(st.textures_count == 4);
+            require(st.images_count == 2);
+            require(st.dedup_hits == 2);
+            require(st.dedup_saved_bytes == 2 * (st.images_bytes / 2));
+
+            // image is freed only with the last reference
+            scene.RemoveTexture(t1);
+            scene.GetTextureStats(st);
+            require(st.textures_count == 3);
+            require(st.images_count == 2);
+
+            scene.RemoveTexture(t2);
+            scene.GetTextureStats(st);
+            require(st.textures_count == 2);
+            require(st.images_count == 2);
+
+            scene.RemoveTexture(t4);
+            scene.GetTextureStats(st);
+            require(st.textures_count == 1);
+            require(st.images_count == 1);
+            require(st.dedup_saved_bytes == 0);
+
+            // image is stored again after it was freed
+            tex_desc.is_srgb = false;
+            const Ray::TextureHandle t5 = scene.AddTexture(tex_desc);
+            scene.GetTextureStats(st);
+            require(t5 != Ray::InvalidTextureHandle);
+            require(st.textures_count == 2);
+            require(st.images_count == 2);
+            require(st.dedup_hits == 2);
+
+            scene.RemoveTexture(t3);
+            scene.RemoveTexture(t5);
+            scene.GetTextureStats(st);
+            require(st.textures_count == 0);
+            require(st.images_count == 0);
+        }
+    }
+
+    { // Test fallback to in-memory storage when out-of-core storage fails
+        const std::string temp_dir = CreateTempDir("ray_tex_cache");
+        require_fatal(!temp_dir.empty());
+        // cache dir can not be created inside of regular file
+        WriteFile(temp_dir + "/file", std::vector<char>(1));
+        const std::string bad_cache_dir = temp_dir + "/file/cache";
+
+        std::vector<uint8_t> pixels(2048 * 32);
+        for (int i = 0; i < int(pixels.size()); ++i) {
+            pixels[i] = uint8_t(i % 251);
+        }
+
+        Ray::tex_desc_t tex_desc;
+        tex_desc.format = Ray::eTextureFormat::R8;
+        tex_desc.w = 2048;
+        tex_desc.h = 32;
+        tex_desc.data = pixels.data();
+
+        for (const char *cache_dir : {temp_dir.c_str(), bad_cache_dir.c_str()}) {
+            const bool expect_virtual = (cache_dir == temp_dir.c_str());
+
+            Ray::Ref::Scene scene(&log, false /* use_wide_bvh */, false /* use_tex_compression */, cache_dir);
+            const Ray::TextureHandle t = scene.AddTexture(tex_desc);
+            require(t != Ray::InvalidTextureHandle);
+            // storage index is kept in upper bits of handle
+            require(((t._index >> 28) == 7) == expect_virtual);
+
+            Ray::tex_stats_t st;
+            scene.GetTextureStats(st);
+            require(st.textures_count == 1);
+            require(st.images_count == 1);
+        }
+
+        RemoveDir(temp_dir);
+    }
+
+    { // Test BVH cache
+        std::vector<float> attrs1, attrs2;
+        std::vector<uint32_t> indices1, indices2;
+        MakeGridMesh(32, 1.0f, attrs1, indices1);
+        MakeGridMesh(32, 2.0f, attrs2, indices2);
+
+        Ray::mesh_desc_t mesh_desc;
+        mesh_desc.prim_type = Ray::ePrimType::TriangleList;
+        mesh_desc.layout = Ray::eVertexLayout::PxyzNxyzTuv;
+        mesh_desc.vtx_attrs = attrs1.data();
+        mesh_desc.vtx_attrs_count = attrs1.size() / 8;
+        mesh_desc.vtx_indices = indices1.data();
+        mesh_desc.vtx_indices_count = indices1.size();
+
+        Ray::mesh_desc_t mesh_desc2 = mesh_desc;
+        mesh_desc2.vtx_attrs = attrs2.data();
+        mesh_desc2.vtx_indices = indices2.data();
+
+        // the same settings as used by scene
+        Ray::bvh_settings_t s;
+        s.oversplit_threshold = 0.95f;
+        s.allow_spatial_splits = mesh_desc.allow_spatial_splits;
+        s.use_fast_bvh_build = mesh_desc.use_fast_bvh_build;
+
+        for (const bool use_wide_bvh : {false, true}) {
+            const std::string cache_dir = CreateTempDir("ray_bvh_cache");
+            require_fatal(!cache_dir.empty());
+
+            const uint64_t key = Ray::Ref::BVHCache::GetKey(mesh_desc, s, use_wide_bvh);
+            const uint64_t key2 = Ray::Ref::BVHCache::GetKey(mesh_desc2, s, use_wide_bvh);
+            require(key != key2);
+
+            char file_name[32];
+            snprintf(file_name, sizeof(file_name), "%016llx.bvh", (unsigned long long)key);
+            const std::string entry_path = cache_dir + "/" + file_name;
+            snprintf(file_name, sizeof(file_name), "%016llx.bvh", (unsigned long long)key2);
+            const std::string entry_path2 = cache_dir + "/" + file_name;
+
+            auto add_mesh = [&](LogCounter &log, const Ray::mesh_desc_t &desc, uint32_t &out_node_count) {
+                Ray::Ref::Scene scene(&log, use_wide_bvh, false /* use_tex_compression */, nullptr, 0,
+                                      cache_dir.c_str());
+                require(scene.AddMesh(desc) != Ray::InvalidMeshHandle);
+                out_node_count = scene.node_count();
+            };
+
+            uint32_t node_count_built = 0;
+            { // cache miss, entry is written
+                LogCounter log;
+                add_mesh(log, mesh_desc, node_count_built);
+                require(log.cache_hits == 0 && log.cache_rejects == 0);
+                require(!ReadFile(entry_path).empty());
+            }
+
+            { // stored entry is identical to freshly built structures
+                std::vector<Ray::bvh_node_t> nodes;
+                Ray::aligned_vector<Ray::mbvh_node_t> mnodes;
+                Ray::aligned_vector<Ray::tri_accel_t> tris;
+                Ray::aligned_vector<Ray::mtri_accel_t> mtris;
+                std::vector<uint32_t> tri_indices;
+                Ray::PreprocessMesh(mesh_desc.vtx_attrs, {mesh_desc.vtx_indices, mesh_desc.vtx_indices_count},
+                                    mesh_desc.layout, mesh_desc.base_vertex, s, nodes, tris, tri_indices, mtris);
+                if (use_wide_bvh) {
+                    Ray::FlattenBVH_Recursive(nodes.data(), 0, 0xffffffff, mnodes);
+                    nodes.clear();
+                }
+
+                LogCounter log;
+                Ray::Ref::BVHCache cache;
+                cache.Init(&log, cache_dir.c_str());
+
+                Ray::Ref::BVHCache::Entry entry;
+                require_fatal(cache.Load(key, entry));
+                require(ArraysEqual(entry.nodes, entry.nodes_count, nodes.data(), nodes.size()));
+                require(ArraysEqual(entry.mnodes, entry.mnodes_count, mnodes.data(), mnodes.size()));
+                require(ArraysEqual(entry.tris, entry.tris_count, tris.data(), tris.size()));
+                require(ArraysEqual(entry.mtris, entry.mtris_count, mtris.data(), mtris.size()));
+                require(ArraysEqual(entry.tri_indices, entry.tri_indices_count, tri_indices.data(),
+                                    tri_indices.size()));
+            }
+
+            { // cache hit
+                LogCounter log;
+                uint32_t node_count = 0;
+                add_mesh(log, mesh_desc, node_count);
+                require(log.cache_hits == 1 && log.cache_rejects == 0);
+                require(node_count == node_count_built);
+            }
+
+            const std::vector<char> valid_entry = ReadFile(entry_path);
+
+            { // corrupted entry is rejected and rebuilt
+                std::vector<char> corrupted = valid_entry;
+                corrupted[0] ^= 0xff;
+                WriteFile(entry_path, corrupted);
+
+                LogCounter log;
+                uint32_t node_count = 0;
+                add_mesh(log, mesh_desc, node_count);
+                require(log.cache_hits == 0 && log.cache_rejects == 1);
+                require(node_count == node_count_built);
+                require(ReadFile(entry_path) == valid_entry);
+            }
+
+            LogCounter log;
+            Ray::Ref::BVHCache cache;
+            cache.Init(&log, cache_dir.c_str());
+
+            { // entry of older format version
+                std::vector<char> stale = valid_entry;
+                stale[4] += 1;
+                WriteFile(entry_path, stale);
+
+                Ray::Ref::BVHCache::Entry entry;
+                require(!cache.Load(key, entry));
+            }
+
+            { // truncated entry
+                const std::vector<char> truncated(valid_entry.begin(), valid_entry.begin() + valid_entry.size() / 2);
+                WriteFile(entry_path, truncated);
+
+                Ray::Ref::BVHCache::Entry entry;
+                require(!cache.Load(key, entry));
+            }
+
+            { // entry with damaged payload (header is intact)
+                std::vector<char> damaged = valid_entry;
+                damaged.back() ^= 0x01;
+                WriteFile(entry_path, damaged);
+
+                Ray::Ref::BVHCache::Entry entry;
+                require(!cache.Load(key, entry));
+            }
+
+            { // entry of other mesh under this key
+                uint32_t node_count = 0;
+                add_mesh(log, mesh_desc2, node_count);
+                WriteFile(entry_path, ReadFile(entry_path2));
+
+                Ray::Ref::BVHCache::Entry entry;
+                require(!cache.Load(key, entry));
+            }
+
+            require(log.cache_rejects == 4);
+
+            RemoveDir(cache_dir);
+        }
+    }
+
+    { // Test scene snapshot round trip
+        std::vector<float> attrs;
+        std::vector<uint32_t> indices;
+        MakeGridMesh(16, 1.0f, attrs, indices);
+
+        std::vector<uint8_t> pixels(32 * 32 * 4);
+        for (int i = 0; i < int(pixels.size()); ++i) {
+            pixels[i] = uint8_t(i * 7);
+        }
+
+        for (const bool use_wide_bvh : {false, true}) {
+            const std::string temp_dir = CreateTempDir("ray_snapshot");
+            require_fatal(!temp_dir.empty());
+            const std::string snapshot_path = temp_dir + "/scene.snap", snapshot_path2 = temp_dir + "/scene2.snap";
+
+            auto same_stats = [](const Ray::Ref::Scene &lhs, const Ray::Ref::Scene &rhs) {
+                Ray::tex_stats_t lhs_st, rhs_st;
+                lhs.GetTextureStats(lhs_st);
+                rhs.GetTextureStats(rhs_st);
+                return lhs.triangle_count() == rhs.triangle_count() && lhs.node_count() == rhs.node_count() &&
+                       lhs_st.textures_count == rhs_st.textures_count && lhs_st.images_count == rhs_st.images_count &&
+                       lhs_st.dedup_hits == rhs_st.dedup_hits;
+            };
+
+            Ray::Ref::Scene scene(&log, use_wide_bvh, false /* use_tex_compression */);
+            {
+                Ray::environment_desc_t env_desc;
+                env_desc.env_col[0] = env_desc.env_col[1] = env_desc.env_col[2] = 0.5f;
+                scene.SetEnvironment(env_desc);
+
+                Ray::tex_desc_t tex_desc;
+                tex_desc.format = Ray::eTextureFormat::RGBA8888;
+                tex_desc.w = tex_desc.h = 32;
+                tex_desc.data = pixels.data();
+                tex_desc.generate_mipmaps = true;
+
+                Ray::principled_mat_desc_t mat_desc;
+                mat_desc.base_texture = scene.AddTexture(tex_desc);
+                require(mat_desc.base_texture != Ray::InvalidTextureHandle);
+
+                Ray::mesh_desc_t mesh_desc;
+                mesh_desc.prim_type = Ray::ePrimType::TriangleList;
+                mesh_desc.layout = Ray::eVertexLayout::PxyzNxyzTuv;
+                mesh_desc.vtx_attrs = attrs.data();
+                mesh_desc.vtx_attrs_count = attrs.size() / 8;
+                mesh_desc.vtx_indices = indices.data();
+                mesh_desc.vtx_indices_count = indices.size();
+                const Ray::MaterialHandle mat = scene.AddMaterial(mat_desc);
+                mesh_desc.shapes.emplace_back(mat, mat, 0, indices.size());
+
+                const float xform[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+                require(scene.AddMeshInstance(scene.AddMesh(mesh_desc), xform) != Ray::InvalidMeshInstanceHandle);
+
+                Ray::sphere_light_desc_t light_desc;
+                light_desc.position[1] = 4.0f;
+                require(scene.AddLight(light_desc) != Ray::InvalidLightHandle);
+
+                Ray::camera_desc_t cam_desc;
+                cam_desc.origin[1] = 2.0f;
+                cam_desc.fwd[2] = 1.0f;
+                scene.SetCamera(scene.AddCamera(cam_desc), cam_desc);
+
+                scene.Finalize();
+            }
+            require_fatal(scene.SaveSnapshot(snapshot_path.c_str()));
+
+            { // loaded scene is the same and saves into identical file
+                Ray::Ref::Scene loaded(&log, use_wide_bvh, false /* use_tex_compression */);
+                require_fatal(loaded.LoadSnapshot(snapshot_path.c_str()));
+                require(same_stats(scene, loaded));
+                require(loaded.SaveSnapshot(snapshot_path2.c_str()));
+                require(ReadFile(snapshot_path2) == ReadFile(snapshot_path));
+            }
+
+            { // snapshot of other BVH type is rejected
+                Ray::Ref::Scene loaded(&log, !use_wide_bvh, false /* use_tex_compression */);
+                require(!loaded.LoadSnapshot(snapshot_path.c_str()));
+            }
+
+            // scene header is the first chunk (after file header and chunk size)
+            const std::vector<char> valid_snapshot = ReadFile(snapshot_path);
+            const size_t HeaderOffset = 2 * Ray::Ref::SnapshotAlignment;
+            require_fatal(valid_snapshot.size() > HeaderOffset + 16);
+
+            for (const size_t corrupted_offset : {HeaderOffset /* magic */, HeaderOffset + 4 /* version */,
+                                                  HeaderOffset + 8 /* layout fingerprint */}) {
+                std::vector<char> corrupted = valid_snapshot;
+                corrupted[corrupted_offset] ^= 0xff;
+                WriteFile(snapshot_path2, corrupted);
+
+                Ray::Ref::Scene loaded(&log, use_wide_bvh, false /* use_tex_compression */);
+                require(!loaded.LoadSnapshot(snapshot_path2.c_str()));
+                require(loaded.triangle_count() == 0);
+            }
+
+            RemoveDir(temp_dir);
+        }
+    }
+}
@@ -1,9 +1,63 @@
 #include "test_common.h"
 
+#include "../Log.h"
 #include "../internal/TextureStorageRef.h"
+#include "../internal/TextureStorageVirtualRef.h"
+#include "../internal/Utils.h"
+#include "utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
 #include <random>
+#include <thread>
+
+namespace Ray {
+void DecodeAlphaBlock_Ref(const uint8_t block[8], uint8_t out_alpha[16]);
+void DecodeColorBlock_Ref(const uint8_t block[8], const uint8_t alpha[16], uint8_t out_rgba[64]);
+void ConvertCoCgxY_to_RGB_Block_Ref(uint8_t block[64]);
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+template <int Channels>
+int DownsampleRow_Box_SSE2(const uint8_t row0[], const uint8_t row1[], int count, uint8_t out_row[]);
+#endif
+} // namespace Ray
+
+namespace {
+template <int Channels>
+void DownsampleRow_Box_Ref(const uint8_t row0[], const uint8_t row1[], const int count, uint8_t out_row[]) {
+    for (int i = 0; i < count * Channels; ++i) {
+        const int x = 2 * (i / Channels) * Channels + (i % Channels);
+        out_row[i] = uint8_t((row0[x] + row0[x + Channels] + row1[x] + row1[x + Channels] + 2) / 4);
+    }
+}
+
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+template <int Channels> void test_downsample_row_sse2(std::mt19937 &gen) {
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    const int MaxCount = 67;
+    uint8_t row0[2 * MaxCount * Channels], row1[2 * MaxCount * Channels];
+    for (int i = 0; i < 2 * MaxCount * Channels; ++i) {
+        row0[i] = uint8_t(dist(gen));
+        row1[i] = uint8_t(dist(gen));
+    }
+    // extreme values
+    memset(row0, 255, 8 * Channels);
+    memset(row1, 255, 8 * Channels);
+    memset(&row0[8 * Channels], 0, 8 * Channels);
+
+    for (int count = 0; count <= MaxCount; ++count) {
+        uint8_t out_ref[MaxCount * Channels], out_sse2[MaxCount * Channels];
+        DownsampleRow_Box_Ref<Channels>(row0, row1, count, out_ref);
+
+        const int processed = Ray::DownsampleRow_Box_SSE2<Channels>(row0, row1, count, out_sse2);
+        require(processed <= count && processed > count - 16 / Channels);
+        require(memcmp(out_sse2, out_ref, processed * Channels) == 0);
+    }
+}
+#endif
+} // namespace
 
 void test_tex_storage() {
     { // Test three storage layouts
@@ -57,5 +111,301 @@ void test_tex_storage() {
                 require(sampled_color3.v[3] == test_color.v[3]);
             }
         }
+
+        // content check used for deduplication
+        require(storage_swizzled.Matches(0, &test_pixels[0].v[0], 4, res));
+        test_pixels[TextureRes * TextureRes - 1].v[3] ^= 0xff;
+        require(!storage_swizzled.Matches(0, &test_pixels[0].v[0], 4, res));
+    }
+
+    { // Test block-compressed storage round trip
+        const int TextureRes = 61; // not multiple of block size on purpose
+
+        auto test_pixels = std::unique_ptr<Ray::color_t<uint8_t, 3>[]>{
+            new Ray::color_t<uint8_t, 3>[TextureRes * TextureRes]};
+        auto test_pixels_r = std::unique_ptr<Ray::color_t<uint8_t, 1>[]>{
+            new Ray::color_t<uint8_t, 1>[TextureRes * TextureRes]};
+
+        { // Fill test pixels (smooth gradient with a bit of noise)
+            std::uniform_int_distribution<int> dist(-4, 4);
+            std::mt19937 gen(42);
+
+            for (int j = 0; j < TextureRes; j++) {
+                for (int i = 0; i < TextureRes; i++) {
+                    Ray::color_t<uint8_t, 3> &p = test_pixels[j * TextureRes + i];
+                    p.v[0] = uint8_t(8 + (i * 200) / TextureRes + dist(gen));
+                    p.v[1] = uint8_t(8 + (j * 200) / TextureRes + dist(gen));
+                    p.v[2] = uint8_t(8 + ((i + j) * 100) / TextureRes + dist(gen));
+                    test_pixels_r[j * TextureRes + i].v[0] = p.v[0];
+                }
+            }
+        }
+
+        Ray::Ref::TexStorageBCn<3> storage_bc3;
+        Ray::Ref::TexStorageBCn<2> storage_bc5;
+        Ray::Ref::TexStorageBCn<1> storage_bc4;
+
+        const int res[2] = {TextureRes, TextureRes};
+        require_fatal(storage_bc3.Insert(Ray::Ref::TexStorageBCn<3>::Prepare(test_pixels.get(), res, false)) == 0);
+        require_fatal(storage_bc5.Insert(Ray::Ref::TexStorageBCn<2>::Prepare(test_pixels.get(), res, false)) == 0);
+        require_fatal(storage_bc4.Insert(Ray::Ref::TexStorageBCn<1>::Prepare(test_pixels_r.get(), res, false)) == 0);
+
+        int max_diff[3] = {}, total_diff[3] = {};
+        for (int y = 0; y < TextureRes; ++y) {
+            for (int x = 0; x < TextureRes; ++x) {
+                const Ray::color_t<uint8_t, 3> &test_color = test_pixels[y * TextureRes + x];
+
+                const Ray::color_t<uint8_t, 3> c3 = storage_bc3.Get(0, x, y, 0);
+                const Ray::color_t<uint8_t, 2> c2 = storage_bc5.Get(0, x, y, 0);
+                const Ray::color_t<uint8_t, 1> c1 = storage_bc4.Get(0, x, y, 0);
+
+                for (int i = 0; i < 3; ++i) {
+                    const int diff = std::abs(int(c3.v[i]) - int(test_color.v[i]));
+                    max_diff[0] = std::max(max_diff[0], diff);
+                    total_diff[0] += diff;
+                }
+                for (int i = 0; i < 2; ++i) {
+                    const int diff = std::abs(int(c2.v[i]) - int(test_color.v[i]));
+                    max_diff[1] = std::max(max_diff[1], diff);
+                    total_diff[1] += diff;
+                }
+                const int diff = std::abs(int(c1.v[0]) - int(test_color.v[0]));
+                max_diff[2] = std::max(max_diff[2], diff);
+                total_diff[2] += diff;
+            }
+        }
+
+        // BC3 color is 5:6:5 endpoints with 4 interpolated values, BC4/BC5 channels have 8 values per block
+        require(max_diff[0] <= 16);
+        require(total_diff[0] <= 2 * 3 * TextureRes * TextureRes);
+        require(max_diff[1] <= 2);
+        require(total_diff[1] <= 1 * 2 * TextureRes * TextureRes);
+        require(max_diff[2] <= 2);
+        require(total_diff[2] <= 1 * TextureRes * TextureRes);
+
+        // content check used for deduplication
+        const uint8_t *raw_pixels = &test_pixels[0].v[0];
+        require(storage_bc3.Matches(0, raw_pixels, 3, res));
+        require(storage_bc5.Matches(0, raw_pixels, 3, res));
+        const int other_res[2] = {TextureRes, TextureRes - 1};
+        require(!storage_bc3.Matches(0, raw_pixels, 3, other_res));
+        test_pixels[TextureRes + 1].v[0] ^= 0xff;
+        require(!storage_bc3.Matches(0, raw_pixels, 3, res));
+        require(!storage_bc5.Matches(0, raw_pixels, 3, res));
+        test_pixels[TextureRes + 1].v[0] ^= 0xff;
+
+        require(storage_bc3.Free(0));
+        require(!storage_bc3.Free(1));
+        require(storage_bc3.img_count() == 0);
+    }
+
+    { // Test SSE2 block decoder against reference
+        std::uniform_int_distribution<int> dist(0, 255);
+        std::mt19937 gen(42);
+
+        for (int test = 0; test < 10000; ++test) {
+            uint8_t block[16];
+            for (int i = 0; i < 16; ++i) {
+                block[i] = uint8_t(dist(gen));
+            }
+            if (test % 2) {
+                // exercise both alpha modes
+                std::swap(block[0], block[1]);
+                std::swap(block[8], block[9]);
+            }
+
+            uint8_t ref_alpha[16], ref_g[16], ref_rgba[64];
+            Ray::DecodeAlphaBlock_Ref(block, ref_alpha);
+            Ray::DecodeAlphaBlock_Ref(block + 8, ref_g);
+            Ray::DecodeColorBlock_Ref(block + 8, ref_alpha, ref_rgba);
+
+            uint8_t bc4[16];
+            Ray::DecodeBlock_BC4(block, bc4);
+            require(memcmp(bc4, ref_alpha, 16) == 0);
+
+            uint8_t bc5[32];
+            Ray::DecodeBlock_BC5(block, bc5);
+            for (int i = 0; i < 16; ++i) {
+                require(bc5[2 * i + 0] == ref_alpha[i]);
+                require(bc5[2 * i + 1] == ref_g[i]);
+            }
+
+            alignas(16) uint8_t bc3[64];
+            Ray::DecodeBlock_BC3<false>(block, bc3);
+            require(memcmp(bc3, ref_rgba, 64) == 0);
+
+            Ray::DecodeBlock_BC3<true>(block, bc3);
+            Ray::ConvertCoCgxY_to_RGB_Block_Ref(ref_rgba);
+            require(memcmp(bc3, ref_rgba, 64) == 0);
+        }
+    }
+
+    { // Test block cache with two images
+        const int TextureRes = 8;
+        Ray::color_t<uint8_t, 1> pixels1[TextureRes * TextureRes], pixels2[TextureRes * TextureRes];
+        for (int i = 0; i < TextureRes * TextureRes; ++i) {
+            pixels1[i].v[0] = 32;
+            pixels2[i].v[0] = 224;
+        }
+
+        Ray::Ref::TexStorageBCn<1> storage;
+
+        const int res[2] = {TextureRes, TextureRes};
+        const int img1 = storage.Allocate(pixels1, res, false);
+        const int img2 = storage.Allocate(pixels2, res, false);
+        require_fatal(img1 == 0 && img2 == 1);
+
+        const uint64_t misses_before = Ray::Ref::TexStorageBCn<1>::block_cache_misses();
+
+        // first access decodes the block
+        require(storage.Get(img1, 0, 0, 0).v[0] == 32);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 1);
+        // texel from the same block is taken from cache
+        require(storage.Get(img1, 3, 3, 0).v[0] == 32);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 1);
+        // the same block of another image must not be picked from cache
+        require(storage.Get(img2, 0, 0, 0).v[0] == 224);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 2);
+        require(storage.Get(img2, 1, 2, 0).v[0] == 224);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 2);
+        // another block
+        require(storage.Get(img1, 4, 0, 0).v[0] == 32);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 3);
+
+        // image inserted into the freed slot gets new uid, so stale blocks are not returned
+        require(storage.Free(img1));
+        require(storage.Allocate(pixels2, res, false) == img1);
+        require(storage.Get(img1, 0, 0, 0).v[0] == 224);
+        require(Ray::Ref::TexStorageBCn<1>::block_cache_misses() == misses_before + 4);
+    }
+
+    { // Test out-of-core storage with tiny cache budget
+        const std::string cache_dir = CreateTempDir("ray_tex_cache");
+        require_fatal(!cache_dir.empty());
+
+        const int TextureRes = 512;
+        const int TilesPerRow = TextureRes / Ray::Ref::TexStorageVirtual::TileSize;
+
+        // odd columns encode tile index, so coarser mip level (average of columns) is easy to tell apart
+        std::unique_ptr<uint8_t[]> test_pixels(new uint8_t[TextureRes * TextureRes]);
+        for (int y = 0; y < TextureRes; ++y) {
+            for (int x = 0; x < TextureRes; ++x) {
+                const int tile = (y / Ray::Ref::TexStorageVirtual::TileSize) * TilesPerRow +
+                                 (x / Ray::Ref::TexStorageVirtual::TileSize);
+                test_pixels[y * TextureRes + x] = uint8_t((x % 2) ? 128 + tile : 0);
+            }
+        }
+
+        auto tile_texel = [&](const int tile, int &x, int &y) {
+            x = (tile % TilesPerRow) * Ray::Ref::TexStorageVirtual::TileSize + 1;
+            y = (tile / TilesPerRow) * Ray::Ref::TexStorageVirtual::TileSize;
+        };
+
+        Ray::LogNull log;
+        {
+            Ray::Ref::TexStorageVirtual storage;
+            storage.Init(&log, cache_dir.c_str(), 0 /* budget */);
+            require_fatal(storage.enabled());
+            const int slots_count = storage.slots_count();
+            require(slots_count < TilesPerRow * TilesPerRow);
+
+            const int res[2] = {TextureRes, TextureRes};
+            const int img = storage.Allocate(test_pixels.get(), 1, res, true);
+            require_fatal(img == 0);
+            require(storage.resident_tiles_count() == 0);
+
+            // content check used for deduplication
+            require(storage.Matches(img, test_pixels.get(), 1, res));
+            test_pixels[TextureRes * TextureRes - 1] ^= 0xff;
+            require(!storage.Matches(img, test_pixels.get(), 1, res));
+            test_pixels[TextureRes * TextureRes - 1] ^= 0xff;
+
+            auto wait_resident = [&](const int x, const int y, const uint8_t expected) {
+                for (int i = 0; i < 5000; ++i) {
+                    if (storage.Get(img, x, y, 0).v[0] == expected) {
+                        return true;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return false;
+            };
+
+            { // miss returns texel of coarser mip level, then tile becomes resident
+                int x, y;
+                tile_texel(5, x, y);
+                const uint8_t coarse = storage.Get(img, x, y, 0).v[0];
+                require(coarse >= 64 && coarse <= 64 + 5 + 1);
+                require(wait_resident(x, y, 128 + 5));
+                // tiles of intermediate levels (256x256 and 128x128) were requested during fallback as well
+                require(storage.resident_tiles_count() == 3);
+            }
+
+            { // touching all tiles evicts older ones, resident set stays within budget
+                for (int tile = 0; tile < TilesPerRow * TilesPerRow; ++tile) {
+                    int x, y;
+                    tile_texel(tile, x, y);
+                    const uint8_t col = storage.Get(img, x, y, 0).v[0];
+                    require(col == 128 + tile || (col >= 64 && col <= 64 + tile + 1));
+                    require(storage.resident_tiles_count() <= slots_count);
+                }
+
+                int last_x, last_y;
+                tile_texel(TilesPerRow * TilesPerRow - 1, last_x, last_y);
+                require(wait_resident(last_x, last_y, 128 + TilesPerRow * TilesPerRow - 1));
+                require(storage.resident_tiles_count() == slots_count);
+
+                // evicted tile is paged in again
+                int x, y;
+                tile_texel(5, x, y);
+                require(wait_resident(x, y, 128 + 5));
+                require(storage.resident_tiles_count() == slots_count);
+            }
+
+            require(storage.Free(img));
+            require(storage.resident_tiles_count() == 0);
+        }
+
+        RemoveDir(cache_dir);
+    }
+
+    { // Test mip level downsampling
+        std::mt19937 gen(42);
+#if !defined(__arm__) && !defined(__aarch64__) && !defined(_M_ARM) && !defined(_M_ARM64)
+        test_downsample_row_sse2<1>(gen);
+        test_downsample_row_sse2<2>(gen);
+        test_downsample_row_sse2<4>(gen);
+#endif
+
+        std::uniform_int_distribution<int> dist(0, 255);
+
+        const int w = 37, h = 21;
+        uint8_t in_data[w * h * 4];
+        for (int i = 0; i < w * h * 4; ++i) {
+            in_data[i] = uint8_t(dist(gen));
+        }
+
+        for (int channels = 1; channels <= 4; ++channels) {
+            // odd dimensions are either rounded down or rounded up (last texel is clamped)
+            for (const int out_w : {w / 2, (w + 1) / 2}) {
+                const int out_h = (h + 1) / 2;
+
+                uint8_t out_data[w * h * 4];
+                Ray::DownsampleImage_Box(in_data, w, h, channels, out_data, out_w, out_h);
+
+                for (int y = 0; y < out_h; ++y) {
+                    for (int x = 0; x < out_w; ++x) {
+                        const int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+                        const int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+                        for (int j = 0; j < channels; ++j) {
+                            const uint8_t *row0 = &in_data[y0 * w * channels + j];
+                            const uint8_t *row1 = &in_data[y1 * w * channels + j];
+                            const int sum =
+                                row0[x0 * channels] + row0[x1 * channels] + row1[x0 * channels] + row1[x1 * channels];
+                            require(out_data[(y * out_w + x) * channels + j] == uint8_t((sum + 2) / 4));
+                        }
+                    }
+                }
+            }
+        }
     }
 }
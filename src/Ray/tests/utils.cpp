@@ -1,12 +1,28 @@
 #include "utils.h"
 
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include <fstream>
 #include <memory>
 #include <string>
 
+#ifdef _WIN32
+#include <direct.h>
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
 std::tuple<std::vector<float>, std::vector<uint32_t>, std::vector<uint32_t>> LoadBIN(const char file_name[]) {
     std::ifstream in_file(file_name, std::ios::binary);
     uint32_t num_attrs;
@@ -348,4 +364,55 @@ void WriteTGA(const uint8_t *data, int w, int h, int bpp, const char *name) {
                                    "TRUEVISION-XFILE" // yep, this is a TGA file
                                    ".";
     file.write((const char *)&footer, sizeof(footer));
-}
\ No newline at end of file
+}
+
+std::string CreateTempDir(const char prefix[]) {
+#ifdef _WIN32
+    char temp_path[MAX_PATH + 1];
+    if (!GetTempPathA(sizeof(temp_path), temp_path)) {
+        return {};
+    }
+    for (unsigned i = 0; i < 1000; ++i) {
+        const std::string path = std::string(temp_path) + prefix + std::to_string(GetCurrentProcessId()) + "_" +
+                                 std::to_string(GetTickCount() + i);
+        if (_mkdir(path.c_str()) == 0) {
+            return path;
+        }
+    }
+    return {};
+#else
+    const char *temp_dir = getenv("TMPDIR");
+    std::string path = std::string(temp_dir ? temp_dir : "/tmp") + "/" + prefix + "XXXXXX";
+    if (!mkdtemp(&path[0])) {
+        return {};
+    }
+    return path;
+#endif
+}
+
+void RemoveDir(const std::string &path) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA find_data;
+    HANDLE h = FindFirstFileA((path + "/*").c_str(), &find_data);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                std::remove((path + "/" + find_data.cFileName).c_str());
+            }
+        } while (FindNextFileA(h, &find_data));
+        FindClose(h);
+    }
+    _rmdir(path.c_str());
+#else
+    DIR *dir = opendir(path.c_str());
+    if (dir) {
+        while (const dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                std::remove((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+#endif
+}
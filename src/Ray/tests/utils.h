@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -12,3 +13,7 @@ std::vector<uint8_t> LoadHDR(const char file_name[], int &w, int &h);
 
 void WriteTGA(const uint8_t *data, int w, int h, int bpp, const char *name);
 
+// Creates uniquely named directory in system temp folder, returns empty string on failure
+std::string CreateTempDir(const char prefix[]);
+// Removes directory along with files in it (not recursive)
+void RemoveDir(const std::string &path);
@@ -17,7 +17,7 @@
 namespace Sys {
 struct Package {
     std::string name;
-    std::vector<Sys::FileDesc> file_list;
+    std::shared_ptr<const PackageReader> reader;
 };
 
 std::vector<Package> added_packages;
@@ -48,14 +48,18 @@ Sys::AssetFile& Sys::AssetFile::operator=(AssetFile&& rhs) noexcept {
 #else
     file_stream_ = rhs.file_stream_;
     rhs.file_stream_ = nullptr;
+    pack_ = std::move(rhs.pack_);
+    pack_entry_ = rhs.pack_entry_;
+    rhs.pack_entry_ = -1;
+    pack_pos_ = rhs.pack_pos_;
+    rhs.pack_pos_ = 0;
+    pack_cache_ = std::move(rhs.pack_cache_);
 #endif
     mode_ = rhs.mode_;
     rhs.mode_ = eOpenMode::None;
     name_ = std::move(rhs.name_);
     size_ = rhs.size_;
     rhs.size_ = 0;
-    pos_override_ = rhs.pos_override_;
-    rhs.pos_override_ = 0;
 
     return (*this);
 }
@@ -108,29 +112,22 @@ bool Sys::AssetFile::Open(const char* file_name, const eOpenMode mode) {
             size_ = 0;
         }
 #else
-        file_stream_ = new std::fstream();
-
         bool found_in_package = false;
 
-        string fname = file_name;
-        for (Package& p : added_packages) {
-            for (FileDesc& f : p.file_list) {
-                if (fname == f.name) {
-                    file_stream_->open(p.name, std::ios::in | std::ios::binary);
-                    if (file_stream_->good()) {
-                        file_stream_->seekg(f.off, ios::beg);
-                        pos_override_ = f.off;
-                        size_ = f.size;
-                        found_in_package = true;
-                        break;
-                }
-            }
-        }
-            if (found_in_package)
+        for (const Package &p : added_packages) {
+            const int i = p.reader->Find(file_name);
+            if (i != -1) {
+                pack_ = p.reader;
+                pack_entry_ = i;
+                pack_pos_ = 0;
+                size_ = size_t(pack_->entry(i).size);
+                found_in_package = true;
                 break;
+            }
         }
 
         if (!found_in_package) {
+            file_stream_ = new std::fstream();
             file_stream_->open(file_name, std::ios::in | std::ios::binary);
             file_stream_->seekg(0, std::ios::end);
             size_ = (size_t)file_stream_->tellg();
@@ -159,6 +156,11 @@ void Sys::AssetFile::Close() {
     }
 #else
     delete file_stream_;
+    file_stream_ = nullptr;
+    pack_ = nullptr;
+    pack_entry_ = -1;
+    pack_pos_ = 0;
+    pack_cache_.entry = -1;
 #endif
     mode_ = eOpenMode::None;
     size_ = 0;
@@ -168,6 +170,11 @@ size_t Sys::AssetFile::Read(char *buf, const size_t size) {
 #ifdef __ANDROID__
     return size_t(AAsset_read(asset_file_, buf, size));
 #else
+    if (pack_) {
+        const size_t bytes_read = pack_->Read(pack_entry_, pack_pos_, buf, size, &pack_cache_);
+        pack_pos_ += bytes_read;
+        return bytes_read;
+    }
     if (!file_stream_) {
         return 0;
     }
@@ -180,7 +187,11 @@ void Sys::AssetFile::SeekAbsolute(const uint64_t pos) {
 #ifdef __ANDROID__
     AAsset_seek(asset_file_, pos, SEEK_SET);
 #else
-    file_stream_->seekg(pos_override_ + pos);
+    if (pack_) {
+        pack_pos_ = pos;
+        return;
+    }
+    file_stream_->seekg(pos);
 #endif
 }
 
@@ -188,6 +199,10 @@ void Sys::AssetFile::SeekRelative(const int64_t off) {
 #ifdef __ANDROID__
     AAsset_seek(asset_file_, off, SEEK_CUR);
 #else
+    if (pack_) {
+        pack_pos_ += off;
+        return;
+    }
     file_stream_->seekg(off, std::ios::cur);
 #endif
 }
@@ -196,7 +211,7 @@ Sys::AssetFile::operator bool() {
 #ifdef __ANDROID__
     return asset_file_ && bool(AAsset_getLength(asset_file_));
 #else
-    return file_stream_ && file_stream_->good();
+    return pack_ || (file_stream_ && file_stream_->good());
 #endif
 }
 
@@ -214,7 +229,10 @@ size_t Sys::AssetFile::pos() {
 #ifdef __ANDROID__
     return AAsset_seek(asset_file_, 0, SEEK_CUR);
 #else
-    return size_t(file_stream_->tellg()) - pos_override_;
+    if (pack_) {
+        return size_t(pack_pos_);
+    }
+    return size_t(file_stream_->tellg());
 #endif
 }
 
@@ -231,10 +249,14 @@ void Sys::AssetFile::AddPackage(const char *name) {
         name[ln - 2] != 'c' || name[ln - 1] != 'k') {
         throw std::runtime_error("Invalid package file!");
     }
+    std::shared_ptr<PackageReader> reader = std::make_shared<PackageReader>(name);
+    if (!*reader) {
+        throw std::runtime_error("Cannot open package file!");
+    }
     added_packages.emplace_back();
     Package &p = added_packages.back();
     p.name = name;
-    p.file_list = Sys::EnumFilesInPackage(name);
+    p.reader = std::move(reader);
 }
 
 void Sys::AssetFile::RemovePackage(const char *name) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 #include <string>
 
 #if defined(__ANDROID__)
@@ -8,6 +9,8 @@ class AAsset;
 class AAssetManager;
 #else
 #include <iosfwd>
+
+#include "Pack.h"
 #endif
 
 namespace Sys {
@@ -20,10 +23,15 @@ class AssetFile {
     AAsset *asset_file_ = nullptr;
 #else
     std::fstream *file_stream_ = nullptr;
+    // file inside of added package
+    std::shared_ptr<const PackageReader> pack_;
+    int pack_entry_ = -1;
+    uint64_t pack_pos_ = 0;
+    PackBlockCache pack_cache_;
 #endif
     eOpenMode mode_ = eOpenMode::None;
     std::string name_;
-    size_t size_ = 0, pos_override_ = 0;
+    size_t size_ = 0;
 
   public:
     AssetFile() = default;
@@ -45,6 +53,11 @@ class AssetFile {
 
     size_t pos();
 
+#ifndef __ANDROID__
+    // Returns pointer to file contents if it is uncompressed file inside of package (mapped into memory)
+    const uint8_t *data() const { return pack_ ? pack_->data(pack_entry_) : nullptr; }
+#endif
+
     bool Open(const char* file_name, eOpenMode mode = eOpenMode::In);
     void Close();
 
@@ -5,6 +5,7 @@
 
 namespace Sys {
 class AsyncFileReaderImpl;
+class IoUringQueue;
 
 const size_t WholeFile = std::numeric_limits<size_t>::max();
 
@@ -70,12 +71,28 @@ class DefaultFileReadBuf : public FileReadBufBase {
 
 enum class eFileReadResult { Failed = -1, Pending = 0, Successful = 1 };
 
+// Backend used by reader on Linux (other platforms have only one), Default picks io_uring if kernel supports it.
+// Unsupported backend falls back to Linux AIO.
+enum class eFileReadBackend { Default, LinuxAIO, PosixAIO, IoUring };
+
 class FileReadEvent {
 #if defined(_WIN32)
     void *h_file_ = nullptr;
     void *ev_ = nullptr;
     char ov_[32] = {};
-#elif defined(__linux__) || defined(__APPLE__)
+#elif defined(__linux__)
+    friend class AsyncFileReaderImpl;
+    friend class IoUringQueue;
+
+    unsigned long ctx_ = 0; // Linux AIO context (created on first use)
+    int fd_ = 0;
+    eFileReadBackend backend_ = eFileReadBackend::LinuxAIO;
+    // io_uring request state (accessed under queue lock)
+    IoUringQueue *ring_ = nullptr;
+    int ring_state_ = 0;
+    long long ring_res_ = 0;
+    alignas(8) char cb_buf_[192] = {};
+#elif defined(__APPLE__)
     unsigned long ctx_ = 0;
     int fd_ = 0;
     char cb_buf_[128] = {};
@@ -93,13 +110,17 @@ class FileReadEvent {
     eFileReadResult GetResult(bool block, size_t *bytes_read);
 };
 
+// Reader must outlive events used with its non-blocking requests
 class AsyncFileReader {
     std::unique_ptr<AsyncFileReaderImpl> impl_;
 
   public:
-    AsyncFileReader() noexcept;
+    explicit AsyncFileReader(eFileReadBackend backend = eFileReadBackend::Default) noexcept;
     ~AsyncFileReader();
 
+    // Backend actually used (Default on platforms without a choice)
+    eFileReadBackend backend() const;
+
     bool ReadFileBlocking(const char *file_path, size_t read_offset, size_t read_size,
                           FileReadBufBase &out_buf);
 
@@ -108,5 +129,9 @@ class AsyncFileReader {
 
     bool ReadFileNonBlocking(const char *file_path, size_t read_offset, size_t read_size,
                              FileReadBufBase &out_buf, FileReadEvent &out_event);
+
+    // Non-blocking requests can be queued and submitted in batches (io_uring), they are submitted here or on
+    // first poll of any event
+    void SubmitRequests();
 };
 } // namespace Sys
@@ -7,14 +7,18 @@
 
 #include <algorithm>
 
+#include <aio.h>
 #include <fcntl.h>
 #include <linux/aio_abi.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include "AsyncFileReader_uring.h"
+
 namespace Sys {
 static const int MaxVolumeSectorSize = 4096;
 static const int SimultaniousFileRequests = 16;
+static const int RingEntries = 64;
 
 static long io_setup(unsigned nr, aio_context_t *ctxp) {
     return syscall(__NR_io_setup, nr, ctxp);
@@ -46,21 +50,49 @@ void DefaultFileReadBuf::Free() {
     }
 }
 
-FileReadEvent::FileReadEvent() {
-    const long ret = io_setup(1 /* requests count */, &ctx_);
-    assert(ret >= 0 && "io_setup failed!");
-}
+FileReadEvent::FileReadEvent() = default;
 
 FileReadEvent::~FileReadEvent() {
-    io_destroy(ctx_);
+    if (ring_ && ring_state_ == RingRequestPending) {
+        // request must not outlive event
+        ring_->Poll(this, true /* block */);
+    }
+    if (ctx_) {
+        io_destroy(ctx_);
+    }
 }
 
 bool FileReadEvent::ReadFile(int fd, size_t read_offset, size_t read_size, uint8_t *out_buf) {
     assert(!fd_);
     fd_ = fd;
 
+    if (backend_ == eFileReadBackend::IoUring) {
+        return ring_->Read(this, fd, read_offset, read_size, out_buf);
+    }
+
+    if (backend_ == eFileReadBackend::PosixAIO) {
+        static_assert(sizeof(cb_buf_) >= sizeof(struct aiocb), "!");
+        auto *cb = reinterpret_cast<struct aiocb *>(cb_buf_);
+        memset(cb, 0, sizeof(struct aiocb));
+
+        cb->aio_fildes = fd;
+        cb->aio_lio_opcode = LIO_READ;
+
+        cb->aio_offset = off_t(read_offset);
+        cb->aio_nbytes = read_size;
+        cb->aio_buf = out_buf;
+
+        return aio_read(cb) == 0;
+    }
+
+    if (!ctx_ && io_setup(1 /* requests count */, &ctx_) < 0) {
+        ctx_ = 0;
+        return false;
+    }
+
     static_assert(sizeof(cb_buf_) >= sizeof(struct iocb), "!");
     auto *cb = reinterpret_cast<struct iocb *>(cb_buf_);
+    memset(cb, 0, sizeof(struct iocb));
 
     cb->aio_fildes = fd;
     cb->aio_lio_opcode = IOCB_CMD_PREAD;
@@ -78,18 +110,46 @@ eFileReadResult FileReadEvent::GetResult(const bool block, size_t *bytes_read) {
         return eFileReadResult::Failed;
     }
 
-    io_event ev = {0};
-    timespec timeout = {};
-    const long ret = io_getevents(ctx_, 1, 1, &ev, block ? nullptr : &timeout);
-
     eFileReadResult res;
-    if (!block && ret == 0) {
-        res = eFileReadResult::Pending;
+    if (backend_ == eFileReadBackend::IoUring) {
+        if (!ring_->Poll(this, block)) {
+            return eFileReadResult::Pending;
+        }
+        const bool success = (ring_state_ == RingRequestDone && ring_res_ >= 0);
+        res = success ? eFileReadResult::Successful : eFileReadResult::Failed;
+        (*bytes_read) = success ? size_t(ring_res_) : 0;
+        ring_state_ = RingRequestIdle;
+    } else if (backend_ == eFileReadBackend::PosixAIO) {
+        auto *cb = reinterpret_cast<struct aiocb *>(cb_buf_);
+        if (block) {
+            const struct aiocb *const cbs[] = {cb};
+            while (aio_error(cb) == EINPROGRESS) {
+                aio_suspend(cbs, 1, nullptr);
+            }
+        }
+
+        const int ret = aio_error(cb);
+        if (ret == EINPROGRESS) {
+            return eFileReadResult::Pending;
+        }
+        res = ret == 0 ? eFileReadResult::Successful : eFileReadResult::Failed;
+
+        const ssize_t ret2 = aio_return(cb);
+        (*bytes_read) = ret2 >= 0 ? size_t(ret2) : 0;
     } else {
-        res = ret == 1 ? eFileReadResult::Successful : eFileReadResult::Failed;
+        io_event ev = {0};
+        timespec timeout = {};
+        const long ret = io_getevents(ctx_, 1, 1, &ev, block ? nullptr : &timeout);
+
+        if (!block && ret == 0) {
+            res = eFileReadResult::Pending;
+        } else {
+            res = ret == 1 ? eFileReadResult::Successful : eFileReadResult::Failed;
+        }
+
+        (*bytes_read) = size_t(ev.res);
     }
 
-    (*bytes_read) = size_t(ev.res);
     if (block) {
         fd_ = 0;
     } else if (res != eFileReadResult::Pending) {
@@ -102,12 +162,46 @@ eFileReadResult FileReadEvent::GetResult(const bool block, size_t *bytes_read) {
 
 class AsyncFileReaderImpl {
     DefaultFileReadBuf internal_buf_;
+    eFileReadBackend backend_;
+    // must outlive events
+    std::unique_ptr<IoUringQueue> ring_;
     FileReadEvent internal_ev_[SimultaniousFileRequests];
 
   public:
-    AsyncFileReaderImpl() {
+    explicit AsyncFileReaderImpl(const eFileReadBackend backend) : backend_(backend) {
         internal_buf_.Realloc(size_t(internal_buf_.chunk_size()) *
                               SimultaniousFileRequests);
+
+        if (backend_ == eFileReadBackend::Default || backend_ == eFileReadBackend::IoUring) {
+            ring_.reset(new IoUringQueue);
+            if (ring_->Init(RingEntries)) {
+                backend_ = eFileReadBackend::IoUring;
+                // chunks of blocking reads go through internal buffer
+                ring_->RegisterBuffer(internal_buf_.chunk(0),
+                                      size_t(internal_buf_.chunk_size()) * internal_buf_.chunk_count());
+            } else {
+                ring_ = nullptr;
+                backend_ = eFileReadBackend::LinuxAIO;
+            }
+        }
+
+        for (FileReadEvent &ev : internal_ev_) {
+            Bind(ev);
+        }
+    }
+
+    eFileReadBackend backend() const { return backend_; }
+
+    void Bind(FileReadEvent &ev) const {
+        assert(!ev.fd_);
+        ev.backend_ = backend_;
+        ev.ring_ = ring_.get();
+    }
+
+    void SubmitRequests() {
+        if (ring_) {
+            ring_->Submit();
+        }
     }
 
     bool ReadFileBlocking(const char *file_path, const size_t read_offset,
@@ -323,6 +417,7 @@ class AsyncFileReaderImpl {
         out_buf.set_data_off(read_offset - aligned_read_offset);
         out_buf.set_data_len(read_size);
 
+        Bind(out_event);
         if (!out_event.ReadFile(fd, aligned_read_offset, aligned_read_size,
                                 out_buf.chunk(0))) {
             out_buf.set_data_off(0);
@@ -455,10 +550,15 @@ const int AsyncFileReaderImpl::SimultaniousFileRequestsCount;
 #endif
 } // namespace Sys
 
-Sys::AsyncFileReader::AsyncFileReader() noexcept : impl_(new AsyncFileReaderImpl) {}
+Sys::AsyncFileReader::AsyncFileReader(const eFileReadBackend backend) noexcept
+    : impl_(new AsyncFileReaderImpl(backend)) {}
 
 Sys::AsyncFileReader::~AsyncFileReader() = default;
 
+Sys::eFileReadBackend Sys::AsyncFileReader::backend() const { return impl_->backend(); }
+
+void Sys::AsyncFileReader::SubmitRequests() { impl_->SubmitRequests(); }
+
 bool Sys::AsyncFileReader ::ReadFileBlocking(const char *file_path,
                                              const size_t read_offset,
                                              const size_t read_size,
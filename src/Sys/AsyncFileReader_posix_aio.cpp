@@ -442,10 +442,14 @@ const int AsyncFileReaderImpl::SimultaniousFileRequestsCount;
 #endif
 } // namespace Sys
 
-Sys::AsyncFileReader::AsyncFileReader() noexcept : impl_(new AsyncFileReaderImpl) {}
+Sys::AsyncFileReader::AsyncFileReader(const eFileReadBackend backend) noexcept : impl_(new AsyncFileReaderImpl) {}
 
 Sys::AsyncFileReader::~AsyncFileReader() = default;
 
+Sys::eFileReadBackend Sys::AsyncFileReader::backend() const { return eFileReadBackend::PosixAIO; }
+
+void Sys::AsyncFileReader::SubmitRequests() {}
+
 bool Sys::AsyncFileReader ::ReadFileBlocking(const char *file_path,
                                              const size_t read_offset,
                                              const size_t read_size,
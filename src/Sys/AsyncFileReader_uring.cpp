@@ -0,0 +1,275 @@
+#include "AsyncFileReader_uring.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+
+#include "AsyncFileReader.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// probing and plain read operations appeared together (5.6), fast poll feature marks headers of 5.7+
+#if defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+#define SYS_HAS_IO_URING 1
+#endif
+
+#ifdef SYS_HAS_IO_URING
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Sys {
+// single request size is limited by kernel anyway
+static const size_t MaxRingReadSize = 0x7ffff000;
+
+static int io_uring_setup(const unsigned entries, io_uring_params *p) {
+    return int(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags) {
+    return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int io_uring_register(const int fd, const unsigned opcode, const void *arg, const unsigned nr_args) {
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T> T *RingPtr(void *ring, const uint32_t offset) {
+    return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(ring) + offset);
+}
+} // namespace Sys
+
+Sys::IoUringQueue::~IoUringQueue() {
+    if (ring_fd_ == -1) {
+        return;
+    }
+    { // events are expected to be finished already, remaining completions are dropped
+        std::lock_guard<std::mutex> lock(mtx_);
+        Submit_nolock(0);
+        while (in_flight_) {
+            if (io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                break;
+            }
+            const uint32_t head = *cq_head_, tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            in_flight_ -= std::min(in_flight_, tail - head);
+            __atomic_store_n(cq_head_, tail, __ATOMIC_RELEASE);
+        }
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    close(ring_fd_);
+}
+
+bool Sys::IoUringQueue::Init(const uint32_t entries) {
+    assert(ring_fd_ == -1);
+
+    io_uring_params p = {};
+    const int fd = io_uring_setup(entries, &p);
+    if (fd < 0) {
+        return false;
+    }
+    ring_fd_ = fd;
+
+    { // make sure read operation is supported
+        const unsigned ops_count = 256;
+        const size_t probe_size = sizeof(io_uring_probe) + ops_count * sizeof(io_uring_probe_op);
+        std::unique_ptr<uint8_t[]> probe_buf(new uint8_t[probe_size]());
+        auto *probe = reinterpret_cast<io_uring_probe *>(probe_buf.get());
+        if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, ops_count) < 0 ||
+            probe->ops_len <= IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) ||
+            !(probe->ops[IORING_OP_READ_FIXED].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+
+    sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ =
+            mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            return false;
+        }
+    }
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        return false;
+    }
+
+    sq_head_ = RingPtr<uint32_t>(sq_ring_, p.sq_off.head);
+    sq_tail_ = RingPtr<uint32_t>(sq_ring_, p.sq_off.tail);
+    sq_array_ = RingPtr<uint32_t>(sq_ring_, p.sq_off.array);
+    sq_mask_ = *RingPtr<uint32_t>(sq_ring_, p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+
+    cq_head_ = RingPtr<uint32_t>(cq_ring_, p.cq_off.head);
+    cq_tail_ = RingPtr<uint32_t>(cq_ring_, p.cq_off.tail);
+    cqes_ = RingPtr<io_uring_cqe>(cq_ring_, p.cq_off.cqes);
+    cq_mask_ = *RingPtr<uint32_t>(cq_ring_, p.cq_off.ring_mask);
+    cq_entries_ = p.cq_entries;
+
+    return true;
+}
+
+bool Sys::IoUringQueue::RegisterBuffer(const void *buf, const size_t size) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    assert(!fixed_buf_ && !in_flight_ && !queued_);
+
+    iovec iov = {};
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = size;
+    // can fail because of locked memory limit, plain reads are used then
+    if (io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        return false;
+    }
+    fixed_buf_ = reinterpret_cast<const uint8_t *>(buf);
+    fixed_buf_size_ = size;
+    return true;
+}
+
+bool Sys::IoUringQueue::Submit_nolock(const uint32_t wait_count) {
+    for (;;) {
+        const unsigned flags = wait_count ? IORING_ENTER_GETEVENTS : 0;
+        const int ret = io_uring_enter(ring_fd_, queued_, wait_count, flags);
+        if (ret >= 0) {
+            queued_ -= uint32_t(ret);
+            in_flight_ += uint32_t(ret);
+            return true;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno == EAGAIN || errno == EBUSY) && in_flight_) {
+            // completion queue is full, make space for new completions and retry
+            Reap_nolock();
+            continue;
+        }
+        return false;
+    }
+}
+
+void Sys::IoUringQueue::Reap_nolock() {
+    uint32_t head = *cq_head_;
+    const uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = reinterpret_cast<const io_uring_cqe *>(cqes_)[head & cq_mask_];
+
+        auto *ev = reinterpret_cast<FileReadEvent *>(uintptr_t(cqe.user_data));
+        ev->ring_res_ = cqe.res;
+        ev->ring_state_ = RingRequestDone;
+
+        assert(in_flight_);
+        --in_flight_;
+    }
+    __atomic_store_n(cq_head_, tail, __ATOMIC_RELEASE);
+}
+
+bool Sys::IoUringQueue::Read(FileReadEvent *ev, const int fd, const size_t read_offset, const size_t read_size,
+                             uint8_t *out_buf) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    assert(ev->ring_state_ != RingRequestPending);
+
+    // completion queue must be able to hold results of all requests
+    while (queued_ + in_flight_ >= cq_entries_) {
+        Reap_nolock();
+        if (queued_ + in_flight_ >= cq_entries_ && !Submit_nolock(1)) {
+            return false;
+        }
+    }
+    // submission queue is full
+    if (queued_ == sq_entries_ && !Submit_nolock(0)) {
+        return false;
+    }
+
+    const uint32_t tail = *sq_tail_;
+    const uint32_t index = tail & sq_mask_;
+
+    io_uring_sqe &sqe = reinterpret_cast<io_uring_sqe *>(sqes_)[index];
+    memset(&sqe, 0, sizeof(io_uring_sqe));
+
+    const size_t size = std::min(read_size, MaxRingReadSize);
+    if (fixed_buf_ && out_buf >= fixed_buf_ && out_buf + size <= fixed_buf_ + fixed_buf_size_) {
+        sqe.opcode = IORING_OP_READ_FIXED;
+        sqe.buf_index = 0;
+    } else {
+        sqe.opcode = IORING_OP_READ;
+    }
+    sqe.fd = fd;
+    sqe.off = uint64_t(read_offset);
+    sqe.addr = uint64_t(uintptr_t(out_buf));
+    sqe.len = uint32_t(size);
+    sqe.user_data = uint64_t(uintptr_t(ev));
+
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++queued_;
+
+    ev->ring_state_ = RingRequestPending;
+    ev->ring_res_ = 0;
+
+    return true;
+}
+
+void Sys::IoUringQueue::Submit() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (queued_) {
+        Submit_nolock(0);
+    }
+}
+
+bool Sys::IoUringQueue::Poll(FileReadEvent *ev, const bool block) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (queued_ && !Submit_nolock(0)) {
+        return true;
+    }
+    Reap_nolock();
+    while (block && ev->ring_state_ == RingRequestPending) {
+        if (!Submit_nolock(1)) {
+            break;
+        }
+        Reap_nolock();
+    }
+    return ev->ring_state_ != RingRequestPending;
+}
+#else
+Sys::IoUringQueue::~IoUringQueue() = default;
+
+bool Sys::IoUringQueue::Init(const uint32_t entries) { return false; }
+bool Sys::IoUringQueue::RegisterBuffer(const void *buf, const size_t size) { return false; }
+bool Sys::IoUringQueue::Read(FileReadEvent *ev, const int fd, const size_t read_offset, const size_t read_size,
+                             uint8_t *out_buf) {
+    return false;
+}
+void Sys::IoUringQueue::Submit() {}
+bool Sys::IoUringQueue::Poll(FileReadEvent *ev, const bool block) { return true; }
+#endif
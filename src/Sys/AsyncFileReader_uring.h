@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <mutex>
+
+namespace Sys {
+class FileReadEvent;
+
+// State of io_uring request of an event
+enum eRingRequestState { RingRequestIdle, RingRequestPending, RingRequestDone };
+
+// Minimal io_uring wrapper (raw syscalls). Read requests are queued and submitted in batches, completions are
+// polled from shared ring memory and stored in events, so checking of finished request does not need a syscall.
+class IoUringQueue {
+    int ring_fd_ = -1;
+
+    void *sq_ring_ = nullptr, *cq_ring_ = nullptr, *sqes_ = nullptr;
+    size_t sq_ring_size_ = 0, cq_ring_size_ = 0, sqes_size_ = 0;
+
+    uint32_t *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+    uint32_t *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    void *cqes_ = nullptr;
+    uint32_t sq_mask_ = 0, sq_entries_ = 0, cq_mask_ = 0, cq_entries_ = 0;
+
+    // requests written to submission queue and requests passed to kernel
+    uint32_t queued_ = 0, in_flight_ = 0;
+
+    const uint8_t *fixed_buf_ = nullptr;
+    size_t fixed_buf_size_ = 0;
+
+    std::mutex mtx_;
+
+    bool Submit_nolock(uint32_t wait_count);
+    void Reap_nolock();
+
+  public:
+    IoUringQueue() = default;
+    ~IoUringQueue();
+
+    IoUringQueue(const IoUringQueue &rhs) = delete;
+    IoUringQueue &operator=(const IoUringQueue &rhs) = delete;
+
+    // Returns false if io_uring (or required operations) is not supported by kernel
+    bool Init(uint32_t entries);
+
+    // Reads into registered memory use pre-mapped pages (IORING_OP_READ_FIXED)
+    bool RegisterBuffer(const void *buf, size_t size);
+
+    bool Read(FileReadEvent *ev, int fd, size_t read_offset, size_t read_size, uint8_t *out_buf);
+    void Submit();
+
+    // Returns true when request of event is finished (result is stored in event)
+    bool Poll(FileReadEvent *ev, bool block);
+};
+} // namespace Sys
@@ -296,10 +296,14 @@ class AsyncFileReaderImpl {
 };
 } // namespace Sys
 
-Sys::AsyncFileReader::AsyncFileReader() noexcept : impl_(new AsyncFileReaderImpl) {}
+Sys::AsyncFileReader::AsyncFileReader(const eFileReadBackend backend) noexcept : impl_(new AsyncFileReaderImpl) {}
 
 Sys::AsyncFileReader::~AsyncFileReader() = default;
 
+Sys::eFileReadBackend Sys::AsyncFileReader::backend() const { return eFileReadBackend::Default; }
+
+void Sys::AsyncFileReader::SubmitRequests() {}
+
 bool Sys::AsyncFileReader ::ReadFileBlocking(const char *file_path, const size_t read_offset, const size_t read_size,
                                              FileReadBufBase &out_buf) {
     return impl_->ReadFileBlocking(file_path, read_offset, read_size, out_buf);
@@ -1,10 +1,326 @@
 #include "Json.h"
 
+#include <cassert>
+#include <cstdlib>
 #include <cstring>
 
 #include <iostream>
+#include <new>
 #include <stdexcept>
 
+namespace JsReaderInternal {
+static const double Pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool IsDigit(const char c) { return c >= '0' && c <= '9'; }
+
+static int HexValue(const char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return 10 + (c - 'a');
+    } else if (c >= 'A' && c <= 'F') {
+        return 10 + (c - 'A');
+    }
+    return -1;
+}
+
+// Parses 4 hex digits of \u escape
+static bool ParseHex4(const char *p, uint32_t &out_code) {
+    out_code = 0;
+    for (int i = 0; i < 4; ++i) {
+        const int v = HexValue(p[i]);
+        if (v == -1) {
+            return false;
+        }
+        out_code = (out_code << 4u) | uint32_t(v);
+    }
+    return true;
+}
+
+static char *EncodeUTF8(const uint32_t code, char *out) {
+    if (code < 0x80) {
+        *out++ = char(code);
+    } else if (code < 0x800) {
+        *out++ = char(0xc0 | (code >> 6));
+        *out++ = char(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        *out++ = char(0xe0 | (code >> 12));
+        *out++ = char(0x80 | ((code >> 6) & 0x3f));
+        *out++ = char(0x80 | (code & 0x3f));
+    } else {
+        *out++ = char(0xf0 | (code >> 18));
+        *out++ = char(0x80 | ((code >> 12) & 0x3f));
+        *out++ = char(0x80 | ((code >> 6) & 0x3f));
+        *out++ = char(0x80 | (code & 0x3f));
+    }
+    return out;
+}
+} // namespace JsReaderInternal
+
+bool JsReader::Error(const char *msg) {
+    if (!error_) {
+        error_ = msg;
+        error_offset_ = size_t(cur_ - begin_);
+    }
+    return false;
+}
+
+bool JsReader::ParseString(char *&out_str, size_t &out_len) {
+    using namespace JsReaderInternal;
+
+    assert(*cur_ == '\"');
+    ++cur_;
+    out_str = cur_;
+
+    // no copying is needed until first escape sequence
+    while (cur_ != end_ && *cur_ != '\"' && *cur_ != '\\') {
+        ++cur_;
+    }
+
+    char *dst = cur_;
+    while (cur_ != end_) {
+        const char c = *cur_;
+        if (c == '\"') {
+            ++cur_;
+            *dst = '\0';
+            out_len = size_t(dst - out_str);
+            return true;
+        } else if (c != '\\') {
+            *dst++ = c;
+            ++cur_;
+            continue;
+        }
+
+        if (end_ - cur_ < 2) {
+            break;
+        }
+        const char e = cur_[1];
+        cur_ += 2;
+        if (e == '\"' || e == '\\' || e == '/') {
+            *dst++ = e;
+        } else if (e == 'b') {
+            *dst++ = '\b';
+        } else if (e == 'f') {
+            *dst++ = '\f';
+        } else if (e == 'n') {
+            *dst++ = '\n';
+        } else if (e == 'r') {
+            *dst++ = '\r';
+        } else if (e == 't') {
+            *dst++ = '\t';
+        } else if (e == 'u') {
+            // encoded character always takes less space than escape sequence
+            uint32_t code;
+            if (end_ - cur_ < 4 || !ParseHex4(cur_, code)) {
+                return Error("Invalid unicode escape sequence");
+            }
+            cur_ += 4;
+            if (code >= 0xd800 && code <= 0xdbff) {
+                // surrogate pair
+                uint32_t low;
+                if (end_ - cur_ < 6 || cur_[0] != '\\' || cur_[1] != 'u' || !ParseHex4(cur_ + 2, low) ||
+                    low < 0xdc00 || low > 0xdfff) {
+                    return Error("Invalid surrogate pair");
+                }
+                cur_ += 6;
+                code = 0x10000 + ((code - 0xd800) << 10u) + (low - 0xdc00);
+            }
+            dst = EncodeUTF8(code, dst);
+        } else {
+            return Error("Invalid escape sequence");
+        }
+    }
+
+    return Error("Unexpected end of data");
+}
+
+bool JsReader::ParseNumber(double &out_val) {
+    using namespace JsReaderInternal;
+
+    const char *start = cur_;
+
+    const bool negative = (*cur_ == '-');
+    if (negative) {
+        ++cur_;
+    }
+    if (cur_ == end_ || !IsDigit(*cur_)) {
+        return Error("Invalid number");
+    }
+
+    // significant digits are accumulated while they fit, result is exact if no digits were dropped
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool exact = true;
+    for (; cur_ != end_ && IsDigit(*cur_); ++cur_) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + uint64_t(*cur_ - '0');
+            digits += (mantissa != 0);
+        } else {
+            ++exponent;
+            exact = false;
+        }
+    }
+    if (cur_ != end_ && *cur_ == '.') {
+        ++cur_;
+        if (cur_ == end_ || !IsDigit(*cur_)) {
+            return Error("Invalid number");
+        }
+        for (; cur_ != end_ && IsDigit(*cur_); ++cur_) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + uint64_t(*cur_ - '0');
+                digits += (mantissa != 0);
+                --exponent;
+            } else {
+                exact = false;
+            }
+        }
+    }
+    if (cur_ != end_ && (*cur_ == 'e' || *cur_ == 'E')) {
+        ++cur_;
+        bool exp_negative = false;
+        if (cur_ != end_ && (*cur_ == '+' || *cur_ == '-')) {
+            exp_negative = (*cur_ == '-');
+            ++cur_;
+        }
+        if (cur_ == end_ || !IsDigit(*cur_)) {
+            return Error("Invalid number");
+        }
+        int exp = 0;
+        for (; cur_ != end_ && IsDigit(*cur_); ++cur_) {
+            exp = std::min(exp * 10 + (*cur_ - '0'), 100000);
+        }
+        exponent += exp_negative ? -exp : exp;
+    }
+
+    if (exact && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        // both values are exactly representable, so single operation gives correctly rounded result
+        double val = double(mantissa);
+        if (exponent < 0) {
+            val /= Pow10[-exponent];
+        } else {
+            val *= Pow10[exponent];
+        }
+        out_val = negative ? -val : val;
+        return true;
+    }
+
+    // fallback to correctly rounded conversion (number is not null-terminated in buffer)
+    const size_t len = size_t(cur_ - start);
+    char temp[64];
+    std::string long_number;
+    const char *number = temp;
+    if (len < sizeof(temp)) {
+        memcpy(temp, start, len);
+        temp[len] = '\0';
+    } else {
+        long_number.assign(start, len);
+        number = long_number.c_str();
+    }
+    out_val = strtod(number, nullptr);
+    return true;
+}
+
+bool JsReader::ParseLiteral(JsLiteralType &out_val) {
+    const size_t left = size_t(end_ - cur_);
+    if (left >= 4 && memcmp(cur_, "null", 4) == 0) {
+        out_val = JsLiteralType::Null;
+        cur_ += 4;
+    } else if (left >= 4 && memcmp(cur_, "true", 4) == 0) {
+        out_val = JsLiteralType::True;
+        cur_ += 4;
+    } else if (left >= 5 && memcmp(cur_, "false", 5) == 0) {
+        out_val = JsLiteralType::False;
+        cur_ += 5;
+    } else {
+        return Error("Unexpected character");
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////
+
+namespace JsReaderInternal {
+// Values of unfinished containers are kept on stack, containers are allocated with exact size when they end
+template <typename Alloc> class DomBuilder {
+    JsElementT<Alloc> &root_;
+    const Alloc &alloc_;
+    std::vector<JsElementT<Alloc>> values_;
+    std::vector<std::pair<const char *, size_t>> keys_;
+    std::vector<std::pair<size_t, size_t>> frames_; // start of values and keys of each open container
+
+    void Add(JsElementT<Alloc> &&el) {
+        if (frames_.empty()) {
+            root_ = std::move(el);
+        } else {
+            values_.push_back(std::move(el));
+        }
+    }
+
+  public:
+    DomBuilder(JsElementT<Alloc> &root, const Alloc &alloc) : root_(root), alloc_(alloc) {}
+
+    bool Literal(const JsLiteralType val) {
+        Add(JsElementT<Alloc>(val));
+        return true;
+    }
+    bool Number(const double val) {
+        Add(JsElementT<Alloc>(val));
+        return true;
+    }
+    bool String(const char *str, const size_t len) {
+        JsElementT<Alloc> el(JsType::String, alloc_);
+        el.as_str().val.assign(str, len);
+        Add(std::move(el));
+        return true;
+    }
+    bool StartObject() {
+        frames_.emplace_back(values_.size(), keys_.size());
+        return true;
+    }
+    bool Key(const char *str, const size_t len) {
+        keys_.emplace_back(str, len);
+        return true;
+    }
+    bool EndObject(const size_t members_count) {
+        const size_t values_start = frames_.back().first, keys_start = frames_.back().second;
+        frames_.pop_back();
+        assert(values_.size() - values_start == members_count && keys_.size() - keys_start == members_count);
+
+        JsElementT<Alloc> el(JsType::Object, alloc_);
+        auto &elements = el.as_obj().elements;
+        elements.reserve(members_count);
+        for (size_t i = 0; i < members_count; i++) {
+            const std::pair<const char *, size_t> &key = keys_[keys_start + i];
+            elements.emplace_back(StdString<Alloc>(key.first, key.second, alloc_), std::move(values_[values_start + i]));
+        }
+        values_.erase(values_.begin() + values_start, values_.end());
+        keys_.resize(keys_start);
+        Add(std::move(el));
+        return true;
+    }
+    bool StartArray() {
+        frames_.emplace_back(values_.size(), keys_.size());
+        return true;
+    }
+    bool EndArray(const size_t elements_count) {
+        const size_t values_start = frames_.back().first;
+        frames_.pop_back();
+        assert(values_.size() - values_start == elements_count);
+
+        JsElementT<Alloc> el(JsType::Array, alloc_);
+        auto &elements = el.as_arr().elements;
+        elements.reserve(elements_count);
+        for (size_t i = values_start; i < values_.size(); i++) {
+            elements.emplace_back(std::move(values_[i]));
+        }
+        values_.erase(values_.begin() + values_start, values_.end());
+        Add(std::move(el));
+        return true;
+    }
+};
+} // namespace JsReaderInternal
+
 bool JsLiteral::Read(std::istream &in) {
     char c;
     while (in.read(&c, 1) && isspace(c))
@@ -91,6 +407,7 @@ void JsStringT<Allocator>::Write(std::ostream &out, const JsFlags /*flags*/) con
 
 template struct JsStringT<std::allocator<char>>;
 template struct JsStringT<Sys::MultiPoolAllocator<char>>;
+template struct JsStringT<Sys::MonoArenaAlloc<char>>;
 
 /////////////////////////////////////////////////////////////////
 
@@ -196,6 +513,7 @@ void JsArrayT<Alloc>::Write(std::ostream &out, JsFlags flags) const {
 
 template struct JsArrayT<std::allocator<char>>;
 template struct JsArrayT<Sys::MultiPoolAllocator<char>>;
+template struct JsArrayT<Sys::MonoArenaAlloc<char>>;
 
 /////////////////////////////////////////////////////////////////
 
@@ -348,6 +666,19 @@ template <typename Alloc> bool JsObjectT<Alloc>::Read(std::istream &in) {
     return false;
 }
 
+template <typename Alloc> bool JsObjectT<Alloc>::Read(char *buf, const size_t len) {
+    JsElementT<Alloc> root(JsLiteralType::Null);
+    if (!root.Read(buf, len, elements.get_allocator())) {
+        return false;
+    }
+    if (root.type() != JsType::Object) {
+        std::cerr << "JsObject::Read(): Expected object" << std::endl;
+        return false;
+    }
+    elements = std::move(root.as_obj().elements);
+    return true;
+}
+
 template <typename Alloc>
 void JsObjectT<Alloc>::Write(std::ostream &out, JsFlags flags) const {
     flags.level++;
@@ -377,6 +708,7 @@ void JsObjectT<Alloc>::Write(std::ostream &out, JsFlags flags) const {
 
 template struct JsObjectT<std::allocator<char>>;
 template struct JsObjectT<Sys::MultiPoolAllocator<char>>;
+template struct JsObjectT<Sys::MonoArenaAlloc<char>>;
 
 /////////////////////////////////////////////////////////////////
 
@@ -682,6 +1014,16 @@ bool JsElementT<Alloc>::Read(std::istream &in, const Alloc &alloc) {
     }
 }
 
+template <typename Alloc> bool JsElementT<Alloc>::Read(char *buf, const size_t len, const Alloc &alloc) {
+    JsReaderInternal::DomBuilder<Alloc> builder(*this, alloc);
+    JsReader reader(buf, len);
+    if (!reader.Parse(builder)) {
+        std::cerr << "JsElement::Read(): " << reader.error() << " at offset " << reader.error_offset() << std::endl;
+        return false;
+    }
+    return true;
+}
+
 template <typename Alloc>
 void JsElementT<Alloc>::Write(std::ostream &out, const JsFlags flags) const {
     if (type_ == JsType::Literal) {
@@ -698,4 +1040,23 @@ void JsElementT<Alloc>::Write(std::ostream &out, const JsFlags flags) const {
 }
 
 template struct JsElementT<std::allocator<char>>;
-template struct JsElementT<Sys::MultiPoolAllocator<char>>;
\ No newline at end of file
+template struct JsElementT<Sys::MultiPoolAllocator<char>>;
+template struct JsElementT<Sys::MonoArenaAlloc<char>>;
+
+JsArenaDocument::JsArenaDocument(const size_t block_size) : arena_(block_size), root_(nullptr) { Clear(); }
+
+void JsArenaDocument::Clear() {
+    arena_.Reset();
+    // root is placed in arena too, destructors are never called (all memory that nodes own belongs to arena)
+    root_ = new (arena_.Alloc(sizeof(JsElementA), alignof(JsElementA))) JsElementA(JsLiteralType::Null);
+}
+
+bool JsArenaDocument::Read(std::istream &in) {
+    Clear();
+    return root_->Read(in, alloc());
+}
+
+bool JsArenaDocument::Read(char *buf, const size_t len) {
+    Clear();
+    return root_->Read(buf, len, alloc());
+}
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "MonoAlloc.h"
 #include "PoolAlloc.h"
 #include "Variant.h"
 
@@ -21,6 +22,128 @@ struct JsFlags {
 };
 static_assert(sizeof(JsFlags) == 4, "!");
 
+// In-situ SAX parser of JSON text stored in contiguous buffer. Strings are unescaped in place and null-terminated,
+// so buffer must be writable and outlive string pointers passed to handler. Handler receives:
+//  bool Literal(JsLiteralType val), bool Number(double val), bool String(const char *str, size_t len),
+//  bool StartObject(), bool Key(const char *str, size_t len), bool EndObject(size_t members_count),
+//  bool StartArray(), bool EndArray(size_t elements_count)
+// Parsing is stopped when handler returns false.
+class JsReader {
+    static const int MaxDepth = 512;
+
+    char *begin_, *cur_, *end_;
+    const char *error_ = nullptr;
+    size_t error_offset_ = 0;
+
+    bool Error(const char *msg);
+
+    void SkipWhitespace() {
+        while (cur_ != end_ && (*cur_ == ' ' || *cur_ == '\n' || *cur_ == '\r' || *cur_ == '\t')) {
+            ++cur_;
+        }
+    }
+
+    bool ParseString(char *&out_str, size_t &out_len);
+    bool ParseNumber(double &out_val);
+    bool ParseLiteral(JsLiteralType &out_val);
+
+    template <typename Handler> bool ParseValue(Handler &h, int depth);
+
+  public:
+    JsReader(char *buf, const size_t len) : begin_(buf), cur_(buf), end_(buf + len) {}
+
+    // Returns false on syntax error or if stopped by handler
+    template <typename Handler> bool Parse(Handler &h);
+
+    const char *error() const { return error_; }
+    size_t error_offset() const { return error_offset_; }
+};
+
+template <typename Handler> bool JsReader::Parse(Handler &h) {
+    SkipWhitespace();
+    if (!ParseValue(h, 0)) {
+        return false;
+    }
+    SkipWhitespace();
+    if (cur_ != end_ && *cur_ != '\0') {
+        return Error("Unexpected data after root element");
+    }
+    return true;
+}
+
+template <typename Handler> bool JsReader::ParseValue(Handler &h, const int depth) {
+    if (cur_ == end_) {
+        return Error("Unexpected end of data");
+    }
+
+    const char c = *cur_;
+    if (c == '\"') {
+        char *str;
+        size_t len;
+        return ParseString(str, len) && (h.String(str, len) || Error("Stopped by handler"));
+    } else if (c == '{' || c == '[') {
+        if (depth == MaxDepth) {
+            return Error("Too deep nesting");
+        }
+        const bool is_object = (c == '{');
+        const char closing = is_object ? '}' : ']';
+        if (!(is_object ? h.StartObject() : h.StartArray())) {
+            return Error("Stopped by handler");
+        }
+        ++cur_;
+        SkipWhitespace();
+
+        size_t count = 0;
+        if (cur_ != end_ && *cur_ == closing) {
+            ++cur_;
+        } else {
+            for (;;) {
+                if (is_object) {
+                    if (cur_ == end_ || *cur_ != '\"') {
+                        return Error("Expected '\"'");
+                    }
+                    char *key;
+                    size_t key_len;
+                    if (!ParseString(key, key_len)) {
+                        return false;
+                    }
+                    if (!h.Key(key, key_len)) {
+                        return Error("Stopped by handler");
+                    }
+                    SkipWhitespace();
+                    if (cur_ == end_ || *cur_ != ':') {
+                        return Error("Expected ':'");
+                    }
+                    ++cur_;
+                    SkipWhitespace();
+                }
+                if (!ParseValue(h, depth + 1)) {
+                    return false;
+                }
+                ++count;
+
+                SkipWhitespace();
+                if (cur_ != end_ && *cur_ == ',') {
+                    ++cur_;
+                    SkipWhitespace();
+                } else if (cur_ != end_ && *cur_ == closing) {
+                    ++cur_;
+                    break;
+                } else {
+                    return Error(is_object ? "Expected ',' or '}'" : "Expected ',' or ']'");
+                }
+            }
+        }
+        return (is_object ? h.EndObject(count) : h.EndArray(count)) || Error("Stopped by handler");
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        double val;
+        return ParseNumber(val) && (h.Number(val) || Error("Stopped by handler"));
+    }
+
+    JsLiteralType val;
+    return ParseLiteral(val) && (h.Literal(val) || Error("Stopped by handler"));
+}
+
 template <typename Alloc> struct JsElementT;
 
 struct JsLiteral {
@@ -55,6 +178,7 @@ struct JsNumber {
 
 template <typename Alloc> using StdString = std::basic_string<char, std::char_traits<char>, Alloc>;
 using StdStringP = StdString<Sys::MultiPoolAllocator<char>>;
+using StdStringA = StdString<Sys::MonoArenaAlloc<char>>;
 
 inline bool operator==(const std::string &lhs, const StdStringP &rhs) { return lhs.compare(rhs.c_str()) == 0; }
 inline bool operator!=(const std::string &lhs, const StdStringP &rhs) { return !operator==(lhs, rhs); }
@@ -62,6 +186,12 @@ inline bool operator!=(const std::string &lhs, const StdStringP &rhs) { return !
 inline bool operator==(const StdStringP &lhs, const std::string &rhs) { return lhs.compare(rhs.c_str()) == 0; }
 inline bool operator!=(const StdStringP &lhs, const std::string &rhs) { return !operator==(lhs, rhs); }
 
+inline bool operator==(const std::string &lhs, const StdStringA &rhs) { return lhs.compare(rhs.c_str()) == 0; }
+inline bool operator!=(const std::string &lhs, const StdStringA &rhs) { return !operator==(lhs, rhs); }
+
+inline bool operator==(const StdStringA &lhs, const std::string &rhs) { return lhs.compare(rhs.c_str()) == 0; }
+inline bool operator!=(const StdStringA &lhs, const std::string &rhs) { return !operator==(lhs, rhs); }
+
 template <typename Alloc> struct JsStringT {
     StdString<Alloc> val;
 
@@ -84,6 +214,7 @@ template <typename Alloc> struct JsStringT {
 };
 extern template struct JsStringT<std::allocator<char>>;
 extern template struct JsStringT<Sys::MultiPoolAllocator<char>>;
+extern template struct JsStringT<Sys::MonoArenaAlloc<char>>;
 
 template <typename Alloc> struct JsArrayT {
     using AllocV = typename Alloc::template rebind<JsElementT<Alloc>>::other;
@@ -115,6 +246,7 @@ template <typename Alloc> struct JsArrayT {
 };
 extern template struct JsArrayT<std::allocator<char>>;
 extern template struct JsArrayT<Sys::MultiPoolAllocator<char>>;
+extern template struct JsArrayT<Sys::MonoArenaAlloc<char>>;
 
 template <typename Alloc> struct JsObjectT {
     using AllocV = typename Alloc::template rebind<std::pair<StdString<Alloc>, JsElementT<Alloc>>>::other;
@@ -153,12 +285,15 @@ template <typename Alloc> struct JsObjectT {
     }
 
     bool Read(std::istream &in);
+    // Parses buffer in place (see JsReader)
+    bool Read(char *buf, size_t len);
     void Write(std::ostream &out, JsFlags flags = {}) const;
 
     static const JsType type = JsType::Object;
 };
 extern template struct JsObjectT<std::allocator<char>>;
 extern template struct JsObjectT<Sys::MultiPoolAllocator<char>>;
+extern template struct JsObjectT<Sys::MonoArenaAlloc<char>>;
 
 template <typename Alloc> struct JsElementT {
   private:
@@ -215,20 +350,52 @@ template <typename Alloc> struct JsElementT {
     bool operator!=(const JsElementT &rhs) const { return !operator==(rhs); }
 
     bool Read(std::istream &in, const Alloc &alloc = Alloc());
+    // Parses buffer in place (see JsReader), unlike stream version escape sequences of strings are decoded
+    bool Read(char *buf, size_t len, const Alloc &alloc = Alloc());
     void Write(std::ostream &out, JsFlags flags = {}) const;
 };
 
 extern template struct JsElementT<std::allocator<char>>;
 extern template struct JsElementT<Sys::MultiPoolAllocator<char>>;
+extern template struct JsElementT<Sys::MonoArenaAlloc<char>>;
 
 using JsString = JsStringT<std::allocator<char>>;
 using JsStringP = JsStringT<Sys::MultiPoolAllocator<char>>;
+using JsStringA = JsStringT<Sys::MonoArenaAlloc<char>>;
 
 using JsArray = JsArrayT<std::allocator<char>>;
 using JsArrayP = JsArrayT<Sys::MultiPoolAllocator<char>>;
+using JsArrayA = JsArrayT<Sys::MonoArenaAlloc<char>>;
 
 using JsObject = JsObjectT<std::allocator<char>>;
 using JsObjectP = JsObjectT<Sys::MultiPoolAllocator<char>>;
+using JsObjectA = JsObjectT<Sys::MonoArenaAlloc<char>>;
 
 using JsElement = JsElementT<std::allocator<char>>;
 using JsElementP = JsElementT<Sys::MultiPoolAllocator<char>>;
+using JsElementA = JsElementT<Sys::MonoArenaAlloc<char>>;
+
+// Document with all nodes allocated from monotonic arena. Nodes are never destroyed one by one, arena is released
+// as a whole on Clear/Read or destruction of document (references to old nodes become invalid then).
+class JsArenaDocument {
+    Sys::MonoArena arena_;
+    JsElementA *root_;
+
+  public:
+    explicit JsArenaDocument(size_t block_size = 64 * 1024);
+
+    JsArenaDocument(const JsArenaDocument &rhs) = delete;
+    JsArenaDocument &operator=(const JsArenaDocument &rhs) = delete;
+
+    JsElementA &root() { return *root_; }
+    const JsElementA &root() const { return *root_; }
+
+    Sys::MonoArenaAlloc<char> alloc() { return Sys::MonoArenaAlloc<char>(arena_); }
+    const Sys::MonoArena &arena() const { return arena_; }
+
+    void Clear();
+
+    bool Read(std::istream &in);
+    // Parses buffer in place (see JsReader)
+    bool Read(char *buf, size_t len);
+};
@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Sys::MappedFile::MappedFile(MappedFile &&rhs) noexcept { (*this) = std::move(rhs); }
+
+Sys::MappedFile &Sys::MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (this == &rhs) {
+        return (*this);
+    }
+
+    Close();
+
+    data_ = rhs.data_;
+    size_ = rhs.size_;
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+#if defined(_WIN32)
+    file_ = rhs.file_;
+    mapping_ = rhs.mapping_;
+    rhs.file_ = rhs.mapping_ = nullptr;
+#endif
+
+    return (*this);
+}
+
+bool Sys::MappedFile::Open(const char *file_name) {
+    Close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    data_ = reinterpret_cast<const uint8_t *>(data);
+    size_ = size_t(file_size.QuadPart);
+    file_ = file;
+    mapping_ = mapping;
+#else
+    const int fd = open(file_name, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // mapping stays valid after descriptor is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = reinterpret_cast<const uint8_t *>(data);
+    size_ = size_t(st.st_size);
+#endif
+
+    return true;
+}
+
+void Sys::MappedFile::Close() {
+    if (!data_) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    file_ = mapping_ = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Sys {
+// Read-only memory-mapped file (empty files can not be mapped)
+class MappedFile {
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    void *file_ = nullptr, *mapping_ = nullptr;
+#endif
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const char *file_name) { Open(file_name); }
+
+    MappedFile(const MappedFile &rhs) = delete;
+    MappedFile(MappedFile &&rhs) noexcept;
+
+    MappedFile &operator=(const MappedFile &rhs) = delete;
+    MappedFile &operator=(MappedFile &&rhs) noexcept;
+
+    ~MappedFile() { Close(); }
+
+    explicit operator bool() const { return data_ != nullptr; }
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+    bool Open(const char *file_name);
+    void Close();
+};
+} // namespace Sys
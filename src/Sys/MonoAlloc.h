@@ -1,8 +1,12 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
+#include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace Sys {
     template <typename T>
@@ -120,4 +124,149 @@ namespace Sys {
         template<class U>
         friend class MonoAlloc;
     };
+
+    // Growable monotonic arena. Memory is taken from few large blocks and released all at once, so containers
+    // that use it (through MonoArenaAlloc) can be dropped without destroying their contents.
+    class MonoArena {
+    public:
+        explicit MonoArena(const size_t block_size = 64 * 1024, const size_t max_block_size = 16 * 1024 * 1024)
+            : next_block_size_(block_size), max_block_size_(max_block_size) {}
+
+        MonoArena(const MonoArena &) = delete;
+        MonoArena& operator=(const MonoArena &) = delete;
+
+        void *Alloc(const size_t size, const size_t align) {
+            uintptr_t p = (uintptr_t(cur_) + align - 1) & ~uintptr_t(align - 1);
+            if (!cur_ || p > uintptr_t(end_) || size > uintptr_t(end_) - p) {
+                NewBlock(size + align);
+                p = (uintptr_t(cur_) + align - 1) & ~uintptr_t(align - 1);
+            }
+            cur_ = reinterpret_cast<char *>(p + size);
+            ++allocations_count_;
+            bytes_used_ += size;
+            return reinterpret_cast<void *>(p);
+        }
+
+        // Only the last allocation can be returned (this makes growing of lone container cheaper)
+        void Free(void *p, const size_t size) {
+            if (p && static_cast<char *>(p) + size == cur_) {
+                cur_ = static_cast<char *>(p);
+                bytes_used_ -= size;
+            }
+        }
+
+        // Releases all allocations, the largest block is kept for reuse
+        void Reset() {
+            if (blocks_.empty()) {
+                return;
+            }
+            size_t largest = 0;
+            for (size_t i = 1; i < blocks_.size(); i++) {
+                if (blocks_[i].size > blocks_[largest].size) {
+                    largest = i;
+                }
+            }
+            std::swap(blocks_[0], blocks_[largest]);
+            blocks_.resize(1);
+            cur_ = blocks_[0].data.get();
+            end_ = cur_ + blocks_[0].size;
+            allocations_count_ = 0;
+            bytes_used_ = 0;
+        }
+
+        size_t allocations_count() const { return allocations_count_; }
+        size_t blocks_count() const { return blocks_.size(); }
+        size_t bytes_used() const { return bytes_used_; }
+        size_t bytes_reserved() const {
+            size_t ret = 0;
+            for (const Block &b : blocks_) {
+                ret += b.size;
+            }
+            return ret;
+        }
+
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            size_t size;
+        };
+        std::vector<Block> blocks_;
+        char *cur_ = nullptr, *end_ = nullptr;
+        size_t next_block_size_, max_block_size_;
+        size_t allocations_count_ = 0, bytes_used_ = 0;
+
+        void NewBlock(const size_t min_size) {
+            const size_t size = next_block_size_ > min_size ? next_block_size_ : min_size;
+            if (next_block_size_ < max_block_size_) {
+                next_block_size_ *= 2;
+            }
+            blocks_.push_back({std::unique_ptr<char[]>(new char[size]), size});
+            cur_ = blocks_.back().data.get();
+            end_ = cur_ + size;
+        }
+    };
+
+    // Allocator that takes memory from MonoArena, deallocation is (almost) no-op
+    template <typename T>
+    class MonoArenaAlloc {
+    public:
+        typedef T * pointer;
+        typedef const T * const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef T value_type;
+        typedef std::size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind {
+            typedef MonoArenaAlloc<U> other;
+        };
+
+        explicit MonoArenaAlloc(MonoArena &arena) : arena_(&arena) {}
+        template <typename U> MonoArenaAlloc(const MonoArenaAlloc<U> &other) : arena_(other.arena_) {}
+
+        std::size_t max_size() const {
+            return (static_cast<std::size_t>(0) - static_cast<std::size_t>(1)) / sizeof(T);
+        }
+
+        T *allocate(const std::size_t n) {
+            if (n == 0) {
+                return nullptr;
+            }
+            if (n > max_size()) {
+                throw std::length_error("MonoArenaAlloc<T>::allocate() - Integer overflow.");
+            }
+            return static_cast<T *>(arena_->Alloc(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T * const p, const std::size_t n) {
+            arena_->Free(p, n * sizeof(T));
+        }
+
+        template<class U, class... Args>
+        void construct(U* p, Args&&... args) {
+            ::new((void *)p) U(std::forward<Args>(args)...);
+        }
+
+        template<class U>
+        void destroy(U *p) {
+            p->~U();
+        }
+
+        bool operator==(const MonoArenaAlloc& other) const {
+            return arena_ == other.arena_;
+        }
+        bool operator!=(const MonoArenaAlloc& other) const {
+            return !(*this == other);
+        }
+
+        MonoArena *arena() const { return arena_; }
+
+    private:
+        MonoArena *arena_;
+
+        template<class U>
+        friend class MonoArenaAlloc;
+    };
 }
\ No newline at end of file
@@ -1,102 +1,569 @@
 #include "Pack.h"
 
-#include <cassert>
-
+#include <algorithm>
+#include <climits>
+#include <fstream>
 #include <memory>
 
 #include "AssetFile.h"
 
-void Sys::ReadPackage(const char *pack_name, onfile_func on_file) {
-    AssetFile in_file(pack_name, eOpenMode::In);
-    size_t file_size = in_file.size();
+namespace Sys {
+const char PackMagic[4] = {'P', 'A', 'K', '2'};
+const uint32_t PackEmptySlot = 0xffffffff;
+
+// Block compression is a simple LZ77 with byte-oriented format (similar to LZ4 block), each sequence is:
+//  token (literals count in high 4 bits, match length - 4 in low 4 bits), extra literals count bytes, literals,
+//  2-byte match offset, extra match length bytes. Last sequence of block contains only literals.
+const int LzMinMatch = 4;
+const int LzHashBits = 14;
+
+static uint32_t LzRead32(const uint8_t *p) {
+    uint32_t ret;
+    memcpy(&ret, p, sizeof(uint32_t));
+    return ret;
+}
+
+static bool LzWriteLength(uint8_t *&out, const uint8_t *out_end, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (out == out_end) {
+            return false;
+        }
+        *out++ = 255;
+    }
+    if (out == out_end) {
+        return false;
+    }
+    *out++ = uint8_t(len);
+    return true;
+}
+
+static bool LzReadLength(const uint8_t *&in, const uint8_t *in_end, size_t &len) {
+    uint8_t b;
+    do {
+        if (in == in_end) {
+            return false;
+        }
+        b = *in++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+static bool LzWriteSequence(uint8_t *&out, const uint8_t *out_end, const uint8_t *literals, const size_t lit_len,
+                            const size_t match_off, const size_t match_len) {
+    if (out == out_end) {
+        return false;
+    }
+    uint8_t &token = *out++;
+    token = uint8_t(std::min(lit_len, size_t(15)) << 4);
+    if (lit_len >= 15 && !LzWriteLength(out, out_end, lit_len - 15)) {
+        return false;
+    }
+    if (size_t(out_end - out) < lit_len) {
+        return false;
+    }
+    memcpy(out, literals, lit_len);
+    out += lit_len;
+
+    if (match_len) {
+        const size_t len = match_len - LzMinMatch;
+        token |= uint8_t(std::min(len, size_t(15)));
+        if (out_end - out < 2) {
+            return false;
+        }
+        *out++ = uint8_t(match_off & 0xff);
+        *out++ = uint8_t(match_off >> 8);
+        if (len >= 15 && !LzWriteLength(out, out_end, len - 15)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns compressed size or 0 if result does not fit into output buffer
+static size_t LzCompress(const uint8_t *src, const size_t src_size, uint8_t *dst, const size_t dst_capacity,
+                         uint32_t *hash_table) {
+    std::fill(hash_table, hash_table + (1 << LzHashBits), PackEmptySlot);
+
+    uint8_t *out = dst;
+    const uint8_t *out_end = dst + dst_capacity;
+
+    size_t ip = 0, anchor = 0;
+    while (ip + LzMinMatch <= src_size) {
+        const uint32_t seq = LzRead32(src + ip);
+        const uint32_t hash = (seq * 2654435761u) >> (32 - LzHashBits);
+        const uint32_t ref = hash_table[hash];
+        hash_table[hash] = uint32_t(ip);
+
+        if (ref != PackEmptySlot && ip - ref <= 0xffff && LzRead32(src + ref) == seq) {
+            size_t len = LzMinMatch;
+            while (ip + len < src_size && src[ref + len] == src[ip + len]) {
+                ++len;
+            }
+            if (!LzWriteSequence(out, out_end, src + anchor, ip - anchor, ip - ref, len)) {
+                return 0;
+            }
+            ip += len;
+            anchor = ip;
+        } else {
+            ++ip;
+        }
+    }
+
+    if (!LzWriteSequence(out, out_end, src + anchor, src_size - anchor, 0, 0)) {
+        return 0;
+    }
+    return size_t(out - dst);
+}
+
+static bool LzDecompress(const uint8_t *src, const size_t src_size, uint8_t *dst, const size_t dst_size) {
+    const uint8_t *in = src, *in_end = src + src_size;
+    uint8_t *out = dst, *out_end = dst + dst_size;
+
+    while (in < in_end) {
+        const uint8_t token = *in++;
+
+        size_t lit_len = (token >> 4);
+        if (lit_len == 15 && !LzReadLength(in, in_end, lit_len)) {
+            return false;
+        }
+        if (size_t(in_end - in) < lit_len || size_t(out_end - out) < lit_len) {
+            return false;
+        }
+        memcpy(out, in, lit_len);
+        in += lit_len;
+        out += lit_len;
+
+        if (in == in_end) {
+            break;
+        }
+
+        if (in_end - in < 2) {
+            return false;
+        }
+        const size_t off = size_t(in[0]) | (size_t(in[1]) << 8);
+        in += 2;
+
+        size_t match_len = (token & 0xf);
+        if (match_len == 15 && !LzReadLength(in, in_end, match_len)) {
+            return false;
+        }
+        match_len += LzMinMatch;
+        if (off == 0 || off > size_t(out - dst) || size_t(out_end - out) < match_len) {
+            return false;
+        }
+
+        // regions can overlap
+        const uint8_t *match = out - off;
+        for (size_t i = 0; i < match_len; ++i) {
+            out[i] = match[i];
+        }
+        out += match_len;
+    }
+
+    return out == out_end;
+}
+
+static uint64_t PackBlocksCount(const uint64_t size) { return (size + PackBlockSize - 1) / PackBlockSize; }
+
+// Compressed entry is a table of block ends (relative to entry start) followed by blocks data
+static void CompressEntry(const uint8_t *data, const uint64_t size, uint32_t *hash_table,
+                          std::vector<uint8_t> &out) {
+    const uint64_t blocks_count = PackBlocksCount(size);
+    out.resize(size_t(blocks_count * sizeof(uint64_t)));
+
+    for (uint64_t i = 0; i < blocks_count; ++i) {
+        const uint8_t *src = data + i * PackBlockSize;
+        const size_t src_size = size_t(std::min(uint64_t(PackBlockSize), size - i * PackBlockSize));
+
+        const size_t pos = out.size();
+        out.resize(pos + src_size);
+        // block is stored uncompressed if it is not getting smaller
+        size_t stored_size = LzCompress(src, src_size, &out[pos], src_size - 1, hash_table);
+        if (!stored_size) {
+            memcpy(&out[pos], src, src_size);
+            stored_size = src_size;
+        }
+        out.resize(pos + stored_size);
+
+        const uint64_t block_end = out.size();
+        memcpy(&out[size_t(i * sizeof(uint64_t))], &block_end, sizeof(uint64_t));
+    }
+}
+
+// Open addressing hash table with linear probing, size is a power of two
+static std::vector<uint32_t> BuildIndex(const PackEntry *entries, const uint32_t entries_count) {
+    uint32_t index_size = 1;
+    while (index_size < 2 * entries_count) {
+        index_size *= 2;
+    }
+
+    std::vector<uint32_t> index(index_size, PackEmptySlot);
+    for (uint32_t i = 0; i < entries_count; ++i) {
+        uint32_t slot = entries[i].name_hash & (index_size - 1);
+        while (index[slot] != PackEmptySlot) {
+            slot = (slot + 1) & (index_size - 1);
+        }
+        index[slot] = i;
+    }
+    return index;
+}
+} // namespace Sys
+
+uint32_t Sys::PackNameHash(const char *name, const size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ uint8_t(name[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool Sys::PackageReader::Open(const char *pack_name) {
+    Close();
+
+    if (!file_.Open(pack_name)) {
+        return false;
+    }
+
+    bool ok;
+    if (file_.size() >= sizeof(PackHeader) && memcmp(file_.data(), PackMagic, 4) == 0) {
+        ok = OpenV2();
+    } else {
+        ok = OpenV1();
+    }
+
+    if (!ok) {
+        Close();
+    }
+    return ok;
+}
+
+void Sys::PackageReader::Close() {
+    file_.Close();
+    entries_ = nullptr;
+    entries_count_ = 0;
+    index_ = nullptr;
+    index_size_ = 0;
+    names_ = nullptr;
+    v1_entries_ = {};
+    v1_index_ = {};
+    v1_names_ = {};
+}
+
+bool Sys::PackageReader::OpenV1() {
+    const uint64_t file_size = file_.size();
+    if (file_size < sizeof(uint32_t)) {
+        return false;
+    }
+
     uint32_t num_files;
-    in_file.Read((char *)&num_files, sizeof(uint32_t));
+    memcpy(&num_files, file_.data(), sizeof(uint32_t));
+    if (sizeof(uint32_t) + uint64_t(num_files) * sizeof(FileDesc) > file_size) {
+        return false;
+    }
 
-    std::vector<FileDesc> file_list;
+    v1_entries_.resize(num_files);
+    for (uint32_t i = 0; i < num_files; ++i) {
+        FileDesc f;
+        memcpy(&f, file_.data() + sizeof(uint32_t) + i * sizeof(FileDesc), sizeof(FileDesc));
+        if (uint64_t(f.off) + f.size > file_size) {
+            return false;
+        }
+
+        const size_t name_len = strnlen(f.name, sizeof(f.name));
+
+        PackEntry &e = v1_entries_[i];
+        e.off = f.off;
+        e.size = e.stored_size = f.size;
+        e.name_off = uint32_t(v1_names_.size());
+        e.name_len = uint32_t(name_len);
+        e.name_hash = PackNameHash(f.name, name_len);
+        e.flags = 0;
+
+        v1_names_.append(f.name, name_len);
+    }
+    v1_index_ = BuildIndex(v1_entries_.data(), num_files);
+
+    entries_ = v1_entries_.data();
+    entries_count_ = num_files;
+    index_ = v1_index_.data();
+    index_size_ = uint32_t(v1_index_.size());
+    names_ = v1_names_.data();
+
+    return true;
+}
+
+bool Sys::PackageReader::OpenV2() {
+    const uint64_t file_size = file_.size();
+
+    PackHeader header;
+    memcpy(&header, file_.data(), sizeof(PackHeader));
 
-    // size_t file_pos = sizeof(uint32_t) + num_files * (120 + 2 * sizeof(uint32_t));
-    for (unsigned i = 0; i < num_files; i++) {
-        file_list.emplace_back();
-        FileDesc &f = file_list.back();
-        in_file.Read((char *)&f, sizeof(FileDesc));
-        assert(f.off + f.size <= file_size);
+    if (header.version != PackVersion || header.block_size != PackBlockSize || header.index_size == 0 ||
+        (header.index_size & (header.index_size - 1)) != 0 || header.index_size < header.entries_count ||
+        (header.entries_off % alignof(PackEntry)) != 0 || (header.index_off % alignof(uint32_t)) != 0 ||
+        header.entries_off > file_size || header.index_off > file_size || header.names_off > file_size ||
+        uint64_t(header.entries_count) * sizeof(PackEntry) > file_size - header.entries_off ||
+        uint64_t(header.index_size) * sizeof(uint32_t) > file_size - header.index_off ||
+        header.names_size > file_size - header.names_off) {
+        return false;
     }
 
-    for (auto &f : file_list) {
-        std::unique_ptr<char[]> buf(new char[f.size]);
-        in_file.SeekAbsolute(f.off);
-        in_file.Read(buf.get(), f.size);
+    entries_ = reinterpret_cast<const PackEntry *>(file_.data() + header.entries_off);
+    entries_count_ = header.entries_count;
+    index_ = reinterpret_cast<const uint32_t *>(file_.data() + header.index_off);
+    index_size_ = header.index_size;
+    names_ = reinterpret_cast<const char *>(file_.data() + header.names_off);
 
-        on_file(f.name, buf.get(), f.size);
+    for (uint32_t i = 0; i < entries_count_; ++i) {
+        const PackEntry &e = entries_[i];
+        if (e.off > file_size || e.stored_size > file_size - e.off ||
+            uint64_t(e.name_off) + e.name_len > header.names_size) {
+            return false;
+        }
+        if ((e.flags & PackEntryCompressed) && PackBlocksCount(e.size) * sizeof(uint64_t) > e.stored_size) {
+            return false;
+        }
+        if (!(e.flags & PackEntryCompressed) && e.stored_size != e.size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < index_size_; ++i) {
+        if (index_[i] != PackEmptySlot && index_[i] >= entries_count_) {
+            return false;
+        }
     }
+
+    return true;
 }
 
-#ifndef __ANDROID__
-void Sys::WritePackage(const char *pack_name, std::vector<std::string> &file_list) {
-    AssetFile out_file(pack_name, eOpenMode::Out);
-    uint32_t num_files = (uint32_t)file_list.size();
-    out_file.Write((char *)&num_files, sizeof(uint32_t));
-
-    size_t file_pos = sizeof(uint32_t) + num_files * (120 + 2 * sizeof(uint32_t));
-    for (auto &f : file_list) {
-        assert(f.length() < 124);
-        AssetFile in_file(f.c_str(), eOpenMode::In);
-        char name[120]{};
-        strcpy(name, f.c_str());
-        const auto file_size = uint32_t(in_file.size());
-        out_file.Write(name, sizeof(name));
-        out_file.Write((char *)&file_pos, sizeof(uint32_t));
-        out_file.Write((char *)&file_size, sizeof(uint32_t));
-        file_pos += file_size;
+int Sys::PackageReader::Find(const char *name) const {
+    if (!index_size_) {
+        return -1;
+    }
+
+    const size_t len = strlen(name);
+    const uint32_t hash = PackNameHash(name, len);
+
+    uint32_t slot = hash & (index_size_ - 1);
+    for (uint32_t probe = 0; probe < index_size_; ++probe) {
+        const uint32_t i = index_[slot];
+        if (i == PackEmptySlot) {
+            break;
+        }
+        const PackEntry &e = entries_[i];
+        if (e.name_hash == hash && e.name_len == len && memcmp(names_ + e.name_off, name, len) == 0) {
+            return int(i);
+        }
+        slot = (slot + 1) & (index_size_ - 1);
+    }
+
+    return -1;
+}
+
+const uint8_t *Sys::PackageReader::data(const int i) const {
+    const PackEntry &e = entries_[i];
+    if (e.flags & PackEntryCompressed) {
+        return nullptr;
+    }
+    return file_.data() + e.off;
+}
+
+bool Sys::PackageReader::ReadBlock(const PackEntry &e, const uint64_t block, uint8_t *out_data) const {
+    const uint8_t *entry_data = file_.data() + e.off;
+    const uint64_t blocks_count = PackBlocksCount(e.size);
+
+    uint64_t block_beg = blocks_count * sizeof(uint64_t), block_end;
+    if (block) {
+        memcpy(&block_beg, entry_data + (block - 1) * sizeof(uint64_t), sizeof(uint64_t));
+    }
+    memcpy(&block_end, entry_data + block * sizeof(uint64_t), sizeof(uint64_t));
+    if (block_beg > block_end || block_end > e.stored_size) {
+        return false;
+    }
+
+    const size_t block_size = size_t(std::min(uint64_t(PackBlockSize), e.size - block * PackBlockSize));
+    const size_t stored_size = size_t(block_end - block_beg);
+    if (stored_size == block_size) {
+        memcpy(out_data, entry_data + block_beg, block_size);
+        return true;
+    }
+    return LzDecompress(entry_data + block_beg, stored_size, out_data, block_size);
+}
+
+size_t Sys::PackageReader::Read(const int i, const uint64_t pos, void *buf, size_t size,
+                                PackBlockCache *cache) const {
+    const PackEntry &e = entries_[i];
+    if (pos >= e.size) {
+        return 0;
+    }
+    size = size_t(std::min(uint64_t(size), e.size - pos));
+
+    auto *out = reinterpret_cast<uint8_t *>(buf);
+    if (!(e.flags & PackEntryCompressed)) {
+        memcpy(out, file_.data() + e.off + pos, size);
+        return size;
     }
 
-    for (auto &f : file_list) {
+    std::vector<uint8_t> temp;
+
+    size_t bytes_read = 0;
+    while (bytes_read < size) {
+        const uint64_t block = (pos + bytes_read) / PackBlockSize;
+        const size_t block_off = size_t((pos + bytes_read) % PackBlockSize);
+        const size_t block_size = size_t(std::min(uint64_t(PackBlockSize), e.size - block * PackBlockSize));
+        const size_t len = std::min(size - bytes_read, block_size - block_off);
+
+        if (cache && cache->entry == i && cache->block == block) {
+            memcpy(out + bytes_read, &cache->data[block_off], len);
+        } else if (len == block_size) {
+            // whole block is decompressed directly into output
+            if (!ReadBlock(e, block, out + bytes_read)) {
+                break;
+            }
+        } else {
+            std::vector<uint8_t> &block_data = cache ? cache->data : temp;
+            block_data.resize(block_size);
+            if (cache) {
+                cache->entry = -1;
+            }
+            if (!ReadBlock(e, block, block_data.data())) {
+                break;
+            }
+            if (cache) {
+                cache->entry = i;
+                cache->block = block;
+            }
+            memcpy(out + bytes_read, &block_data[block_off], len);
+        }
+        bytes_read += len;
+    }
+
+    return bytes_read;
+}
+
+bool Sys::ReadPackage(const char *pack_name, onfile_func on_file) {
+    PackageReader pack(pack_name);
+    if (!pack) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < pack.entries_count(); i++) {
+        const PackEntry &e = pack.entry(int(i));
+        if (e.size > uint64_t(INT_MAX)) {
+            // entry size does not fit into on_file argument
+            return false;
+        }
+
+        std::unique_ptr<char[]> buf(new char[size_t(e.size)]);
+        if (pack.Read(int(i), 0, buf.get(), size_t(e.size)) != e.size) {
+            // corrupted entry data
+            return false;
+        }
+
+        on_file(pack.entry_name(int(i)).c_str(), buf.get(), int(e.size));
+    }
+
+    return true;
+}
+
+#ifndef __ANDROID__
+void Sys::WritePackage(const char *pack_name, std::vector<std::string> &file_list, const bool compress) {
+    std::ofstream out_file(pack_name, std::ios::binary);
+
+    PackHeader header = {};
+    memcpy(header.magic, PackMagic, 4);
+    header.version = PackVersion;
+    header.entries_count = uint32_t(file_list.size());
+    header.page_size = PackPageSize;
+    header.block_size = PackBlockSize;
+
+    static const char padding[PackPageSize] = {};
+    // header is rewritten at the end
+    out_file.write(padding, PackPageSize);
+
+    std::vector<PackEntry> entries(file_list.size());
+    std::string names;
+
+    std::vector<uint8_t> compressed;
+    std::vector<uint32_t> hash_table(compress ? (1u << LzHashBits) : 0);
+
+    uint64_t file_pos = PackPageSize;
+    for (size_t i = 0; i < file_list.size(); ++i) {
+        const std::string &f = file_list[i];
+
         AssetFile in_file(f.c_str(), eOpenMode::In);
-        std::unique_ptr<char[]> buf(new char[in_file.size()]);
-        in_file.Read(buf.get(), in_file.size());
-        out_file.Write(buf.get(), in_file.size());
+        const size_t file_size = in_file.size();
+        std::unique_ptr<uint8_t[]> buf(new uint8_t[file_size]);
+        in_file.Read(reinterpret_cast<char *>(buf.get()), file_size);
+
+        PackEntry &e = entries[i];
+        e.off = file_pos;
+        e.size = e.stored_size = file_size;
+        e.name_off = uint32_t(names.size());
+        e.name_len = uint32_t(f.length());
+        e.name_hash = PackNameHash(f.c_str(), f.length());
+        e.flags = 0;
+
+        names += f;
+
+        const uint8_t *data = buf.get();
+        if (compress && file_size) {
+            CompressEntry(buf.get(), file_size, hash_table.data(), compressed);
+            if (compressed.size() < file_size) {
+                e.flags |= PackEntryCompressed;
+                e.stored_size = compressed.size();
+                data = compressed.data();
+            }
+        }
+
+        out_file.write(reinterpret_cast<const char *>(data), std::streamsize(e.stored_size));
+        file_pos += e.stored_size;
+
+        // each entry starts at page boundary
+        const uint64_t padding_size = (PackPageSize - file_pos % PackPageSize) % PackPageSize;
+        out_file.write(padding, std::streamsize(padding_size));
+        file_pos += padding_size;
     }
+
+    const std::vector<uint32_t> index = BuildIndex(entries.data(), uint32_t(entries.size()));
+
+    header.entries_off = file_pos;
+    header.index_off = header.entries_off + entries.size() * sizeof(PackEntry);
+    header.index_size = uint32_t(index.size());
+    header.names_off = header.index_off + index.size() * sizeof(uint32_t);
+    header.names_size = names.size();
+
+    out_file.write(reinterpret_cast<const char *>(entries.data()), std::streamsize(entries.size() * sizeof(PackEntry)));
+    out_file.write(reinterpret_cast<const char *>(index.data()), std::streamsize(index.size() * sizeof(uint32_t)));
+    out_file.write(names.data(), std::streamsize(names.size()));
+
+    out_file.seekp(0, std::ios::beg);
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(PackHeader));
 }
 #endif
 
-std::vector<Sys::FileDesc> Sys::EnumFilesInPackage(const char *pack_name) {
-    AssetFile in_file(pack_name, eOpenMode::In);
-    size_t file_size = in_file.size();
-    uint32_t num_files;
-    in_file.Read((char *)&num_files, sizeof(uint32_t));
+std::vector<std::string> Sys::EnumFilesInPackage(const char *pack_name) {
+    PackageReader pack(pack_name);
 
-    std::vector<FileDesc> file_list;
-
-    // size_t file_pos = sizeof(uint32_t) + num_files * (120 + 2 * sizeof(uint32_t));
-    for (unsigned i = 0; i < num_files; i++) {
-        file_list.emplace_back();
-        FileDesc &f = file_list.back();
-        in_file.Read((char *)&f, sizeof(FileDesc));
-        assert(f.off + f.size <= file_size);
+    std::vector<std::string> file_list;
+    for (uint32_t i = 0; i < pack.entries_count(); i++) {
+        file_list.push_back(pack.entry_name(int(i)));
     }
 
     return file_list;
 }
 
-bool Sys::ReadFromPackage(const char *pack_name, const char *fname, const size_t pos,
-                          char *buf, const size_t /*size*/) {
-    AssetFile in_file(pack_name, eOpenMode::In);
-    // size_t file_size = in_file.size();
-    uint32_t num_files;
-    in_file.Read((char *)&num_files, sizeof(uint32_t));
-
-    // size_t file_pos = sizeof(uint32_t) + num_files * (120 + 2 * sizeof(uint32_t));
-    for (unsigned i = 0; i < num_files; i++) {
-        char name[120]{};
-        in_file.Read(name, sizeof(name));
-        uint32_t off, size;
-        in_file.Read((char *)&off, sizeof(uint32_t));
-        in_file.Read((char *)&size, sizeof(uint32_t));
-        if (strcmp(name, fname) == 0) {
-            in_file.SeekAbsolute(off + pos);
-            in_file.Read(buf, size);
-            return true;
-        }
-    }
-    return false;
+bool Sys::ReadFromPackage(const char *pack_name, const char *fname, const size_t pos, char *buf,
+                          const size_t size) {
+    PackageReader pack(pack_name);
+
+    const int i = pack.Find(fname);
+    if (i == -1 || pos > pack.entry(i).size) {
+        return false;
+    }
+    // requested range is clamped to entry size
+    const size_t expected = size_t(std::min(uint64_t(size), pack.entry(i).size - pos));
+    return pack.Read(i, pos, buf, size) == expected;
 }
@@ -6,9 +6,12 @@
 #include <string>
 #include <vector>
 
+#include "MappedFile.h"
+
 namespace Sys {
 typedef void (*onfile_func)(const char *name, void *data, int size);
 
+// Entry of legacy (v1) package
 struct FileDesc {
     char name[120];
     uint32_t off, size;
@@ -17,11 +20,98 @@ static_assert(sizeof(FileDesc) == 128, "!!!");
 static_assert(offsetof(FileDesc, off) == 120, "!!!");
 static_assert(offsetof(FileDesc, size) == 124, "!!!");
 
-void ReadPackage(const char *pack_name, onfile_func on_file);
-void WritePackage(const char *pack_name, std::vector<std::string> &file_list);
+// Package v2 layout:
+//  header | entries data (each entry starts at page boundary) | entries table | hash index | names
+// Uncompressed entries can be used directly from mapped file. Compressed entries are split into blocks
+// compressed independently (block ends table is stored in front of entry data), so any range can be read
+// without decompressing whole entry.
+const uint32_t PackVersion = 2;
+const uint32_t PackPageSize = 4096;
+const uint32_t PackBlockSize = 64 * 1024;
+
+enum ePackEntryFlags : uint32_t { PackEntryCompressed = (1u << 0) };
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries_count, index_size;
+    uint32_t page_size, block_size;
+    uint64_t entries_off, index_off, names_off, names_size;
+    uint8_t _padding[8];
+};
+static_assert(sizeof(PackHeader) == 64, "!!!");
+
+struct PackEntry {
+    uint64_t off, size, stored_size;
+    uint32_t name_off, name_len, name_hash, flags;
+};
+static_assert(sizeof(PackEntry) == 40, "!!!");
+
+uint32_t PackNameHash(const char *name, size_t len);
+
+// Cache of last decompressed block (used for sequential reads of compressed entry)
+struct PackBlockCache {
+    int entry = -1;
+    uint64_t block = 0;
+    std::vector<uint8_t> data;
+};
+
+// Memory-mapped package (both v1 and v2 are supported, index of v1 package is built on load)
+class PackageReader {
+    MappedFile file_;
+
+    const PackEntry *entries_ = nullptr;
+    uint32_t entries_count_ = 0;
+    const uint32_t *index_ = nullptr;
+    uint32_t index_size_ = 0;
+    const char *names_ = nullptr;
+
+    // storage for converted v1 directory
+    std::vector<PackEntry> v1_entries_;
+    std::vector<uint32_t> v1_index_;
+    std::string v1_names_;
+
+    bool OpenV1();
+    bool OpenV2();
+
+    bool ReadBlock(const PackEntry &e, uint64_t block, uint8_t *out_data) const;
+
+  public:
+    PackageReader() = default;
+    explicit PackageReader(const char *pack_name) { Open(pack_name); }
+
+    PackageReader(const PackageReader &rhs) = delete;
+    PackageReader &operator=(const PackageReader &rhs) = delete;
+
+    explicit operator bool() const { return bool(file_); }
+
+    bool Open(const char *pack_name);
+    void Close();
+
+    uint32_t entries_count() const { return entries_count_; }
+    const PackEntry &entry(const int i) const { return entries_[i]; }
+    std::string entry_name(const int i) const {
+        return std::string(names_ + entries_[i].name_off, entries_[i].name_len);
+    }
+
+    // Returns index of entry or -1 if not found
+    int Find(const char *name) const;
+
+    // Returns pointer to entry data inside of mapped file (nullptr if entry is compressed)
+    const uint8_t *data(int i) const;
+
+    // Reads range of entry, only blocks that overlap with it are decompressed. Returns number of bytes read.
+    size_t Read(int i, uint64_t pos, void *buf, size_t size, PackBlockCache *cache = nullptr) const;
+};
+
+// Returns false if package can not be opened or one of entries can not be read or is larger than INT_MAX bytes
+// (on_file is not called for it)
+bool ReadPackage(const char *pack_name, onfile_func on_file);
+// Writes package of v2 format, entries are compressed if it reduces their size
+void WritePackage(const char *pack_name, std::vector<std::string> &file_list, bool compress = false);
 
-std::vector<FileDesc> EnumFilesInPackage(const char *pack_name);
+std::vector<std::string> EnumFilesInPackage(const char *pack_name);
 
-bool ReadFromPackage(const char *pack_name, const char *fname, size_t pos, char *buf,
-                     size_t size);
+// Returns true if requested range (clamped to entry size) was read completely
+bool ReadFromPackage(const char *pack_name, const char *fname, size_t pos, char *buf, size_t size);
 } // namespace Sys
@@ -1,10 +1,14 @@
 
 #include <cstdio>
+#include <cstring>
 
 void test_alloc();
 void test_async_file();
+void bench_async_file();
+void bench_json();
 void test_inplace_function();
 void test_json();
+void test_mapped_file();
 void test_optional();
 void test_pack();
 void test_scope_exit();
@@ -12,13 +16,22 @@ void test_signal();
 void test_thread_pool();
 void test_vector();
 
-int main() {
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        puts("Bench async file:");
+        bench_async_file();
+        puts("Bench json:");
+        bench_json();
+        return 0;
+    }
+
     test_alloc();
     test_async_file();
     test_inplace_function();
     test_json();
+    test_mapped_file();
     test_optional();
-    //test_pack();
+    test_pack();
     test_scope_exit();
     test_signal();
     test_thread_pool();
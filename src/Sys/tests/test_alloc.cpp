@@ -1,5 +1,6 @@
 #include "test_common.h"
 
+#include <cstdint>
 #include <cstring>
 
 #include <functional>
@@ -113,6 +114,75 @@ void test_alloc() {
         require(tree.empty());
     }
 
+    { // Arena basic usage
+        Sys::MonoArena arena(256, 1024);
+
+        auto *p1 = static_cast<char *>(arena.Alloc(3, 1));
+        auto *p2 = static_cast<double *>(arena.Alloc(sizeof(double), alignof(double)));
+        require(uintptr_t(p2) % alignof(double) == 0);
+        require(reinterpret_cast<char *>(p2) - p1 < 16);
+        require(arena.allocations_count() == 2);
+        require(arena.blocks_count() == 1);
+
+        // last allocation is reclaimed
+        void *p3 = arena.Alloc(100, 1);
+        arena.Free(p3, 100);
+        require(arena.Alloc(100, 1) == p3);
+        // others are not
+        arena.Free(p1, 3);
+        require(arena.bytes_used() == 3 + sizeof(double) + 100);
+
+        // next blocks grow
+        arena.Alloc(200, 1);
+        require(arena.blocks_count() == 2);
+        arena.Alloc(400, 1);
+        require(arena.blocks_count() == 3);
+        // too large allocation gets its own block
+        void *p4 = arena.Alloc(4096, 16);
+        require(uintptr_t(p4) % 16 == 0);
+        require(arena.blocks_count() == 4);
+        require(arena.allocations_count() == 7);
+
+        // the largest block is kept
+        arena.Reset();
+        require(arena.blocks_count() == 1);
+        require(arena.bytes_reserved() >= 4096);
+        require(arena.allocations_count() == 0);
+        require(arena.bytes_used() == 0);
+        arena.Alloc(2048, 1);
+        require(arena.blocks_count() == 1);
+    }
+
+    { // Arena usage with stl
+        Sys::MonoArena arena(1024);
+        Sys::MonoArenaAlloc<char> my_alloc(arena);
+
+        std::vector<int, Sys::MonoArenaAlloc<int>> vec(my_alloc);
+        for (int i = 0; i < 1000; i++) {
+            vec.push_back(i);
+        }
+
+        std::list<int, Sys::MonoArenaAlloc<int>> list(my_alloc);
+        for (int i = 0; i < 1000; i++) {
+            list.push_back(i);
+        }
+
+        std::basic_string<char, std::char_traits<char>, Sys::MonoArenaAlloc<char>> str(my_alloc);
+        for (int i = 0; i < 100; i++) {
+            str.append("string");
+        }
+
+        for (int i = 0; i < 1000; i++) {
+            require(vec[i] == i);
+        }
+        int expected = 0;
+        for (const int v : list) {
+            require(v == expected++);
+        }
+        require(str.size() == 600);
+        require(arena.blocks_count() < 10);
+    }
+
     { // Pool alloc usage
         Sys::PoolAllocator allocator(4, 255);
 
@@ -1,13 +1,87 @@
 #include "test_common.h"
 
+#include <chrono>
 #include <cstring>
 #include <fstream>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "../AssetFile.h"
 #include "../AsyncFileReader.h"
 
+namespace {
+const Sys::eFileReadBackend g_backends[] = {Sys::eFileReadBackend::Default, Sys::eFileReadBackend::LinuxAIO,
+                                            Sys::eFileReadBackend::PosixAIO, Sys::eFileReadBackend::IoUring};
+const char *g_backend_names[] = {"Default", "LinuxAIO", "PosixAIO", "IoUring"};
+
+void WriteTestFile(const char *file_name, const size_t file_size, const uint8_t test_data[1000]) {
+    std::ofstream out_file(file_name, std::ios::binary);
+    for (size_t i = 0; i < file_size; i += 1000) {
+        out_file.write((const char *)test_data, std::streamsize(std::min(file_size - i, size_t(1000))));
+    }
+}
+
+// Reads all files with non-blocking requests, at most 'window' requests are in flight
+double ReadFilesNonBlocking(Sys::AsyncFileReader &reader, const std::vector<std::string> &file_names,
+                            const size_t window, size_t &out_bytes_read) {
+    std::vector<Sys::DefaultFileReadBuf> bufs(window);
+    std::vector<Sys::FileReadEvent> events(window);
+    std::vector<int> slots(window, -1);
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+
+    out_bytes_read = 0;
+    size_t next_file = 0, files_done = 0;
+    while (files_done < file_names.size()) {
+        for (size_t i = 0; i < window && next_file < file_names.size(); ++i) {
+            if (slots[i] == -1) {
+                require(reader.ReadFileNonBlocking(file_names[next_file].c_str(), 0, Sys::WholeFile, bufs[i],
+                                                   events[i]));
+                slots[i] = int(next_file++);
+            }
+        }
+        reader.SubmitRequests();
+
+        bool any_finished = false;
+        for (size_t i = 0; i < window; ++i) {
+            if (slots[i] == -1) {
+                continue;
+            }
+            size_t bytes_read = 0;
+            const Sys::eFileReadResult res = events[i].GetResult(false /* block */, &bytes_read);
+            if (res != Sys::eFileReadResult::Pending) {
+                require(res == Sys::eFileReadResult::Successful);
+                out_bytes_read += bytes_read;
+                slots[i] = -1;
+                ++files_done;
+                any_finished = true;
+            }
+        }
+        if (!any_finished) {
+            std::this_thread::yield();
+        }
+    }
+
+    const auto t2 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(t2 - t1).count();
+}
+} // namespace
+
+void test_async_file(Sys::eFileReadBackend backend);
+
 void test_async_file() {
+    for (int i = 0; i < 4; ++i) {
+        Sys::AsyncFileReader reader(g_backends[i]);
+        if (g_backends[i] != Sys::eFileReadBackend::Default && reader.backend() != g_backends[i]) {
+            printf("\tSkipping %s backend (not available)\n", g_backend_names[i]);
+            continue;
+        }
+        test_async_file(g_backends[i]);
+    }
+}
+
+void test_async_file(const Sys::eFileReadBackend backend) {
     const char *test_file_name = "test.bin";
     const size_t test_file_size = 64 * 1000 * 1000;
 
@@ -25,7 +99,7 @@ void test_async_file() {
     }
 
     { // read file (blocking 1)
-        Sys::AsyncFileReader reader;
+        Sys::AsyncFileReader reader(backend);
         Sys::DefaultFileReadBuf buf;
 
         require(reader.ReadFileBlocking(test_file_name, 0 /* read_offset */, Sys::WholeFile, buf));
@@ -41,7 +115,7 @@ void test_async_file() {
         const size_t file_data_buf_size = test_file_size;
         file_data_buf.reset(new char[file_data_buf_size]);
 
-        Sys::AsyncFileReader reader;
+        Sys::AsyncFileReader reader(backend);
 
         size_t file_size = file_data_buf_size;
         require(reader.ReadFileBlocking(test_file_name, 0 /* read_offset */, Sys::WholeFile, file_data_buf.get(),
@@ -54,7 +128,7 @@ void test_async_file() {
     }
 
     { // read file (non-blocking 1)
-        Sys::AsyncFileReader reader;
+        Sys::AsyncFileReader reader(backend);
         Sys::DefaultFileReadBuf buf;
         Sys::FileReadEvent event;
 
@@ -72,7 +146,7 @@ void test_async_file() {
     }
 
     { // read file (non-blocking 2)
-        Sys::AsyncFileReader reader;
+        Sys::AsyncFileReader reader(backend);
         Sys::DefaultFileReadBuf buf;
         Sys::FileReadEvent event;
 
@@ -91,6 +165,81 @@ void test_async_file() {
         }
     }
 
+    { // read many small files (non-blocking, batched)
+        std::vector<std::string> file_names;
+        for (int i = 0; i < 100; ++i) {
+            file_names.push_back("test_small" + std::to_string(i) + ".bin");
+            WriteTestFile(file_names.back().c_str(), 1000 * size_t(1 + i % 5), test_data);
+        }
+
+        Sys::AsyncFileReader reader(backend);
+
+        std::vector<Sys::DefaultFileReadBuf> bufs(file_names.size());
+        std::vector<Sys::FileReadEvent> events(file_names.size());
+        for (size_t i = 0; i < file_names.size(); ++i) {
+            require(reader.ReadFileNonBlocking(file_names[i].c_str(), 0, Sys::WholeFile, bufs[i], events[i]));
+        }
+        reader.SubmitRequests();
+
+        for (size_t i = 0; i < file_names.size(); ++i) {
+            size_t bytes_read;
+            require(events[i].GetResult(true /* block */, &bytes_read) == Sys::eFileReadResult::Successful);
+            require(bytes_read == 1000 * (1 + i % 5));
+            require(bufs[i].data_len() == bytes_read);
+            for (size_t j = 0; j < bufs[i].data_len(); j += 1000) {
+                require(memcmp(&bufs[i].data()[j], &test_data[0], 1000) == 0);
+            }
+        }
+
+        size_t bytes_read = 0;
+        ReadFilesNonBlocking(reader, file_names, 16 /* window */, bytes_read);
+        require(bytes_read == 300 * 1000);
+
+        for (const std::string &name : file_names) {
+            std::remove(name.c_str());
+        }
+    }
+
     // remove test file
     std::remove(test_file_name);
 }
+
+void bench_async_file() {
+    uint8_t test_data[1000];
+    for (uint8_t &j : test_data) {
+        j = uint8_t(rand() % 256);
+    }
+
+    struct test_case_t {
+        const char *name;
+        int files_count;
+        size_t file_size;
+    } test_cases[] = {{"small", 2000, 16 * 1000}, {"large", 8, 32 * 1000 * 1000}};
+
+    for (const test_case_t &test : test_cases) {
+        std::vector<std::string> file_names;
+        for (int i = 0; i < test.files_count; ++i) {
+            file_names.push_back("bench_" + std::string(test.name) + std::to_string(i) + ".bin");
+            WriteTestFile(file_names.back().c_str(), test.file_size, test_data);
+        }
+
+        printf("\t%i x %i KB files:\n", test.files_count, int(test.file_size / 1000));
+        for (int i = 1; i < 4; ++i) {
+            Sys::AsyncFileReader reader(g_backends[i]);
+            if (reader.backend() != g_backends[i]) {
+                printf("\t\t%-10s n/a\n", g_backend_names[i]);
+                continue;
+            }
+
+            size_t bytes_read = 0;
+            const double t = ReadFilesNonBlocking(reader, file_names, 64 /* window */, bytes_read);
+            require(bytes_read == test.files_count * test.file_size);
+
+            printf("\t\t%-10s %10.2f MB/s\n", g_backend_names[i], double(bytes_read) / (1000.0 * 1000.0 * t));
+        }
+
+        for (const std::string &name : file_names) {
+            std::remove(name.c_str());
+        }
+    }
+}
@@ -1,6 +1,9 @@
 #include "test_common.h"
 
+#include <chrono>
+#include <cstring>
 #include <sstream>
+#include <vector>
 
 #include "../Json.h"
 
@@ -70,6 +73,73 @@ const char json_example3[] = "{\n"
                              "\t\t}\n"
                              "\t}\n"
                              "}";
+
+struct JsCountingHandler {
+    int literals = 0, numbers = 0, strings = 0, objects = 0, arrays = 0, keys = 0;
+    size_t members = 0, elements = 0;
+    int max_numbers = -1;
+
+    bool Literal(JsLiteralType) {
+        ++literals;
+        return true;
+    }
+    bool Number(double) { return ++numbers <= max_numbers || max_numbers == -1; }
+    bool String(const char *, size_t) {
+        ++strings;
+        return true;
+    }
+    bool StartObject() {
+        ++objects;
+        return true;
+    }
+    bool Key(const char *, size_t) {
+        ++keys;
+        return true;
+    }
+    bool EndObject(const size_t count) {
+        members += count;
+        return true;
+    }
+    bool StartArray() {
+        ++arrays;
+        return true;
+    }
+    bool EndArray(const size_t count) {
+        elements += count;
+        return true;
+    }
+};
+
+// Scene-like document (long arrays of numbers, many small objects)
+std::string GenerateSceneJson(const int meshes_count) {
+    std::stringstream ss;
+    ss << "{\n\t\"meshes\": [";
+    for (int i = 0; i < meshes_count; ++i) {
+        ss << (i ? ",\n\t\t{" : "\n\t\t{");
+        ss << "\"name\": \"mesh_" << i << "\", \"material\": \"material_" << (i % 50) << "\", \"visible\": true, ";
+        ss << "\"xform\": [";
+        for (int j = 0; j < 16; ++j) {
+            ss << (j ? ", " : "") << float(rand()) / float(RAND_MAX);
+        }
+        ss << "], \"vertices\": [";
+        for (int j = 0; j < 300; ++j) {
+            ss << (j ? ", " : "") << (float(rand()) / float(RAND_MAX) - 0.5f) * 100.0f;
+        }
+        ss << "], \"indices\": [";
+        for (int j = 0; j < 100; ++j) {
+            ss << (j ? ", " : "") << (rand() % 100);
+        }
+        ss << "]}";
+    }
+    ss << "\n\t],\n\t\"materials\": {";
+    for (int i = 0; i < 50; ++i) {
+        ss << (i ? ",\n\t\t" : "\n\t\t") << "\"material_" << i << "\": {\"type\": \"principled\", \"base_color\": [";
+        ss << float(rand()) / float(RAND_MAX) << ", 0.5, 1], \"base_texture\": \"textures/tex_" << i
+           << ".png\", \"roughness\": 0.25, \"emissive\": null}";
+    }
+    ss << "\n\t}\n}";
+    return ss.str();
+}
 }
 
 void test_json() {
@@ -663,4 +733,225 @@ AGAIN5:
             goto AGAIN6;
         }
     }
+
+    { // In-situ parser (same DOM as with stream parser)
+        const char *examples[] = {json_example, json_example2, json_example3};
+        for (const char *example : examples) {
+            JsElement el1(JsLiteralType::Null);
+            std::stringstream ss(example);
+            require(el1.Read(ss));
+
+            std::vector<char> buf(example, example + strlen(example));
+            JsElement el2(JsLiteralType::Null);
+            require(el2.Read(buf.data(), buf.size()));
+            require(el1 == el2);
+
+            Sys::MultiPoolAllocator<char> my_alloc(32, 512);
+            buf.assign(example, example + strlen(example));
+            JsObjectP obj(my_alloc);
+            require(obj.Read(buf.data(), buf.size()));
+            require(obj.Size() == 1);
+        }
+    }
+
+    { // In-situ parser (SAX events)
+        char buf[] = R"([{"a": 1, "b": [true, false, null, "str"]}, -2.5, {}, []])";
+        JsCountingHandler h;
+        JsReader reader(buf, strlen(buf));
+        require(reader.Parse(h));
+        require(h.objects == 2 && h.arrays == 3 && h.keys == 2 && h.members == 2 && h.elements == 8);
+        require(h.literals == 3 && h.numbers == 2 && h.strings == 1);
+        require(std::string(buf + 36, 3) == "str" && buf[39] == '\0');
+    }
+
+    { // In-situ parser (strings and numbers)
+        char buf[] = R"({"str": "a\"b\\c\/d\n\t\u00e9\ud83d\ude00", "nums": [0, -0.5, 1e3, 0.1, 3.14159265358979, )"
+                     R"(123456789012345678901234, 1.7976931348623157e308, 5e-324, 2.2250738585072014E-308, 1e-400]})";
+        JsElement el(JsLiteralType::Null);
+        require(el.Read(buf, strlen(buf)));
+
+        const JsObject &root = el.as_obj();
+        require(root.at("str").as_str().val == "a\"b\\c/d\n\t\xc3\xa9\xf0\x9f\x98\x80");
+
+        const char *nums[] = {"0", "-0.5", "1e3", "0.1", "3.14159265358979", "123456789012345678901234",
+                              "1.7976931348623157e308", "5e-324", "2.2250738585072014E-308", "1e-400"};
+        const JsArray &arr = root.at("nums").as_arr();
+        require(arr.Size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            require(arr[i].as_num().val == strtod(nums[i], nullptr));
+        }
     }
+
+    { // In-situ parser (buffer is not null-terminated)
+        char buf[] = "[1, 2]123";
+        JsElement el(JsLiteralType::Null);
+        require(el.Read(buf, 6));
+        require(el.as_arr().Size() == 2);
+
+        char buf2[] = "{\"abc\": 12";
+        require(!el.Read(buf2, 9));
+        char buf3[] = "\"abcdef\"";
+        require(!el.Read(buf3, 5));
+    }
+
+    { // In-situ parser (errors)
+        const char *invalid[] = {"",        "{",        "[1,]",     "{\"a\" 1}", "[1 2]",   "\"abc",  "tru",
+                                 "[1] x",   "{\"a\":}", "[-]",      "[1.]",      "[1e]",    "\"\\x\"", "\"\\u12\"",
+                                 "{1: 2}",  "[,1]",     "\"\\ud800\"", "nul",   "[01x]"};
+        for (const char *str : invalid) {
+            std::vector<char> buf(str, str + strlen(str));
+            JsCountingHandler h;
+            JsReader reader(buf.data(), buf.size());
+            require(!reader.Parse(h));
+            require(reader.error() != nullptr);
+        }
+
+        std::vector<char> deep(10000, '[');
+        JsCountingHandler h;
+        JsReader reader(deep.data(), deep.size());
+        require(!reader.Parse(h));
+        require(strcmp(reader.error(), "Too deep nesting") == 0);
+    }
+
+    { // In-situ parser (stopped by handler)
+        char buf[] = "[1, 2, 3, 4]";
+        JsCountingHandler h;
+        h.max_numbers = 2;
+        JsReader reader(buf, strlen(buf));
+        require(!reader.Parse(h));
+        require(h.numbers == 3);
+        require(strcmp(reader.error(), "Stopped by handler") == 0);
+    }
+
+    { // Arena document
+        const char *examples[] = {json_example, json_example2, json_example3};
+        JsArenaDocument doc(1024);
+        for (const char *example : examples) {
+            JsElement el1(JsLiteralType::Null);
+            std::stringstream ss1(example);
+            require(el1.Read(ss1));
+
+            std::stringstream ss2(example);
+            require(doc.Read(ss2));
+
+            std::stringstream out1, out2;
+            el1.Write(out1);
+            doc.root().Write(out2);
+            require(out1.str() == out2.str());
+
+            std::vector<char> buf(example, example + strlen(example));
+            require(el1.Read(buf.data(), buf.size()));
+            buf.assign(example, example + strlen(example));
+            require(doc.Read(buf.data(), buf.size()));
+
+            out1.str({});
+            out2.str({});
+            el1.Write(out1);
+            doc.root().Write(out2);
+            require(out1.str() == out2.str());
+        }
+
+        // nodes allocated with the same arena can be added
+        JsObjectA &root = doc.root().as_obj();
+        root.Push("added", JsElementA{"new string", doc.alloc()});
+        root["added"].as_str().val += " (modified)";
+        require(root.at("added").as_str().val == "new string (modified)");
+
+        const size_t allocs_before = doc.arena().allocations_count();
+        root.Push("number", JsElementA{42});
+        require(doc.arena().allocations_count() > allocs_before);
+
+        // large document spans several blocks, all of them (except one) are released at once
+        std::string scene = GenerateSceneJson(100);
+        std::vector<char> buf(scene.begin(), scene.end());
+        require(doc.Read(buf.data(), buf.size()));
+        require(doc.root().as_obj().at("meshes").as_arr().Size() == 100);
+        require(doc.arena().blocks_count() > 1);
+        // at least object and three arrays per mesh
+        require(doc.arena().allocations_count() >= 4 * 100);
+
+        doc.Clear();
+        require(doc.arena().blocks_count() == 1);
+        require(doc.arena().allocations_count() == 1); // root element
+        require(doc.root().type() == JsType::Literal);
+    }
+}
+
+void bench_json() {
+    using namespace std::chrono;
+
+    const std::string scene = GenerateSceneJson(10000);
+    const double size_mb = double(scene.size()) / (1000.0 * 1000.0);
+    printf("\tScene JSON size %.2f MB\n", size_mb);
+
+    JsElement el1(JsLiteralType::Null), el2(JsLiteralType::Null);
+
+    { // stream parser
+        std::stringstream ss(scene);
+        const auto t1 = high_resolution_clock::now();
+        require(el1.Read(ss));
+        const double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tstream parser  %10.2f MB/s\n", size_mb / t);
+    }
+
+    std::vector<char> buf(scene.begin(), scene.end());
+    { // in-situ parser (SAX only)
+        JsCountingHandler h;
+        JsReader reader(buf.data(), buf.size());
+        const auto t1 = high_resolution_clock::now();
+        require(reader.Parse(h));
+        const double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tin-situ SAX    %10.2f MB/s\n", size_mb / t);
+    }
+
+    buf.assign(scene.begin(), scene.end());
+    { // in-situ parser (DOM)
+        const auto t1 = high_resolution_clock::now();
+        require(el2.Read(buf.data(), buf.size()));
+        const double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tin-situ DOM    %10.2f MB/s\n", size_mb / t);
+    }
+
+    require(el1 == el2);
+
+    { // teardown of DOM
+        const auto t1 = high_resolution_clock::now();
+        el2 = JsElement(JsLiteralType::Null);
+        const double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tDOM destroy    %10.2f ms\n", t * 1000.0);
+    }
+
+    buf.assign(scene.begin(), scene.end());
+    { // in-situ parser (pooled DOM)
+        Sys::MultiPoolAllocator<char> my_alloc(32, 512);
+        JsElementP el(JsLiteralType::Null);
+        auto t1 = high_resolution_clock::now();
+        require(el.Read(buf.data(), buf.size(), my_alloc));
+        double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tpooled DOM     %10.2f MB/s\n", size_mb / t);
+
+        t1 = high_resolution_clock::now();
+        el = JsElementP(JsLiteralType::Null);
+        t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tpooled destroy %10.2f ms\n", t * 1000.0);
+    }
+
+    buf.assign(scene.begin(), scene.end());
+    { // in-situ parser (DOM in arena)
+        JsArenaDocument doc;
+        auto t1 = high_resolution_clock::now();
+        require(doc.Read(buf.data(), buf.size()));
+        double t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tarena DOM      %10.2f MB/s\n", size_mb / t);
+
+        const Sys::MonoArena &arena = doc.arena();
+        printf("\t\t\t%zu allocations in %zu blocks (%.2f MB used, %.2f MB reserved)\n",
+               arena.allocations_count(), arena.blocks_count(), double(arena.bytes_used()) / (1000.0 * 1000.0),
+               double(arena.bytes_reserved()) / (1000.0 * 1000.0));
+
+        t1 = high_resolution_clock::now();
+        doc.Clear();
+        t = duration<double>(high_resolution_clock::now() - t1).count();
+        printf("\t\tarena clear    %10.2f ms\n", t * 1000.0);
+    }
+}
@@ -0,0 +1,46 @@
+#include "test_common.h"
+
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "../MappedFile.h"
+
+void test_mapped_file() {
+    const char *test_file_name = "test_mapped.bin";
+
+    uint8_t test_data[1000];
+    for (uint8_t &j : test_data) {
+        j = uint8_t(rand() % 256);
+    }
+
+    { // create test file
+        std::ofstream out_file(test_file_name, std::ios::binary);
+        out_file.write((char *)test_data, sizeof(test_data));
+    }
+
+    { // map file
+        Sys::MappedFile file(test_file_name);
+        require(bool(file));
+        require(file.size() == sizeof(test_data));
+        require(memcmp(file.data(), test_data, sizeof(test_data)) == 0);
+
+        Sys::MappedFile file2 = std::move(file);
+        require(!file);
+        require(bool(file2));
+        require(file2.size() == sizeof(test_data));
+        require(memcmp(file2.data(), test_data, sizeof(test_data)) == 0);
+
+        file2.Close();
+        require(!file2);
+        require(file2.size() == 0);
+    }
+
+    { // non-existing file
+        Sys::MappedFile file("non_existing_file.bin");
+        require(!file);
+        require(!file.Open(""));
+    }
+
+    std::remove(test_file_name);
+}
@@ -3,54 +3,254 @@
 #include <algorithm>
 #include <fstream>
 #include <memory>
+#include <string>
 
 #include "../AssetFile.h"
 #include "../Pack.h"
 
 namespace {
-std::vector<std::string> file_list = {"./constant.fs", "./src/CMakeLists.txt"};
-}
-
-void test_pack() {
+std::vector<std::string> file_list = {"./test_pack_text.txt", "./test_pack_random.bin", "./test_pack_large.bin",
+                                      "./test_pack_empty.bin"};
 
-    {
-        // Save/Load package
-        Sys::WritePackage("./my_pack.pack", file_list);
+std::vector<char> ReadWholeFile(const char *name) {
+    std::ifstream in_file(name, std::ios::ate | std::ios::binary);
+    std::vector<char> ret(size_t(in_file.tellg()));
+    ret.reserve(ret.size() + 1); // avoid null data pointer for empty file
+    in_file.seekg(0, std::ios::beg);
+    in_file.read(ret.data(), std::streamsize(ret.size()));
+    return ret;
+}
 
+void CheckPackage(const char *pack_name, const bool expect_aligned, const bool expect_compressed) {
+    { // read whole package
         auto OnFile = [](const char *name, void *data, int size) {
             auto it = std::find(file_list.begin(), file_list.end(), name);
             require(it != file_list.end());
 
-            Sys::AssetFile in_file(name, Sys::eOpenMode::In);
-            require(in_file.size() == size);
-
-            std::unique_ptr<char[]> buf(new char[size]);
-            in_file.Read(buf.get(), (size_t)size);
-            const char *p1 = (char *)data;
-            const char *p2 = buf.get();
-            require(memcmp(p1, p2, (size_t)size) == 0);
+            const std::vector<char> file_data = ReadWholeFile(name);
+            require(file_data.size() == size_t(size));
+            require(memcmp(data, file_data.data(), file_data.size()) == 0);
         };
-        Sys::ReadPackage("./my_pack.pack", OnFile);
+        require(Sys::ReadPackage(pack_name, OnFile));
+
+        const std::vector<std::string> list = Sys::EnumFilesInPackage(pack_name);
+        require(list == file_list);
+    }
+
+    { // lookup and random access
+        Sys::PackageReader pack(pack_name);
+        require(bool(pack));
+        require(pack.entries_count() == file_list.size());
+        require(pack.Find("./missing.bin") == -1);
+
+        bool any_compressed = false;
+        for (int i = 0; i < int(file_list.size()); ++i) {
+            const std::vector<char> file_data = ReadWholeFile(file_list[i].c_str());
 
-        std::vector<Sys::FileDesc> list = Sys::EnumFilesInPackage("./my_pack.pack");
+            const int index = pack.Find(file_list[i].c_str());
+            require(index == i);
+            require(pack.entry(index).size == file_data.size());
+            require(!expect_aligned || (pack.entry(index).off % Sys::PackPageSize) == 0);
+
+            const bool compressed = (pack.entry(index).flags & Sys::PackEntryCompressed) != 0;
+            any_compressed |= compressed;
+            if (!compressed) {
+                // zero-copy access
+                require(memcmp(pack.data(index), file_data.data(), file_data.size()) == 0);
+            }
+
+            Sys::PackBlockCache cache;
+            std::vector<char> buf(file_data.size() + 1);
+            const size_t positions[] = {0, 1, 1000, Sys::PackBlockSize - 10, Sys::PackBlockSize,
+                                        3 * Sys::PackBlockSize + 7};
+            for (const size_t pos : positions) {
+                for (const size_t size : {size_t(1), size_t(100), size_t(Sys::PackBlockSize + 20)}) {
+                    const size_t expected = pos < file_data.size() ? std::min(size, file_data.size() - pos) : 0;
+                    require(pack.Read(index, pos, buf.data(), size, &cache) == expected);
+                    require(memcmp(buf.data(), file_data.data() + std::min(pos, file_data.size()), expected) == 0);
+                    require(pack.Read(index, pos, buf.data(), size) == expected);
+                    require(memcmp(buf.data(), file_data.data() + std::min(pos, file_data.size()), expected) == 0);
+                }
+            }
+        }
+        require(any_compressed == expect_compressed);
+    }
 
-        require(std::string(list[0].name) == "./constant.fs");
-        require(std::string(list[1].name) == "./src/CMakeLists.txt");
+    { // partial read
+        std::vector<char> buf(10);
+        require(Sys::ReadFromPackage(pack_name, "./test_pack_text.txt", 5, buf.data(), buf.size()));
+        const std::vector<char> file_data = ReadWholeFile("./test_pack_text.txt");
+        require(memcmp(buf.data(), &file_data[5], buf.size()) == 0);
+        require(!Sys::ReadFromPackage(pack_name, "./missing.bin", 0, buf.data(), buf.size()));
+        // range is clamped to entry size
+        require(Sys::ReadFromPackage(pack_name, "./test_pack_text.txt", file_data.size() - 3, buf.data(), buf.size()));
+        require(memcmp(buf.data(), &file_data[file_data.size() - 3], 3) == 0);
+        require(!Sys::ReadFromPackage(pack_name, "./test_pack_text.txt", file_data.size() + 1, buf.data(), buf.size()));
     }
 
-    {
-        // Add package to AssetFile
-        Sys::AssetFile::AddPackage("./my_pack.pack");
+    { // add package to AssetFile
+        Sys::AssetFile::AddPackage(pack_name);
+
+        const std::vector<char> file_data = ReadWholeFile("./test_pack_large.bin");
+
+        // files in package are found first
+        std::remove("./test_pack_large.bin");
+
+        Sys::AssetFile in_file("./test_pack_large.bin", Sys::eOpenMode::In);
+        require(bool(in_file));
+        require(in_file.size() == file_data.size());
+        require(bool(in_file.data()) == !expect_compressed);
+
+        // sequential reads in small portions
+        std::vector<char> buf(file_data.size());
+        size_t pos = 0;
+        while (pos < buf.size()) {
+            const size_t bytes_read = in_file.Read(&buf[pos], std::min(size_t(1000), buf.size() - pos));
+            require(bytes_read != 0);
+            pos += bytes_read;
+        }
+        require(in_file.pos() == buf.size());
+        require(memcmp(buf.data(), file_data.data(), file_data.size()) == 0);
+
+        in_file.SeekAbsolute(12345);
+        require(in_file.Read(buf.data(), 10) == 10);
+        require(memcmp(buf.data(), &file_data[12345], 10) == 0);
+
+        Sys::AssetFile::RemovePackage(pack_name);
+
+        std::ofstream out_file("./test_pack_large.bin", std::ios::binary);
+        out_file.write(file_data.data(), std::streamsize(file_data.size()));
+    }
+}
+} // namespace
+
+void test_pack() {
+    { // create test files
+        std::ofstream text_file(file_list[0], std::ios::binary);
+        for (int i = 0; i < 1000; ++i) {
+            text_file << "Line number " << i << " of test file\n";
+        }
 
-        Sys::AssetFile in_file1("./constant.fs", Sys::eOpenMode::In);
-        std::ifstream in_file2("./constant.fs", std::ios::ate | std::ios::binary);
-        size_t size = (size_t)in_file2.tellg();
-        in_file2.seekg(0, std::ios::beg);
-        require(in_file1.size() == size);
+        std::ofstream random_file(file_list[1], std::ios::binary);
+        for (int i = 0; i < 100000; ++i) {
+            random_file.put(char(rand() % 256));
+        }
+
+        // repeated random sequences, several blocks in size
+        std::vector<char> seq(3000);
+        for (char &c : seq) {
+            c = char(rand() % 256);
+        }
+        std::ofstream large_file(file_list[2], std::ios::binary);
+        for (int i = 0; i < 150; ++i) {
+            large_file.write(&seq[rand() % 1000], 2000);
+        }
+
+        std::ofstream empty_file(file_list[3], std::ios::binary);
+    }
+
+    { // legacy package
+        std::ofstream out_file("./test_pack_v1.pack", std::ios::binary);
+        const auto num_files = uint32_t(file_list.size());
+        out_file.write((const char *)&num_files, sizeof(uint32_t));
+
+        uint32_t file_pos = sizeof(uint32_t) + num_files * sizeof(Sys::FileDesc);
+        for (const std::string &f : file_list) {
+            Sys::FileDesc desc = {};
+            strcpy(desc.name, f.c_str());
+            desc.off = file_pos;
+            desc.size = uint32_t(ReadWholeFile(f.c_str()).size());
+            out_file.write((const char *)&desc, sizeof(Sys::FileDesc));
+            file_pos += desc.size;
+        }
+        for (const std::string &f : file_list) {
+            const std::vector<char> file_data = ReadWholeFile(f.c_str());
+            out_file.write(file_data.data(), std::streamsize(file_data.size()));
+        }
+    }
+    CheckPackage("./test_pack_v1.pack", false /* expect_aligned */, false /* expect_compressed */);
+
+    Sys::WritePackage("./test_pack.pack", file_list);
+    CheckPackage("./test_pack.pack", true /* expect_aligned */, false /* expect_compressed */);
+
+    Sys::WritePackage("./test_pack_lz.pack", file_list, true /* compress */);
+    CheckPackage("./test_pack_lz.pack", true /* expect_aligned */, true /* expect_compressed */);
+
+    { // random data is stored uncompressed, text and repeated sequences are compressed
+        Sys::PackageReader pack("./test_pack_lz.pack");
+        require((pack.entry(0).flags & Sys::PackEntryCompressed) != 0);
+        require((pack.entry(1).flags & Sys::PackEntryCompressed) == 0);
+        require((pack.entry(2).flags & Sys::PackEntryCompressed) != 0);
+        require(pack.entry(2).stored_size < pack.entry(2).size / 4);
+    }
+
+    { // many entries
+        std::vector<std::string> many_files;
+        for (int i = 0; i < 2000; ++i) {
+            many_files.push_back("./test_pack_" + std::to_string(i) + ".txt");
+            std::ofstream out_file(many_files.back(), std::ios::binary);
+            out_file << "file " << i;
+        }
+        Sys::WritePackage("./test_pack_many.pack", many_files, true /* compress */);
+
+        Sys::PackageReader pack("./test_pack_many.pack");
+        require(pack.entries_count() == many_files.size());
+        for (int i = 0; i < int(many_files.size()); ++i) {
+            const int index = pack.Find(many_files[i].c_str());
+            require(index == i);
+
+            const std::string expected = "file " + std::to_string(i);
+            char buf[32] = {};
+            require(pack.Read(index, 0, buf, sizeof(buf)) == expected.size());
+            require(expected == buf);
+        }
+
+        for (const std::string &f : many_files) {
+            std::remove(f.c_str());
+        }
+        std::remove("./test_pack_many.pack");
+    }
+
+    { // corrupted package is rejected
+        std::vector<char> pack_data = ReadWholeFile("./test_pack.pack");
+        reinterpret_cast<Sys::PackHeader *>(pack_data.data())->entries_off = uint64_t(pack_data.size());
+        std::ofstream out_file("./test_pack_bad.pack", std::ios::binary);
+        out_file.write(pack_data.data(), std::streamsize(pack_data.size()));
+        out_file.close();
+
+        Sys::PackageReader pack("./test_pack_bad.pack");
+        require(!pack);
+        require_throws(Sys::AssetFile::AddPackage("./test_pack_bad.pack"));
+        std::remove("./test_pack_bad.pack");
+    }
+
+    { // read of corrupted compressed entry fails
+        std::vector<char> pack_data = ReadWholeFile("./test_pack_lz.pack");
+        {
+            Sys::PackageReader pack("./test_pack_lz.pack");
+            const Sys::PackEntry &e = pack.entry(2);
+            require((e.flags & Sys::PackEntryCompressed) != 0);
+            // end of first block points outside of entry data
+            const uint64_t bad_block_end = e.stored_size + 1;
+            memcpy(&pack_data[size_t(e.off)], &bad_block_end, sizeof(uint64_t));
+        }
+        std::ofstream out_file("./test_pack_bad.pack", std::ios::binary);
+        out_file.write(pack_data.data(), std::streamsize(pack_data.size()));
+        out_file.close();
+
+        auto OnFile = [](const char *name, void *data, int size) { require(strcmp(name, file_list[2].c_str()) != 0); };
+        require(!Sys::ReadPackage("./test_pack_bad.pack", OnFile));
+
+        std::vector<char> buf(10);
+        require(!Sys::ReadFromPackage("./test_pack_bad.pack", file_list[2].c_str(), 0, buf.data(), buf.size()));
+        require(Sys::ReadFromPackage("./test_pack_bad.pack", file_list[0].c_str(), 0, buf.data(), buf.size()));
+        std::remove("./test_pack_bad.pack");
+    }
 
-        std::unique_ptr<char[]> buf1(new char[size]), buf2(new char[size]);
-        require(in_file1.Read(buf1.get(), size));
-        in_file2.read(buf2.get(), size);
-        require(memcmp(buf1.get(), buf2.get(), size) == 0);
+    for (const std::string &f : file_list) {
+        std::remove(f.c_str());
     }
+    std::remove("./test_pack_v1.pack");
+    std::remove("./test_pack.pack");
+    std::remove("./test_pack_lz.pack");
 }